@@ -0,0 +1,241 @@
+#include "BatchRenderer.h"
+#include "Benchmark.h"
+#include "Json.h"
+#include "Png.h"
+#include "ReadbackRing.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+namespace {
+	uint32_t ReadUint(const JsonValue& value, uint32_t defaultValue) {
+		const double number = value.AsNumber(static_cast<double>(defaultValue));
+		return (number > 0.0) ? static_cast<uint32_t>(number) : defaultValue;
+	}
+}
+
+bool LoadBatchManifest(const std::string& path, BatchOptions& options, std::vector<BatchJob>& jobs, std::string& error) {
+	JsonValue manifest;
+	if (!JsonValue::ReadFile(path, manifest, error)) {
+		return false;
+	}
+	if (!manifest.IsObject() || !manifest["jobs"].IsArray()) {
+		error = "manifest needs a \"jobs\" array";
+		return false;
+	}
+
+	if (manifest["output"].IsString()) {
+		options.outputDirectory = manifest["output"].AsString();
+	}
+	options.inFlight = ReadUint(manifest["inFlight"], options.inFlight);
+
+	BatchJob defaults;
+	defaults.extent.width = ReadUint(manifest["width"], defaults.extent.width);
+	defaults.extent.height = ReadUint(manifest["height"], defaults.extent.height);
+	defaults.triangleCount = ReadUint(manifest["triangles"], 1024);
+
+	const JsonValue& entries = manifest["jobs"];
+	jobs.clear();
+	for (size_t i = 0; i < entries.Size(); ++i) {
+		const JsonValue& entry = entries[i];
+		BatchJob job = defaults;
+		job.name = entry["name"].IsString() ? entry["name"].AsString() : "job_" + std::to_string(i);
+		job.extent.width = ReadUint(entry["width"], defaults.extent.width);
+		job.extent.height = ReadUint(entry["height"], defaults.extent.height);
+		job.triangleCount = ReadUint(entry["triangles"], defaults.triangleCount);
+
+		const std::string scene = entry["scene"].IsString() ? entry["scene"].AsString() : "triangles";
+		if (scene == "clear") {
+			job.triangleCount = 0;
+		}
+		else if (scene != "triangles") {
+			error = "job " + job.name + " has an unknown scene " + scene;
+			return false;
+		}
+
+		const JsonValue& camera = entry["camera"];
+		job.camera.centerX = static_cast<float>(camera["x"].AsNumber(0.0));
+		job.camera.centerY = static_cast<float>(camera["y"].AsNumber(0.0));
+		job.camera.zoom = static_cast<float>(camera["zoom"].AsNumber(1.0));
+		jobs.push_back(job);
+	}
+	return true;
+}
+
+BatchRenderer::BatchRenderer(VulkanBase& vulkan, const BatchOptions& options) :
+	Vulkan(vulkan),
+	Options(options),
+	ImagesRendered(0),
+	ElapsedMs(0.0) {
+	if (Options.inFlight < 1) {
+		Options.inFlight = 1;
+	}
+}
+
+bool BatchRenderer::Run(const std::vector<BatchJob>& jobs) {
+	ImagesRendered = 0;
+	BenchmarkTimer timer;
+
+	VkDeviceSize largestImage = 0;
+	for (const BatchJob& job : jobs) {
+		largestImage = std::max<VkDeviceSize>(largestImage, static_cast<VkDeviceSize>(job.extent.width) * job.extent.height * 4);
+	}
+	if (largestImage == 0) {
+		return true;
+	}
+
+	// Twice the slots, so writers can be busy with one round of images while the next one renders.
+	// The ring's workers write the PNGs straight from mapped memory.
+	ReadbackRing ring(Vulkan.GetDeviceContext());
+	if (!ring.Create(2 * Options.inFlight, largestImage, Options.writerThreads)) {
+		return false;
+	}
+	std::atomic<bool> writeFailed(false);
+
+	std::vector<std::unique_ptr<OffscreenRenderer>> renderers(Options.inFlight);
+	bool result = true;
+	for (size_t i = 0; result && (i < jobs.size()); ++i) {
+		const BatchJob& job = jobs[i];
+		std::unique_ptr<OffscreenRenderer>& renderer = renderers[i % renderers.size()];
+
+		// Targets and vertex buffers are only recreated when the job differs from the slot's previous one.
+		// Waiting here only throttles on the GPU, the readback itself is tracked by the ring.
+		if (!renderer) {
+			renderer.reset(new OffscreenRenderer(Vulkan));
+			result = renderer->Create(job.extent);
+		}
+		else if ((renderer->GetExtent().width != job.extent.width) || (renderer->GetExtent().height != job.extent.height)) {
+			result = renderer->Resize(job.extent);
+		}
+		result = result && renderer->Wait() && renderer->SetTriangleCount(job.triangleCount);
+
+		// Blocks only while writers are behind
+		ReadbackTicket ticket;
+		if (!result || !ring.Acquire(static_cast<VkDeviceSize>(job.extent.width) * job.extent.height * 4, ticket)) {
+			std::cout << "BATCH JOB " << job.name << " FAILED " << std::endl;
+			result = false;
+			break;
+		}
+
+		OffscreenDrawList drawList;
+		drawList.drawCount = (job.triangleCount > 0) ? 1 : 0;
+		drawList.trianglesPerDraw = job.triangleCount;
+		drawList.camera = job.camera;
+		drawList.readback = &ticket;
+		if (!renderer->Record(drawList) || !renderer->Submit()) {
+			ring.Cancel(ticket);
+			std::cout << "BATCH JOB " << job.name << " FAILED " << std::endl;
+			result = false;
+			break;
+		}
+
+		const std::string path = GetPath(job);
+		const bool writeImages = Options.writeImages;
+		result = ring.Commit(ticket, job.extent, renderer->GetFormat(), [path, writeImages, &writeFailed](const ReadbackData& data) {
+			if (data.data == nullptr) {
+				return;
+			}
+			if (writeImages && !Png::Write(path, data.extent.width, data.extent.height, data.data)) {
+				std::cout << "COULD NOT WRITE " << path << std::endl;
+				writeFailed = true;
+			}
+		});
+		ImagesRendered += result ? 1 : 0;
+	}
+
+	ring.Drain();
+	for (std::unique_ptr<OffscreenRenderer>& renderer : renderers) {
+		if (renderer && !renderer->Wait()) {
+			result = false;
+		}
+	}
+	result = result && !writeFailed && !ring.HasFailed();
+
+	ElapsedMs = timer.ElapsedMs();
+	return result;
+}
+
+size_t BatchRenderer::GetImagesRendered() const {
+	return ImagesRendered;
+}
+
+double BatchRenderer::GetElapsedMs() const {
+	return ElapsedMs;
+}
+
+std::string BatchRenderer::GetPath(const BatchJob& job) const {
+	std::string path = Options.outputDirectory;
+	if (!path.empty() && (path.back() != '/') && (path.back() != '\\')) {
+		path += '/';
+	}
+	return path + job.name + ".png";
+}
+
+// ***** --batch mode ***** //
+
+int RunBatchRenderer(int argc, char* argv[]) {
+	std::string manifestPath;
+	BatchOptions options;
+	std::string outputDirectory;
+	uint32_t inFlight = 0;
+
+	// --batch MANIFEST : render every job of the manifest (see LoadBatchManifest())
+	// --in-flight N    : offscreen targets rendering at the same time (default from the manifest, else 4)
+	// --writers N      : PNG writer threads (default 2)
+	// --output DIR     : existing directory for the images, overrides the manifest
+	// --no-write       : render and read back without writing files, to measure the GPU side alone
+	for (int i = 1; i < argc; ++i) {
+		if ((strcmp(argv[i], "--batch") == 0) && (i + 1 < argc)) {
+			manifestPath = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--in-flight") == 0) && (i + 1 < argc)) {
+			inFlight = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if ((strcmp(argv[i], "--writers") == 0) && (i + 1 < argc)) {
+			options.writerThreads = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if ((strcmp(argv[i], "--output") == 0) && (i + 1 < argc)) {
+			outputDirectory = argv[++i];
+		}
+		else if (strcmp(argv[i], "--no-write") == 0) {
+			options.writeImages = false;
+		}
+	}
+
+	if (manifestPath.empty()) {
+		std::cout << "--batch NEEDS A MANIFEST " << std::endl;
+		return 2;
+	}
+
+	std::vector<BatchJob> jobs;
+	std::string error;
+	if (!LoadBatchManifest(manifestPath, options, jobs, error)) {
+		std::cout << "COULD NOT LOAD BATCH MANIFEST: " << error << std::endl;
+		return 2;
+	}
+	if (!outputDirectory.empty()) {
+		options.outputDirectory = outputDirectory;
+	}
+	if (inFlight > 0) {
+		options.inFlight = inFlight;
+	}
+
+	VulkanBase vulkan;
+	if (!vulkan.PrepareVulkanHeadless()) {
+		return 2;
+	}
+
+	BatchRenderer renderer(vulkan, options);
+	const bool result = renderer.Run(jobs);
+
+	const double seconds = renderer.GetElapsedMs() / 1000.0;
+	std::cout << "Batch: " << renderer.GetImagesRendered() << " of " << jobs.size() << " images in " << renderer.GetElapsedMs() << " ms";
+	if (seconds > 0.0) {
+		std::cout << ", " << static_cast<double>(renderer.GetImagesRendered()) / seconds << " images/s";
+	}
+	std::cout << " (" << options.inFlight << " in flight, " << options.writerThreads << " writers)" << std::endl;
+	return result ? 0 : 2;
+}
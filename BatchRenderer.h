@@ -0,0 +1,67 @@
+#pragma once
+
+#include "OffscreenRenderer.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One image of an offline batch: which scene, from where and how large
+struct BatchJob {
+	std::string name;			// Output is <output directory>/<name>.png
+	uint32_t triangleCount;		// 0 renders the clear scene
+	VkExtent2D extent;
+	OffscreenCamera camera;
+
+	BatchJob() :
+		name(),
+		triangleCount(0),
+		extent({ 512, 512 }),
+		camera() {
+	}
+};
+
+struct BatchOptions {
+	std::string outputDirectory;	// Must exist
+	uint32_t inFlight;				// Offscreen targets (each with its own command buffer) rendering at the same time
+	uint32_t writerThreads;			// Threads encoding and writing PNGs
+	bool writeImages;				// False measures rendering and readback only
+
+	BatchOptions() :
+		outputDirectory("."),
+		inFlight(4),
+		writerThreads(2),
+		writeImages(true) {
+	}
+};
+
+// Reads a job manifest. Top level "width", "height", "triangles" and "output" are defaults for the jobs,
+// every entry of "jobs" may override them and set "name", "scene" ("clear" or "triangles") and
+// "camera": { "x", "y", "zoom" }.
+bool LoadBatchManifest(const std::string& path, BatchOptions& options, std::vector<BatchJob>& jobs, std::string& error);
+
+// Renders jobs through a fixed pool of offscreen targets. A target is only waited for when its turn comes
+// again, so the GPU always has inFlight frames queued. Images are copied into a ReadbackRing and written
+// by its workers straight from mapped memory while the next ones render.
+class BatchRenderer {
+public:
+	BatchRenderer(VulkanBase& vulkan, const BatchOptions& options);
+
+	BatchRenderer(const BatchRenderer&) = delete;
+	BatchRenderer& operator=(const BatchRenderer&) = delete;
+
+	bool Run(const std::vector<BatchJob>& jobs);
+
+	size_t GetImagesRendered() const;
+	double GetElapsedMs() const;
+
+private:
+	std::string GetPath(const BatchJob& job) const;
+
+	VulkanBase& Vulkan;
+	BatchOptions Options;
+	size_t ImagesRendered;
+	double ElapsedMs;
+};
+
+// Entry point of the --batch mode, returns the process exit code
+int RunBatchRenderer(int argc, char* argv[]);
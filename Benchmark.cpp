@@ -0,0 +1,1420 @@
+#include "Benchmark.h"
+#include "ClusteredLighting.h"
+#include "ComputePrimitives.h"
+#include "ComputeQueue.h"
+#include "DynamicResolution.h"
+#include "FrameCapture.h"
+#include "GpuTimer.h"
+#include "LevelOfDetail.h"
+#include "Meshlets.h"
+#include "OcclusionCulling.h"
+#include "OffscreenRenderer.h"
+#include "ParticleSystem.h"
+#include "SceneAssets.h"
+#include "SceneGraph.h"
+#include "ShadowCascades.h"
+#include "SkeletalAnimation.h"
+#include "TemporalUpscaling.h"
+#include "VulkanFunctions.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+
+namespace {
+	// Sizes cycled through by the resize storm, including odd ones
+	const VkExtent2D ResizeStormExtents[] = {
+		{ 1280, 720 }, { 640, 480 }, { 1920, 1080 }, { 333, 777 }, { 1024, 1024 }, { 64, 64 }, { 1279, 719 }
+	};
+
+	double Percentile(std::vector<double> values, double percentile) {
+		if (values.empty()) {
+			return 0.0;
+		}
+		size_t index = static_cast<size_t>(percentile / 100.0 * static_cast<double>(values.size() - 1) + 0.5);
+		std::nth_element(values.begin(), values.begin() + index, values.end());
+		return values[index];
+	}
+
+	// Largest difference (0 to 255) between the average colors of corresponding cells of a grid laid over two tightly
+	// packed RGBA8 images, which may differ in size
+	double GridDifference(const std::vector<uint8_t>& a, VkExtent2D aExtent, const std::vector<uint8_t>& b, VkExtent2D bExtent, uint32_t cells) {
+		auto averages = [cells](const std::vector<uint8_t>& rgba, VkExtent2D extent) {
+			std::vector<double> sums(cells * cells * 3, 0.0);
+			std::vector<uint32_t> counts(cells * cells, 0);
+			for (uint32_t y = 0; y < extent.height; ++y) {
+				for (uint32_t x = 0; x < extent.width; ++x) {
+					const uint32_t cell = (y * cells / extent.height) * cells + x * cells / extent.width;
+					const uint8_t* pixel = &rgba[(static_cast<size_t>(y) * extent.width + x) * 4];
+					for (uint32_t c = 0; c < 3; ++c) {
+						sums[cell * 3 + c] += pixel[c];
+					}
+					++counts[cell];
+				}
+			}
+			for (uint32_t i = 0; i < sums.size(); ++i) {
+				sums[i] /= std::max<uint32_t>(counts[i / 3], 1);
+			}
+			return sums;
+		};
+		const std::vector<double> aAverages = averages(a, aExtent);
+		const std::vector<double> bAverages = averages(b, bExtent);
+		double difference = 0.0;
+		for (uint32_t i = 0; i < aAverages.size(); ++i) {
+			difference = std::max(difference, std::fabs(aAverages[i] - bAverages[i]));
+		}
+		return difference;
+	}
+
+	// One frame of a scene, split into the phases the CPU goes through
+	bool RenderFrame(BenchmarkContext& context, OffscreenRenderer& renderer, const OffscreenDrawList& drawList, uint32_t frame) {
+		BenchmarkTimer frameTimer;
+
+		BenchmarkTimer recordTimer;
+		if (!renderer.Record(drawList)) {
+			return false;
+		}
+		const double recordMs = recordTimer.ElapsedMs();
+
+		BenchmarkTimer submitTimer;
+		if (!renderer.Submit()) {
+			return false;
+		}
+		const double submitMs = submitTimer.ElapsedMs();
+
+		BenchmarkTimer waitTimer;
+		if (!renderer.Wait()) {
+			return false;
+		}
+		const double waitMs = waitTimer.ElapsedMs();
+
+		if (context.IsMeasured(frame)) {
+			context.AddSample("record", recordMs);
+			context.AddSample("submit", submitMs);
+			context.AddSample("wait", waitMs);
+			context.AddSample("frame", frameTimer.ElapsedMs());
+
+			double gpuMs = 0.0;
+			if (renderer.GetGpuTime(gpuMs)) {
+				context.AddSample("gpu", gpuMs);
+			}
+		}
+		return true;
+	}
+
+	BenchmarkFunction DrawScene(uint32_t drawCount, uint32_t trianglesPerDraw, uint32_t pipelineCount, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT) {
+		return [=](BenchmarkContext& context) {
+			OffscreenRenderer renderer(context.GetVulkan());
+			if (!renderer.Create(context.GetOptions().extent, VK_FORMAT_R8G8B8A8_UNORM, samples) || !renderer.SetTriangleCount(drawCount * trianglesPerDraw)) {
+				return false;
+			}
+			if (samples != VK_SAMPLE_COUNT_1_BIT) {
+				std::cout << "  multisample attachments " << (renderer.HasLazyAttachments() ? "lazily allocated" : "in device local memory") << std::endl;
+			}
+
+			if (pipelineCount > 1) {
+				BenchmarkTimer pipelineTimer;
+				if (!renderer.SetPipelineCount(pipelineCount)) {
+					return false;
+				}
+				context.AddSample("create_pipelines", pipelineTimer.ElapsedMs());
+			}
+
+			OffscreenDrawList drawList;
+			drawList.drawCount = drawCount;
+			drawList.trianglesPerDraw = trianglesPerDraw;
+			drawList.pipelineCount = pipelineCount;
+
+			for (uint32_t frame = 0; frame < context.GetFrameCount(); ++frame) {
+				if (!RenderFrame(context, renderer, drawList, frame)) {
+					return false;
+				}
+			}
+			return true;
+		};
+	}
+
+	// Lit scene followed by tonemapping, color grading and a vignette, with the exposure changing every frame.
+	// Fused, all three effects run in a single subpass after the scene's; unfused, each one gets its own.
+	BenchmarkFunction PostProcessScene(bool fuse) {
+		return [=](BenchmarkContext& context) {
+			PostProcessSettings post;
+			post.effects.push_back(PostEffect(PostEffectType::Tonemap, 1.0f));
+			post.effects.push_back(PostEffect(PostEffectType::ColorGrade, 1.2f, 1.1f, 0.3f));
+			post.effects.push_back(PostEffect(PostEffectType::Vignette, 0.6f, 0.4f, 0.6f));
+			post.fuse = fuse;
+
+			OffscreenRenderer renderer(context.GetVulkan());
+			ClusteredLighting lighting(context.GetVulkan().GetDeviceContext());
+			if (!renderer.Create(context.GetOptions().extent, VK_FORMAT_R8G8B8A8_UNORM, VK_SAMPLE_COUNT_1_BIT, post)
+				|| !lighting.Create(256, renderer.GetRenderPass()) || !renderer.SetTriangleCount(10000)) {
+				return false;
+			}
+
+			std::vector<ClusteredLight> lights(256);
+			for (uint32_t i = 0; i < lights.size(); ++i) {
+				const uint32_t hash = i * 2654435761u;
+				ClusteredLight& light = lights[i];
+				// Bright enough for the tonemapper to have something to compress
+				light.position[0] = static_cast<float>(hash & 0xFF) / 255.0f * 40.0f - 20.0f;
+				light.position[1] = -1.0f + static_cast<float>((hash >> 8) & 0xF) * 0.25f;
+				light.position[2] = -30.0f + static_cast<float>((hash >> 12) & 0xFF) / 255.0f * 20.0f;
+				light.range = 3.0f;
+				light.color[0] = 1.0f + static_cast<float>((hash >> 20) & 0x3);
+				light.color[1] = 1.0f;
+				light.color[2] = 1.0f + static_cast<float>((hash >> 22) & 0x3);
+			}
+			if (!lighting.SetLights(lights)) {
+				return false;
+			}
+
+			OffscreenDrawList drawList;
+			drawList.drawCount = 1;
+			drawList.trianglesPerDraw = 10000;
+			drawList.drawables.push_back(&lighting);
+
+			for (uint32_t frame = 0; frame < context.GetFrameCount(); ++frame) {
+				const float exposure = 1.0f + 0.5f * std::sin(static_cast<float>(frame) / 30.0f);
+				if (!renderer.SetPostParameters(0, exposure, 0.0f, 0.0f, 0.0f) || !RenderFrame(context, renderer, drawList, frame)) {
+					return false;
+				}
+			}
+			return true;
+		};
+	}
+
+	BenchmarkFunction ResizeStormScene(uint32_t triangleCount) {
+		return [=](BenchmarkContext& context) {
+			OffscreenRenderer renderer(context.GetVulkan());
+			if (!renderer.Create(context.GetOptions().extent) || !renderer.SetTriangleCount(triangleCount)) {
+				return false;
+			}
+
+			OffscreenDrawList drawList;
+			drawList.drawCount = 1;
+			drawList.trianglesPerDraw = triangleCount;
+
+			const size_t extentCount = sizeof(ResizeStormExtents) / sizeof(ResizeStormExtents[0]);
+			for (uint32_t frame = 0; frame < context.GetFrameCount(); ++frame) {
+				BenchmarkTimer resizeTimer;
+				if (!renderer.Resize(ResizeStormExtents[frame % extentCount])) {
+					return false;
+				}
+				if (context.IsMeasured(frame)) {
+					context.AddSample("resize", resizeTimer.ElapsedMs());
+				}
+
+				if (!RenderFrame(context, renderer, drawList, frame)) {
+					return false;
+				}
+			}
+			return true;
+		};
+	}
+
+	// Captures every frame of two alternating targets at a fixed size into a stream that isn't written anywhere.
+	// "frame" is measured from one frame start to the next and includes waiting for a free readback slot, so
+	// 1000 / median is the sustained capture rate; "convert" is the average RGBA to I420 time of a frame.
+	BenchmarkFunction CaptureScene(VkExtent2D extent, uint32_t triangleCount) {
+		return [=](BenchmarkContext& context) {
+			std::unique_ptr<OffscreenRenderer> renderers[2];
+			for (std::unique_ptr<OffscreenRenderer>& renderer : renderers) {
+				renderer.reset(new OffscreenRenderer(context.GetVulkan()));
+				if (!renderer->Create(extent) || !renderer->SetTriangleCount(triangleCount)) {
+					return false;
+				}
+			}
+
+			FrameCapture capture(context.GetVulkan().GetDeviceContext());
+			if (!capture.Open(CaptureOptions(), extent)) {
+				return false;
+			}
+
+			OffscreenDrawList drawList;
+			drawList.drawCount = 1;
+			drawList.trianglesPerDraw = triangleCount;
+
+			bool result = true;
+			for (uint32_t frame = 0; result && (frame < context.GetFrameCount()); ++frame) {
+				BenchmarkTimer frameTimer;
+				OffscreenRenderer& renderer = *renderers[frame % 2];
+
+				ReadbackTicket ticket;
+				result = renderer.Wait() && capture.BeginFrame(extent, renderer.GetFormat(), ticket, true);
+				if (!result) {
+					break;
+				}
+
+				drawList.readback = &ticket;
+				if (!renderer.Record(drawList) || !renderer.Submit()) {
+					capture.CancelFrame(ticket);
+					result = false;
+					break;
+				}
+				result = capture.CommitFrame(ticket, renderer.GetFormat());
+
+				if (context.IsMeasured(frame)) {
+					context.AddSample("frame", frameTimer.ElapsedMs());
+				}
+			}
+
+			const CaptureStats stats = capture.GetStats();
+			result = capture.Close() && result;
+			if (stats.captured > 0) {
+				context.AddSample("convert", stats.convertMs / static_cast<double>(stats.captured));
+			}
+			if (stats.droppedQueue > 0) {
+				std::cout << "  " << stats.droppedQueue << " frames dropped by the converters" << std::endl;
+			}
+			return result;
+		};
+	}
+
+	// Starts with a full particle buffer and keeps it roughly full; "gpu" covers simulation, emission, sorting and drawing
+	BenchmarkFunction ParticleScene(uint32_t capacity) {
+		return [=](BenchmarkContext& context) {
+			OffscreenRenderer renderer(context.GetVulkan());
+			ParticleSystem particles(context.GetVulkan().GetDeviceContext());
+			if (!renderer.Create(context.GetOptions().extent) || !particles.Create(capacity, renderer.GetRenderPass())) {
+				return false;
+			}
+
+			// Particles live 1.5 times the emitter's life on average, so this rate replaces the ones which die
+			ParticleEmitter emitter;
+			emitter.rate = static_cast<float>(capacity) / (1.5f * emitter.life);
+			particles.SetEmitter(emitter);
+			particles.Emit(capacity);
+
+			OffscreenDrawList drawList;
+			drawList.drawables.push_back(&particles);
+
+			for (uint32_t frame = 0; frame < context.GetFrameCount(); ++frame) {
+				if (!RenderFrame(context, renderer, drawList, frame)) {
+					return false;
+				}
+			}
+			return true;
+		};
+	}
+
+	// Lights a floor and a back wall with lightCount lights, a quarter of them spots, which orbit the scene so that
+	// every frame rebuilds the light grid from new positions. The animation only depends on the frame index.
+	BenchmarkFunction ClusteredLightingScene(uint32_t lightCount, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT) {
+		return [=](BenchmarkContext& context) {
+			OffscreenRenderer renderer(context.GetVulkan());
+			ClusteredLighting lighting(context.GetVulkan().GetDeviceContext());
+			if (!renderer.Create(context.GetOptions().extent, VK_FORMAT_R8G8B8A8_UNORM, samples)
+				|| !lighting.Create(lightCount, renderer.GetRenderPass(), renderer.GetSampleCount())) {
+				return false;
+			}
+
+			OffscreenDrawList drawList;
+			drawList.drawables.push_back(&lighting);
+
+			std::vector<ClusteredLight> lights(lightCount);
+			for (uint32_t frame = 0; frame < context.GetFrameCount(); ++frame) {
+				const float time = static_cast<float>(frame) / 60.0f;
+				for (uint32_t i = 0; i < lightCount; ++i) {
+					// Fixed pseudo random orbit per light
+					const uint32_t hash = i * 2654435761u;
+					const float radius = 2.0f + static_cast<float>(hash & 0xFF) / 255.0f * 30.0f;
+					const float phase = static_cast<float>((hash >> 8) & 0xFF) / 255.0f * 6.2831853f + time * (0.2f + 2.0f / radius);
+					ClusteredLight& light = lights[i];
+					light.position[0] = radius * std::cos(phase);
+					light.position[1] = -1.0f + static_cast<float>((hash >> 16) & 0xF) * 0.5f;
+					light.position[2] = -30.0f + radius * std::sin(phase) * 0.9f;
+					light.range = 1.5f + static_cast<float>((hash >> 20) & 0xF) * 0.25f;
+					light.color[0] = 0.2f + static_cast<float>((hash >> 24) & 0x3) * 0.25f;
+					light.color[1] = 0.2f + static_cast<float>((hash >> 26) & 0x3) * 0.25f;
+					light.color[2] = 0.2f + static_cast<float>((hash >> 28) & 0x3) * 0.25f;
+					if ((i & 3) == 3) {
+						// Spot pointing straight down
+						light.range *= 2.0f;
+						light.spotCosine = 0.8f;
+						light.direction[0] = 0.0f;
+						light.direction[1] = -1.0f;
+						light.direction[2] = 0.0f;
+					}
+				}
+				// Frames are waited for, so the previous lights are no longer in use
+				if (!lighting.SetLights(lights) || !RenderFrame(context, renderer, drawList, frame)) {
+					return false;
+				}
+			}
+			return true;
+		};
+	}
+
+	// Four shadow cascades over a field of 4096 static cubes with 128 dynamic cubes circling through it, seen by a fixed
+	// camera. Cached, the static cascades are only rendered in the first frame; uncached they're re-rendered every frame.
+	BenchmarkFunction ShadowScene(bool cached) {
+		return [=](BenchmarkContext& context) {
+			const uint32_t gridSize = 64;
+			const uint32_t dynamicCount = 128;
+
+			OffscreenRenderer renderer(context.GetVulkan());
+			ShadowCascades shadows(context.GetVulkan().GetDeviceContext());
+			ShadowSettings settings;
+			settings.maxStaticCasters = gridSize * gridSize;
+			settings.maxDynamicCasters = dynamicCount;
+			if (!renderer.Create(context.GetOptions().extent) || !shadows.Create(settings, renderer.GetRenderPass())) {
+				return false;
+			}
+
+			std::vector<ShadowCaster> staticCasters(gridSize * gridSize);
+			for (uint32_t i = 0; i < staticCasters.size(); ++i) {
+				ShadowCaster& caster = staticCasters[i];
+				caster.halfSize = 0.5f + static_cast<float>((i * 2654435761u) >> 30) * 0.4f;
+				caster.position[0] = (static_cast<float>(i % gridSize) - 0.5f * gridSize) * 3.0f;
+				caster.position[1] = caster.halfSize;
+				caster.position[2] = (static_cast<float>(i / gridSize) - 0.5f * gridSize) * 3.0f;
+			}
+
+			SceneCamera camera;
+			camera.position[1] = 8.0f;
+			camera.position[2] = 20.0f;
+			camera.pitch = -0.35f;
+			shadows.SetCamera(camera);
+			if (!shadows.SetStaticCasters(staticCasters)) {
+				return false;
+			}
+
+			OffscreenDrawList drawList;
+			drawList.drawables.push_back(&shadows);
+
+			std::vector<ShadowCaster> dynamicCasters(dynamicCount);
+			for (uint32_t frame = 0; frame < context.GetFrameCount(); ++frame) {
+				const float time = static_cast<float>(frame) / 60.0f;
+				for (uint32_t i = 0; i < dynamicCount; ++i) {
+					const float angle = static_cast<float>(i) / dynamicCount * 6.2831853f + time * 0.5f;
+					const float radius = 5.0f + static_cast<float>(i % 8) * 6.0f;
+					ShadowCaster& caster = dynamicCasters[i];
+					caster.halfSize = 0.75f;
+					caster.position[0] = radius * std::cos(angle);
+					caster.position[1] = 4.0f + static_cast<float>(i % 3) * 2.0f;
+					caster.position[2] = radius * std::sin(angle);
+				}
+				if (!cached) {
+					shadows.InvalidateStaticCascades();
+				}
+				// Frames are waited for, so the previous casters are no longer in use
+				if (!shadows.SetDynamicCasters(dynamicCasters) || !RenderFrame(context, renderer, drawList, frame)) {
+					return false;
+				}
+			}
+			std::cout << "  rendered " << shadows.GetStaticRenderCount() << " of " << shadows.GetCascadeFrameCount() << " static cascades" << std::endl;
+			return true;
+		};
+	}
+
+	// City of 65536 boxes on a 256 x 256 block grid, walked through at street level down one of its streets, so nearly
+	// everything inside the frustum is hidden behind the first rows of buildings. Without occlusion only frustum
+	// culling is done; both cases run the depth pre-pass.
+	BenchmarkFunction OcclusionScene(bool occlusion) {
+		return [=](BenchmarkContext& context) {
+			const uint32_t gridSize = 256;
+			const float blockSize = 6.0f;
+
+			OffscreenRenderer renderer(context.GetVulkan());
+			OcclusionCulling culling(context.GetVulkan().GetDeviceContext());
+			if (!renderer.Create(context.GetOptions().extent)
+				|| !culling.Create(gridSize * gridSize, renderer.GetRenderPass(), renderer.GetDepthView(), context.GetOptions().extent)) {
+				return false;
+			}
+
+			std::vector<OcclusionInstance> buildings(gridSize * gridSize);
+			for (uint32_t i = 0; i < buildings.size(); ++i) {
+				const uint32_t hash = i * 2654435761u;
+				OcclusionInstance& building = buildings[i];
+				building.halfExtent[0] = 2.0f;
+				building.halfExtent[1] = 3.0f + static_cast<float>(hash >> 28) * 1.5f;
+				building.halfExtent[2] = 2.0f;
+				building.center[0] = (static_cast<float>(i % gridSize) - 0.5f * gridSize) * blockSize;
+				building.center[1] = building.halfExtent[1];
+				building.center[2] = (static_cast<float>(i / gridSize) - 0.5f * gridSize) * blockSize;
+				building.shade = static_cast<float>((hash >> 20) & 255) / 255.0f;
+			}
+			if (!culling.SetInstances(buildings)) {
+				return false;
+			}
+			culling.SetOcclusionEnabled(occlusion);
+
+			OffscreenDrawList drawList;
+			drawList.drawables.push_back(&culling);
+
+			// Street between two columns of blocks, looking slightly off its axis so side streets open up
+			SceneCamera camera;
+			camera.position[0] = 0.5f * blockSize;
+			camera.position[1] = 1.7f;
+			camera.yaw = 0.2f;
+			camera.farPlane = gridSize * blockSize;
+			uint64_t visibleSum = 0;
+			for (uint32_t frame = 0; frame < context.GetFrameCount(); ++frame) {
+				camera.position[2] = 0.25f * gridSize * blockSize - static_cast<float>(frame % 1000) * 0.2f;
+				culling.SetCamera(camera);
+				if (!RenderFrame(context, renderer, drawList, frame)) {
+					return false;
+				}
+				visibleSum += culling.GetVisibleCount();
+			}
+			const uint64_t average = visibleSum / std::max<uint32_t>(context.GetFrameCount(), 1);
+			std::cout << "  drew " << average << " of " << culling.GetInstanceCount() << " boxes per frame on average" << std::endl;
+			return true;
+		};
+	}
+
+	// Street of the occlusion scene with cars driving along it, rendered at renderScale of the output extent with a
+	// jittered camera and reconstructed to the full extent by temporal upscaling. A scale of 1 is plain TAA.
+	BenchmarkFunction TemporalScene(float renderScale) {
+		return [=](BenchmarkContext& context) {
+			const uint32_t gridSize = 64;
+			const uint32_t carCount = 64;
+			const float blockSize = 6.0f;
+
+			const VkExtent2D outputExtent = context.GetOptions().extent;
+			const VkExtent2D renderExtent = {
+				std::max<uint32_t>(static_cast<uint32_t>(static_cast<float>(outputExtent.width) * renderScale + 0.5f), 1),
+				std::max<uint32_t>(static_cast<uint32_t>(static_cast<float>(outputExtent.height) * renderScale + 0.5f), 1)
+			};
+			TemporalSettings settings;
+			settings.outputExtent = outputExtent;
+			settings.maxMotionBoxes = carCount;
+
+			OffscreenRenderer renderer(context.GetVulkan());
+			OcclusionCulling culling(context.GetVulkan().GetDeviceContext());
+			TemporalUpscaler upscaler(context.GetVulkan().GetDeviceContext());
+			if (!renderer.Create(renderExtent)
+				|| !culling.Create(gridSize * gridSize + carCount, renderer.GetRenderPass(), renderer.GetDepthView(), renderExtent)
+				|| !upscaler.Create(settings, renderer)) {
+				return false;
+			}
+
+			std::vector<OcclusionInstance> instances(gridSize * gridSize + carCount);
+			for (uint32_t i = 0; i < gridSize * gridSize; ++i) {
+				const uint32_t hash = i * 2654435761u;
+				OcclusionInstance& building = instances[i];
+				building.halfExtent[0] = 2.0f;
+				building.halfExtent[1] = 3.0f + static_cast<float>(hash >> 28) * 1.5f;
+				building.halfExtent[2] = 2.0f;
+				building.center[0] = (static_cast<float>(i % gridSize) - 0.5f * gridSize) * blockSize;
+				building.center[1] = building.halfExtent[1];
+				building.center[2] = (static_cast<float>(i / gridSize) - 0.5f * gridSize) * blockSize;
+				building.shade = static_cast<float>((hash >> 20) & 255) / 255.0f;
+			}
+
+			OffscreenDrawList drawList;
+			drawList.drawables.push_back(&culling);
+			drawList.drawables.push_back(&upscaler);
+
+			SceneCamera camera;
+			camera.position[0] = 0.5f * blockSize;
+			camera.position[1] = 1.7f;
+			camera.yaw = 0.2f;
+			camera.farPlane = gridSize * blockSize;
+			std::vector<TemporalMotionBox> cars(carCount);
+			const float span = gridSize * blockSize;
+			auto wrap = [span](float z) {
+				const float wrapped = std::fmod(z + 0.5f * span, span);
+				return ((wrapped < 0.0f) ? wrapped + span : wrapped) - 0.5f * span;
+			};
+			for (uint32_t frame = 0; frame < context.GetFrameCount(); ++frame) {
+				camera.position[2] = 0.25f * gridSize * blockSize - static_cast<float>(frame % 500) * 0.1f;
+				if (frame % 500 == 0) {
+					upscaler.Reset();
+				}
+
+				// Cars drive both ways along the camera's street, so they move against the background
+				for (uint32_t i = 0; i < carCount; ++i) {
+					const float direction = (i % 2 == 0) ? 1.0f : -1.0f;
+					const float lane = 0.5f * blockSize + direction * 0.8f;
+					const float start = (static_cast<float>(i) - 0.5f * carCount) * 2.0f * blockSize;
+					const uint32_t previousFrame = (frame > 0) ? frame - 1 : 0;
+					TemporalMotionBox& car = cars[i];
+					car.halfExtent[0] = 0.8f;
+					car.halfExtent[1] = 0.6f;
+					car.halfExtent[2] = 2.0f;
+					car.center[0] = lane;
+					car.center[1] = car.halfExtent[1];
+					car.center[2] = wrap(start + direction * static_cast<float>(frame) * 0.3f);
+					car.previousCenter[0] = car.center[0];
+					car.previousCenter[1] = car.center[1];
+					car.previousCenter[2] = wrap(start + direction * static_cast<float>(previousFrame) * 0.3f);
+
+					OcclusionInstance& instance = instances[gridSize * gridSize + i];
+					memcpy(instance.center, car.center, sizeof(car.center));
+					memcpy(instance.halfExtent, car.halfExtent, sizeof(car.halfExtent));
+					instance.shade = (direction > 0.0f) ? 0.9f : 0.2f;
+				}
+				// Wrapping around the grid is a jump, not motion
+				for (TemporalMotionBox& car : cars) {
+					if (std::fabs(car.center[2] - car.previousCenter[2]) > 1.0f) {
+						car.previousCenter[2] = car.center[2];
+					}
+				}
+
+				culling.SetCamera(upscaler.JitterCamera(camera));
+				if (!culling.SetInstances(instances) || !upscaler.SetMotionBoxes(cars) || !RenderFrame(context, renderer, drawList, frame)) {
+					return false;
+				}
+			}
+
+			// Readback must copy the reconstructed output, which has to look like the same frame rendered at the internal
+			// resolution without jitter, down to small details
+			std::vector<uint8_t> resolved;
+			if (!renderer.ReadPixels(resolved)) {
+				return false;
+			}
+			const VkExtent2D resolvedExtent = renderer.GetOutputExtent();
+			if ((resolvedExtent.width != outputExtent.width) || (resolvedExtent.height != outputExtent.height)
+				|| (resolved.size() != static_cast<size_t>(outputExtent.width) * outputExtent.height * 4)) {
+				std::cout << "  read back " << resolvedExtent.width << "x" << resolvedExtent.height << " instead of the output extent" << std::endl;
+				return false;
+			}
+			OffscreenDrawList referenceList;
+			referenceList.drawables.push_back(&culling);
+			culling.SetCamera(camera);
+			std::vector<uint8_t> reference;
+			if (!renderer.Record(referenceList) || !renderer.Submit() || !renderer.Wait() || !renderer.ReadPixels(reference)) {
+				return false;
+			}
+			const double difference = GridDifference(resolved, outputExtent, reference, renderExtent, 8);
+			if (difference > 16.0) {
+				std::cout << "  resolved output differs from the reference frame by " << difference << " of 255 in an 8x8 grid" << std::endl;
+				return false;
+			}
+			std::cout << "  rendered " << renderExtent.width << "x" << renderExtent.height << ", reconstructed to "
+				<< outputExtent.width << "x" << outputExtent.height << std::endl;
+			return true;
+		};
+	}
+
+	// Field of rocks walked through by the camera. The levels are baked once before the first frame; "lod_select" is the
+	// CPU time of picking every instance's level. Without LOD every rock is drawn at full detail.
+	BenchmarkFunction LodScene(bool lod) {
+		return [=](BenchmarkContext& context) {
+			const uint32_t gridSize = 64;
+			const float spacing = 8.0f;
+
+			std::vector<float> positions;
+			std::vector<uint32_t> indices;
+			BuildRockMesh(48, 96, positions, indices);
+			LodMesh mesh;
+			BenchmarkTimer bakeTimer;
+			if (!BuildLodMesh(positions, indices, 6, 0.5f, mesh)) {
+				return false;
+			}
+			const double bakeMs = bakeTimer.ElapsedMs();
+
+			OffscreenRenderer renderer(context.GetVulkan());
+			LodRenderer lods(context.GetVulkan().GetDeviceContext());
+			if (!renderer.Create(context.GetOptions().extent) || !lods.Create(mesh, gridSize * gridSize, renderer.GetRenderPass())) {
+				return false;
+			}
+
+			std::vector<LodInstance> rocks(gridSize * gridSize);
+			for (uint32_t i = 0; i < rocks.size(); ++i) {
+				const uint32_t hash = i * 2654435761u;
+				LodInstance& rock = rocks[i];
+				rock.scale = 0.5f + static_cast<float>(hash >> 28) * 0.15f;
+				rock.position[0] = (static_cast<float>(i % gridSize) - 0.5f * gridSize) * spacing + static_cast<float>((hash >> 8) & 0xF) * 0.2f;
+				rock.position[1] = 0.5f * rock.scale;
+				rock.position[2] = (static_cast<float>(i / gridSize) - 0.5f * gridSize) * spacing + static_cast<float>((hash >> 12) & 0xF) * 0.2f;
+			}
+			if (!lods.SetInstances(rocks)) {
+				return false;
+			}
+			lods.SetMaxScreenError(lod ? 1.0f : 0.0f);
+
+			OffscreenDrawList drawList;
+			drawList.drawables.push_back(&lods);
+
+			SceneCamera camera;
+			camera.position[0] = 0.5f * spacing;
+			camera.position[1] = 2.0f;
+			camera.yaw = 0.3f;
+			camera.pitch = -0.1f;
+			camera.farPlane = gridSize * spacing;
+			uint64_t triangleSum = 0;
+			for (uint32_t frame = 0; frame < context.GetFrameCount(); ++frame) {
+				camera.position[2] = 0.25f * gridSize * spacing - static_cast<float>(frame % 1000) * 0.2f;
+
+				BenchmarkTimer selectTimer;
+				lods.SelectLevels(camera, context.GetOptions().extent);
+				if (context.IsMeasured(frame)) {
+					context.AddSample("lod_select", selectTimer.ElapsedMs());
+				}
+				if (!RenderFrame(context, renderer, drawList, frame)) {
+					return false;
+				}
+				triangleSum += lods.GetTriangleCount();
+			}
+
+			std::cout << "  baked " << lods.GetLevelCount() << " levels in " << static_cast<uint64_t>(bakeMs + 0.5) << " ms:";
+			for (const LodLevel& level : mesh.levels) {
+				std::cout << " " << level.indexCount / 3;
+			}
+			std::cout << " triangles" << std::endl;
+			const uint64_t average = triangleSum / std::max<uint32_t>(context.GetFrameCount(), 1);
+			std::cout << "  drew " << average << " triangles per frame on average" << std::endl;
+			return true;
+		};
+	}
+
+	// A few dense rocks seen from up close, so most of every rock is either outside the view or facing away.
+	// Without culling every meshlet is drawn; back faces are still culled per triangle by the rasterizer either way.
+	BenchmarkFunction MeshletScene(bool culling) {
+		return [=](BenchmarkContext& context) {
+			const uint32_t gridSize = 8;
+			const float spacing = 12.0f;
+
+			std::vector<float> positions;
+			std::vector<uint32_t> indices;
+			BuildRockMesh(256, 512, positions, indices);
+			MeshletMesh mesh;
+			if (!BuildMeshlets(positions, indices, mesh)) {
+				return false;
+			}
+
+			OffscreenRenderer renderer(context.GetVulkan());
+			MeshletRenderer meshlets(context.GetVulkan().GetDeviceContext());
+			if (!renderer.Create(context.GetOptions().extent) || !meshlets.Create(mesh, gridSize * gridSize, renderer.GetRenderPass())) {
+				return false;
+			}
+
+			std::vector<MeshletInstance> rocks(gridSize * gridSize);
+			for (uint32_t i = 0; i < rocks.size(); ++i) {
+				MeshletInstance& rock = rocks[i];
+				rock.scale = 4.0f;
+				rock.position[0] = (static_cast<float>(i % gridSize) - 0.5f * gridSize) * spacing;
+				rock.position[1] = 0.0f;
+				rock.position[2] = (static_cast<float>(i / gridSize) - 0.5f * gridSize) * spacing;
+			}
+			if (!meshlets.SetInstances(rocks)) {
+				return false;
+			}
+			meshlets.SetCulling(culling, culling);
+
+			OffscreenDrawList drawList;
+			drawList.drawables.push_back(&meshlets);
+
+			// Circles the field between the rocks
+			SceneCamera camera;
+			camera.position[1] = 3.0f;
+			camera.farPlane = 2.0f * gridSize * spacing;
+			uint64_t visibleSum = 0;
+			for (uint32_t frame = 0; frame < context.GetFrameCount(); ++frame) {
+				const float angle = static_cast<float>(frame) * 0.01f;
+				camera.position[0] = 0.5f * spacing + 20.0f * std::cos(angle);
+				camera.position[2] = 0.5f * spacing + 20.0f * std::sin(angle);
+				camera.yaw = angle;
+				meshlets.SetCamera(camera);
+				if (!RenderFrame(context, renderer, drawList, frame)) {
+					return false;
+				}
+				visibleSum += meshlets.GetVisibleCount();
+			}
+
+			const uint64_t average = visibleSum / std::max<uint32_t>(context.GetFrameCount(), 1);
+			std::cout << "  " << mesh.meshlets.size() << " meshlets for " << indices.size() / 3 << " triangles, drew " << average << " of "
+				<< mesh.meshlets.size() * rocks.size() << " per frame on average" << std::endl;
+			return true;
+		};
+	}
+
+	// Field of animated characters, each blending its own mix of two clips. "animate" is the CPU time of posing every
+	// character into its palette, spread over threadCount threads (0 for one per hardware thread); skinning runs in a
+	// compute pass before the render pass. With shadows the skinned vertices are also drawn into shadow cascades, cast
+	// onto the ground.
+	BenchmarkFunction CrowdScene(uint32_t characterCount, uint32_t threadCount, bool shadowed = false) {
+		return [=](BenchmarkContext& context) {
+			const uint32_t jointCount = 16;
+			const float segmentLength = 0.25f;
+			const uint32_t gridSize = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(characterCount))));
+			const float spacing = 1.5f;
+
+			SkinnedMesh mesh;
+			Skeleton skeleton;
+			BuildTentacle(jointCount, segmentLength, mesh, skeleton);
+			std::vector<AnimationClip> clips(2);
+			if (!BuildWaveClip(jointCount, segmentLength, 2, 0.3f, clips[0]) || !BuildWaveClip(jointCount, segmentLength, 0, 0.2f, clips[1])) {
+				return false;
+			}
+
+			OffscreenRenderer renderer(context.GetVulkan());
+			SkinnedCrowd crowd(context.GetVulkan().GetDeviceContext());
+			ShadowCascades shadows(context.GetVulkan().GetDeviceContext());
+			ShadowSettings shadowSettings;
+			shadowSettings.resolution = 1024;
+			shadowSettings.shadowDistance = 30.0f;
+			if (!renderer.Create(context.GetOptions().extent)
+				|| !crowd.Create(skeleton, clips, mesh, characterCount, renderer.GetRenderPass(), VK_SAMPLE_COUNT_1_BIT, threadCount)
+				|| (shadowed && !shadows.Create(shadowSettings, renderer.GetRenderPass()))) {
+				return false;
+			}
+
+			std::vector<CrowdCharacter> characters(characterCount);
+			for (uint32_t i = 0; i < characterCount; ++i) {
+				const uint32_t hash = i * 2654435761u;
+				CrowdCharacter& character = characters[i];
+				character.position[0] = (static_cast<float>(i % gridSize) - 0.5f * gridSize) * spacing;
+				character.position[2] = -static_cast<float>(i / gridSize) * spacing;
+				character.heading = static_cast<float>((hash >> 8) & 0xFF) / 255.0f * 6.2831853f;
+				character.clips[0] = 0;
+				character.clips[1] = 1;
+				character.blend = static_cast<float>((hash >> 16) & 0xFF) / 255.0f;
+				character.timeOffset = static_cast<float>((hash >> 24) & 0xFF) / 255.0f * 2.0f;
+				character.speed = 0.75f + 0.5f * static_cast<float>((hash >> 4) & 0xF) / 15.0f;
+			}
+			if (!crowd.SetCharacters(characters)) {
+				return false;
+			}
+
+			// Skinning runs in the crowd's pre-pass, so it has to come before the shadows drawing its result
+			OffscreenDrawList drawList;
+			drawList.drawables.push_back(&crowd);
+
+			SceneCamera camera;
+			camera.position[1] = 3.0f;
+			camera.position[2] = 4.0f;
+			camera.pitch = -0.35f;
+			camera.farPlane = 2.0f * gridSize * spacing;
+			crowd.SetCamera(camera);
+			if (shadowed) {
+				ShadowMeshCasters casters;
+				casters.vertices = crowd.GetSkinnedVertices();
+				casters.indices = crowd.GetIndices();
+				casters.vertexCount = crowd.GetVertexCount();
+				casters.indexCount = crowd.GetIndexCount();
+				casters.instanceCount = crowd.GetCharacterCount();
+				shadows.SetCamera(camera);
+				shadows.SetMeshCasters(casters);
+				drawList.drawables.push_back(&shadows);
+			}
+			for (uint32_t frame = 0; frame < context.GetFrameCount(); ++frame) {
+				BenchmarkTimer animateTimer;
+				crowd.Update(static_cast<float>(frame) / 60.0f);
+				if (context.IsMeasured(frame)) {
+					context.AddSample("animate", animateTimer.ElapsedMs());
+				}
+				if (!RenderFrame(context, renderer, drawList, frame)) {
+					return false;
+				}
+			}
+
+			size_t rawBytes = 0;
+			size_t compressedBytes = 0;
+			for (const AnimationClip& clip : clips) {
+				rawBytes += static_cast<size_t>(clip.frameCount) * jointCount * 7 * sizeof(float);
+				compressedBytes += (clip.rotations.size() + clip.translations.size()) * sizeof(uint16_t);
+			}
+			std::cout << "  " << characterCount << " characters of " << jointCount << " joints and " << mesh.positions.size() / 3
+				<< " vertices, clips compressed from " << rawBytes << " to " << compressedBytes << " bytes" << std::endl;
+			return true;
+		};
+	}
+
+	// Feeds a fixed script of synthetic GPU frame times to the dynamic resolution controller and checks the scale after
+	// every step: spikes and frames within budget must not move it, sustained overload lowers it in proportion, headroom
+	// raises it one step at a time and it stays within its limits. Then a simulated GPU whose time grows with the pixel
+	// count has to settle with a single change. Runs no GPU work, "update" is the CPU time of the whole script.
+	BenchmarkFunction DynamicResolutionScene() {
+		return [](BenchmarkContext& context) {
+			struct Step {
+				double frameTimeMs;
+				uint32_t frames;
+				double expectedScale;
+			};
+			// Default parameters: 16 ms budget, headroom below 12.8 ms, 3 frames to go down, 30 to go up, 0.05 steps
+			const Step steps[] = {
+				{ 14.0, 100, 1.0 },		// Within budget
+				{ 40.0, 2, 1.0 },		// Two spikes aren't enough
+				{ 14.0, 1, 1.0 },		// and a frame within budget starts counting again
+				{ 40.0, 2, 1.0 },
+				{ 32.0, 1, 0.7 },		// Twice the budget halves the pixel count
+				{ 8.0, 29, 0.7 },
+				{ 8.0, 1, 0.75 },		// Headroom raises it by one step
+				{ 14.0, 10, 0.75 },		// Within budget without headroom keeps it
+				{ 8.0, 29, 0.75 },
+				{ 16.5, 3, 0.7 },		// Barely over budget still lowers it by at least one step
+				{ 1000.0, 300, 0.5 },	// Never below minScale
+				{ 4.0, 600, 1.0 }		// nor above maxScale
+			};
+			const uint32_t settleFrames = 300;
+			const double tolerance = 1e-6;
+
+			for (uint32_t frame = 0; frame < context.GetFrameCount(); ++frame) {
+				BenchmarkTimer updateTimer;
+				DynamicResolutionController controller;
+				for (size_t i = 0; i < sizeof(steps) / sizeof(steps[0]); ++i) {
+					for (uint32_t j = 0; j < steps[i].frames; ++j) {
+						controller.Update(steps[i].frameTimeMs);
+					}
+					if (std::abs(controller.GetScale() - steps[i].expectedScale) > tolerance) {
+						std::cout << "  scale " << controller.GetScale() << " instead of " << steps[i].expectedScale << " after step " << i << std::endl;
+						return false;
+					}
+				}
+
+				// 24 ms at full resolution: 0.8 fits the budget (15.4 ms) without headroom, so nothing may change after it
+				uint32_t changes = 0;
+				for (uint32_t i = 0; i < settleFrames; ++i) {
+					const double scale = controller.GetScale();
+					if (controller.Update(24.0 * scale * scale)) {
+						++changes;
+					}
+				}
+				const VkExtent2D renderExtent = controller.GetRenderExtent({ 1280, 720 });
+				if ((changes != 1) || (renderExtent.width != 1024) || (renderExtent.height != 576)) {
+					std::cout << "  simulated GPU settled at " << renderExtent.width << "x" << renderExtent.height << " after " << changes
+						<< " changes instead of 1024x576 after one" << std::endl;
+					return false;
+				}
+
+				if (context.IsMeasured(frame)) {
+					context.AddSample("update", updateTimer.ElapsedMs());
+				}
+			}
+			return true;
+		};
+	}
+
+	// Hierarchy of 131070 nodes: 6 roots, every node below has 4 children down to 8 levels, and the leaves carry one of 4
+	// meshes. The full update turns every root each frame, which moves the whole scene; the incremental one moves 1000
+	// nodes spread over all levels. "propagate" is the CPU time of updating world transforms and the render list.
+	BenchmarkFunction SceneGraphScene(bool incremental) {
+		return [=](BenchmarkContext& context) {
+			const uint32_t rootCount = 6;
+			const uint32_t branching = 4;
+			const uint32_t depthCount = 8;
+			const uint32_t movedCount = 1000;
+
+			SceneGraph scene;
+			std::vector<uint32_t> nodes;
+			std::vector<uint32_t> level;
+			for (uint32_t root = 0; root < rootCount; ++root) {
+				const float local[12] = { 1.0f, 0.0f, 0.0f, 20.0f * root, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f };
+				level.push_back(scene.AddNode(UINT32_MAX, local));
+			}
+			nodes.insert(nodes.end(), level.begin(), level.end());
+			for (uint32_t depth = 1; depth < depthCount; ++depth) {
+				std::vector<uint32_t> next;
+				for (uint32_t parent : level) {
+					for (uint32_t child = 0; child < branching; ++child) {
+						const float local[12] = { 0.5f, 0.0f, 0.0f, static_cast<float>(child) - 1.5f, 0.0f, 0.5f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.0f };
+						next.push_back(scene.AddNode(parent, local, (depth + 1 == depthCount) ? child : UINT32_MAX));
+					}
+				}
+				nodes.insert(nodes.end(), next.begin(), next.end());
+				level.swap(next);
+			}
+
+			BenchmarkTimer sortTimer;
+			scene.Update();
+			const double sortMs = sortTimer.ElapsedMs();
+
+			uint64_t updatedSum = 0;
+			for (uint32_t frame = 0; frame < context.GetFrameCount(); ++frame) {
+				const float angle = static_cast<float>(frame) * 0.01f;
+				const float turn[12] = { std::cos(angle), 0.0f, std::sin(angle), 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, -std::sin(angle), 0.0f, std::cos(angle), 0.0f };
+				if (incremental) {
+					for (uint32_t i = 0; i < movedCount; ++i) {
+						const uint32_t node = nodes[(frame * movedCount + i) * 2654435761u % nodes.size()];
+						float local[12];
+						memcpy(local, turn, sizeof(local));
+						local[7] = 1.0f;
+						scene.SetLocalTransform(node, local);
+					}
+				}
+				else {
+					for (uint32_t root = 0; root < rootCount; ++root) {
+						float local[12];
+						memcpy(local, turn, sizeof(local));
+						local[3] = 20.0f * root;
+						scene.SetLocalTransform(nodes[root], local);
+					}
+				}
+
+				BenchmarkTimer propagateTimer;
+				scene.Update();
+				if (context.IsMeasured(frame)) {
+					context.AddSample("propagate", propagateTimer.ElapsedMs());
+				}
+				updatedSum += scene.GetUpdatedCount();
+			}
+
+			const uint64_t average = updatedSum / std::max<uint32_t>(context.GetFrameCount(), 1);
+			std::cout << "  " << scene.GetNodeCount() << " nodes in " << scene.GetDepthCount() << " levels, first update " << static_cast<uint64_t>(sortMs + 0.5)
+				<< " ms, " << scene.GetRenderList().size() << " render items, " << average << " transforms updated per frame on average" << std::endl;
+			return true;
+		};
+	}
+
+	// Scans (or sums up) a fixed sequence of uints every frame on the compute queue, which is a separate async compute
+	// queue where the device has one. Every frame re-uploads the input, so "gpu" includes that copy; after the last
+	// frame the results are read back and checked against the CPU, a mismatch fails the benchmark.
+	BenchmarkFunction ComputeScene(uint32_t count, bool scan) {
+		return [=](BenchmarkContext& context) {
+			const DeviceContext device = context.GetVulkan().GetDeviceContext();
+			const DeviceDispatchTable& dispatch = *device.dispatch;
+			const VkDeviceSize size = count * sizeof(uint32_t);
+
+			ComputeQueue queue(device);
+			PrefixSum prefixSum(device);
+			Reduction reduction(device);
+			GpuBuffer values;
+			GpuBuffer staging;
+			GpuTimer timer;
+			if (!queue.Create(1)
+				|| !CreateGpuBuffer(device, size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, values)
+				|| !CreateGpuBuffer(device, 2 * size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging)) {
+				DestroyGpuBuffer(device, values);
+				return false;
+			}
+			if (scan ? (!prefixSum.Create(count) || !prefixSum.SetBuffer(values.handle, 0, count))
+				: (!reduction.Create(count) || !reduction.SetBuffer(values.handle, 0, count))) {
+				DestroyGpuBuffer(device, values);
+				DestroyGpuBuffer(device, staging);
+				return false;
+			}
+			timer.Create(device.physicalDevice, dispatch, queue.GetQueue(), queue.GetQueueFamilyIndex(), 1);
+
+			// Input in the first half of the staging buffer, results are copied to the second half
+			std::vector<uint32_t> input(count);
+			for (uint32_t i = 0; i < count; ++i) {
+				input[i] = (i * 2654435761u) >> 24;
+			}
+			uint32_t* mapped = static_cast<uint32_t*>(staging.mapped);
+			memcpy(mapped, input.data(), static_cast<size_t>(size));
+
+			VkMemoryBarrier uploadBarrier = {};
+			uploadBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			uploadBarrier.pNext = nullptr;
+			uploadBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			uploadBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+			bool result = true;
+			for (uint32_t frame = 0; result && (frame < context.GetFrameCount()); ++frame) {
+				const bool last = frame + 1 == context.GetFrameCount();
+				BenchmarkTimer frameTimer;
+
+				VkCommandBuffer commandBuffer = queue.Begin();
+				if (commandBuffer == VK_NULL_HANDLE) {
+					result = false;
+					break;
+				}
+
+				timer.CmdBegin(commandBuffer, 0);
+				const VkBufferCopy upload = { 0, 0, size };
+				dispatch.vkCmdCopyBuffer(commandBuffer, staging.handle, values.handle, 1, &upload);
+				dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+					1, &uploadBarrier, 0, nullptr, 0, nullptr);
+				if (scan) {
+					prefixSum.CmdScan(commandBuffer);
+				}
+				else {
+					reduction.CmdReduce(commandBuffer);
+				}
+				if (last) {
+					// Compute barrier above already made the results visible to transfers
+					const VkBufferCopy readback = { scan ? 0 : reduction.GetResultOffset(), size, scan ? size : sizeof(uint32_t) };
+					dispatch.vkCmdCopyBuffer(commandBuffer, scan ? values.handle : reduction.GetResultBuffer(), staging.handle, 1, &readback);
+
+					// The fence alone doesn't make transfer writes visible to the host
+					VkMemoryBarrier hostBarrier = {};
+					hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+					hostBarrier.pNext = nullptr;
+					hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+					hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+					dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+						1, &hostBarrier, 0, nullptr, 0, nullptr);
+				}
+				timer.CmdEnd(commandBuffer, 0);
+
+				result = queue.Submit() && queue.Wait();
+				if (result && context.IsMeasured(frame)) {
+					context.AddSample("frame", frameTimer.ElapsedMs());
+
+					double gpuMs = 0.0;
+					if (timer.GetResult(0, gpuMs)) {
+						context.AddSample("gpu", gpuMs);
+					}
+				}
+			}
+
+			if (result) {
+				// Host coherent memory, the barrier after the copy and the fence wait make it visible
+				const uint32_t* output = mapped + count;
+				uint32_t sum = 0;
+				for (uint32_t i = 0; result && (i < count); ++i) {
+					sum += input[i];
+					if (scan && (output[i] != sum)) {
+						std::cout << "  prefix sum mismatch at " << i << ": " << output[i] << " instead of " << sum << std::endl;
+						result = false;
+					}
+				}
+				if (!scan && (output[0] != sum)) {
+					std::cout << "  reduction mismatch: " << output[0] << " instead of " << sum << std::endl;
+					result = false;
+				}
+				std::cout << "  ran on the " << (queue.IsAsync() ? "async compute" : "graphics") << " queue" << std::endl;
+			}
+
+			queue.Wait();
+			timer.Destroy();
+			DestroyGpuBuffer(device, values);
+			DestroyGpuBuffer(device, staging);
+			return result;
+		};
+	}
+
+	// Records the same cheap state commands through the loader's trampolines and through the device dispatch table,
+	// the difference between the two phases is what skipping the loader saves on command recording
+	BenchmarkFunction DispatchOverheadScene(uint32_t callCount) {
+		return [=](BenchmarkContext& context) {
+			const DeviceDispatchTable& device = context.GetVulkan().GetDeviceDispatch();
+
+			// Device functions queried from the instance are trampolines which find the device's table on every call
+			PFN_vkCmdSetViewport loaderSetViewport = reinterpret_cast<PFN_vkCmdSetViewport>(vkGetInstanceProcAddr(handle.instance, "vkCmdSetViewport"));
+			PFN_vkCmdSetScissor loaderSetScissor = reinterpret_cast<PFN_vkCmdSetScissor>(vkGetInstanceProcAddr(handle.instance, "vkCmdSetScissor"));
+			if ((loaderSetViewport == nullptr) || (loaderSetScissor == nullptr)) {
+				std::cout << "COULD NOT GET LOADER ENTRY POINTS " << std::endl;
+				return false;
+			}
+
+			VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+			commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			commandPoolCreateInfo.pNext = nullptr;
+			commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+			commandPoolCreateInfo.queueFamilyIndex = handle.graphicsQueueFamilyIndex;
+
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			if (device.vkCreateCommandPool(device.device, &commandPoolCreateInfo, nullptr, &commandPool) != VK_SUCCESS) {
+				std::cout << "ERROR WHILE CREATING COMMAND POOL " << std::endl;
+				return false;
+			}
+
+			VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+			commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			commandBufferAllocateInfo.pNext = nullptr;
+			commandBufferAllocateInfo.commandPool = commandPool;
+			commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			commandBufferAllocateInfo.commandBufferCount = 1;
+
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			bool result = device.vkAllocateCommandBuffers(device.device, &commandBufferAllocateInfo, &commandBuffer) == VK_SUCCESS;
+
+			VkCommandBufferBeginInfo cmdBufferBeginInfo = {};
+			cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			cmdBufferBeginInfo.pNext = nullptr;
+			cmdBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			cmdBufferBeginInfo.pInheritanceInfo = nullptr;
+
+			const VkViewport viewport = { 0.0f, 0.0f, 1280.0f, 720.0f, 0.0f, 1.0f };
+			const VkRect2D scissor = { { 0, 0 }, { 1280, 720 } };
+
+			for (uint32_t frame = 0; result && (frame < context.GetFrameCount()); ++frame) {
+				for (int path = 0; result && (path < 2); ++path) {
+					const bool throughLoader = path == 0;
+					PFN_vkCmdSetViewport setViewport = throughLoader ? loaderSetViewport : device.vkCmdSetViewport;
+					PFN_vkCmdSetScissor setScissor = throughLoader ? loaderSetScissor : device.vkCmdSetScissor;
+
+					if (device.vkBeginCommandBuffer(commandBuffer, &cmdBufferBeginInfo) != VK_SUCCESS) {
+						result = false;
+						break;
+					}
+
+					BenchmarkTimer recordTimer;
+					for (uint32_t i = 0; i < callCount; ++i) {
+						setViewport(commandBuffer, 0, 1, &viewport);
+						setScissor(commandBuffer, 0, 1, &scissor);
+					}
+					const double recordMs = recordTimer.ElapsedMs();
+
+					result = device.vkEndCommandBuffer(commandBuffer) == VK_SUCCESS;
+					if (context.IsMeasured(frame)) {
+						context.AddSample(throughLoader ? "record_loader" : "record_device", recordMs);
+					}
+				}
+			}
+
+			device.vkDestroyCommandPool(device.device, commandPool, nullptr);
+			return result;
+		};
+	}
+}
+
+BenchmarkContext::BenchmarkContext(VulkanBase& vulkan, const BenchmarkOptions& options) :
+	Vulkan(vulkan),
+	Options(options),
+	Phases() {
+}
+
+VulkanBase& BenchmarkContext::GetVulkan() const {
+	return Vulkan;
+}
+
+const BenchmarkOptions& BenchmarkContext::GetOptions() const {
+	return Options;
+}
+
+uint32_t BenchmarkContext::GetFrameCount() const {
+	return Options.warmupFrames + Options.frames;
+}
+
+bool BenchmarkContext::IsMeasured(uint32_t frame) const {
+	return frame >= Options.warmupFrames;
+}
+
+void BenchmarkContext::AddSample(const std::string& phase, double milliseconds) {
+	for (Phase& existing : Phases) {
+		if (existing.first == phase) {
+			existing.second.push_back(milliseconds);
+			return;
+		}
+	}
+	Phases.push_back(Phase(phase, std::vector<double>(1, milliseconds)));
+}
+
+const std::vector<BenchmarkContext::Phase>& BenchmarkContext::GetPhases() const {
+	return Phases;
+}
+
+BenchmarkRunner::BenchmarkRunner(const BenchmarkOptions& options) :
+	Options(options),
+	Benchmarks(),
+	Results(),
+	DeviceName() {
+}
+
+void BenchmarkRunner::Register(const std::string& name, BenchmarkFunction function) {
+	Benchmarks.push_back(std::make_pair(name, function));
+}
+
+void BenchmarkRunner::RegisterDefaultScenes() {
+	Register("clear", DrawScene(0, 1, 1));
+	Register("triangles_100000", DrawScene(1, 100000, 1));
+	Register("triangles_100000_msaa4x", DrawScene(1, 100000, 1, VK_SAMPLE_COUNT_4_BIT));
+	Register("draws_10000", DrawScene(10000, 1, 1));
+	Register("pipelines_100", DrawScene(100, 1, 100));
+	Register("resize_storm", ResizeStormScene(1000));
+	Register("dynamic_resolution", DynamicResolutionScene());
+	Register("dispatch_overhead", DispatchOverheadScene(100000));
+	Register("capture_1080p", CaptureScene({ 1920, 1080 }, 1000));
+	Register("capture_4k", CaptureScene({ 3840, 2160 }, 1000));
+	Register("compute_prefix_sum", ComputeScene(1 << 20, true));
+	Register("compute_reduction", ComputeScene(1 << 20, false));
+	Register("particles_1000000", ParticleScene(1000000));
+	Register("lights_256", ClusteredLightingScene(256));
+	Register("lights_1024", ClusteredLightingScene(1024));
+	Register("lights_4096", ClusteredLightingScene(4096));
+	Register("lights_1024_msaa4x", ClusteredLightingScene(1024, VK_SAMPLE_COUNT_4_BIT));
+	Register("post_fused", PostProcessScene(true));
+	Register("post_unfused", PostProcessScene(false));
+	Register("shadows_cached", ShadowScene(true));
+	Register("shadows_uncached", ShadowScene(false));
+	Register("occlusion_on", OcclusionScene(true));
+	Register("occlusion_off", OcclusionScene(false));
+	Register("lod_on", LodScene(true));
+	Register("lod_off", LodScene(false));
+	Register("meshlets_culled", MeshletScene(true));
+	Register("meshlets_unculled", MeshletScene(false));
+	Register("taa_native", TemporalScene(1.0f));
+	Register("taa_upscale_67", TemporalScene(0.67f));
+	Register("crowd_500", CrowdScene(500, 0));
+	Register("crowd_500_single_thread", CrowdScene(500, 1));
+	Register("crowd_500_shadows", CrowdScene(500, 0, true));
+	Register("scene_graph_full", SceneGraphScene(false));
+	Register("scene_graph_incremental", SceneGraphScene(true));
+}
+
+bool BenchmarkRunner::Run(VulkanBase& vulkan) {
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(handle.physicalDevice, &deviceProperties);
+	DeviceName = deviceProperties.deviceName;
+
+	Results.clear();
+	for (const auto& benchmark : Benchmarks) {
+		if (!Options.filter.empty() && (benchmark.first.find(Options.filter) == std::string::npos)) {
+			continue;
+		}
+
+		std::cout << "Running " << benchmark.first << "..." << std::endl;
+		BenchmarkContext context(vulkan, Options);
+		if (!benchmark.second(context)) {
+			std::cout << "BENCHMARK " << benchmark.first << " FAILED " << std::endl;
+			return false;
+		}
+
+		BenchmarkResult result;
+		result.name = benchmark.first;
+		for (const BenchmarkContext::Phase& phase : context.GetPhases()) {
+			BenchmarkPhaseResult phaseResult;
+			phaseResult.name = phase.first;
+			phaseResult.medianMs = Percentile(phase.second, 50.0);
+			phaseResult.p95Ms = Percentile(phase.second, 95.0);
+			phaseResult.samples = phase.second.size();
+			result.phases.push_back(phaseResult);
+		}
+		Results.push_back(result);
+	}
+	return true;
+}
+
+const std::vector<BenchmarkResult>& BenchmarkRunner::GetResults() const {
+	return Results;
+}
+
+JsonValue BenchmarkRunner::ToJson() const {
+	JsonValue root = JsonValue::MakeObject();
+	root.Set("device", DeviceName);
+	JsonValue extent = JsonValue::MakeArray();
+	extent.Append(static_cast<int>(Options.extent.width));
+	extent.Append(static_cast<int>(Options.extent.height));
+	root.Set("extent", extent);
+	root.Set("frames", static_cast<int>(Options.frames));
+
+	JsonValue benchmarks = JsonValue::MakeObject();
+	for (const BenchmarkResult& result : Results) {
+		JsonValue phases = JsonValue::MakeObject();
+		for (const BenchmarkPhaseResult& phase : result.phases) {
+			JsonValue values = JsonValue::MakeObject();
+			values.Set("median", phase.medianMs);
+			values.Set("p95", phase.p95Ms);
+			phases.Set(phase.name, values);
+		}
+		benchmarks.Set(result.name, phases);
+	}
+	root.Set("benchmarks", benchmarks);
+	return root;
+}
+
+bool BenchmarkRunner::CompareWithBaseline(const JsonValue& baseline, std::ostream& report) const {
+	if (baseline["device"].AsString() != DeviceName) {
+		report << "Warning: baseline was recorded on \"" << baseline["device"].AsString() << "\", running on \"" << DeviceName << "\"" << std::endl;
+	}
+
+	bool passed = true;
+	for (const BenchmarkResult& result : Results) {
+		const JsonValue& expected = baseline["benchmarks"][result.name];
+		if (expected.IsNull()) {
+			report << "  new       " << result.name << " (not in baseline)" << std::endl;
+			continue;
+		}
+		// Noisy benchmarks may carry their own tolerance in the baseline file
+		const double tolerance = expected["tolerance"].AsNumber(baseline["tolerance"].AsNumber(Options.tolerance));
+
+		for (const BenchmarkPhaseResult& phase : result.phases) {
+			const JsonValue& expectedPhase = expected[phase.name];
+			if (!expectedPhase["median"].IsNumber()) {
+				continue;
+			}
+			// Only medians gate, tails are too noisy on shared machines
+			const double baselineMs = expectedPhase["median"].AsNumber();
+			const double limitMs = baselineMs * (1.0 + tolerance) + Options.toleranceMs;
+			if (phase.medianMs > limitMs) {
+				report << "  SLOWER    " << result.name << "/" << phase.name << ": " << phase.medianMs << " ms (baseline " << baselineMs
+					<< " ms, limit " << limitMs << " ms)" << std::endl;
+				passed = false;
+			}
+			else if (phase.medianMs < baselineMs * (1.0 - tolerance) - Options.toleranceMs) {
+				report << "  faster    " << result.name << "/" << phase.name << ": " << phase.medianMs << " ms (baseline " << baselineMs << " ms)" << std::endl;
+			}
+		}
+	}
+	return passed;
+}
+
+void BenchmarkRunner::Print(std::ostream& stream) const {
+	stream << "Device: " << DeviceName << ", " << Options.extent.width << "x" << Options.extent.height << ", " << Options.frames << " frames" << std::endl;
+	stream << std::fixed << std::setprecision(3);
+	for (const BenchmarkResult& result : Results) {
+		stream << result.name << std::endl;
+		for (const BenchmarkPhaseResult& phase : result.phases) {
+			stream << "  " << std::left << std::setw(18) << phase.name << std::right
+				<< " median " << std::setw(9) << phase.medianMs << " ms   p95 " << std::setw(9) << phase.p95Ms << " ms" << std::endl;
+		}
+	}
+	stream.unsetf(std::ios::floatfield);
+}
+
+int RunBenchmarks(int argc, char* argv[]) {
+	BenchmarkOptions options;
+
+	// --baseline FILE     : compare against FILE, exit code 1 on regression
+	// --update-baseline   : write results to the --baseline file instead of comparing
+	// --output FILE       : write results as JSON
+	// --tolerance X       : allowed relative slowdown (default 0.1)
+	// --frames N          : measured frames per scene
+	// --filter NAME       : run only benchmarks containing NAME
+	for (int i = 1; i < argc; ++i) {
+		if ((strcmp(argv[i], "--baseline") == 0) && (i + 1 < argc)) {
+			options.baselinePath = argv[++i];
+		}
+		else if (strcmp(argv[i], "--update-baseline") == 0) {
+			options.updateBaseline = true;
+		}
+		else if ((strcmp(argv[i], "--output") == 0) && (i + 1 < argc)) {
+			options.outputPath = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--tolerance") == 0) && (i + 1 < argc)) {
+			options.tolerance = atof(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--frames") == 0) && (i + 1 < argc)) {
+			options.frames = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if ((strcmp(argv[i], "--filter") == 0) && (i + 1 < argc)) {
+			options.filter = argv[++i];
+		}
+	}
+
+	// Pipeline creation is measured, so it must not get faster just because a previous run saved a cache
+	VulkanBase vulkan;
+	vulkan.SetPipelineCachePath("");
+	if (!vulkan.PrepareVulkanHeadless()) {
+		return 2;
+	}
+
+	BenchmarkRunner runner(options);
+	runner.RegisterDefaultScenes();
+	if (!runner.Run(vulkan)) {
+		return 2;
+	}
+	runner.Print(std::cout);
+
+	const JsonValue results = runner.ToJson();
+	if (!options.outputPath.empty() && !results.WriteFile(options.outputPath)) {
+		std::cout << "COULD NOT WRITE " << options.outputPath << std::endl;
+		return 2;
+	}
+
+	if (options.baselinePath.empty()) {
+		return 0;
+	}
+	if (options.updateBaseline) {
+		if (!results.WriteFile(options.baselinePath)) {
+			std::cout << "COULD NOT WRITE " << options.baselinePath << std::endl;
+			return 2;
+		}
+		std::cout << "Baseline written to " << options.baselinePath << std::endl;
+		return 0;
+	}
+
+	JsonValue baseline;
+	std::string error;
+	if (!JsonValue::ReadFile(options.baselinePath, baseline, error)) {
+		std::cout << "COULD NOT READ BASELINE: " << error << std::endl;
+		return 2;
+	}
+
+	std::cout << "Comparison with " << options.baselinePath << std::endl;
+	if (!runner.CompareWithBaseline(baseline, std::cout)) {
+		std::cout << "PERFORMANCE REGRESSION DETECTED " << std::endl;
+		return 1;
+	}
+	std::cout << "No regressions" << std::endl;
+	return 0;
+}
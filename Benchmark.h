@@ -0,0 +1,113 @@
+#pragma once
+
+#include "VulkanBase.h"
+#include "Json.h"
+#include <chrono>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct BenchmarkOptions {
+	uint32_t warmupFrames;
+	uint32_t frames;
+	VkExtent2D extent;
+	double tolerance;			// Allowed relative slowdown against the baseline (0.1 = 10 %)
+	double toleranceMs;			// Differences below this are noise even when the relative one is large
+	std::string filter;			// Runs only benchmarks whose name contains this
+	std::string baselinePath;
+	std::string outputPath;
+	bool updateBaseline;
+
+	BenchmarkOptions() :
+		warmupFrames(10),
+		frames(100),
+		extent({ 1280, 720 }),
+		tolerance(0.10),
+		toleranceMs(0.05),
+		filter(),
+		baselinePath(),
+		outputPath(),
+		updateBaseline(false) {
+	}
+};
+
+// Measures the CPU time of a block of code
+class BenchmarkTimer {
+public:
+	BenchmarkTimer() :
+		Start(std::chrono::steady_clock::now()) {
+	}
+
+	double ElapsedMs() const {
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - Start).count();
+	}
+
+private:
+	std::chrono::steady_clock::time_point Start;
+};
+
+// Passed to every benchmark, collects its samples per phase (for example "record", "submit", "gpu")
+class BenchmarkContext {
+public:
+	typedef std::pair<std::string, std::vector<double>> Phase;
+
+	BenchmarkContext(VulkanBase& vulkan, const BenchmarkOptions& options);
+
+	VulkanBase& GetVulkan() const;
+	const BenchmarkOptions& GetOptions() const;
+
+	// Frames the benchmark should run, warm-up frames come first and are not measured
+	uint32_t GetFrameCount() const;
+	bool IsMeasured(uint32_t frame) const;
+
+	void AddSample(const std::string& phase, double milliseconds);
+	const std::vector<Phase>& GetPhases() const;
+
+private:
+	VulkanBase& Vulkan;
+	const BenchmarkOptions& Options;
+	std::vector<Phase> Phases;
+};
+
+typedef std::function<bool(BenchmarkContext& context)> BenchmarkFunction;
+
+struct BenchmarkPhaseResult {
+	std::string name;
+	double medianMs;
+	double p95Ms;
+	size_t samples;
+};
+
+struct BenchmarkResult {
+	std::string name;
+	std::vector<BenchmarkPhaseResult> phases;
+};
+
+// Runs registered benchmarks on a headless device and compares their medians against a stored baseline.
+// Scenes are fixed scripts (no randomness, fixed frame counts), so runs on the same machine are comparable.
+class BenchmarkRunner {
+public:
+	explicit BenchmarkRunner(const BenchmarkOptions& options);
+
+	void Register(const std::string& name, BenchmarkFunction function);
+	void RegisterDefaultScenes();
+
+	bool Run(VulkanBase& vulkan);
+	const std::vector<BenchmarkResult>& GetResults() const;
+
+	JsonValue ToJson() const;
+	// Returns false when any phase got slower than the baseline allows
+	bool CompareWithBaseline(const JsonValue& baseline, std::ostream& report) const;
+	void Print(std::ostream& stream) const;
+
+private:
+	BenchmarkOptions Options;
+	std::vector<std::pair<std::string, BenchmarkFunction>> Benchmarks;
+	std::vector<BenchmarkResult> Results;
+	std::string DeviceName;
+};
+
+// Entry point of the --benchmark mode, returns the process exit code
+int RunBenchmarks(int argc, char* argv[]);
@@ -0,0 +1,299 @@
+#include "ClusteredLighting.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {
+	// 16 x 9 screen tiles times 24 depth slices
+	const uint32_t ClusterCountX = 16;
+	const uint32_t ClusterCountY = 9;
+	const uint32_t ClusterCountZ = 24;
+	const uint32_t ClusterCount = ClusterCountX * ClusterCountY * ClusterCountZ;
+	// Lights past this many in one cluster are dropped
+	const uint32_t MaxLightsPerCluster = 256;
+
+	const uint32_t AssignGroupSize = 128;
+
+	// Shared by the compute and the graphics shaders
+	const char* ClusterHeader = R"(#version 450
+const uvec3 ClusterGrid = uvec3(16, 9, 24);
+const uint MaxLightsPerCluster = 256;
+
+struct Light {
+	vec4 positionRange;
+	vec4 colorSpotCosine;
+	vec4 direction;
+};
+
+layout(push_constant) uniform Parameters {
+	vec2 scale;
+	float nearPlane;
+	float farPlane;
+	vec2 extent;
+	uint lightCount;
+};
+
+// Depth slices are spaced exponentially, so clusters stay roughly cubical
+float SliceDepth(uint slice) {
+	return nearPlane * pow(farPlane / nearPlane, float(slice) / float(ClusterGrid.z));
+}
+)";
+
+	// One invocation per cluster; the group walks through the lights in batches loaded into shared memory
+	const char* AssignShader = R"(
+layout(local_size_x_id = 0) in;
+
+layout(set = 0, binding = 0) readonly buffer Lights {
+	Light lights[];
+};
+layout(set = 0, binding = 1) writeonly buffer ClusterCounts {
+	uint clusterCounts[];
+};
+layout(set = 0, binding = 2) writeonly buffer ClusterLights {
+	uint clusterLights[];
+};
+
+shared vec4 batch[gl_WorkGroupSize.x];
+
+void main() {
+	const uint cluster = gl_GlobalInvocationID.x;
+	const uint clusterTotal = ClusterGrid.x * ClusterGrid.y * ClusterGrid.z;
+	const bool valid = cluster < clusterTotal;
+
+	// View space bounds of the cluster, x and y grow with depth
+	const uvec3 cell = uvec3(cluster % ClusterGrid.x, (cluster / ClusterGrid.x) % ClusterGrid.y, cluster / (ClusterGrid.x * ClusterGrid.y));
+	const float nearDepth = SliceDepth(cell.z);
+	const float farDepth = SliceDepth(cell.z + 1u);
+	const vec2 ndcMin = vec2(cell.xy) / vec2(ClusterGrid.xy) * 2.0 - 1.0;
+	const vec2 ndcMax = vec2(cell.xy + 1u) / vec2(ClusterGrid.xy) * 2.0 - 1.0;
+	// Screen y points down, view y up
+	const vec3 minimum = vec3(
+		min(ndcMin.x * nearDepth, ndcMin.x * farDepth) / scale.x,
+		min(-ndcMax.y * nearDepth, -ndcMax.y * farDepth) / scale.y,
+		-farDepth);
+	const vec3 maximum = vec3(
+		max(ndcMax.x * nearDepth, ndcMax.x * farDepth) / scale.x,
+		max(-ndcMin.y * nearDepth, -ndcMin.y * farDepth) / scale.y,
+		-nearDepth);
+
+	uint count = 0;
+	for (uint first = 0; first < lightCount; first += gl_WorkGroupSize.x) {
+		const uint load = first + gl_LocalInvocationID.x;
+		if (load < lightCount) {
+			batch[gl_LocalInvocationID.x] = lights[load].positionRange;
+		}
+		barrier();
+
+		const uint batchSize = min(gl_WorkGroupSize.x, lightCount - first);
+		for (uint i = 0; valid && (i < batchSize); ++i) {
+			// Sphere against box: distance to the closest point of the box
+			const vec4 light = batch[i];
+			const vec3 offset = clamp(light.xyz, minimum, maximum) - light.xyz;
+			if ((dot(offset, offset) <= light.w * light.w) && (count < MaxLightsPerCluster)) {
+				clusterLights[cluster * MaxLightsPerCluster + count] = first + i;
+				++count;
+			}
+		}
+		barrier();
+	}
+
+	if (valid) {
+		clusterCounts[cluster] = count;
+	}
+}
+)";
+
+	// Floor and back wall, generated from the vertex index
+	const char* ShadeVertexShader = R"(
+layout(location = 0) out vec3 ViewPosition;
+layout(location = 1) out vec3 Normal;
+
+const vec3 Corners[12] = vec3[12](
+	vec3(-40.0, -2.0, 0.0), vec3(40.0, -2.0, 0.0), vec3(40.0, -2.0, -60.0),
+	vec3(-40.0, -2.0, 0.0), vec3(40.0, -2.0, -60.0), vec3(-40.0, -2.0, -60.0),
+	vec3(-40.0, -2.0, -60.0), vec3(40.0, -2.0, -60.0), vec3(40.0, 30.0, -60.0),
+	vec3(-40.0, -2.0, -60.0), vec3(40.0, 30.0, -60.0), vec3(-40.0, 30.0, -60.0));
+
+void main() {
+	ViewPosition = Corners[gl_VertexIndex];
+	Normal = (gl_VertexIndex < 6) ? vec3(0.0, 1.0, 0.0) : vec3(0.0, 0.0, 1.0);
+
+	// Perspective projection to reversed depth
+	const float depth = -ViewPosition.z;
+	gl_Position = vec4(ViewPosition.x * scale.x, -ViewPosition.y * scale.y, nearPlane, depth);
+}
+)";
+
+	const char* ShadeFragmentShader = R"(
+layout(set = 0, binding = 0) readonly buffer Lights {
+	Light lights[];
+};
+layout(set = 0, binding = 1) readonly buffer ClusterCounts {
+	uint clusterCounts[];
+};
+layout(set = 0, binding = 2) readonly buffer ClusterLights {
+	uint clusterLights[];
+};
+
+layout(location = 0) in vec3 ViewPosition;
+layout(location = 1) in vec3 Normal;
+
+layout(location = 0) out vec4 Color;
+
+void main() {
+	const uvec2 tile = min(uvec2(gl_FragCoord.xy / extent * vec2(ClusterGrid.xy)), ClusterGrid.xy - 1u);
+	const float depth = -ViewPosition.z;
+	const uint slice = uint(clamp(log(depth / nearPlane) / log(farPlane / nearPlane) * float(ClusterGrid.z), 0.0, float(ClusterGrid.z - 1u)));
+	const uint cluster = (slice * ClusterGrid.y + tile.y) * ClusterGrid.x + tile.x;
+
+	const vec3 albedo = vec3(0.8);
+	vec3 lighting = vec3(0.03);
+	const uint count = clusterCounts[cluster];
+	for (uint i = 0; i < count; ++i) {
+		const Light light = lights[clusterLights[cluster * MaxLightsPerCluster + i]];
+		const vec3 toLight = light.positionRange.xyz - ViewPosition;
+		const float lightDistance = length(toLight);
+		if (lightDistance >= light.positionRange.w) {
+			continue;
+		}
+
+		const vec3 direction = toLight / lightDistance;
+		float attenuation = 1.0 - lightDistance / light.positionRange.w;
+		attenuation *= attenuation;
+		const float spotCosine = light.colorSpotCosine.w;
+		if (spotCosine > -1.0) {
+			// Soft edge over the outer tenth of the cone
+			const float angleCosine = dot(-direction, light.direction.xyz);
+			attenuation *= smoothstep(spotCosine, mix(spotCosine, 1.0, 0.1), angleCosine);
+		}
+		lighting += light.colorSpotCosine.rgb * attenuation * max(dot(Normal, direction), 0.0);
+	}
+	Color = vec4(albedo * lighting, 1.0);
+}
+)";
+}
+
+ClusteredLighting::ClusteredLighting(const DeviceContext& device) :
+	Device(device),
+	Dispatch(*device.dispatch),
+	AssignPipeline(device),
+	ShadePipeline(device),
+	Lights(),
+	ClusterCounts(),
+	ClusterLights(),
+	AssignSet(VK_NULL_HANDLE),
+	ShadeSet(VK_NULL_HANDLE),
+	MaxLights(0),
+	View(),
+	Constants() {
+}
+
+ClusteredLighting::~ClusteredLighting() {
+	Destroy();
+}
+
+bool ClusteredLighting::Create(uint32_t maxLights, VkRenderPass renderPass, VkSampleCountFlagBits samples) {
+	Destroy();
+	MaxLights = std::max<uint32_t>(maxLights, 1);
+
+	if (!CreateGpuBuffer(Device, MaxLights * sizeof(ClusteredLight), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, Lights)
+		|| !CreateGpuBuffer(Device, ClusterCount * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ClusterCounts)
+		|| !CreateGpuBuffer(Device, ClusterCount * MaxLightsPerCluster * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ClusterLights)) {
+		return false;
+	}
+
+	GraphicsPipelineState state;
+	state.renderPass = renderPass;
+	state.samples = samples;
+	state.cullMode = VK_CULL_MODE_NONE;
+	state.depthTest = true;
+	state.depthWrite = true;
+
+	const std::string header = ClusterHeader;
+	const std::vector<VkDescriptorType> bindings(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+	if (!AssignPipeline.Create((header + AssignShader).c_str(), "cluster_assign.comp", bindings, sizeof(Parameters), 1, AssignGroupSize)
+		|| !ShadePipeline.Create((header + ShadeVertexShader).c_str(), (header + ShadeFragmentShader).c_str(), "clustered_shading", bindings, sizeof(Parameters), 1, state)
+		|| !AssignPipeline.AllocateDescriptorSet(AssignSet)
+		|| !ShadePipeline.AllocateDescriptorSet(ShadeSet)) {
+		return false;
+	}
+
+	AssignPipeline.WriteBuffer(AssignSet, 0, Lights.handle);
+	AssignPipeline.WriteBuffer(AssignSet, 1, ClusterCounts.handle);
+	AssignPipeline.WriteBuffer(AssignSet, 2, ClusterLights.handle);
+	ShadePipeline.WriteBuffer(ShadeSet, 0, Lights.handle);
+	ShadePipeline.WriteBuffer(ShadeSet, 1, ClusterCounts.handle);
+	ShadePipeline.WriteBuffer(ShadeSet, 2, ClusterLights.handle);
+
+	Constants = Parameters();
+	return true;
+}
+
+void ClusteredLighting::Destroy() {
+	AssignPipeline.Destroy();
+	ShadePipeline.Destroy();
+	DestroyGpuBuffer(Device, Lights);
+	DestroyGpuBuffer(Device, ClusterCounts);
+	DestroyGpuBuffer(Device, ClusterLights);
+	AssignSet = VK_NULL_HANDLE;
+	ShadeSet = VK_NULL_HANDLE;
+	MaxLights = 0;
+	Constants.lightCount = 0;
+}
+
+bool ClusteredLighting::SetLights(const std::vector<ClusteredLight>& lights) {
+	if (lights.size() > MaxLights) {
+		std::cout << "CLUSTERED LIGHTING WAS CREATED FOR AT MOST " << MaxLights << " LIGHTS " << std::endl;
+		return false;
+	}
+	if (!lights.empty()) {
+		memcpy(Lights.mapped, lights.data(), lights.size() * sizeof(ClusteredLight));
+	}
+	Constants.lightCount = static_cast<uint32_t>(lights.size());
+	return true;
+}
+
+void ClusteredLighting::SetView(const ClusteredView& view) {
+	View = view;
+}
+
+void ClusteredLighting::CmdBuildClusters(VkCommandBuffer commandBuffer, VkExtent2D extent) {
+	const float scaleY = 1.0f / std::tan(0.5f * View.verticalFov);
+	Constants.scale[0] = scaleY * static_cast<float>(extent.height) / static_cast<float>(extent.width);
+	Constants.scale[1] = scaleY;
+	Constants.nearPlane = View.nearPlane;
+	Constants.farPlane = View.farPlane;
+	Constants.extent[0] = static_cast<float>(extent.width);
+	Constants.extent[1] = static_cast<float>(extent.height);
+
+	// Earlier frames' fragment shaders still read the lists rewritten here
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+	AssignPipeline.CmdBind(commandBuffer, AssignSet);
+	AssignPipeline.CmdPushConstants(commandBuffer, &Constants, sizeof(Constants));
+	AssignPipeline.CmdDispatch(commandBuffer, ClusterCount);
+
+	VkMemoryBarrier memoryBarrier = {};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.pNext = nullptr;
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+void ClusteredLighting::CmdPrePass(VkCommandBuffer commandBuffer, const OffscreenFrame& frame) {
+	CmdBuildClusters(commandBuffer, frame.extent);
+}
+
+void ClusteredLighting::CmdDraw(VkCommandBuffer commandBuffer, const OffscreenFrame& /*frame*/) const {
+	ShadePipeline.CmdBind(commandBuffer, ShadeSet);
+	ShadePipeline.CmdPushConstants(commandBuffer, &Constants, sizeof(Constants));
+	Dispatch.vkCmdDraw(commandBuffer, 12, 1, 0, 0);
+}
+
+uint32_t ClusteredLighting::GetLightCount() const {
+	return Constants.lightCount;
+}
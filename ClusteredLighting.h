@@ -0,0 +1,95 @@
+#pragma once
+
+#include "ComputePipeline.h"
+#include "GraphicsPipeline.h"
+#include "OffscreenRenderer.h"
+#include <cstdint>
+#include <vector>
+
+// Point or spot light in view space (camera at the origin looking down -z, y up)
+struct ClusteredLight {
+	float position[3];
+	float range;				// Light has no effect past this distance
+	float color[3];
+	float spotCosine;			// Cosine of the cone's half angle, -1 (or less) for point lights
+	float direction[3];			// Spot lights only, normalized
+	float padding;
+
+	ClusteredLight() :
+		position(),
+		range(1.0f),
+		color(),
+		spotCosine(-1.0f),
+		direction(),
+		padding(0.0f) {
+	}
+};
+
+// Vertical field of view and depth range of the lit view
+struct ClusteredView {
+	float verticalFov;			// Radians
+	float nearPlane;
+	float farPlane;
+
+	ClusteredView() :
+		verticalFov(1.0f),
+		nearPlane(0.1f),
+		farPlane(100.0f) {
+	}
+};
+
+// Clustered forward lighting. The view frustum is split into a grid of screen tiles times exponentially spaced depth
+// slices; a compute pass assigns every light to the clusters its sphere of influence touches, and the fragment shader
+// only loops over the lights of its own cluster. So shading cost depends on local light density, not the light count,
+// and all lights are handled in the same draw.
+// The lit scene is a floor and a back wall, drawn in the first subpass of render passes compatible with the given one.
+class ClusteredLighting : public OffscreenDrawable {
+public:
+	// Context's dispatch table must outlive the lighting
+	explicit ClusteredLighting(const DeviceContext& device);
+	~ClusteredLighting();
+
+	ClusteredLighting(const ClusteredLighting&) = delete;
+	ClusteredLighting& operator=(const ClusteredLighting&) = delete;
+
+	bool Create(uint32_t maxLights, VkRenderPass renderPass, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+	void Destroy();
+
+	// Lights are written straight into mapped memory, so no frame using the previous ones may still be executing
+	bool SetLights(const std::vector<ClusteredLight>& lights);
+	void SetView(const ClusteredView& view);
+
+	// Outside a render pass; results are visible to CmdDraw() in the same command buffer
+	void CmdBuildClusters(VkCommandBuffer commandBuffer, VkExtent2D extent);
+
+	// Builds the clusters before the render pass, then draws the lit scene in it
+	void CmdPrePass(VkCommandBuffer commandBuffer, const OffscreenFrame& frame) override;
+	void CmdDraw(VkCommandBuffer commandBuffer, const OffscreenFrame& frame) const override;
+
+	uint32_t GetLightCount() const;
+
+private:
+	// Push constants of the compute and graphics shaders
+	struct Parameters {
+		float scale[2];			// Projection scale of x and y
+		float nearPlane;
+		float farPlane;
+		float extent[2];
+		uint32_t lightCount;
+	};
+
+	DeviceContext Device;
+	const DeviceDispatchTable& Dispatch;
+	ComputePipeline AssignPipeline;
+	GraphicsPipeline ShadePipeline;
+
+	GpuBuffer Lights;				// Host visible
+	GpuBuffer ClusterCounts;
+	GpuBuffer ClusterLights;		// A fixed size list per cluster
+	VkDescriptorSet AssignSet;
+	VkDescriptorSet ShadeSet;
+
+	uint32_t MaxLights;
+	ClusteredView View;
+	Parameters Constants;
+};
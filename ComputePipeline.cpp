@@ -0,0 +1,315 @@
+#include "ComputePipeline.h"
+#include <iostream>
+
+bool CreateGpuBuffer(const DeviceContext& device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, GpuBuffer& buffer,
+	const std::vector<uint32_t>& sharingFamilies) {
+	const DeviceDispatchTable& dispatch = *device.dispatch;
+
+	VkBufferCreateInfo bufferCreateInfo = {};
+	bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferCreateInfo.pNext = nullptr;
+	bufferCreateInfo.flags = 0;
+	bufferCreateInfo.size = size;
+	bufferCreateInfo.usage = usage;
+	bufferCreateInfo.sharingMode = (sharingFamilies.size() > 1) ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	bufferCreateInfo.queueFamilyIndexCount = (sharingFamilies.size() > 1) ? static_cast<uint32_t>(sharingFamilies.size()) : 0;
+	bufferCreateInfo.pQueueFamilyIndices = (sharingFamilies.size() > 1) ? sharingFamilies.data() : nullptr;
+
+	if (dispatch.vkCreateBuffer(dispatch.device, &bufferCreateInfo, nullptr, &buffer.handle) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE BUFFER " << std::endl;
+		return false;
+	}
+	buffer.size = size;
+
+	VkMemoryRequirements memoryRequirements;
+	dispatch.vkGetBufferMemoryRequirements(dispatch.device, buffer.handle, &memoryRequirements);
+
+	VkMemoryAllocateInfo memoryAllocateInfo = {};
+	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memoryAllocateInfo.pNext = nullptr;
+	memoryAllocateInfo.allocationSize = memoryRequirements.size;
+	if (!device.GetMemoryType(memoryRequirements.memoryTypeBits, properties, memoryAllocateInfo.memoryTypeIndex)) {
+		std::cout << "NO SUITABLE MEMORY TYPE FOR BUFFER " << std::endl;
+		DestroyGpuBuffer(device, buffer);
+		return false;
+	}
+
+	if ((dispatch.vkAllocateMemory(dispatch.device, &memoryAllocateInfo, nullptr, &buffer.memory) != VK_SUCCESS)
+		|| (dispatch.vkBindBufferMemory(dispatch.device, buffer.handle, buffer.memory, 0) != VK_SUCCESS)) {
+		std::cout << "COULD NOT ALLOCATE MEMORY FOR BUFFER " << std::endl;
+		DestroyGpuBuffer(device, buffer);
+		return false;
+	}
+
+	if ((properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && (dispatch.vkMapMemory(dispatch.device, buffer.memory, 0, VK_WHOLE_SIZE, 0, &buffer.mapped) != VK_SUCCESS)) {
+		std::cout << "COULD NOT MAP BUFFER MEMORY " << std::endl;
+		DestroyGpuBuffer(device, buffer);
+		return false;
+	}
+	return true;
+}
+
+void DestroyGpuBuffer(const DeviceContext& device, GpuBuffer& buffer) {
+	const DeviceDispatchTable& dispatch = *device.dispatch;
+	if (buffer.mapped != nullptr) {
+		dispatch.vkUnmapMemory(dispatch.device, buffer.memory);
+	}
+	if (buffer.handle != VK_NULL_HANDLE) {
+		dispatch.vkDestroyBuffer(dispatch.device, buffer.handle, nullptr);
+	}
+	if (buffer.memory != VK_NULL_HANDLE) {
+		dispatch.vkFreeMemory(dispatch.device, buffer.memory, nullptr);
+	}
+	buffer = GpuBuffer();
+}
+
+void CmdComputeBarrier(const DeviceDispatchTable& dispatch, VkCommandBuffer commandBuffer) {
+	VkMemoryBarrier memoryBarrier = {};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.pNext = nullptr;
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+ComputePipeline::ComputePipeline(const DeviceContext& device) :
+	Device(device),
+	Dispatch(*device.dispatch),
+	Compiler(),
+	Bindings(),
+	LocalSize(),
+	SetLayout(VK_NULL_HANDLE),
+	DescriptorPool(VK_NULL_HANDLE),
+	PipelineLayout(VK_NULL_HANDLE),
+	Pipeline(VK_NULL_HANDLE) {
+}
+
+ComputePipeline::~ComputePipeline() {
+	Destroy();
+}
+
+bool ComputePipeline::Create(const char* source, const char* name, const std::vector<VkDescriptorType>& bindings, uint32_t pushConstantSize, uint32_t maxSets,
+	uint32_t localSizeX, uint32_t localSizeY, uint32_t localSizeZ) {
+	Destroy();
+	Bindings = bindings;
+	LocalSize[0] = localSizeX;
+	LocalSize[1] = localSizeY;
+	LocalSize[2] = localSizeZ;
+
+	std::vector<VkDescriptorSetLayoutBinding> layoutBindings(bindings.size());
+	std::vector<VkDescriptorPoolSize> poolSizes;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(bindings.size()); ++i) {
+		layoutBindings[i].binding = i;
+		layoutBindings[i].descriptorType = bindings[i];
+		layoutBindings[i].descriptorCount = 1;
+		layoutBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		layoutBindings[i].pImmutableSamplers = nullptr;
+
+		bool counted = false;
+		for (VkDescriptorPoolSize& poolSize : poolSizes) {
+			if (poolSize.type == bindings[i]) {
+				poolSize.descriptorCount += maxSets;
+				counted = true;
+				break;
+			}
+		}
+		if (!counted) {
+			poolSizes.push_back({ bindings[i], maxSets });
+		}
+	}
+
+	VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = {};
+	setLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutCreateInfo.pNext = nullptr;
+	setLayoutCreateInfo.flags = 0;
+	setLayoutCreateInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size());
+	setLayoutCreateInfo.pBindings = layoutBindings.data();
+
+	if (Dispatch.vkCreateDescriptorSetLayout(Dispatch.device, &setLayoutCreateInfo, nullptr, &SetLayout) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE DESCRIPTOR SET LAYOUT OF " << name << std::endl;
+		return false;
+	}
+
+	if ((maxSets > 0) && !poolSizes.empty()) {
+		VkDescriptorPoolCreateInfo poolCreateInfo = {};
+		poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolCreateInfo.pNext = nullptr;
+		poolCreateInfo.flags = 0;
+		poolCreateInfo.maxSets = maxSets;
+		poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolCreateInfo.pPoolSizes = poolSizes.data();
+
+		if (Dispatch.vkCreateDescriptorPool(Dispatch.device, &poolCreateInfo, nullptr, &DescriptorPool) != VK_SUCCESS) {
+			std::cout << "COULD NOT CREATE DESCRIPTOR POOL OF " << name << std::endl;
+			return false;
+		}
+	}
+
+	VkPushConstantRange pushConstantRange = { VK_SHADER_STAGE_COMPUTE_BIT, 0, pushConstantSize };
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.pNext = nullptr;
+	pipelineLayoutCreateInfo.flags = 0;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &SetLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = (pushConstantSize > 0) ? 1 : 0;
+	pipelineLayoutCreateInfo.pPushConstantRanges = (pushConstantSize > 0) ? &pushConstantRange : nullptr;
+
+	if (Dispatch.vkCreatePipelineLayout(Dispatch.device, &pipelineLayoutCreateInfo, nullptr, &PipelineLayout) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE PIPELINE LAYOUT OF " << name << std::endl;
+		return false;
+	}
+
+	VkShaderModule shaderModule = VK_NULL_HANDLE;
+	if (!Compiler.CreateShaderModule(Dispatch, source, VK_SHADER_STAGE_COMPUTE_BIT, name, shaderModule)) {
+		return false;
+	}
+
+	// Work group size comes in through specialization constants 0 to 2
+	const VkSpecializationMapEntry specializationEntries[3] = {
+		{ 0, 0, sizeof(uint32_t) },
+		{ 1, sizeof(uint32_t), sizeof(uint32_t) },
+		{ 2, 2 * sizeof(uint32_t), sizeof(uint32_t) }
+	};
+	VkSpecializationInfo specializationInfo = { 3, specializationEntries, sizeof(LocalSize), LocalSize };
+
+	VkComputePipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.pNext = nullptr;
+	pipelineCreateInfo.flags = 0;
+	pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineCreateInfo.stage.pNext = nullptr;
+	pipelineCreateInfo.stage.flags = 0;
+	pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineCreateInfo.stage.module = shaderModule;
+	pipelineCreateInfo.stage.pName = "main";
+	pipelineCreateInfo.stage.pSpecializationInfo = &specializationInfo;
+	pipelineCreateInfo.layout = PipelineLayout;
+	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineCreateInfo.basePipelineIndex = -1;
+
+	const VkResult result = Dispatch.vkCreateComputePipelines(Dispatch.device, Device.pipelineCache, 1, &pipelineCreateInfo, nullptr, &Pipeline);
+	Dispatch.vkDestroyShaderModule(Dispatch.device, shaderModule, nullptr);
+	if (result != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE COMPUTE PIPELINE " << name << std::endl;
+		Pipeline = VK_NULL_HANDLE;
+		return false;
+	}
+	return true;
+}
+
+void ComputePipeline::Destroy() {
+	if (Pipeline != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyPipeline(Dispatch.device, Pipeline, nullptr);
+		Pipeline = VK_NULL_HANDLE;
+	}
+	if (PipelineLayout != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyPipelineLayout(Dispatch.device, PipelineLayout, nullptr);
+		PipelineLayout = VK_NULL_HANDLE;
+	}
+	// Sets are freed together with their pool
+	if (DescriptorPool != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyDescriptorPool(Dispatch.device, DescriptorPool, nullptr);
+		DescriptorPool = VK_NULL_HANDLE;
+	}
+	if (SetLayout != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyDescriptorSetLayout(Dispatch.device, SetLayout, nullptr);
+		SetLayout = VK_NULL_HANDLE;
+	}
+}
+
+bool ComputePipeline::AllocateDescriptorSet(VkDescriptorSet& set) {
+	VkDescriptorSetAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.pNext = nullptr;
+	allocateInfo.descriptorPool = DescriptorPool;
+	allocateInfo.descriptorSetCount = 1;
+	allocateInfo.pSetLayouts = &SetLayout;
+
+	if ((DescriptorPool == VK_NULL_HANDLE) || (Dispatch.vkAllocateDescriptorSets(Dispatch.device, &allocateInfo, &set) != VK_SUCCESS)) {
+		std::cout << "COULD NOT ALLOCATE DESCRIPTOR SET " << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void ComputePipeline::WriteBuffer(VkDescriptorSet set, uint32_t binding, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) const {
+	VkDescriptorBufferInfo bufferInfo = { buffer, offset, range };
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.pNext = nullptr;
+	write.dstSet = set;
+	write.dstBinding = binding;
+	write.dstArrayElement = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = Bindings.at(binding);
+	write.pImageInfo = nullptr;
+	write.pBufferInfo = &bufferInfo;
+	write.pTexelBufferView = nullptr;
+	Dispatch.vkUpdateDescriptorSets(Dispatch.device, 1, &write, 0, nullptr);
+}
+
+void ComputePipeline::WriteStorageImage(VkDescriptorSet set, uint32_t binding, VkImageView view) const {
+	VkDescriptorImageInfo imageInfo = { VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_GENERAL };
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.pNext = nullptr;
+	write.dstSet = set;
+	write.dstBinding = binding;
+	write.dstArrayElement = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = Bindings.at(binding);
+	write.pImageInfo = &imageInfo;
+	write.pBufferInfo = nullptr;
+	write.pTexelBufferView = nullptr;
+	Dispatch.vkUpdateDescriptorSets(Dispatch.device, 1, &write, 0, nullptr);
+}
+
+void ComputePipeline::WriteImage(VkDescriptorSet set, uint32_t binding, VkImageView view, VkSampler sampler, VkImageLayout layout) const {
+	VkDescriptorImageInfo imageInfo = { sampler, view, layout };
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.pNext = nullptr;
+	write.dstSet = set;
+	write.dstBinding = binding;
+	write.dstArrayElement = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = Bindings.at(binding);
+	write.pImageInfo = &imageInfo;
+	write.pBufferInfo = nullptr;
+	write.pTexelBufferView = nullptr;
+	Dispatch.vkUpdateDescriptorSets(Dispatch.device, 1, &write, 0, nullptr);
+}
+
+void ComputePipeline::CmdBind(VkCommandBuffer commandBuffer, VkDescriptorSet set) const {
+	Dispatch.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, Pipeline);
+	Dispatch.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, PipelineLayout, 0, 1, &set, 0, nullptr);
+}
+
+void ComputePipeline::CmdPushConstants(VkCommandBuffer commandBuffer, const void* data, uint32_t size) const {
+	Dispatch.vkCmdPushConstants(commandBuffer, PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, size, data);
+}
+
+void ComputePipeline::CmdDispatch(VkCommandBuffer commandBuffer, uint32_t countX, uint32_t countY, uint32_t countZ) const {
+	Dispatch.vkCmdDispatch(commandBuffer,
+		(countX + LocalSize[0] - 1) / LocalSize[0],
+		(countY + LocalSize[1] - 1) / LocalSize[1],
+		(countZ + LocalSize[2] - 1) / LocalSize[2]);
+}
+
+void ComputePipeline::CmdDispatchIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset) const {
+	Dispatch.vkCmdDispatchIndirect(commandBuffer, buffer, offset);
+}
+
+VkPipeline ComputePipeline::GetPipeline() const {
+	return Pipeline;
+}
+
+VkPipelineLayout ComputePipeline::GetLayout() const {
+	return PipelineLayout;
+}
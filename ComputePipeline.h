@@ -0,0 +1,80 @@
+#pragma once
+
+#include "VulkanDispatch.h"
+#include "ShaderCompiler.h"
+#include <cstdint>
+#include <vector>
+
+// Buffer with its own memory. Host visible buffers stay mapped for their whole life.
+struct GpuBuffer {
+	VkBuffer handle;
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	void* mapped;
+
+	GpuBuffer() :
+		handle(VK_NULL_HANDLE),
+		memory(VK_NULL_HANDLE),
+		size(0),
+		mapped(nullptr) {
+	}
+};
+
+// Buffers used by more than one queue family (graphics and async compute) are shared concurrently,
+// so no ownership transfers are needed; pass the families from ComputeQueue::GetSharingFamilies().
+bool CreateGpuBuffer(const DeviceContext& device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, GpuBuffer& buffer,
+	const std::vector<uint32_t>& sharingFamilies = std::vector<uint32_t>());
+void DestroyGpuBuffer(const DeviceContext& device, GpuBuffer& buffer);
+
+// Makes shader writes of earlier dispatches visible to later dispatches, transfers and indirect draws
+void CmdComputeBarrier(const DeviceDispatchTable& dispatch, VkCommandBuffer commandBuffer);
+
+// Compute shader with all its resources in descriptor set 0, one binding per entry of bindings
+// (storage buffers, storage images and anything else a descriptor pool can hold) and optional push constants.
+// Work group size is set at creation, the shader declares it as
+//     layout(local_size_x_id = 0, local_size_y_id = 1, local_size_z_id = 2) in;
+// and may use the same constant ids (0 to 2) for its shared memory sizes.
+class ComputePipeline {
+public:
+	// Context's dispatch table must outlive the pipeline
+	explicit ComputePipeline(const DeviceContext& device);
+	~ComputePipeline();
+
+	ComputePipeline(const ComputePipeline&) = delete;
+	ComputePipeline& operator=(const ComputePipeline&) = delete;
+
+	// Up to maxSets descriptor sets can be allocated afterwards
+	bool Create(const char* source, const char* name, const std::vector<VkDescriptorType>& bindings, uint32_t pushConstantSize, uint32_t maxSets,
+		uint32_t localSizeX, uint32_t localSizeY = 1, uint32_t localSizeZ = 1);
+	void Destroy();
+
+	bool AllocateDescriptorSet(VkDescriptorSet& set);
+	// Uniform or storage buffer, as the binding was declared. Sets must not be in use by the GPU while they are written
+	void WriteBuffer(VkDescriptorSet set, uint32_t binding, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE) const;
+	// Storage images are accessed in the GENERAL layout
+	void WriteStorageImage(VkDescriptorSet set, uint32_t binding, VkImageView view) const;
+	// Sampled (or combined image sampler) binding
+	void WriteImage(VkDescriptorSet set, uint32_t binding, VkImageView view, VkSampler sampler, VkImageLayout layout) const;
+
+	void CmdBind(VkCommandBuffer commandBuffer, VkDescriptorSet set) const;
+	void CmdPushConstants(VkCommandBuffer commandBuffer, const void* data, uint32_t size) const;
+	// Dispatches enough work groups to cover the given number of invocations in each dimension
+	void CmdDispatch(VkCommandBuffer commandBuffer, uint32_t countX, uint32_t countY = 1, uint32_t countZ = 1) const;
+	// Work group counts are read from a VkDispatchIndirectCommand written by earlier GPU work
+	void CmdDispatchIndirect(VkCommandBuffer commandBuffer, VkBuffer buffer, VkDeviceSize offset) const;
+
+	VkPipeline GetPipeline() const;
+	VkPipelineLayout GetLayout() const;
+
+private:
+	DeviceContext Device;
+	const DeviceDispatchTable& Dispatch;
+	ShaderCompiler Compiler;
+
+	std::vector<VkDescriptorType> Bindings;
+	uint32_t LocalSize[3];
+	VkDescriptorSetLayout SetLayout;
+	VkDescriptorPool DescriptorPool;
+	VkPipelineLayout PipelineLayout;
+	VkPipeline Pipeline;
+};
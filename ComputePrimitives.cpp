@@ -0,0 +1,340 @@
+#include "ComputePrimitives.h"
+#include "VulkanFunctions.h"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+	const uint32_t GroupSize = 256;
+
+	// Scans the work group's values in shared memory and writes the group's total to the next level
+	const char* ScanShader = R"(#version 450
+layout(local_size_x_id = 0) in;
+
+layout(set = 0, binding = 0) buffer Values {
+	uint values[];
+};
+layout(set = 0, binding = 1) writeonly buffer GroupTotals {
+	uint totals[];
+};
+layout(push_constant) uniform Parameters {
+	uint count;
+};
+
+shared uint scratch[gl_WorkGroupSize.x];
+
+void main() {
+	const uint index = gl_GlobalInvocationID.x;
+	const uint local = gl_LocalInvocationID.x;
+	scratch[local] = (index < count) ? values[index] : 0;
+	barrier();
+
+	for (uint offset = 1; offset < gl_WorkGroupSize.x; offset <<= 1) {
+		const uint previous = (local >= offset) ? scratch[local - offset] : 0;
+		barrier();
+		scratch[local] += previous;
+		barrier();
+	}
+
+	if (index < count) {
+		values[index] = scratch[local];
+	}
+	if (local == gl_WorkGroupSize.x - 1) {
+		totals[gl_WorkGroupID.x] = scratch[local];
+	}
+}
+)";
+
+	// Adds the scanned totals of all earlier groups to every value of a group
+	const char* AddShader = R"(#version 450
+layout(local_size_x_id = 0) in;
+
+layout(set = 0, binding = 0) buffer Values {
+	uint values[];
+};
+layout(set = 0, binding = 1) readonly buffer ScannedTotals {
+	uint totals[];
+};
+layout(push_constant) uniform Parameters {
+	uint count;
+};
+
+void main() {
+	const uint index = gl_GlobalInvocationID.x;
+	if ((gl_WorkGroupID.x > 0) && (index < count)) {
+		values[index] += totals[gl_WorkGroupID.x - 1];
+	}
+}
+)";
+
+	// Every invocation adds two values while loading, so a group covers twice its size
+	const char* ReduceShader = R"(#version 450
+layout(local_size_x_id = 0) in;
+
+layout(set = 0, binding = 0) readonly buffer Values {
+	uint values[];
+};
+layout(set = 0, binding = 1) writeonly buffer GroupSums {
+	uint sums[];
+};
+layout(push_constant) uniform Parameters {
+	uint count;
+};
+
+shared uint scratch[gl_WorkGroupSize.x];
+
+void main() {
+	const uint local = gl_LocalInvocationID.x;
+	const uint first = gl_WorkGroupID.x * 2 * gl_WorkGroupSize.x + local;
+	const uint second = first + gl_WorkGroupSize.x;
+	scratch[local] = ((first < count) ? values[first] : 0) + ((second < count) ? values[second] : 0);
+
+	for (uint stride = gl_WorkGroupSize.x / 2; stride > 0; stride >>= 1) {
+		barrier();
+		if (local < stride) {
+			scratch[local] += scratch[local + stride];
+		}
+	}
+
+	if (local == 0) {
+		sums[gl_WorkGroupID.x] = scratch[0];
+	}
+}
+)";
+
+	// Value counts of every level: the input, then one value per group of the level before, down to a single one
+	std::vector<uint32_t> GetLevelCounts(uint32_t count, uint32_t valuesPerGroup) {
+		std::vector<uint32_t> counts(1, count);
+		while (counts.back() > 1) {
+			counts.push_back((counts.back() + valuesPerGroup - 1) / valuesPerGroup);
+		}
+		return counts;
+	}
+
+	VkDeviceSize GetStorageBufferAlignment(VkPhysicalDevice physicalDevice) {
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		return std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment, sizeof(uint32_t));
+	}
+
+	VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+}
+
+// ***** PrefixSum ***** //
+
+PrefixSum::PrefixSum(const DeviceContext& device) :
+	Device(device),
+	ScanPipeline(device),
+	AddPipeline(device),
+	Totals(),
+	MaxCount(0),
+	Levels(),
+	LevelCount(0) {
+}
+
+PrefixSum::~PrefixSum() {
+	Destroy();
+}
+
+bool PrefixSum::Create(uint32_t maxCount) {
+	Destroy();
+	MaxCount = std::max<uint32_t>(maxCount, 1);
+
+	// Totals of all levels share one buffer, each level starts on an offset descriptors can use
+	const std::vector<uint32_t> counts = GetLevelCounts(MaxCount, GroupSize);
+	const VkDeviceSize alignment = GetStorageBufferAlignment(Device.physicalDevice);
+	VkDeviceSize size = 0;
+	Levels.resize(counts.size());
+	for (size_t i = 0; i < counts.size(); ++i) {
+		Levels[i].count = counts[i];
+		Levels[i].offset = 0;
+		Levels[i].scanSet = VK_NULL_HANDLE;
+		Levels[i].addSet = VK_NULL_HANDLE;
+		if (i > 0) {
+			Levels[i].offset = size;
+			size += AlignUp(counts[i] * sizeof(uint32_t), alignment);
+		}
+	}
+
+	const uint32_t setCount = static_cast<uint32_t>(Levels.size());
+	const std::vector<VkDescriptorType> bindings(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+	if (!CreateGpuBuffer(Device, std::max(size, alignment), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, Totals)
+		|| !ScanPipeline.Create(ScanShader, "prefix_sum_scan.comp", bindings, sizeof(uint32_t), setCount, GroupSize)
+		|| !AddPipeline.Create(AddShader, "prefix_sum_add.comp", bindings, sizeof(uint32_t), setCount, GroupSize)) {
+		return false;
+	}
+
+	// Only level 0 depends on the input buffer, everything else is written once here
+	for (size_t i = 0; i + 1 < Levels.size(); ++i) {
+		if (!ScanPipeline.AllocateDescriptorSet(Levels[i].scanSet) || !AddPipeline.AllocateDescriptorSet(Levels[i].addSet)) {
+			return false;
+		}
+		const VkDeviceSize nextRange = Levels[i + 1].count * sizeof(uint32_t);
+		ScanPipeline.WriteBuffer(Levels[i].scanSet, 1, Totals.handle, Levels[i + 1].offset, nextRange);
+		AddPipeline.WriteBuffer(Levels[i].addSet, 1, Totals.handle, Levels[i + 1].offset, nextRange);
+		if (i > 0) {
+			const VkDeviceSize range = Levels[i].count * sizeof(uint32_t);
+			ScanPipeline.WriteBuffer(Levels[i].scanSet, 0, Totals.handle, Levels[i].offset, range);
+			AddPipeline.WriteBuffer(Levels[i].addSet, 0, Totals.handle, Levels[i].offset, range);
+		}
+	}
+	return true;
+}
+
+void PrefixSum::Destroy() {
+	ScanPipeline.Destroy();
+	AddPipeline.Destroy();
+	DestroyGpuBuffer(Device, Totals);
+	Levels.clear();
+	LevelCount = 0;
+	MaxCount = 0;
+}
+
+bool PrefixSum::SetBuffer(VkBuffer buffer, VkDeviceSize offset, uint32_t count) {
+	if ((count == 0) || (count > MaxCount)) {
+		std::cout << "PREFIX SUM WAS CREATED FOR AT MOST " << MaxCount << " VALUES " << std::endl;
+		return false;
+	}
+
+	// A smaller input needs fewer and smaller levels, they fit into the ones laid out for the maximum
+	const std::vector<uint32_t> counts = GetLevelCounts(count, GroupSize);
+	LevelCount = static_cast<uint32_t>(counts.size());
+	for (size_t i = 0; i < counts.size(); ++i) {
+		Levels[i].count = counts[i];
+	}
+
+	if (LevelCount > 1) {
+		ScanPipeline.WriteBuffer(Levels[0].scanSet, 0, buffer, offset, count * sizeof(uint32_t));
+		AddPipeline.WriteBuffer(Levels[0].addSet, 0, buffer, offset, count * sizeof(uint32_t));
+	}
+	return true;
+}
+
+void PrefixSum::CmdScan(VkCommandBuffer commandBuffer) const {
+	const DeviceDispatchTable& dispatch = *Device.dispatch;
+
+	// Scan down to the level which fits into a single group...
+	for (uint32_t i = 0; i + 1 < LevelCount; ++i) {
+		ScanPipeline.CmdBind(commandBuffer, Levels[i].scanSet);
+		ScanPipeline.CmdPushConstants(commandBuffer, &Levels[i].count, sizeof(uint32_t));
+		ScanPipeline.CmdDispatch(commandBuffer, Levels[i].count);
+		CmdComputeBarrier(dispatch, commandBuffer);
+	}
+
+	// ...then add the scanned totals back on the way up
+	// (the last scanned level fits into one group and needs nothing added)
+	for (uint32_t i = (LevelCount > 2) ? LevelCount - 2 : 0; i-- > 0;) {
+		AddPipeline.CmdBind(commandBuffer, Levels[i].addSet);
+		AddPipeline.CmdPushConstants(commandBuffer, &Levels[i].count, sizeof(uint32_t));
+		AddPipeline.CmdDispatch(commandBuffer, Levels[i].count);
+		CmdComputeBarrier(dispatch, commandBuffer);
+	}
+}
+
+// ***** Reduction ***** //
+
+Reduction::Reduction(const DeviceContext& device) :
+	Device(device),
+	ReducePipeline(device),
+	Partials(),
+	MaxCount(0),
+	Levels(),
+	LevelCount(0),
+	ResultBuffer(VK_NULL_HANDLE),
+	ResultOffset(0) {
+}
+
+Reduction::~Reduction() {
+	Destroy();
+}
+
+bool Reduction::Create(uint32_t maxCount) {
+	Destroy();
+	MaxCount = std::max<uint32_t>(maxCount, 1);
+
+	const std::vector<uint32_t> counts = GetLevelCounts(MaxCount, 2 * GroupSize);
+	const VkDeviceSize alignment = GetStorageBufferAlignment(Device.physicalDevice);
+	VkDeviceSize size = 0;
+	Levels.resize(counts.size());
+	for (size_t i = 0; i < counts.size(); ++i) {
+		Levels[i].count = counts[i];
+		Levels[i].offset = 0;
+		Levels[i].set = VK_NULL_HANDLE;
+		if (i > 0) {
+			Levels[i].offset = size;
+			size += AlignUp(counts[i] * sizeof(uint32_t), alignment);
+		}
+	}
+
+	// The result may be copied out, so partial sums can be a transfer source
+	const std::vector<VkDescriptorType> bindings(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+	if (!CreateGpuBuffer(Device, std::max(size, alignment), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, Partials)
+		|| !ReducePipeline.Create(ReduceShader, "reduction.comp", bindings, sizeof(uint32_t), static_cast<uint32_t>(Levels.size()), GroupSize)) {
+		return false;
+	}
+
+	for (size_t i = 0; i + 1 < Levels.size(); ++i) {
+		if (!ReducePipeline.AllocateDescriptorSet(Levels[i].set)) {
+			return false;
+		}
+		ReducePipeline.WriteBuffer(Levels[i].set, 1, Partials.handle, Levels[i + 1].offset, Levels[i + 1].count * sizeof(uint32_t));
+		if (i > 0) {
+			ReducePipeline.WriteBuffer(Levels[i].set, 0, Partials.handle, Levels[i].offset, Levels[i].count * sizeof(uint32_t));
+		}
+	}
+	return true;
+}
+
+void Reduction::Destroy() {
+	ReducePipeline.Destroy();
+	DestroyGpuBuffer(Device, Partials);
+	Levels.clear();
+	LevelCount = 0;
+	MaxCount = 0;
+	ResultBuffer = VK_NULL_HANDLE;
+	ResultOffset = 0;
+}
+
+bool Reduction::SetBuffer(VkBuffer buffer, VkDeviceSize offset, uint32_t count) {
+	if ((count == 0) || (count > MaxCount)) {
+		std::cout << "REDUCTION WAS CREATED FOR AT MOST " << MaxCount << " VALUES " << std::endl;
+		return false;
+	}
+
+	const std::vector<uint32_t> counts = GetLevelCounts(count, 2 * GroupSize);
+	LevelCount = static_cast<uint32_t>(counts.size());
+	for (size_t i = 0; i < counts.size(); ++i) {
+		Levels[i].count = counts[i];
+	}
+
+	// A single value is its own sum
+	if (LevelCount == 1) {
+		ResultBuffer = buffer;
+		ResultOffset = offset;
+		return true;
+	}
+	ReducePipeline.WriteBuffer(Levels[0].set, 0, buffer, offset, count * sizeof(uint32_t));
+	ResultBuffer = Partials.handle;
+	ResultOffset = Levels[LevelCount - 1].offset;
+	return true;
+}
+
+void Reduction::CmdReduce(VkCommandBuffer commandBuffer) const {
+	const DeviceDispatchTable& dispatch = *Device.dispatch;
+	for (uint32_t i = 0; i + 1 < LevelCount; ++i) {
+		// Two values per invocation
+		ReducePipeline.CmdBind(commandBuffer, Levels[i].set);
+		ReducePipeline.CmdPushConstants(commandBuffer, &Levels[i].count, sizeof(uint32_t));
+		ReducePipeline.CmdDispatch(commandBuffer, (Levels[i].count + 1) / 2);
+		CmdComputeBarrier(dispatch, commandBuffer);
+	}
+}
+
+VkBuffer Reduction::GetResultBuffer() const {
+	return ResultBuffer;
+}
+
+VkDeviceSize Reduction::GetResultOffset() const {
+	return ResultOffset;
+}
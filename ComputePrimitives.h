@@ -0,0 +1,81 @@
+#pragma once
+
+#include "ComputePipeline.h"
+#include <cstdint>
+#include <vector>
+
+// Inclusive prefix sum of 32-bit unsigned integers, in place. Every work group scans its part in shared memory
+// and writes its total to the next level, which is scanned the same way until a single group covers it; the
+// scanned totals are then added back level by level. Sums wrap around like uint arithmetic.
+class PrefixSum {
+public:
+	// Context's dispatch table must outlive the prefix sum
+	explicit PrefixSum(const DeviceContext& device);
+	~PrefixSum();
+
+	PrefixSum(const PrefixSum&) = delete;
+	PrefixSum& operator=(const PrefixSum&) = delete;
+
+	bool Create(uint32_t maxCount);
+	void Destroy();
+
+	// Values to scan, count of them from offset (aligned to minStorageBufferOffsetAlignment).
+	// Writes descriptors, so no earlier scan may still be executing.
+	bool SetBuffer(VkBuffer buffer, VkDeviceSize offset, uint32_t count);
+	// Leaves the results visible to later compute shaders and transfers
+	void CmdScan(VkCommandBuffer commandBuffer) const;
+
+private:
+	struct Level {
+		uint32_t count;
+		VkDeviceSize offset;		// In Totals, level 0 is the input itself
+		VkDescriptorSet scanSet;
+		VkDescriptorSet addSet;
+	};
+
+	DeviceContext Device;
+	ComputePipeline ScanPipeline;
+	ComputePipeline AddPipeline;
+	GpuBuffer Totals;
+	uint32_t MaxCount;
+	std::vector<Level> Levels;		// Laid out for MaxCount
+	uint32_t LevelCount;			// Used by the current buffer
+};
+
+// Sum of 32-bit unsigned integers. Every pass adds up each work group's values in shared memory, until one value is left.
+class Reduction {
+public:
+	// Context's dispatch table must outlive the reduction
+	explicit Reduction(const DeviceContext& device);
+	~Reduction();
+
+	Reduction(const Reduction&) = delete;
+	Reduction& operator=(const Reduction&) = delete;
+
+	bool Create(uint32_t maxCount);
+	void Destroy();
+
+	// Same rules as PrefixSum::SetBuffer(), the input isn't modified
+	bool SetBuffer(VkBuffer buffer, VkDeviceSize offset, uint32_t count);
+	void CmdReduce(VkCommandBuffer commandBuffer) const;
+
+	// Where CmdReduce() leaves the sum (a single uint)
+	VkBuffer GetResultBuffer() const;
+	VkDeviceSize GetResultOffset() const;
+
+private:
+	struct Level {
+		uint32_t count;
+		VkDeviceSize offset;
+		VkDescriptorSet set;
+	};
+
+	DeviceContext Device;
+	ComputePipeline ReducePipeline;
+	GpuBuffer Partials;
+	uint32_t MaxCount;
+	std::vector<Level> Levels;
+	uint32_t LevelCount;
+	VkBuffer ResultBuffer;
+	VkDeviceSize ResultOffset;
+};
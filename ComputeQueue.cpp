@@ -0,0 +1,174 @@
+#include "ComputeQueue.h"
+#include <iostream>
+
+ComputeQueue::ComputeQueue(const DeviceContext& device) :
+	Device(device),
+	Dispatch(*device.dispatch),
+	Queue((device.computeQueue != VK_NULL_HANDLE) ? device.computeQueue : device.graphicsQueue),
+	QueueFamilyIndex((device.computeQueue != VK_NULL_HANDLE) ? device.computeQueueFamilyIndex : device.graphicsQueueFamilyIndex),
+	CommandPool(VK_NULL_HANDLE),
+	Submissions(),
+	Current(0),
+	Recording(false) {
+}
+
+ComputeQueue::~ComputeQueue() {
+	Destroy();
+}
+
+bool ComputeQueue::Create(uint32_t inFlight) {
+	Destroy();
+
+	VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+	commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	commandPoolCreateInfo.pNext = nullptr;
+	commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	commandPoolCreateInfo.queueFamilyIndex = QueueFamilyIndex;
+
+	if (Dispatch.vkCreateCommandPool(Dispatch.device, &commandPoolCreateInfo, nullptr, &CommandPool) != VK_SUCCESS) {
+		std::cout << "ERROR WHILE CREATING COMPUTE COMMAND POOL " << std::endl;
+		return false;
+	}
+
+	Submissions.resize((inFlight > 0) ? inFlight : 1);
+	for (Submission& submission : Submissions) {
+		submission.commandBuffer = VK_NULL_HANDLE;
+		submission.fence = VK_NULL_HANDLE;
+		submission.pending = false;
+
+		VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+		commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		commandBufferAllocateInfo.pNext = nullptr;
+		commandBufferAllocateInfo.commandPool = CommandPool;
+		commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		commandBufferAllocateInfo.commandBufferCount = 1;
+
+		VkFenceCreateInfo fenceCreateInfo = {};
+		fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fenceCreateInfo.pNext = nullptr;
+		fenceCreateInfo.flags = 0;
+
+		if ((Dispatch.vkAllocateCommandBuffers(Dispatch.device, &commandBufferAllocateInfo, &submission.commandBuffer) != VK_SUCCESS)
+			|| (Dispatch.vkCreateFence(Dispatch.device, &fenceCreateInfo, nullptr, &submission.fence) != VK_SUCCESS)) {
+			std::cout << "COULD NOT CREATE COMPUTE COMMAND BUFFERS " << std::endl;
+			return false;
+		}
+	}
+	Current = 0;
+	return true;
+}
+
+void ComputeQueue::Destroy() {
+	Wait();
+	for (Submission& submission : Submissions) {
+		if (submission.fence != VK_NULL_HANDLE) {
+			Dispatch.vkDestroyFence(Dispatch.device, submission.fence, nullptr);
+		}
+	}
+	Submissions.clear();
+
+	// Command buffers are freed together with their pool
+	if (CommandPool != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyCommandPool(Dispatch.device, CommandPool, nullptr);
+		CommandPool = VK_NULL_HANDLE;
+	}
+	Recording = false;
+}
+
+VkCommandBuffer ComputeQueue::Begin() {
+	if (Submissions.empty()) {
+		return VK_NULL_HANDLE;
+	}
+
+	Submission& submission = Submissions[Current];
+	if (!WaitFor(submission)) {
+		return VK_NULL_HANDLE;
+	}
+
+	VkCommandBufferBeginInfo cmdBufferBeginInfo = {};
+	cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	cmdBufferBeginInfo.pNext = nullptr;
+	cmdBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	cmdBufferBeginInfo.pInheritanceInfo = nullptr;
+
+	if (Dispatch.vkBeginCommandBuffer(submission.commandBuffer, &cmdBufferBeginInfo) != VK_SUCCESS) {
+		std::cout << "COULD NOT BEGIN COMPUTE COMMAND BUFFER " << std::endl;
+		return VK_NULL_HANDLE;
+	}
+	Recording = true;
+	return submission.commandBuffer;
+}
+
+bool ComputeQueue::Submit(VkSemaphore waitSemaphore, VkPipelineStageFlags waitStage, VkSemaphore signalSemaphore) {
+	if (!Recording) {
+		return false;
+	}
+	Recording = false;
+
+	Submission& submission = Submissions[Current];
+	if (Dispatch.vkEndCommandBuffer(submission.commandBuffer) != VK_SUCCESS) {
+		std::cout << "COULD NOT RECORD COMPUTE COMMAND BUFFER " << std::endl;
+		return false;
+	}
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = nullptr;
+	submitInfo.waitSemaphoreCount = (waitSemaphore != VK_NULL_HANDLE) ? 1 : 0;
+	submitInfo.pWaitSemaphores = &waitSemaphore;
+	submitInfo.pWaitDstStageMask = &waitStage;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &submission.commandBuffer;
+	submitInfo.signalSemaphoreCount = (signalSemaphore != VK_NULL_HANDLE) ? 1 : 0;
+	submitInfo.pSignalSemaphores = &signalSemaphore;
+
+	if (Dispatch.vkQueueSubmit(Queue, 1, &submitInfo, submission.fence) != VK_SUCCESS) {
+		std::cout << "COULD NOT SUBMIT COMPUTE COMMAND BUFFER " << std::endl;
+		return false;
+	}
+	submission.pending = true;
+	Current = (Current + 1) % static_cast<uint32_t>(Submissions.size());
+	return true;
+}
+
+bool ComputeQueue::Wait() {
+	// Oldest first, the queue finishes them in order anyway
+	bool result = true;
+	for (size_t i = 0; i < Submissions.size(); ++i) {
+		result = WaitFor(Submissions[(Current + i) % Submissions.size()]) && result;
+	}
+	return result;
+}
+
+bool ComputeQueue::IsAsync() const {
+	return QueueFamilyIndex != Device.graphicsQueueFamilyIndex;
+}
+
+VkQueue ComputeQueue::GetQueue() const {
+	return Queue;
+}
+
+uint32_t ComputeQueue::GetQueueFamilyIndex() const {
+	return QueueFamilyIndex;
+}
+
+std::vector<uint32_t> ComputeQueue::GetSharingFamilies() const {
+	std::vector<uint32_t> families(1, Device.graphicsQueueFamilyIndex);
+	if (IsAsync()) {
+		families.push_back(QueueFamilyIndex);
+	}
+	return families;
+}
+
+bool ComputeQueue::WaitFor(Submission& submission) {
+	if (!submission.pending) {
+		return true;
+	}
+	if ((Dispatch.vkWaitForFences(Dispatch.device, 1, &submission.fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS)
+		|| (Dispatch.vkResetFences(Dispatch.device, 1, &submission.fence) != VK_SUCCESS)) {
+		std::cout << "WAITING FOR COMPUTE FENCE TOOK TOO LONG " << std::endl;
+		return false;
+	}
+	submission.pending = false;
+	return true;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "VulkanDispatch.h"
+#include <cstdint>
+#include <vector>
+
+// Records and submits compute work on the device's compute queue. On devices with a compute-only queue family
+// that's a separate (async compute) queue, so its dispatches overlap with the graphics queue's work; elsewhere
+// the work simply goes to the graphics queue. Semaphores passed to Submit() order it against graphics work
+// where results are consumed. Several submissions can be in flight, Begin() waits only for the oldest one.
+class ComputeQueue {
+public:
+	// Context's dispatch table must outlive the queue
+	explicit ComputeQueue(const DeviceContext& device);
+	~ComputeQueue();
+
+	ComputeQueue(const ComputeQueue&) = delete;
+	ComputeQueue& operator=(const ComputeQueue&) = delete;
+
+	bool Create(uint32_t inFlight = 2);
+	void Destroy();
+
+	// Command buffer for the next submission, VK_NULL_HANDLE when waiting for its previous use failed
+	VkCommandBuffer Begin();
+	// Optionally waits for a binary semaphore (at waitStage) and signals another one
+	bool Submit(VkSemaphore waitSemaphore = VK_NULL_HANDLE, VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VkSemaphore signalSemaphore = VK_NULL_HANDLE);
+	// Waits for everything submitted so far
+	bool Wait();
+
+	// Runs on a queue family of its own, next to the graphics queue
+	bool IsAsync() const;
+	VkQueue GetQueue() const;
+	uint32_t GetQueueFamilyIndex() const;
+	// Queue families of resources used by both queues (created with concurrent sharing), one family when they're the same
+	std::vector<uint32_t> GetSharingFamilies() const;
+
+private:
+	struct Submission {
+		VkCommandBuffer commandBuffer;
+		VkFence fence;
+		bool pending;
+	};
+
+	bool WaitFor(Submission& submission);
+
+	DeviceContext Device;
+	const DeviceDispatchTable& Dispatch;
+	VkQueue Queue;
+	uint32_t QueueFamilyIndex;
+
+	VkCommandPool CommandPool;
+	std::vector<Submission> Submissions;
+	uint32_t Current;
+	bool Recording;
+};
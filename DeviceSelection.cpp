@@ -0,0 +1,140 @@
+#include "DeviceSelection.h"
+#include "VulkanFunctions.h"
+#include <algorithm>
+#include <iomanip>
+
+namespace {
+	const double GiB = 1024.0 * 1024.0 * 1024.0;
+
+	// Larger than the most every other term can add up to (800 + 320 + 128 + 75), so the type always decides first
+	const double TypeStep = 10000.0;
+
+	double TypeScore(VkPhysicalDeviceType type) {
+		switch (type) {
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+			return 4.0 * TypeStep;
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+			return 3.0 * TypeStep;
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+			return 2.0 * TypeStep;
+		case VK_PHYSICAL_DEVICE_TYPE_CPU:
+			return TypeStep;
+		default:
+			return 0.0;
+		}
+	}
+
+	const char* TypeName(VkPhysicalDeviceType type) {
+		switch (type) {
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+			return "discrete";
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+			return "integrated";
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+			return "virtual";
+		case VK_PHYSICAL_DEVICE_TYPE_CPU:
+			return "cpu";
+		default:
+			return "other";
+		}
+	}
+}
+
+double ScorePhysicalDevice(const PhysicalDeviceInfo& info) {
+	if (!info.CanRender()) {
+		return -1.0;
+	}
+
+	double score = TypeScore(info.properties.deviceType);
+
+	// Only breaks ties between devices of the same type: integrated GPUs and CPU devices may report most of the system
+	// memory as device local
+	score += 50.0 * std::min(static_cast<double>(info.deviceLocalMemory) / GiB, 16.0);
+
+	const VkPhysicalDeviceLimits& limits = info.properties.limits;
+	score += 10.0 * std::min(static_cast<double>(limits.maxImageDimension2D) / 1024.0, 32.0);
+	score += std::min(static_cast<double>(limits.maxComputeSharedMemorySize) / 1024.0, 128.0);
+
+	// Separate compute and copy queues let uploads and compute overlap with rendering
+	if (info.computeQueueFamilyIndex != UINT32_MAX) {
+		score += 50.0;
+	}
+	if (info.transferQueueFamilyIndex != UINT32_MAX) {
+		score += 25.0;
+	}
+	return score;
+}
+
+std::vector<PhysicalDeviceInfo> EnumeratePhysicalDevices(VkInstance instance) {
+	uint32_t deviceCount = 0;
+	if ((vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr) != VK_SUCCESS) || (deviceCount == 0)) {
+		return std::vector<PhysicalDeviceInfo>();
+	}
+	std::vector<VkPhysicalDevice> physicalDevices(deviceCount);
+	if (vkEnumeratePhysicalDevices(instance, &deviceCount, physicalDevices.data()) != VK_SUCCESS) {
+		return std::vector<PhysicalDeviceInfo>();
+	}
+
+	std::vector<PhysicalDeviceInfo> devices;
+	for (VkPhysicalDevice physicalDevice : physicalDevices) {
+		PhysicalDeviceInfo info;
+		info.handle = physicalDevice;
+		vkGetPhysicalDeviceProperties(physicalDevice, &info.properties);
+
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+			if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+				info.deviceLocalMemory += memoryProperties.memoryHeaps[i].size;
+			}
+		}
+
+		uint32_t queueFamiliesCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamiliesCount, nullptr);
+		std::vector<VkQueueFamilyProperties> queueFamiliesProperties(queueFamiliesCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamiliesCount, queueFamiliesProperties.data());
+
+		for (uint32_t i = 0; i < queueFamiliesCount; ++i) {
+			const VkQueueFlags flags = queueFamiliesProperties[i].queueFlags;
+			if (queueFamiliesProperties[i].queueCount == 0) {
+				continue;
+			}
+			if ((flags & VK_QUEUE_GRAPHICS_BIT) && (info.graphicsQueueFamilyIndex == UINT32_MAX)) {
+				info.graphicsQueueFamilyIndex = i;
+			}
+			else if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) && (info.computeQueueFamilyIndex == UINT32_MAX)) {
+				info.computeQueueFamilyIndex = i;
+			}
+			else if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) && (info.transferQueueFamilyIndex == UINT32_MAX)) {
+				info.transferQueueFamilyIndex = i;
+			}
+		}
+
+		info.score = ScorePhysicalDevice(info);
+		devices.push_back(info);
+	}
+
+	// Stable, so identical devices keep the driver's order
+	std::stable_sort(devices.begin(), devices.end(), [](const PhysicalDeviceInfo& a, const PhysicalDeviceInfo& b) {
+		return a.score > b.score;
+	});
+	return devices;
+}
+
+void PrintPhysicalDevices(const std::vector<PhysicalDeviceInfo>& devices, std::ostream& stream) {
+	const std::ios::fmtflags flags = stream.flags();
+	const std::streamsize precision = stream.precision();
+
+	stream << std::fixed << std::setprecision(1);
+	for (size_t i = 0; i < devices.size(); ++i) {
+		const PhysicalDeviceInfo& device = devices[i];
+		stream << "  [" << i << "] " << device.properties.deviceName << " (" << TypeName(device.properties.deviceType) << ")"
+			<< ", " << static_cast<double>(device.deviceLocalMemory) / GiB << " GiB"
+			<< ", queues:" << (device.CanRender() ? " graphics" : "")
+			<< ((device.computeQueueFamilyIndex != UINT32_MAX) ? " compute" : "")
+			<< ((device.transferQueueFamilyIndex != UINT32_MAX) ? " transfer" : "")
+			<< ", score " << device.score << std::endl;
+	}
+	stream.flags(flags);
+	stream.precision(precision);
+}
@@ -0,0 +1,46 @@
+#pragma once
+#define VK_NO_PROTOTYPES
+
+#if defined _WIN32
+#define VK_USE_PLATFORM_WIN32_KHR
+#elif defined __linux__
+#define VK_USE_PLATFORM_XCB_KHR
+#endif
+
+#include "vulkan.h"
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+struct PhysicalDeviceInfo {
+	VkPhysicalDevice handle;
+	VkPhysicalDeviceProperties properties;
+	VkDeviceSize deviceLocalMemory;			// Sum of all device local heaps
+	uint32_t graphicsQueueFamilyIndex;		// UINT32_MAX when the device can't render
+	uint32_t computeQueueFamilyIndex;		// Compute without graphics (async compute), UINT32_MAX when there is none
+	uint32_t transferQueueFamilyIndex;		// Transfer only (copy engine), UINT32_MAX when there is none
+	double score;
+
+	PhysicalDeviceInfo() :
+		handle(VK_NULL_HANDLE),
+		properties(),
+		deviceLocalMemory(0),
+		graphicsQueueFamilyIndex(UINT32_MAX),
+		computeQueueFamilyIndex(UINT32_MAX),
+		transferQueueFamilyIndex(UINT32_MAX),
+		score(0.0) {
+	}
+
+	bool CanRender() const {
+		return graphicsQueueFamilyIndex != UINT32_MAX;
+	}
+};
+
+// Higher is better. Device type decides first (discrete, integrated, virtual, CPU); device local memory, limits and
+// queue layout only order devices of the same type. Devices without a graphics queue score below zero.
+double ScorePhysicalDevice(const PhysicalDeviceInfo& info);
+
+// Describes all physical devices of the instance, ordered from the highest score to the lowest
+std::vector<PhysicalDeviceInfo> EnumeratePhysicalDevices(VkInstance instance);
+
+void PrintPhysicalDevices(const std::vector<PhysicalDeviceInfo>& devices, std::ostream& stream);
@@ -0,0 +1,89 @@
+#include "DynamicResolution.h"
+#include <algorithm>
+#include <cmath>
+
+DynamicResolutionController::DynamicResolutionController() :
+	Parameters(),
+	Scale(1.0),
+	FramesOverBudget(0),
+	FramesUnderBudget(0) {
+}
+
+void DynamicResolutionController::SetParameters(const DynamicResolutionParameters& parameters) {
+	Parameters = parameters;
+	Scale = Quantize(Scale);
+}
+
+const DynamicResolutionParameters& DynamicResolutionController::GetParameters() const {
+	return Parameters;
+}
+
+bool DynamicResolutionController::Update(double gpuFrameTimeMs) {
+	if (gpuFrameTimeMs <= 0.0) {
+		return false;
+	}
+
+	if (gpuFrameTimeMs > Parameters.frameBudgetMs) {
+		FramesUnderBudget = 0;
+		if (++FramesOverBudget < Parameters.framesToDecrease) {
+			return false;
+		}
+		FramesOverBudget = 0;
+
+		// GPU time scales roughly with pixel count, i.e. with the square of the per axis scale
+		double target = Scale * std::sqrt(Parameters.frameBudgetMs / gpuFrameTimeMs);
+		double newScale = Quantize(std::min(target, Scale - Parameters.scaleStep));
+		if (newScale < Scale) {
+			Scale = newScale;
+			return true;
+		}
+		return false;
+	}
+
+	FramesOverBudget = 0;
+	if (gpuFrameTimeMs < Parameters.frameBudgetMs * Parameters.headroom) {
+		if (++FramesUnderBudget < Parameters.framesToIncrease) {
+			return false;
+		}
+		FramesUnderBudget = 0;
+
+		// Going up one step at a time avoids jumping straight back over the budget
+		double newScale = Quantize(Scale + Parameters.scaleStep);
+		if (newScale > Scale) {
+			Scale = newScale;
+			return true;
+		}
+		return false;
+	}
+
+	// Within budget but without headroom - the current scale is right
+	FramesUnderBudget = 0;
+	return false;
+}
+
+void DynamicResolutionController::Reset() {
+	Scale = Quantize(Parameters.maxScale);
+	FramesOverBudget = 0;
+	FramesUnderBudget = 0;
+}
+
+double DynamicResolutionController::GetScale() const {
+	return Scale;
+}
+
+VkExtent2D DynamicResolutionController::GetRenderExtent(VkExtent2D fullExtent) const {
+	VkExtent2D extent = {
+		static_cast<uint32_t>(std::lround(fullExtent.width * Scale)),
+		static_cast<uint32_t>(std::lround(fullExtent.height * Scale))
+	};
+	extent.width = std::max(1u, std::min(extent.width, fullExtent.width));
+	extent.height = std::max(1u, std::min(extent.height, fullExtent.height));
+	return extent;
+}
+
+double DynamicResolutionController::Quantize(double scale) const {
+	if (Parameters.scaleStep > 0.0) {
+		scale = std::round(scale / Parameters.scaleStep) * Parameters.scaleStep;
+	}
+	return std::max(Parameters.minScale, std::min(Parameters.maxScale, scale));
+}
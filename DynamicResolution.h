@@ -0,0 +1,59 @@
+#pragma once
+#define VK_NO_PROTOTYPES
+
+#if defined _WIN32
+#define VK_USE_PLATFORM_WIN32_KHR
+#elif defined __linux__
+#define VK_USE_PLATFORM_XCB_KHR
+#endif
+
+#include "vulkan.h"
+#include <cstdint>
+
+// Tuning of the dynamic resolution controller
+struct DynamicResolutionParameters {
+	double frameBudgetMs;		// GPU time a frame should fit in
+	double minScale;			// Smallest allowed fraction of the full resolution (per axis)
+	double maxScale;			// Largest allowed fraction of the full resolution (per axis)
+	double scaleStep;			// Scale is always a multiple of this, so small jitter doesn't change it
+	double headroom;			// Scale goes up only when GPU time is below frameBudgetMs * headroom
+	uint32_t framesToDecrease;	// Consecutive over-budget frames before the scale goes down
+	uint32_t framesToIncrease;	// Consecutive frames with headroom before the scale goes up
+
+	DynamicResolutionParameters() :
+		frameBudgetMs(16.0),
+		minScale(0.5),
+		maxScale(1.0),
+		scaleStep(0.05),
+		headroom(0.8),
+		framesToDecrease(3),
+		framesToIncrease(30) {
+	}
+};
+
+// Chooses the resolution scale of the offscreen scene target from measured GPU frame times.
+// Scale goes down quickly when the budget is exceeded and comes back slowly once there is headroom,
+// so a single spike or a single fast frame doesn't make it oscillate.
+// Doesn't touch Vulkan objects - it only decides, so it can be driven by any timing source.
+class DynamicResolutionController {
+public:
+	DynamicResolutionController();
+
+	void SetParameters(const DynamicResolutionParameters& parameters);
+	const DynamicResolutionParameters& GetParameters() const;
+
+	// Feeds GPU time of one frame, returns true when the scale changed
+	bool Update(double gpuFrameTimeMs);
+	void Reset();
+
+	double GetScale() const;
+	VkExtent2D GetRenderExtent(VkExtent2D fullExtent) const;
+
+private:
+	double Quantize(double scale) const;
+
+	DynamicResolutionParameters Parameters;
+	double Scale;
+	uint32_t FramesOverBudget;
+	uint32_t FramesUnderBudget;
+};
@@ -0,0 +1,315 @@
+#include "FrameCapture.h"
+#include "Benchmark.h"
+#include "YuvConverter.h"
+#include <algorithm>
+#include <iostream>
+
+#if defined _WIN32
+#define CAPTURE_POPEN _popen
+#define CAPTURE_PCLOSE _pclose
+#define CAPTURE_PIPE_MODE "wb"
+#else
+#include <csignal>
+#define CAPTURE_POPEN popen
+#define CAPTURE_PCLOSE pclose
+#define CAPTURE_PIPE_MODE "w"
+#endif
+
+namespace {
+	bool IsCaptureFormat(VkFormat format) {
+		switch (format) {
+		case VK_FORMAT_R8G8B8A8_UNORM:
+		case VK_FORMAT_R8G8B8A8_SRGB:
+		case VK_FORMAT_B8G8R8A8_UNORM:
+		case VK_FORMAT_B8G8R8A8_SRGB:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	bool IsBgra(VkFormat format) {
+		return (format == VK_FORMAT_B8G8R8A8_UNORM) || (format == VK_FORMAT_B8G8R8A8_SRGB);
+	}
+}
+
+FrameCapture::FrameCapture(const DeviceContext& device) :
+	Dispatch(*device.dispatch),
+	Ring(device),
+	Options(),
+	Extent(),
+	Output(nullptr),
+	Pipe(false),
+	Opened(false),
+	NextSequence(0),
+	Mutex(),
+	FrameConverted(),
+	Converted(),
+	FreeFrames(),
+	Queued(0),
+	NextWrite(0),
+	Closing(false),
+	WriteFailed(false),
+	Stats(),
+	Writer() {
+}
+
+FrameCapture::~FrameCapture() {
+	Close();
+}
+
+bool FrameCapture::Open(const CaptureOptions& options, VkExtent2D extent) {
+	Close();
+	if ((extent.width == 0) || (extent.height == 0)) {
+		return false;
+	}
+
+	Options = options;
+	Options.readbackSlots = std::max<uint32_t>(Options.readbackSlots, 1);
+	Options.converterThreads = std::max<uint32_t>(Options.converterThreads, 1);
+	Options.queuedFrames = std::max<uint32_t>(Options.queuedFrames, 1);
+	Extent = extent;
+
+	if (!Ring.Create(Options.readbackSlots, static_cast<VkDeviceSize>(extent.width) * extent.height * 4, Options.converterThreads)) {
+		return false;
+	}
+
+	if (!Options.pipeCommand.empty()) {
+#if !defined _WIN32
+		// An encoder that exits early must show up as a failed write and not kill the renderer
+		signal(SIGPIPE, SIG_IGN);
+#endif
+		Output = CAPTURE_POPEN(Options.pipeCommand.c_str(), CAPTURE_PIPE_MODE);
+		Pipe = true;
+	}
+	else if (!Options.path.empty()) {
+		Output = fopen(Options.path.c_str(), "wb");
+	}
+	if ((Output == nullptr) && (!Options.pipeCommand.empty() || !Options.path.empty())) {
+		std::cout << "COULD NOT OPEN CAPTURE OUTPUT " << (Pipe ? Options.pipeCommand : Options.path) << std::endl;
+		Ring.Destroy();
+		Pipe = false;
+		return false;
+	}
+
+	// 2x2 averaged chroma is sited like JPEG's, the conversion produces limited range values
+	if ((Output != nullptr) && (fprintf(Output, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n",
+		extent.width, extent.height, Options.framesPerSecond) < 0)) {
+		std::cout << "COULD NOT WRITE CAPTURE HEADER " << std::endl;
+		WriteFailed = true;
+	}
+
+	NextSequence = 0;
+	NextWrite = 0;
+	Queued = 0;
+	Closing = false;
+	Stats = CaptureStats();
+	Opened = true;
+	Writer = std::thread(&FrameCapture::WriteFrames, this);
+	return true;
+}
+
+bool FrameCapture::Close() {
+	if (!Opened) {
+		return true;
+	}
+
+	// Converters finish first, so the writer sees every frame before it's told to stop
+	Ring.Drain();
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Closing = true;
+	}
+	FrameConverted.notify_all();
+	Writer.join();
+
+	const bool result = !WriteFailed && !Ring.HasFailed();
+	Ring.Destroy();
+	if (Output != nullptr) {
+		if (Pipe) {
+			CAPTURE_PCLOSE(Output);
+		}
+		else {
+			fclose(Output);
+		}
+		Output = nullptr;
+	}
+
+	Converted.clear();
+	FreeFrames.clear();
+	Pipe = false;
+	Opened = false;
+	Closing = false;
+	WriteFailed = false;
+	return result;
+}
+
+bool FrameCapture::IsOpen() const {
+	return Opened;
+}
+
+bool FrameCapture::BeginFrame(VkExtent2D extent, VkFormat format, ReadbackTicket& ticket, bool wait) {
+	if (!Opened) {
+		return false;
+	}
+	if ((extent.width != Extent.width) || (extent.height != Extent.height) || !IsCaptureFormat(format)) {
+		std::lock_guard<std::mutex> lock(Mutex);
+		++Stats.droppedUnsupported;
+		return false;
+	}
+
+	const VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+	if (wait ? Ring.Acquire(size, ticket) : Ring.TryAcquire(size, ticket)) {
+		return true;
+	}
+	std::lock_guard<std::mutex> lock(Mutex);
+	++Stats.droppedReadback;
+	return false;
+}
+
+void FrameCapture::CmdCopyImage(VkCommandBuffer commandBuffer, const ReadbackTicket& ticket, VkImage image, VkImageLayout layout) const {
+	// The image may have been written by anything earlier in the submission
+	VkImageMemoryBarrier imageBarriers[2] = {};
+	imageBarriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageBarriers[0].pNext = nullptr;
+	imageBarriers[0].srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+	imageBarriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	imageBarriers[0].oldLayout = layout;
+	imageBarriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	imageBarriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageBarriers[0].image = image;
+	imageBarriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	imageBarriers[1] = imageBarriers[0];
+	imageBarriers[1].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	imageBarriers[1].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+	imageBarriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	imageBarriers[1].newLayout = layout;
+
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarriers[0]);
+
+	VkBufferImageCopy region = {};
+	region.bufferOffset = ticket.offset;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { Extent.width, Extent.height, 1 };
+	Dispatch.vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, ticket.buffer, 1, &region);
+
+	VkBufferMemoryBarrier bufferBarrier = {};
+	bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferBarrier.pNext = nullptr;
+	bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.buffer = ticket.buffer;
+	bufferBarrier.offset = ticket.offset;
+	bufferBarrier.size = ticket.size;
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarriers[1]);
+}
+
+bool FrameCapture::CommitFrame(const ReadbackTicket& ticket, VkFormat format) {
+	const uint64_t sequence = NextSequence;
+	if (!Ring.Commit(ticket, Extent, format, [this, sequence](const ReadbackData& data) { ConvertFrame(sequence, data); })) {
+		return false;
+	}
+	++NextSequence;
+
+	std::lock_guard<std::mutex> lock(Mutex);
+	++Stats.captured;
+	return true;
+}
+
+void FrameCapture::CancelFrame(const ReadbackTicket& ticket) {
+	Ring.Cancel(ticket);
+}
+
+CaptureStats FrameCapture::GetStats() const {
+	std::lock_guard<std::mutex> lock(Mutex);
+	return Stats;
+}
+
+void FrameCapture::ConvertFrame(uint64_t sequence, const ReadbackData& data) {
+	std::vector<uint8_t> frame;
+	{
+		// The writer keeps frames in order, so a dropped one still leaves an (empty) entry behind
+		std::lock_guard<std::mutex> lock(Mutex);
+		if (data.data == nullptr) {
+			Converted[sequence] = std::vector<uint8_t>();
+			++Stats.droppedFailed;
+			FrameConverted.notify_one();
+			return;
+		}
+		if (Queued >= Options.queuedFrames) {
+			Converted[sequence] = std::vector<uint8_t>();
+			++Stats.droppedQueue;
+			FrameConverted.notify_one();
+			return;
+		}
+		++Queued;
+		if (!FreeFrames.empty()) {
+			frame = std::move(FreeFrames.back());
+			FreeFrames.pop_back();
+		}
+	}
+
+	BenchmarkTimer timer;
+	frame.resize(GetI420Size(data.extent.width, data.extent.height));
+	ConvertToI420(data.data, data.extent.width, data.extent.height, IsBgra(data.format), frame.data());
+	const double convertMs = timer.ElapsedMs();
+
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Stats.convertMs += convertMs;
+		Converted[sequence] = std::move(frame);
+	}
+	FrameConverted.notify_one();
+}
+
+void FrameCapture::WriteFrames() {
+	static const char frameHeader[] = "FRAME\n";
+
+	for (;;) {
+		std::vector<uint8_t> frame;
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			FrameConverted.wait(lock, [this]() { return Closing || (Converted.find(NextWrite) != Converted.end()); });
+
+			std::map<uint64_t, std::vector<uint8_t>>::iterator next = Converted.find(NextWrite);
+			if (next == Converted.end()) {
+				// Closing - skip over any frame that is still missing
+				if (Converted.empty()) {
+					return;
+				}
+				next = Converted.begin();
+			}
+			NextWrite = next->first + 1;
+			frame = std::move(next->second);
+			Converted.erase(next);
+		}
+		if (frame.empty()) {
+			continue;
+		}
+
+		// After a failed write the stream is broken, frames are still released so the capture keeps running
+		bool written = !WriteFailed;
+		if ((Output != nullptr) && written) {
+			written = (fwrite(frameHeader, 1, sizeof(frameHeader) - 1, Output) == sizeof(frameHeader) - 1)
+				&& (fwrite(frame.data(), 1, frame.size(), Output) == frame.size());
+			if (!written) {
+				std::cout << "COULD NOT WRITE CAPTURED FRAME " << std::endl;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(Mutex);
+		WriteFailed = WriteFailed || !written;
+		Stats.written += written ? 1 : 0;
+		--Queued;
+		FreeFrames.push_back(std::move(frame));
+	}
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "ReadbackRing.h"
+#include <condition_variable>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct CaptureOptions {
+	std::string path;				// Y4M file
+	std::string pipeCommand;		// Or a process reading the Y4M stream on its stdin, e.g. "ffmpeg -i - out.mp4"
+	uint32_t framesPerSecond;		// Only written into the stream header
+	uint32_t readbackSlots;
+	uint32_t converterThreads;
+	uint32_t queuedFrames;			// Frames converting or waiting for the writer before new ones are dropped
+
+	CaptureOptions() :
+		path(),
+		pipeCommand(),
+		framesPerSecond(60),
+		readbackSlots(3),
+		converterThreads(2),
+		queuedFrames(4) {
+	}
+};
+
+struct CaptureStats {
+	uint64_t captured;				// Read back and handed to the converters
+	uint64_t written;
+	uint64_t droppedReadback;		// Every readback slot was busy
+	uint64_t droppedQueue;			// Writer (or the encoder behind the pipe) was too slow
+	uint64_t droppedUnsupported;	// Extent or format didn't match the stream
+	uint64_t droppedFailed;			// Readback failed on the GPU
+	double convertMs;				// Total RGBA to I420 conversion time
+
+	CaptureStats() :
+		captured(0),
+		written(0),
+		droppedReadback(0),
+		droppedQueue(0),
+		droppedUnsupported(0),
+		droppedFailed(0),
+		convertMs(0.0) {
+	}
+};
+
+// Records rendered frames into an uncompressed Y4M (I420) stream, written to a file or piped into an encoder.
+// Frames are copied into a ReadbackRing in the frame's own submission, converted on the ring's workers and
+// written in order by one writer thread. Nothing on the render thread ever blocks on the capture: when the
+// readback slots or the queue of converted frames are full, frames are dropped and counted instead.
+// Without a path and a pipe command frames are converted but not written, which measures the capture alone.
+class FrameCapture {
+public:
+	explicit FrameCapture(const DeviceContext& device);
+	~FrameCapture();
+
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+	// Every frame of the stream has this extent
+	bool Open(const CaptureOptions& options, VkExtent2D extent);
+	// Waits for committed frames and writes them, false when any write or readback failed
+	bool Close();
+	bool IsOpen() const;
+
+	// False when the frame is dropped. With wait the call blocks for a free slot instead of dropping the frame,
+	// for offline rendering where every frame must be kept.
+	bool BeginFrame(VkExtent2D extent, VkFormat format, ReadbackTicket& ticket, bool wait = false);
+	// Copies the image (in layout, left in it afterwards) into the ticket's slot
+	void CmdCopyImage(VkCommandBuffer commandBuffer, const ReadbackTicket& ticket, VkImage image, VkImageLayout layout) const;
+	// Call right after the submission containing the copy
+	bool CommitFrame(const ReadbackTicket& ticket, VkFormat format);
+	void CancelFrame(const ReadbackTicket& ticket);
+
+	CaptureStats GetStats() const;
+
+private:
+	void ConvertFrame(uint64_t sequence, const ReadbackData& data);
+	void WriteFrames();
+
+	const DeviceDispatchTable& Dispatch;
+	ReadbackRing Ring;
+	CaptureOptions Options;
+	VkExtent2D Extent;
+	FILE* Output;
+	bool Pipe;
+	bool Opened;
+	uint64_t NextSequence;
+
+	mutable std::mutex Mutex;
+	std::condition_variable FrameConverted;
+	std::map<uint64_t, std::vector<uint8_t>> Converted;		// By sequence, empty for frames dropped by the converters
+	std::vector<std::vector<uint8_t>> FreeFrames;
+	size_t Queued;
+	uint64_t NextWrite;
+	bool Closing;
+	bool WriteFailed;
+	CaptureStats Stats;
+	std::thread Writer;
+};
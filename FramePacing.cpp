@@ -0,0 +1,239 @@
+#include "FramePacing.h"
+#include <algorithm>
+#include <thread>
+
+namespace {
+	const size_t PresentIntervalHistory = 120;
+	const size_t GpuFrameTimeHistory = 64;
+	// GPU frames are planned for this percentile of recent durations, not for the average
+	const double GpuFrameTimePercentile = 0.95;
+
+	// Frames counted together when looking for missed refreshes
+	const uint32_t MissWindow = 60;
+	// Misses within one window after which one more swapchain image is requested
+	const uint32_t MissesForExtraImage = 3;
+	// Consecutive frames without misses after which one image is given back
+	const uint32_t StableFramesForFewerImages = 600;
+	const uint32_t MaxExtraImages = 2;
+
+	// Default refresh until it's known or measured (60 Hz)
+	const uint64_t DefaultRefreshDuration = 16666667;
+}
+
+FramePacingController::FramePacingController() :
+	Policy(PresentPolicy::Balanced),
+	PresentMode(VK_PRESENT_MODE_FIFO_KHR),
+	RefreshDuration(DefaultRefreshDuration),
+	RefreshDurationKnown(false),
+	FrameTimeEstimate(0.0),
+	GpuFrameTimes(GpuFrameTimeHistory, 0.0),
+	GpuFrameTimesNext(0),
+	GpuFrameTimesCount(0),
+	FrameStart(Clock::now()),
+	LastPresent(),
+	LastActualPresentTime(0),
+	HasDisplayTiming(false),
+	PresentId(0),
+	PresentIntervals(PresentIntervalHistory, 0),
+	PresentIntervalsNext(0),
+	PresentIntervalsCount(0),
+	ExtraImages(0),
+	RecentMisses(0),
+	StableFrames(0),
+	FramesInWindow(0),
+	RecreateRequested(false) {
+}
+
+void FramePacingController::SetPolicy(PresentPolicy policy) {
+	Policy = policy;
+}
+
+PresentPolicy FramePacingController::GetPolicy() const {
+	return Policy;
+}
+
+VkPresentModeKHR FramePacingController::SelectPresentMode(const std::vector<VkPresentModeKHR>& presentModes) {
+	std::vector<VkPresentModeKHR> preferred;
+	switch (Policy) {
+	case PresentPolicy::LowLatency:
+		// Newest frame goes to the screen immediately, MAILBOX at least doesn't tear
+		preferred = { VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR };
+		break;
+	case PresentPolicy::Balanced:
+		preferred = { VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR };
+		break;
+	case PresentPolicy::PowerSaving:
+		// FIFO blocks the application at refresh rate, so no frame is rendered just to be discarded
+		preferred = { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR };
+		break;
+	}
+
+	for (VkPresentModeKHR mode : preferred) {
+		if (std::find(presentModes.begin(), presentModes.end(), mode) != presentModes.end()) {
+			PresentMode = mode;
+			return mode;
+		}
+	}
+	return static_cast<VkPresentModeKHR>(-1);
+}
+
+uint32_t FramePacingController::SelectImageCount(const VkSurfaceCapabilitiesKHR& surfaceCapabilities) const {
+	uint32_t imageCount = surfaceCapabilities.minImageCount + 1;
+
+	// With vsync every queued image adds one refresh of latency, so keep the queue as short as possible
+	if ((Policy == PresentPolicy::LowLatency) && IsVsyncMode()) {
+		imageCount = surfaceCapabilities.minImageCount;
+	}
+	// MAILBOX needs a spare image to replace while another one is being displayed
+	if ((PresentMode == VK_PRESENT_MODE_MAILBOX_KHR) && (imageCount < 3)) {
+		imageCount = 3;
+	}
+
+	imageCount += ExtraImages;
+	if ((surfaceCapabilities.maxImageCount > 0) && (imageCount > surfaceCapabilities.maxImageCount)) {
+		imageCount = surfaceCapabilities.maxImageCount;
+	}
+	return imageCount;
+}
+
+void FramePacingController::SetRefreshDuration(uint64_t refreshDuration) {
+	if (refreshDuration > 0) {
+		RefreshDuration = refreshDuration;
+		RefreshDurationKnown = true;
+	}
+}
+
+void FramePacingController::WaitForFrameStart() {
+	// Without vsync there is no refresh to aim for, and power saving FIFO already blocks in acquire
+	if (!IsVsyncMode() || (Policy == PresentPolicy::PowerSaving) || (LastPresent == Clock::time_point())) {
+		FrameStart = Clock::now();
+		return;
+	}
+
+	// Pessimistic GPU duration, a frame finishing late costs a whole refresh
+	double gpuFrameTime = 0.0;
+	if (GpuFrameTimesCount > 0) {
+		std::vector<double> gpuFrameTimes(GpuFrameTimes.begin(), GpuFrameTimes.begin() + GpuFrameTimesCount);
+		size_t index = static_cast<size_t>(GpuFrameTimePercentile * static_cast<double>(gpuFrameTimes.size() - 1));
+		std::nth_element(gpuFrameTimes.begin(), gpuFrameTimes.begin() + index, gpuFrameTimes.end());
+		gpuFrameTime = gpuFrameTimes[index];
+	}
+
+	// Start the CPU frame so CPU and GPU work end a safety margin before the next refresh after the previous present
+	const Clock::duration refresh = std::chrono::nanoseconds(RefreshDuration);
+	const Clock::duration frameTime = std::chrono::nanoseconds(static_cast<int64_t>(FrameTimeEstimate + gpuFrameTime));
+	const Clock::duration margin = std::chrono::milliseconds(1) + refresh / 10;
+	const Clock::time_point now = Clock::now();
+
+	Clock::time_point deadline = LastPresent + refresh;
+	while (deadline - frameTime - margin < now) {
+		deadline += refresh;
+		if (deadline - LastPresent > 4 * refresh) {
+			// Frame takes longer than a few refreshes, waiting would only make it worse
+			FrameStart = now;
+			return;
+		}
+	}
+
+	Clock::time_point wakeUp = deadline - frameTime - margin;
+	if (wakeUp - now < refresh) {
+		std::this_thread::sleep_until(wakeUp);
+	}
+	FrameStart = Clock::now();
+}
+
+void FramePacingController::OnFramePresented() {
+	const Clock::time_point now = Clock::now();
+
+	const double frameTime = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - FrameStart).count());
+	FrameTimeEstimate = (FrameTimeEstimate == 0.0) ? frameTime : (0.9 * FrameTimeEstimate + 0.1 * frameTime);
+
+	// When display timing is available intervals come from the presentation engine instead
+	if (!HasDisplayTiming && (LastPresent != Clock::time_point())) {
+		RecordPresentInterval(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now - LastPresent).count()));
+	}
+	LastPresent = now;
+}
+
+void FramePacingController::OnGpuFrameTime(double milliseconds) {
+	GpuFrameTimes[GpuFrameTimesNext] = milliseconds * 1000000.0;
+	GpuFrameTimesNext = (GpuFrameTimesNext + 1) % GpuFrameTimes.size();
+	GpuFrameTimesCount = std::min(GpuFrameTimesCount + 1, GpuFrameTimes.size());
+}
+
+void FramePacingController::OnPresentationTiming(const VkPastPresentationTimingGOOGLE& timing) {
+	HasDisplayTiming = true;
+	if ((LastActualPresentTime != 0) && (timing.actualPresentTime > LastActualPresentTime)) {
+		RecordPresentInterval(timing.actualPresentTime - LastActualPresentTime);
+	}
+	LastActualPresentTime = timing.actualPresentTime;
+}
+
+uint32_t FramePacingController::NextPresentId() {
+	return ++PresentId;
+}
+
+bool FramePacingController::ConsumeSwapchainRecreateRequest() {
+	bool requested = RecreateRequested;
+	RecreateRequested = false;
+	return requested;
+}
+
+double FramePacingController::GetAveragePresentIntervalMs() const {
+	if (PresentIntervalsCount == 0) {
+		return 0.0;
+	}
+	uint64_t sum = 0;
+	for (size_t i = 0; i < PresentIntervalsCount; ++i) {
+		sum += PresentIntervals[i];
+	}
+	return static_cast<double>(sum) / static_cast<double>(PresentIntervalsCount) / 1000000.0;
+}
+
+double FramePacingController::GetRefreshDurationMs() const {
+	return static_cast<double>(RefreshDuration) / 1000000.0;
+}
+
+void FramePacingController::RecordPresentInterval(uint64_t interval) {
+	PresentIntervals[PresentIntervalsNext] = interval;
+	PresentIntervalsNext = (PresentIntervalsNext + 1) % PresentIntervals.size();
+	PresentIntervalsCount = std::min(PresentIntervalsCount + 1, PresentIntervals.size());
+
+	if (!IsVsyncMode()) {
+		return;
+	}
+
+	// Without VK_GOOGLE_display_timing the shortest stable interval under vsync is the refresh period
+	if (!RefreshDurationKnown && (PresentIntervalsCount == PresentIntervals.size())) {
+		RefreshDuration = *std::min_element(PresentIntervals.begin(), PresentIntervals.end());
+		RefreshDurationKnown = true;
+	}
+
+	// Interval noticeably longer than one refresh means the frame missed its vblank
+	if (interval > RefreshDuration + RefreshDuration / 2) {
+		++RecentMisses;
+		StableFrames = 0;
+	} else {
+		++StableFrames;
+	}
+
+	if (++FramesInWindow >= MissWindow) {
+		if ((RecentMisses >= MissesForExtraImage) && (ExtraImages < MaxExtraImages)) {
+			++ExtraImages;
+			RecreateRequested = true;
+		}
+		FramesInWindow = 0;
+		RecentMisses = 0;
+	}
+
+	// Device keeps up again, so drop the extra image and its frame of latency
+	if ((StableFrames >= StableFramesForFewerImages) && (ExtraImages > 0)) {
+		--ExtraImages;
+		StableFrames = 0;
+		RecreateRequested = true;
+	}
+}
+
+bool FramePacingController::IsVsyncMode() const {
+	return (PresentMode == VK_PRESENT_MODE_FIFO_KHR) || (PresentMode == VK_PRESENT_MODE_FIFO_RELAXED_KHR);
+}
@@ -0,0 +1,81 @@
+#pragma once
+#define VK_NO_PROTOTYPES
+
+#if defined _WIN32
+#define VK_USE_PLATFORM_WIN32_KHR
+#elif defined __linux__
+#define VK_USE_PLATFORM_XCB_KHR
+#endif
+
+#include "vulkan.h"
+#include <chrono>
+#include <vector>
+
+// What the swapchain setup should optimize for
+enum class PresentPolicy {
+	LowLatency,		// Shortest input-to-photon time, tearing is acceptable
+	Balanced,		// No tearing, low latency when the device can keep up
+	PowerSaving		// Never render frames that won't be displayed
+};
+
+// Chooses present mode and number of swapchain images for a given policy,
+// measures how often frames are really presented and delays the start of
+// the next CPU frame so it (together with its GPU work) finishes just in
+// time for the next refresh.
+class FramePacingController {
+public:
+	FramePacingController();
+
+	void SetPolicy(PresentPolicy policy);
+	PresentPolicy GetPolicy() const;
+
+	// Swapchain creation
+	VkPresentModeKHR SelectPresentMode(const std::vector<VkPresentModeKHR>& presentModes);
+	uint32_t SelectImageCount(const VkSurfaceCapabilitiesKHR& surfaceCapabilities) const;
+	void SetRefreshDuration(uint64_t refreshDuration);
+
+	// Per frame
+	void WaitForFrameStart();
+	void OnFramePresented();
+	void OnGpuFrameTime(double milliseconds);
+	void OnPresentationTiming(const VkPastPresentationTimingGOOGLE& timing);
+	uint32_t NextPresentId();
+
+	// Set when measured misses ask for a different number of swapchain images
+	bool ConsumeSwapchainRecreateRequest();
+
+	double GetAveragePresentIntervalMs() const;
+	double GetRefreshDurationMs() const;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	void RecordPresentInterval(uint64_t interval);
+	bool IsVsyncMode() const;
+
+	PresentPolicy Policy;
+	VkPresentModeKHR PresentMode;
+
+	uint64_t RefreshDuration;				// Nanoseconds, from VK_GOOGLE_display_timing or estimated
+	bool RefreshDurationKnown;
+	double FrameTimeEstimate;				// Nanoseconds of CPU work between WaitForFrameStart() and present
+	std::vector<double> GpuFrameTimes;		// Nanoseconds, ring of the most recent GPU durations
+	size_t GpuFrameTimesNext;
+	size_t GpuFrameTimesCount;
+
+	Clock::time_point FrameStart;
+	Clock::time_point LastPresent;
+	uint64_t LastActualPresentTime;
+	bool HasDisplayTiming;
+	uint32_t PresentId;
+
+	std::vector<uint64_t> PresentIntervals;	// Ring of the most recent intervals
+	size_t PresentIntervalsNext;
+	size_t PresentIntervalsCount;
+
+	uint32_t ExtraImages;
+	uint32_t RecentMisses;
+	uint32_t StableFrames;
+	uint32_t FramesInWindow;
+	bool RecreateRequested;
+};
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// Frame packet built by the window (simulation) thread and handed over to the render thread.
+// Once pushed into the queue a packet is never modified - the render thread only reads its copy.
+struct FramePacket {
+	uint64_t index;
+	bool resize;
+	bool draw;
+	bool quit;
+	bool input;											// Packet was produced by window events (not only by a frame timer)
+	std::chrono::steady_clock::time_point inputTime;	// When the window thread received those events
+
+	FramePacket() :
+		index(0),
+		resize(false),
+		draw(false),
+		quit(false),
+		input(false),
+		inputTime(std::chrono::steady_clock::now()) {
+	}
+};
+
+// Lock-free single-producer single-consumer ring buffer.
+// Push() may only be called from one thread and Pop() only from one (other) thread.
+// Capacity must be a power of two; one slot is never used to distinguish full from empty.
+template<class T, size_t Capacity>
+class SpscRing {
+	static_assert((Capacity >= 2) && ((Capacity & (Capacity - 1)) == 0), "SpscRing capacity must be a power of two");
+
+public:
+	SpscRing() :
+		Head(0),
+		Tail(0) {
+	}
+
+	SpscRing(const SpscRing&) = delete;
+	SpscRing& operator=(const SpscRing&) = delete;
+
+	// Producer side, returns false when the ring is full
+	bool Push(const T& item) {
+		const size_t tail = Tail.load(std::memory_order_relaxed);
+		const size_t next = (tail + 1) & (Capacity - 1);
+		if (next == Head.load(std::memory_order_acquire)) {
+			return false;
+		}
+		Items[tail] = item;
+		Tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side, returns false when the ring is empty
+	bool Pop(T& item) {
+		const size_t head = Head.load(std::memory_order_relaxed);
+		if (head == Tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		item = Items[head];
+		Head.store((head + 1) & (Capacity - 1), std::memory_order_release);
+		return true;
+	}
+
+	bool Empty() const {
+		return Head.load(std::memory_order_acquire) == Tail.load(std::memory_order_acquire);
+	}
+
+private:
+	// Indices live on separate cache lines so producer and consumer don't false-share
+	alignas(64) std::atomic<size_t> Head;
+	alignas(64) std::atomic<size_t> Tail;
+	alignas(64) T Items[Capacity];
+};
+
+typedef SpscRing<FramePacket, 64> FramePacketQueue;
+
+// Lets the consumer of a ring sleep while there is nothing to process.
+// Only used for waking up - the data itself still goes through the lock-free ring.
+class FrameSignal {
+public:
+	FrameSignal() :
+		Pending(false) {
+	}
+
+	void Notify() {
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			Pending = true;
+		}
+		Condition.notify_one();
+	}
+
+	void Wait() {
+		std::unique_lock<std::mutex> lock(Mutex);
+		Condition.wait(lock, [this]() { return Pending; });
+		Pending = false;
+	}
+
+private:
+	std::mutex Mutex;
+	std::condition_variable Condition;
+	bool Pending;
+};
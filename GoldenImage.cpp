@@ -0,0 +1,556 @@
+#include "GoldenImage.h"
+#include "ClusteredLighting.h"
+#include "LevelOfDetail.h"
+#include "Meshlets.h"
+#include "OcclusionCulling.h"
+#include "ParticleSystem.h"
+#include "ShadowCascades.h"
+#include "SkeletalAnimation.h"
+#include "TemporalUpscaling.h"
+#include "Png.h"
+#include "SceneAssets.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+namespace {
+	// Renders frameCount frames of the draw list and reads the last one back
+	bool RenderFrames(OffscreenRenderer& renderer, const OffscreenDrawList& drawList, uint32_t frameCount, std::vector<uint8_t>& rgba) {
+		for (uint32_t frame = 0; frame < frameCount; ++frame) {
+			if (!renderer.Record(drawList) || !renderer.Submit() || !renderer.Wait()) {
+				return false;
+			}
+		}
+		return renderer.ReadPixels(rgba);
+	}
+}
+
+GoldenImageTester::GoldenImageTester(const GoldenOptions& options) :
+	Options(options),
+	Scenes(),
+	Errors(false) {
+}
+
+void GoldenImageTester::Register(const GoldenScene& scene) {
+	Scenes.push_back(scene);
+}
+
+void GoldenImageTester::RegisterDefaultScenes() {
+	GoldenScene clear;
+	clear.name = "clear";
+	clear.triangleCount = 0;
+	Register(clear);
+
+	GoldenScene triangles;
+	triangles.name = "triangles";
+	triangles.triangleCount = 64;
+	triangles.drawList.drawCount = 1;
+	triangles.drawList.trianglesPerDraw = 64;
+	Register(triangles);
+
+	// Edges are resolved from 4 samples at the end of the subpass; the sample positions are the standard ones
+	GoldenScene multisampled = triangles;
+	multisampled.name = "triangles_msaa4";
+	multisampled.samples = VK_SAMPLE_COUNT_4_BIT;
+	Register(multisampled);
+
+	// Tonemap, color grade and vignette, fused into one subpass and as a subpass each; both must give the same image
+	GoldenScene postFused = triangles;
+	postFused.name = "post_fused";
+	postFused.post.effects.push_back(PostEffect(PostEffectType::Tonemap, 1.5f));
+	postFused.post.effects.push_back(PostEffect(PostEffectType::ColorGrade, 1.2f, 1.1f, 0.3f));
+	postFused.post.effects.push_back(PostEffect(PostEffectType::Vignette, 0.6f, 0.4f, 0.6f));
+	Register(postFused);
+
+	GoldenScene postSeparate = postFused;
+	postSeparate.name = "post_separate";
+	postSeparate.post.fuse = false;
+	Register(postSeparate);
+
+	// Fountain over the triangle grid after a second at the fixed default time step; emission only depends on the frame
+	GoldenScene particles = triangles;
+	particles.name = "particles";
+	particles.render = [](const DeviceContext& device, OffscreenRenderer& renderer, OffscreenDrawList drawList, std::vector<uint8_t>& rgba) {
+		ParticleSystem system(device);
+		if (!system.Create(4096, renderer.GetRenderPass())) {
+			return false;
+		}
+		ParticleEmitter emitter;
+		emitter.rate = 1000.0f;
+		emitter.size = 0.02f;
+		system.SetEmitter(emitter);
+		drawList.drawables.push_back(&system);
+		return RenderFrames(renderer, drawList, 60, rgba);
+	};
+	Register(particles);
+
+	// Floor and back wall lit by 32 lights placed like the first frame of the clustered lighting benchmark, every fourth
+	// one a spot pointing down
+	GoldenScene lighting;
+	lighting.name = "clustered_lighting";
+	lighting.render = [](const DeviceContext& device, OffscreenRenderer& renderer, OffscreenDrawList drawList, std::vector<uint8_t>& rgba) {
+		const uint32_t lightCount = 32;
+		ClusteredLighting clustered(device);
+		if (!clustered.Create(lightCount, renderer.GetRenderPass())) {
+			return false;
+		}
+		std::vector<ClusteredLight> lights(lightCount);
+		for (uint32_t i = 0; i < lightCount; ++i) {
+			const uint32_t hash = i * 2654435761u;
+			const float radius = 2.0f + static_cast<float>(hash & 0xFF) / 255.0f * 30.0f;
+			const float phase = static_cast<float>((hash >> 8) & 0xFF) / 255.0f * 6.2831853f;
+			ClusteredLight& light = lights[i];
+			light.position[0] = radius * std::cos(phase);
+			light.position[1] = -1.0f + static_cast<float>((hash >> 16) & 0xF) * 0.5f;
+			light.position[2] = -30.0f + radius * std::sin(phase) * 0.9f;
+			light.range = 3.0f + static_cast<float>((hash >> 20) & 0xF) * 0.5f;
+			light.color[0] = 0.2f + static_cast<float>((hash >> 24) & 0x3) * 0.25f;
+			light.color[1] = 0.2f + static_cast<float>((hash >> 26) & 0x3) * 0.25f;
+			light.color[2] = 0.2f + static_cast<float>((hash >> 28) & 0x3) * 0.25f;
+			if ((i & 3) == 3) {
+				light.range *= 2.0f;
+				light.spotCosine = 0.8f;
+				light.direction[1] = -1.0f;
+			}
+		}
+		if (!clustered.SetLights(lights)) {
+			return false;
+		}
+		drawList.drawables.push_back(&clustered);
+		return RenderFrames(renderer, drawList, 1, rgba);
+	};
+	Register(lighting);
+
+	// Ground shadowed by a grid of static cubes and a ring of dynamic ones. The second frame reuses the cached static
+	// cascades, so the copy into the sampled atlas is covered too.
+	GoldenScene shadows;
+	shadows.name = "shadow_cascades";
+	shadows.render = [](const DeviceContext& device, OffscreenRenderer& renderer, OffscreenDrawList drawList, std::vector<uint8_t>& rgba) {
+		const uint32_t gridSize = 16;
+		ShadowCascades cascades(device);
+		ShadowSettings settings;
+		settings.resolution = 1024;
+		settings.maxStaticCasters = gridSize * gridSize;
+		settings.maxDynamicCasters = 8;
+		if (!cascades.Create(settings, renderer.GetRenderPass())) {
+			return false;
+		}
+
+		std::vector<ShadowCaster> staticCasters(gridSize * gridSize);
+		for (uint32_t i = 0; i < staticCasters.size(); ++i) {
+			ShadowCaster& caster = staticCasters[i];
+			caster.halfSize = 0.5f + static_cast<float>((i * 2654435761u) >> 30) * 0.4f;
+			caster.position[0] = (static_cast<float>(i % gridSize) - 0.5f * gridSize) * 3.0f;
+			caster.position[1] = caster.halfSize;
+			caster.position[2] = (static_cast<float>(i / gridSize) - 0.5f * gridSize) * 3.0f;
+		}
+		std::vector<ShadowCaster> dynamicCasters(8);
+		for (uint32_t i = 0; i < dynamicCasters.size(); ++i) {
+			const float angle = static_cast<float>(i) / 8.0f * 6.2831853f;
+			ShadowCaster& caster = dynamicCasters[i];
+			caster.halfSize = 0.75f;
+			caster.position[0] = 8.0f * std::cos(angle);
+			caster.position[1] = 4.0f;
+			caster.position[2] = 8.0f * std::sin(angle);
+		}
+
+		SceneCamera camera;
+		camera.position[1] = 8.0f;
+		camera.position[2] = 20.0f;
+		camera.pitch = -0.35f;
+		cascades.SetCamera(camera);
+		if (!cascades.SetStaticCasters(staticCasters) || !cascades.SetDynamicCasters(dynamicCasters)) {
+			return false;
+		}
+		drawList.drawables.push_back(&cascades);
+		return RenderFrames(renderer, drawList, 2, rgba);
+	};
+	Register(shadows);
+
+	// Street level view down a city of boxes. The second frame culls against the Hi-Z pyramid of the first one's depth,
+	// which must hide nothing that is visible.
+	GoldenScene occlusion;
+	occlusion.name = "occlusion_culling";
+	occlusion.render = [](const DeviceContext& device, OffscreenRenderer& renderer, OffscreenDrawList drawList, std::vector<uint8_t>& rgba) {
+		const uint32_t gridSize = 32;
+		const float blockSize = 6.0f;
+		OcclusionCulling culling(device);
+		if (!culling.Create(gridSize * gridSize, renderer.GetRenderPass(), renderer.GetDepthView(), renderer.GetExtent())) {
+			return false;
+		}
+
+		std::vector<OcclusionInstance> buildings(gridSize * gridSize);
+		for (uint32_t i = 0; i < buildings.size(); ++i) {
+			const uint32_t hash = i * 2654435761u;
+			OcclusionInstance& building = buildings[i];
+			building.halfExtent[0] = 2.0f;
+			building.halfExtent[1] = 3.0f + static_cast<float>(hash >> 28) * 1.5f;
+			building.halfExtent[2] = 2.0f;
+			building.center[0] = (static_cast<float>(i % gridSize) - 0.5f * gridSize) * blockSize;
+			building.center[1] = building.halfExtent[1];
+			building.center[2] = (static_cast<float>(i / gridSize) - 0.5f * gridSize) * blockSize;
+			building.shade = static_cast<float>((hash >> 20) & 255) / 255.0f;
+		}
+		if (!culling.SetInstances(buildings)) {
+			return false;
+		}
+
+		SceneCamera camera;
+		camera.position[0] = 0.5f * blockSize;
+		camera.position[1] = 1.7f;
+		camera.position[2] = 0.25f * gridSize * blockSize;
+		camera.yaw = 0.2f;
+		camera.farPlane = gridSize * blockSize;
+		culling.SetCamera(camera);
+		drawList.drawables.push_back(&culling);
+		return RenderFrames(renderer, drawList, 2, rgba);
+	};
+	Register(occlusion);
+
+	// The city of the occlusion scene with one car driving across, rendered at two thirds of the golden's size and
+	// reconstructed to it over two full jitter cycles. The read back result is the upscaler's output.
+	GoldenScene upscaling;
+	upscaling.name = "taa_upscale";
+	upscaling.render = [](const DeviceContext& device, OffscreenRenderer& renderer, OffscreenDrawList drawList, std::vector<uint8_t>& rgba) {
+		const uint32_t gridSize = 16;
+		const float blockSize = 6.0f;
+		const VkExtent2D outputExtent = renderer.GetExtent();
+		if (!renderer.Resize({ std::max<uint32_t>(outputExtent.width * 2 / 3, 1), std::max<uint32_t>(outputExtent.height * 2 / 3, 1) })) {
+			return false;
+		}
+
+		TemporalSettings settings;
+		settings.outputExtent = outputExtent;
+		settings.maxMotionBoxes = 1;
+		OcclusionCulling culling(device);
+		TemporalUpscaler upscaler(device);
+		if (!culling.Create(gridSize * gridSize + 1, renderer.GetRenderPass(), renderer.GetDepthView(), renderer.GetExtent())
+			|| !upscaler.Create(settings, renderer)) {
+			return false;
+		}
+
+		std::vector<OcclusionInstance> instances(gridSize * gridSize + 1);
+		for (uint32_t i = 0; i < gridSize * gridSize; ++i) {
+			const uint32_t hash = i * 2654435761u;
+			OcclusionInstance& building = instances[i];
+			building.halfExtent[0] = 2.0f;
+			building.halfExtent[1] = 3.0f + static_cast<float>(hash >> 28) * 1.5f;
+			building.halfExtent[2] = 2.0f;
+			building.center[0] = (static_cast<float>(i % gridSize) - 0.5f * gridSize) * blockSize;
+			building.center[1] = building.halfExtent[1];
+			building.center[2] = (static_cast<float>(i / gridSize) - 0.5f * gridSize) * blockSize;
+			building.shade = static_cast<float>((hash >> 20) & 255) / 255.0f;
+		}
+
+		SceneCamera camera;
+		camera.position[0] = 0.5f * blockSize;
+		camera.position[1] = 1.7f;
+		camera.position[2] = 0.25f * gridSize * blockSize;
+		camera.yaw = 0.2f;
+		camera.farPlane = gridSize * blockSize;
+		drawList.drawables.push_back(&culling);
+		drawList.drawables.push_back(&upscaler);
+
+		const uint32_t frameCount = 16;
+		std::vector<TemporalMotionBox> cars(1);
+		TemporalMotionBox& car = cars[0];
+		car.halfExtent[0] = 0.8f;
+		car.halfExtent[1] = 0.6f;
+		car.halfExtent[2] = 2.0f;
+		car.center[0] = 0.5f * blockSize + 0.8f;
+		car.center[1] = car.halfExtent[1];
+		for (uint32_t frame = 0; frame < frameCount; ++frame) {
+			car.previousCenter[0] = car.center[0];
+			car.previousCenter[1] = car.center[1];
+			car.previousCenter[2] = (frame > 0) ? car.center[2] : camera.position[2] - 20.0f;
+			car.center[2] = camera.position[2] - 20.0f + static_cast<float>(frame) * 0.3f;
+
+			OcclusionInstance& instance = instances[gridSize * gridSize];
+			memcpy(instance.center, car.center, sizeof(car.center));
+			memcpy(instance.halfExtent, car.halfExtent, sizeof(car.halfExtent));
+			instance.shade = 0.9f;
+
+			culling.SetCamera(upscaler.JitterCamera(camera));
+			if (!culling.SetInstances(instances) || !upscaler.SetMotionBoxes(cars)
+				|| !renderer.Record(drawList) || !renderer.Submit() || !renderer.Wait()) {
+				return false;
+			}
+		}
+		return renderer.ReadPixels(rgba);
+	};
+	Register(upscaling);
+
+	// Rows of rocks receding from the camera, each drawn at the coarsest of four levels whose error stays within a pixel
+	GoldenScene lod;
+	lod.name = "level_of_detail";
+	lod.render = [](const DeviceContext& device, OffscreenRenderer& renderer, OffscreenDrawList drawList, std::vector<uint8_t>& rgba) {
+		const uint32_t gridSize = 8;
+		const float spacing = 6.0f;
+		std::vector<float> positions;
+		std::vector<uint32_t> indices;
+		BuildRockMesh(32, 64, positions, indices);
+		LodMesh mesh;
+		LodRenderer lods(device);
+		if (!BuildLodMesh(positions, indices, 4, 0.5f, mesh) || !lods.Create(mesh, gridSize * gridSize, renderer.GetRenderPass())) {
+			return false;
+		}
+
+		std::vector<LodInstance> rocks(gridSize * gridSize);
+		for (uint32_t i = 0; i < rocks.size(); ++i) {
+			LodInstance& rock = rocks[i];
+			rock.scale = 1.0f + static_cast<float>((i * 2654435761u) >> 30) * 0.25f;
+			rock.position[0] = (static_cast<float>(i % gridSize) - 0.5f * gridSize) * spacing;
+			rock.position[1] = 0.5f * rock.scale;
+			rock.position[2] = -static_cast<float>(i / gridSize) * spacing;
+		}
+		if (!lods.SetInstances(rocks)) {
+			return false;
+		}
+
+		SceneCamera camera;
+		camera.position[1] = 2.0f;
+		camera.position[2] = 6.0f;
+		camera.pitch = -0.1f;
+		camera.farPlane = 2.0f * gridSize * spacing;
+		lods.SetMaxScreenError(1.0f);
+		lods.SelectLevels(camera, renderer.GetExtent());
+		drawList.drawables.push_back(&lods);
+		return RenderFrames(renderer, drawList, 1, rgba);
+	};
+	Register(lod);
+
+	// Dense rocks seen from up close with frustum and cone culling of their meshlets, which must not remove anything
+	// visible
+	GoldenScene meshlets;
+	meshlets.name = "meshlets";
+	meshlets.render = [](const DeviceContext& device, OffscreenRenderer& renderer, OffscreenDrawList drawList, std::vector<uint8_t>& rgba) {
+		const uint32_t gridSize = 4;
+		const float spacing = 12.0f;
+		std::vector<float> positions;
+		std::vector<uint32_t> indices;
+		BuildRockMesh(64, 128, positions, indices);
+		MeshletMesh mesh;
+		MeshletRenderer meshletRenderer(device);
+		if (!BuildMeshlets(positions, indices, mesh) || !meshletRenderer.Create(mesh, gridSize * gridSize, renderer.GetRenderPass())) {
+			return false;
+		}
+
+		std::vector<MeshletInstance> rocks(gridSize * gridSize);
+		for (uint32_t i = 0; i < rocks.size(); ++i) {
+			MeshletInstance& rock = rocks[i];
+			rock.scale = 4.0f;
+			rock.position[0] = (static_cast<float>(i % gridSize) - 0.5f * gridSize) * spacing;
+			rock.position[2] = (static_cast<float>(i / gridSize) - 0.5f * gridSize) * spacing;
+		}
+		if (!meshletRenderer.SetInstances(rocks)) {
+			return false;
+		}
+
+		SceneCamera camera;
+		camera.position[0] = -0.5f * spacing;
+		camera.position[1] = 3.0f;
+		camera.position[2] = 20.0f;
+		camera.farPlane = 2.0f * gridSize * spacing;
+		meshletRenderer.SetCamera(camera);
+		meshletRenderer.SetCulling(true, true);
+		drawList.drawables.push_back(&meshletRenderer);
+		return RenderFrames(renderer, drawList, 1, rgba);
+	};
+	Register(meshlets);
+
+	// A small crowd of skinned tentacles at a fixed point in time, casting shadows onto the ground through the mesh casters
+	GoldenScene crowd;
+	crowd.name = "crowd";
+	crowd.render = [](const DeviceContext& device, OffscreenRenderer& renderer, OffscreenDrawList drawList, std::vector<uint8_t>& rgba) {
+		const uint32_t jointCount = 16;
+		const float segmentLength = 0.25f;
+		const uint32_t gridSize = 4;
+		const float spacing = 1.5f;
+		SkinnedMesh mesh;
+		Skeleton skeleton;
+		BuildTentacle(jointCount, segmentLength, mesh, skeleton);
+		std::vector<AnimationClip> clips(2);
+		if (!BuildWaveClip(jointCount, segmentLength, 2, 0.3f, clips[0]) || !BuildWaveClip(jointCount, segmentLength, 0, 0.2f, clips[1])) {
+			return false;
+		}
+
+		SkinnedCrowd skinnedCrowd(device);
+		ShadowCascades cascades(device);
+		ShadowSettings settings;
+		settings.resolution = 1024;
+		settings.shadowDistance = 20.0f;
+		if (!skinnedCrowd.Create(skeleton, clips, mesh, gridSize * gridSize, renderer.GetRenderPass())
+			|| !cascades.Create(settings, renderer.GetRenderPass())) {
+			return false;
+		}
+
+		std::vector<CrowdCharacter> characters(gridSize * gridSize);
+		for (uint32_t i = 0; i < characters.size(); ++i) {
+			const uint32_t hash = i * 2654435761u;
+			CrowdCharacter& character = characters[i];
+			character.position[0] = (static_cast<float>(i % gridSize) - 0.5f * gridSize) * spacing;
+			character.position[2] = -static_cast<float>(i / gridSize) * spacing;
+			character.heading = static_cast<float>((hash >> 8) & 0xFF) / 255.0f * 6.2831853f;
+			character.clips[0] = 0;
+			character.clips[1] = 1;
+			character.blend = static_cast<float>((hash >> 16) & 0xFF) / 255.0f;
+			character.timeOffset = static_cast<float>((hash >> 24) & 0xFF) / 255.0f * 2.0f;
+		}
+		if (!skinnedCrowd.SetCharacters(characters)) {
+			return false;
+		}
+
+		SceneCamera camera;
+		camera.position[1] = 3.0f;
+		camera.position[2] = 4.0f;
+		camera.pitch = -0.35f;
+		camera.farPlane = 4.0f * gridSize * spacing;
+		skinnedCrowd.SetCamera(camera);
+		skinnedCrowd.Update(0.5f);
+
+		ShadowMeshCasters casters;
+		casters.vertices = skinnedCrowd.GetSkinnedVertices();
+		casters.indices = skinnedCrowd.GetIndices();
+		casters.vertexCount = skinnedCrowd.GetVertexCount();
+		casters.indexCount = skinnedCrowd.GetIndexCount();
+		casters.instanceCount = skinnedCrowd.GetCharacterCount();
+		cascades.SetCamera(camera);
+		cascades.SetMeshCasters(casters);
+
+		// Skinning runs in the crowd's pre-pass, so it has to come before the shadows drawing its result
+		drawList.drawables.push_back(&skinnedCrowd);
+		drawList.drawables.push_back(&cascades);
+		return RenderFrames(renderer, drawList, 1, rgba);
+	};
+	Register(crowd);
+}
+
+bool GoldenImageTester::Run(VulkanBase& vulkan) {
+	bool passed = true;
+	for (const GoldenScene& scene : Scenes) {
+		if (!Options.filter.empty() && (scene.name.find(Options.filter) == std::string::npos)) {
+			continue;
+		}
+		if (!RunScene(vulkan, scene)) {
+			passed = false;
+		}
+	}
+	return passed;
+}
+
+bool GoldenImageTester::HasErrors() const {
+	return Errors;
+}
+
+bool GoldenImageTester::RunScene(VulkanBase& vulkan, const GoldenScene& scene) {
+	OffscreenRenderer renderer(vulkan);
+	std::vector<uint8_t> actual;
+	bool rendered = renderer.Create(Options.extent, VK_FORMAT_R8G8B8A8_UNORM, scene.samples, scene.post)
+		&& renderer.SetTriangleCount(scene.triangleCount)
+		&& renderer.SetPipelineCount(scene.drawList.pipelineCount);
+	if (rendered) {
+		rendered = scene.render ? scene.render(vulkan.GetDeviceContext(), renderer, scene.drawList, actual) : RenderFrames(renderer, scene.drawList, 1, actual);
+	}
+	if (!rendered) {
+		std::cout << scene.name << ": COULD NOT RENDER SCENE " << std::endl;
+		Errors = true;
+		return false;
+	}
+
+	const VkExtent2D extent = renderer.GetOutputExtent();
+	const std::string goldenPath = GetPath(scene, "");
+	if (Options.updateGolden) {
+		if (!Png::Write(goldenPath, extent.width, extent.height, actual)) {
+			std::cout << scene.name << ": COULD NOT WRITE " << goldenPath << std::endl;
+			Errors = true;
+			return false;
+		}
+		std::cout << scene.name << ": golden written to " << goldenPath << std::endl;
+		return true;
+	}
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> expected;
+	std::string error;
+	if (!Png::Read(goldenPath, width, height, expected, error)) {
+		std::cout << scene.name << ": COULD NOT READ GOLDEN: " << error << " (run with --update-golden to create it)" << std::endl;
+		Errors = true;
+		return false;
+	}
+	if ((width != extent.width) || (height != extent.height)) {
+		std::cout << scene.name << ": GOLDEN IS " << width << "x" << height << ", RENDERED " << extent.width << "x" << extent.height << std::endl;
+		return false;
+	}
+
+	const ImageDiffResult result = CompareImages(expected, actual, width, height, Options.tolerance);
+	const bool passed = result.Passed(Options.tolerance);
+	std::cout << scene.name << ": " << (passed ? "passed" : "FAILED") << ", "
+		<< result.differentPixels << " of " << result.totalPixels << " pixels differ, max distance " << result.maxDistance << std::endl;
+
+	if (!passed) {
+		std::vector<uint8_t> diff;
+		MakeDiffImage(expected, actual, width, height, Options.tolerance, diff);
+		const std::string actualPath = GetPath(scene, ".actual");
+		const std::string diffPath = GetPath(scene, ".diff");
+		if (Png::Write(actualPath, width, height, actual) && Png::Write(diffPath, width, height, diff)) {
+			std::cout << "  see " << actualPath << " and " << diffPath << std::endl;
+		}
+	}
+	return passed;
+}
+
+std::string GoldenImageTester::GetPath(const GoldenScene& scene, const char* suffix) const {
+	std::string path = Options.directory;
+	if (!path.empty() && (path.back() != '/') && (path.back() != '\\')) {
+		path += '/';
+	}
+	return path + scene.name + suffix + ".png";
+}
+
+int RunGoldenTests(int argc, char* argv[]) {
+	GoldenOptions options;
+
+	// --golden-dir DIR    : directory with the golden images (default "Golden")
+	// --update-golden     : store the rendered images as the new goldens instead of comparing
+	// --threshold X       : perceptual distance a pixel may differ by (default 0.1)
+	// --max-different X   : share of pixels allowed above the threshold (default 0.001)
+	// --filter NAME       : run only scenes containing NAME
+	for (int i = 1; i < argc; ++i) {
+		if ((strcmp(argv[i], "--golden-dir") == 0) && (i + 1 < argc)) {
+			options.directory = argv[++i];
+		}
+		else if (strcmp(argv[i], "--update-golden") == 0) {
+			options.updateGolden = true;
+		}
+		else if ((strcmp(argv[i], "--threshold") == 0) && (i + 1 < argc)) {
+			options.tolerance.threshold = atof(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--max-different") == 0) && (i + 1 < argc)) {
+			options.tolerance.maxDifferentFraction = atof(argv[++i]);
+		}
+		else if ((strcmp(argv[i], "--filter") == 0) && (i + 1 < argc)) {
+			options.filter = argv[++i];
+		}
+	}
+
+	VulkanBase vulkan;
+	if (!vulkan.PrepareVulkanHeadless()) {
+		return 2;
+	}
+
+	GoldenImageTester tester(options);
+	tester.RegisterDefaultScenes();
+	const bool passed = tester.Run(vulkan);
+	if (tester.HasErrors()) {
+		return 2;
+	}
+	if (!passed) {
+		std::cout << "GOLDEN IMAGE MISMATCH " << std::endl;
+		return 1;
+	}
+	std::cout << "All golden images match" << std::endl;
+	return 0;
+}
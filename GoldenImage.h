@@ -0,0 +1,72 @@
+#pragma once
+
+#include "ImageDiff.h"
+#include "OffscreenRenderer.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+struct GoldenOptions {
+	std::string directory;		// Where <scene>.png goldens live, failures are written next to them
+	std::string filter;			// Runs only scenes whose name contains this
+	VkExtent2D extent;			// Kept small, so goldens stay small and software rasterizers stay fast
+	ImageDiffTolerance tolerance;
+	bool updateGolden;
+
+	GoldenOptions() :
+		directory("Golden"),
+		filter(),
+		extent({ 256, 256 }),
+		tolerance(),
+		updateGolden(false) {
+	}
+};
+
+// Renders the frames of a scene drawn by subsystems, which it creates for the renderer and adds to the draw list, and
+// reads the last frame back while they still exist
+typedef std::function<bool(const DeviceContext& device, OffscreenRenderer& renderer, OffscreenDrawList drawList, std::vector<uint8_t>& rgba)> GoldenRenderFunction;
+
+// A deterministic offscreen frame compared against a stored image
+struct GoldenScene {
+	std::string name;
+	uint32_t triangleCount;
+	OffscreenDrawList drawList;
+	VkSampleCountFlagBits samples;
+	PostProcessSettings post;
+	GoldenRenderFunction render;		// Empty renders drawList once
+
+	GoldenScene() :
+		name(),
+		triangleCount(0),
+		drawList(),
+		samples(VK_SAMPLE_COUNT_1_BIT),
+		post(),
+		render() {
+	}
+};
+
+// Renders every scene offscreen, reads it back and compares it with <directory>/<scene>.png.
+// Every scene gets a renderer of its own, created with its sample count and post-processing.
+// Only core Vulkan 1.0 features are used, so it runs the same way on lavapipe or SwiftShader as on a GPU.
+class GoldenImageTester {
+public:
+	explicit GoldenImageTester(const GoldenOptions& options);
+
+	void Register(const GoldenScene& scene);
+	void RegisterDefaultScenes();
+
+	// Returns false when a scene could not be rendered or did not match its golden
+	bool Run(VulkanBase& vulkan);
+	bool HasErrors() const;
+
+private:
+	bool RunScene(VulkanBase& vulkan, const GoldenScene& scene);
+	std::string GetPath(const GoldenScene& scene, const char* suffix) const;
+
+	GoldenOptions Options;
+	std::vector<GoldenScene> Scenes;
+	bool Errors;
+};
+
+// Entry point of the --golden mode, returns the process exit code
+int RunGoldenTests(int argc, char* argv[]);
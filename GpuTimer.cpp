@@ -0,0 +1,152 @@
+#include "GpuTimer.h"
+#include "VulkanFunctions.h"
+#include <iostream>
+#include <vector>
+
+GpuTimer::GpuTimer() :
+	Dispatch(nullptr),
+	QueryPool(VK_NULL_HANDLE),
+	SlotCount(0),
+	TimestampPeriod(0.0),
+	ValidBitsMask(0) {
+}
+
+GpuTimer::~GpuTimer() {
+	Destroy();
+}
+
+bool GpuTimer::Create(VkPhysicalDevice physicalDevice, const DeviceDispatchTable& device, VkQueue queue, uint32_t queueFamilyIndex, uint32_t slotCount) {
+	Destroy();
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+	uint32_t queueFamiliesCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamiliesCount, nullptr);
+	std::vector<VkQueueFamilyProperties> queueFamiliesProperties(queueFamiliesCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamiliesCount, queueFamiliesProperties.data());
+
+	if ((queueFamilyIndex >= queueFamiliesCount) || (queueFamiliesProperties[queueFamilyIndex].timestampValidBits == 0)) {
+		std::cout << "TIMESTAMP QUERIES NOT SUPPORTED ON QUEUE FAMILY " << queueFamilyIndex << std::endl;
+		return false;
+	}
+
+	uint32_t validBits = queueFamiliesProperties[queueFamilyIndex].timestampValidBits;
+	ValidBitsMask = (validBits >= 64) ? ~0ULL : ((1ULL << validBits) - 1);
+	TimestampPeriod = static_cast<double>(deviceProperties.limits.timestampPeriod);
+
+	VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+	queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolCreateInfo.pNext = nullptr;
+	queryPoolCreateInfo.flags = 0;
+	queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolCreateInfo.queryCount = 2 * slotCount;
+	queryPoolCreateInfo.pipelineStatistics = 0;
+
+	if (device.vkCreateQueryPool(device.device, &queryPoolCreateInfo, nullptr, &QueryPool) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE TIMESTAMP QUERY POOL " << std::endl;
+		return false;
+	}
+
+	Dispatch = &device;
+	SlotCount = slotCount;
+	if (!ResetQueries(queue, queueFamilyIndex)) {
+		Destroy();
+		return false;
+	}
+	return true;
+}
+
+void GpuTimer::Destroy() {
+	if (QueryPool != VK_NULL_HANDLE) {
+		Dispatch->vkDestroyQueryPool(Dispatch->device, QueryPool, nullptr);
+		QueryPool = VK_NULL_HANDLE;
+	}
+	Dispatch = nullptr;
+	SlotCount = 0;
+}
+
+bool GpuTimer::IsSupported() const {
+	return QueryPool != VK_NULL_HANDLE;
+}
+
+void GpuTimer::CmdBegin(VkCommandBuffer commandBuffer, uint32_t slot, VkPipelineStageFlagBits stage) const {
+	if (!IsSupported() || (slot >= SlotCount)) {
+		return;
+	}
+	// Queries must be reset before every use, doing it in the same command buffer keeps prerecorded buffers reusable
+	Dispatch->vkCmdResetQueryPool(commandBuffer, QueryPool, 2 * slot, 2);
+	Dispatch->vkCmdWriteTimestamp(commandBuffer, stage, QueryPool, 2 * slot);
+}
+
+void GpuTimer::CmdEnd(VkCommandBuffer commandBuffer, uint32_t slot, VkPipelineStageFlagBits stage) const {
+	if (!IsSupported() || (slot >= SlotCount)) {
+		return;
+	}
+	Dispatch->vkCmdWriteTimestamp(commandBuffer, stage, QueryPool, 2 * slot + 1);
+}
+
+bool GpuTimer::GetResult(uint32_t slot, double& milliseconds) const {
+	if (!IsSupported() || (slot >= SlotCount)) {
+		return false;
+	}
+
+	uint64_t timestamps[2] = {};
+	if (Dispatch->vkGetQueryPoolResults(Dispatch->device, QueryPool, 2 * slot, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+		return false;
+	}
+
+	uint64_t ticks = ((timestamps[1] & ValidBitsMask) - (timestamps[0] & ValidBitsMask)) & ValidBitsMask;
+	milliseconds = static_cast<double>(ticks) * TimestampPeriod / 1000000.0;
+	return true;
+}
+
+bool GpuTimer::ResetQueries(VkQueue queue, uint32_t queueFamilyIndex) {
+	// Results of queries which were never reset are undefined, and Vulkan 1.0 can only reset them from a command buffer
+	VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+	commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	commandPoolCreateInfo.pNext = nullptr;
+	commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	if (Dispatch->vkCreateCommandPool(Dispatch->device, &commandPoolCreateInfo, nullptr, &commandPool) != VK_SUCCESS) {
+		std::cout << "COULD NOT RESET TIMESTAMP QUERIES " << std::endl;
+		return false;
+	}
+
+	VkCommandBufferAllocateInfo cmdBufferAllocateInfo = {};
+	cmdBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	cmdBufferAllocateInfo.pNext = nullptr;
+	cmdBufferAllocateInfo.commandPool = commandPool;
+	cmdBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	cmdBufferAllocateInfo.commandBufferCount = 1;
+
+	VkCommandBufferBeginInfo cmdBufferBeginInfo = {};
+	cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	cmdBufferBeginInfo.pNext = nullptr;
+	cmdBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	cmdBufferBeginInfo.pInheritanceInfo = nullptr;
+
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	bool result = (Dispatch->vkAllocateCommandBuffers(Dispatch->device, &cmdBufferAllocateInfo, &commandBuffer) == VK_SUCCESS)
+		&& (Dispatch->vkBeginCommandBuffer(commandBuffer, &cmdBufferBeginInfo) == VK_SUCCESS);
+	if (result) {
+		Dispatch->vkCmdResetQueryPool(commandBuffer, QueryPool, 0, 2 * SlotCount);
+		result = Dispatch->vkEndCommandBuffer(commandBuffer) == VK_SUCCESS;
+	}
+	if (result) {
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext = nullptr;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &commandBuffer;
+		result = (Dispatch->vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) == VK_SUCCESS)
+			&& (Dispatch->vkQueueWaitIdle(queue) == VK_SUCCESS);
+	}
+	if (!result) {
+		std::cout << "COULD NOT RESET TIMESTAMP QUERIES " << std::endl;
+	}
+	Dispatch->vkDestroyCommandPool(Dispatch->device, commandPool, nullptr);
+	return result;
+}
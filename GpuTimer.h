@@ -0,0 +1,41 @@
+#pragma once
+#define VK_NO_PROTOTYPES
+
+#if defined _WIN32
+#define VK_USE_PLATFORM_WIN32_KHR
+#elif defined __linux__
+#define VK_USE_PLATFORM_XCB_KHR
+#endif
+
+#include "vulkan.h"
+#include "VulkanDispatch.h"
+
+// Measures GPU time between two points of a command buffer with timestamp queries.
+// Every slot owns a pair of queries, so command buffers recorded once (for example
+// one per swapchain image) can each use their own slot.
+class GpuTimer {
+public:
+	GpuTimer();
+	~GpuTimer();
+
+	// Device functions are called through the given table, which has to outlive the timer. All queries are reset once
+	// on the queue, which is waited for, so slots that were never submitted read as not available instead of undefined
+	bool Create(VkPhysicalDevice physicalDevice, const DeviceDispatchTable& device, VkQueue queue, uint32_t queueFamilyIndex, uint32_t slotCount);
+	void Destroy();
+	bool IsSupported() const;
+
+	void CmdBegin(VkCommandBuffer commandBuffer, uint32_t slot, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT) const;
+	void CmdEnd(VkCommandBuffer commandBuffer, uint32_t slot, VkPipelineStageFlagBits stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT) const;
+
+	// Doesn't wait - returns false when results for the slot are not available yet
+	bool GetResult(uint32_t slot, double& milliseconds) const;
+
+private:
+	bool ResetQueries(VkQueue queue, uint32_t queueFamilyIndex);
+
+	const DeviceDispatchTable* Dispatch;
+	VkQueryPool QueryPool;
+	uint32_t SlotCount;
+	double TimestampPeriod;
+	uint64_t ValidBitsMask;
+};
@@ -0,0 +1,424 @@
+#include "GraphicsPipeline.h"
+#include <iostream>
+#include <string>
+
+namespace {
+	bool IsDepthFormat(VkFormat format) {
+		return (format == VK_FORMAT_D16_UNORM) || (format == VK_FORMAT_X8_D24_UNORM_PACK32) || (format == VK_FORMAT_D32_SFLOAT)
+			|| (format == VK_FORMAT_D16_UNORM_S8_UINT) || (format == VK_FORMAT_D24_UNORM_S8_UINT) || (format == VK_FORMAT_D32_SFLOAT_S8_UINT);
+	}
+
+	bool CreateView(const DeviceContext& device, const GpuImage& image, VkImageViewType viewType, VkImageSubresourceRange range, VkImageView& view) {
+		const DeviceDispatchTable& dispatch = *device.dispatch;
+
+		VkImageViewCreateInfo imageViewCreateInfo = {};
+		imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		imageViewCreateInfo.pNext = nullptr;
+		imageViewCreateInfo.flags = 0;
+		imageViewCreateInfo.image = image.handle;
+		imageViewCreateInfo.viewType = viewType;
+		imageViewCreateInfo.format = image.format;
+		imageViewCreateInfo.components = {
+			VK_COMPONENT_SWIZZLE_IDENTITY,
+			VK_COMPONENT_SWIZZLE_IDENTITY,
+			VK_COMPONENT_SWIZZLE_IDENTITY,
+			VK_COMPONENT_SWIZZLE_IDENTITY
+		};
+		imageViewCreateInfo.subresourceRange = range;
+
+		if (dispatch.vkCreateImageView(dispatch.device, &imageViewCreateInfo, nullptr, &view) != VK_SUCCESS) {
+			std::cout << "COULD NOT CREATE IMAGE VIEW " << std::endl;
+			view = VK_NULL_HANDLE;
+			return false;
+		}
+		return true;
+	}
+}
+
+bool CreateGpuImage(const DeviceContext& device, VkFormat format, VkExtent2D extent, uint32_t layers, uint32_t mipLevels, VkSampleCountFlagBits samples,
+	VkImageUsageFlags usage, GpuImage& image) {
+	const DeviceDispatchTable& dispatch = *device.dispatch;
+	image.format = format;
+	image.aspect = IsDepthFormat(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+	image.layers = layers;
+	image.mipLevels = mipLevels;
+
+	VkImageCreateInfo imageCreateInfo = {};
+	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.pNext = nullptr;
+	imageCreateInfo.flags = 0;
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.format = format;
+	imageCreateInfo.extent = { extent.width, extent.height, 1 };
+	imageCreateInfo.mipLevels = mipLevels;
+	imageCreateInfo.arrayLayers = layers;
+	imageCreateInfo.samples = samples;
+	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.usage = usage;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageCreateInfo.queueFamilyIndexCount = 0;
+	imageCreateInfo.pQueueFamilyIndices = nullptr;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	if (dispatch.vkCreateImage(dispatch.device, &imageCreateInfo, nullptr, &image.handle) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE IMAGE " << std::endl;
+		return false;
+	}
+
+	VkMemoryRequirements memoryRequirements;
+	dispatch.vkGetImageMemoryRequirements(dispatch.device, image.handle, &memoryRequirements);
+
+	VkMemoryAllocateInfo memoryAllocateInfo = {};
+	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memoryAllocateInfo.pNext = nullptr;
+	memoryAllocateInfo.allocationSize = memoryRequirements.size;
+	// On tilers lazily allocated attachments which are never loaded or stored may stay in tile memory and get no backing at all
+	image.lazilyAllocated = ((usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) != 0)
+		&& device.GetMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, memoryAllocateInfo.memoryTypeIndex);
+	if (!image.lazilyAllocated && !device.GetMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, memoryAllocateInfo.memoryTypeIndex)) {
+		std::cout << "NO DEVICE LOCAL MEMORY TYPE FOR IMAGE " << std::endl;
+		DestroyGpuImage(device, image);
+		return false;
+	}
+
+	if ((dispatch.vkAllocateMemory(dispatch.device, &memoryAllocateInfo, nullptr, &image.memory) != VK_SUCCESS)
+		|| (dispatch.vkBindImageMemory(dispatch.device, image.handle, image.memory, 0) != VK_SUCCESS)) {
+		std::cout << "COULD NOT ALLOCATE MEMORY FOR IMAGE " << std::endl;
+		DestroyGpuImage(device, image);
+		return false;
+	}
+
+	if (!CreateView(device, image, (layers > 1) ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D, { image.aspect, 0, mipLevels, 0, layers }, image.view)) {
+		DestroyGpuImage(device, image);
+		return false;
+	}
+	return true;
+}
+
+void DestroyGpuImage(const DeviceContext& device, GpuImage& image) {
+	const DeviceDispatchTable& dispatch = *device.dispatch;
+	if (image.view != VK_NULL_HANDLE) {
+		dispatch.vkDestroyImageView(dispatch.device, image.view, nullptr);
+		image.view = VK_NULL_HANDLE;
+	}
+	if (image.handle != VK_NULL_HANDLE) {
+		dispatch.vkDestroyImage(dispatch.device, image.handle, nullptr);
+		image.handle = VK_NULL_HANDLE;
+	}
+	if (image.memory != VK_NULL_HANDLE) {
+		dispatch.vkFreeMemory(dispatch.device, image.memory, nullptr);
+		image.memory = VK_NULL_HANDLE;
+	}
+}
+
+bool CreateGpuImageView(const DeviceContext& device, const GpuImage& image, uint32_t layer, uint32_t baseMipLevel, uint32_t mipLevels, VkImageView& view) {
+	return CreateView(device, image, VK_IMAGE_VIEW_TYPE_2D, { image.aspect, baseMipLevel, mipLevels, layer, 1 }, view);
+}
+
+GraphicsPipeline::GraphicsPipeline(const DeviceContext& device) :
+	Device(device),
+	Dispatch(*device.dispatch),
+	Compiler(),
+	Bindings(),
+	Stages(0),
+	SetLayout(VK_NULL_HANDLE),
+	DescriptorPool(VK_NULL_HANDLE),
+	PipelineLayout(VK_NULL_HANDLE),
+	Pipeline(VK_NULL_HANDLE) {
+}
+
+GraphicsPipeline::~GraphicsPipeline() {
+	Destroy();
+}
+
+bool GraphicsPipeline::Create(const char* vertexSource, const char* fragmentSource, const char* name, const std::vector<VkDescriptorType>& bindings,
+	uint32_t pushConstantSize, uint32_t maxSets, const GraphicsPipelineState& state) {
+	Destroy();
+	Bindings = bindings;
+
+	// Fragment stage is part of the bindings and the push constant range only when there is a fragment shader
+	Stages = VK_SHADER_STAGE_VERTEX_BIT | ((fragmentSource != nullptr) ? VK_SHADER_STAGE_FRAGMENT_BIT : 0);
+	std::vector<VkDescriptorSetLayoutBinding> layoutBindings(bindings.size());
+	std::vector<VkDescriptorPoolSize> poolSizes;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(bindings.size()); ++i) {
+		layoutBindings[i].binding = i;
+		layoutBindings[i].descriptorType = bindings[i];
+		layoutBindings[i].descriptorCount = 1;
+		// Input attachments can only be read by fragment shaders
+		layoutBindings[i].stageFlags = (bindings[i] == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT) ? static_cast<VkShaderStageFlags>(VK_SHADER_STAGE_FRAGMENT_BIT) : Stages;
+		layoutBindings[i].pImmutableSamplers = nullptr;
+
+		bool counted = false;
+		for (VkDescriptorPoolSize& poolSize : poolSizes) {
+			if (poolSize.type == bindings[i]) {
+				poolSize.descriptorCount += maxSets;
+				counted = true;
+				break;
+			}
+		}
+		if (!counted) {
+			poolSizes.push_back({ bindings[i], maxSets });
+		}
+	}
+
+	VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = {};
+	setLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutCreateInfo.pNext = nullptr;
+	setLayoutCreateInfo.flags = 0;
+	setLayoutCreateInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size());
+	setLayoutCreateInfo.pBindings = layoutBindings.data();
+
+	if (Dispatch.vkCreateDescriptorSetLayout(Dispatch.device, &setLayoutCreateInfo, nullptr, &SetLayout) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE DESCRIPTOR SET LAYOUT OF " << name << std::endl;
+		return false;
+	}
+
+	if ((maxSets > 0) && !poolSizes.empty()) {
+		VkDescriptorPoolCreateInfo poolCreateInfo = {};
+		poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolCreateInfo.pNext = nullptr;
+		poolCreateInfo.flags = 0;
+		poolCreateInfo.maxSets = maxSets;
+		poolCreateInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+		poolCreateInfo.pPoolSizes = poolSizes.data();
+
+		if (Dispatch.vkCreateDescriptorPool(Dispatch.device, &poolCreateInfo, nullptr, &DescriptorPool) != VK_SUCCESS) {
+			std::cout << "COULD NOT CREATE DESCRIPTOR POOL OF " << name << std::endl;
+			return false;
+		}
+	}
+
+	VkPushConstantRange pushConstantRange = { Stages, 0, pushConstantSize };
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.pNext = nullptr;
+	pipelineLayoutCreateInfo.flags = 0;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &SetLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = (pushConstantSize > 0) ? 1 : 0;
+	pipelineLayoutCreateInfo.pPushConstantRanges = (pushConstantSize > 0) ? &pushConstantRange : nullptr;
+
+	if (Dispatch.vkCreatePipelineLayout(Dispatch.device, &pipelineLayoutCreateInfo, nullptr, &PipelineLayout) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE PIPELINE LAYOUT OF " << name << std::endl;
+		return false;
+	}
+
+	const std::string vertexName = std::string(name) + ".vert";
+	const std::string fragmentName = std::string(name) + ".frag";
+	VkShaderModule vertexShader = VK_NULL_HANDLE;
+	VkShaderModule fragmentShader = VK_NULL_HANDLE;
+	if (!Compiler.CreateShaderModule(Dispatch, vertexSource, VK_SHADER_STAGE_VERTEX_BIT, vertexName.c_str(), vertexShader)
+		|| ((fragmentSource != nullptr) && !Compiler.CreateShaderModule(Dispatch, fragmentSource, VK_SHADER_STAGE_FRAGMENT_BIT, fragmentName.c_str(), fragmentShader))) {
+		if (vertexShader != VK_NULL_HANDLE) {
+			Dispatch.vkDestroyShaderModule(Dispatch.device, vertexShader, nullptr);
+		}
+		return false;
+	}
+
+	VkSpecializationInfo specializationInfo = {
+		static_cast<uint32_t>(state.specializationEntries.size()), state.specializationEntries.data(),
+		state.specializationData.size(), state.specializationData.data()
+	};
+
+	VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = vertexShader;
+	shaderStages[0].pName = "main";
+	shaderStages[0].pSpecializationInfo = state.specializationEntries.empty() ? nullptr : &specializationInfo;
+	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = fragmentShader;
+	shaderStages[1].pName = "main";
+	shaderStages[1].pSpecializationInfo = shaderStages[0].pSpecializationInfo;
+
+	VkPipelineVertexInputStateCreateInfo vertexInputState = {};
+	vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputState.vertexBindingDescriptionCount = static_cast<uint32_t>(state.vertexBindings.size());
+	vertexInputState.pVertexBindingDescriptions = state.vertexBindings.data();
+	vertexInputState.vertexAttributeDescriptionCount = static_cast<uint32_t>(state.vertexAttributes.size());
+	vertexInputState.pVertexAttributeDescriptions = state.vertexAttributes.data();
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = {};
+	inputAssemblyState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssemblyState.topology = state.topology;
+	inputAssemblyState.primitiveRestartEnable = VK_FALSE;
+
+	VkPipelineViewportStateCreateInfo viewportState = {};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.pViewports = nullptr;
+	viewportState.scissorCount = 1;
+	viewportState.pScissors = nullptr;
+
+	VkPipelineRasterizationStateCreateInfo rasterizationState = {};
+	rasterizationState.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizationState.depthClampEnable = VK_FALSE;
+	rasterizationState.rasterizerDiscardEnable = VK_FALSE;
+	rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizationState.cullMode = state.cullMode;
+	rasterizationState.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterizationState.depthBiasEnable = state.depthBias ? VK_TRUE : VK_FALSE;
+	rasterizationState.lineWidth = 1.0f;
+
+	VkPipelineMultisampleStateCreateInfo multisampleState = {};
+	multisampleState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampleState.rasterizationSamples = state.samples;
+	multisampleState.sampleShadingEnable = VK_FALSE;
+	multisampleState.minSampleShading = 1.0f;
+
+	VkPipelineDepthStencilStateCreateInfo depthStencilState = {};
+	depthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencilState.depthTestEnable = state.depthTest ? VK_TRUE : VK_FALSE;
+	depthStencilState.depthWriteEnable = state.depthWrite ? VK_TRUE : VK_FALSE;
+	depthStencilState.depthCompareOp = state.depthCompare;
+	depthStencilState.depthBoundsTestEnable = VK_FALSE;
+	depthStencilState.stencilTestEnable = VK_FALSE;
+	depthStencilState.minDepthBounds = 0.0f;
+	depthStencilState.maxDepthBounds = 1.0f;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+	colorBlendAttachment.blendEnable = state.blend ? VK_TRUE : VK_FALSE;
+	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+	colorBlendAttachment.colorWriteMask = state.colorWrite ? (VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT) : 0;
+	const std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments(state.colorAttachmentCount, colorBlendAttachment);
+
+	VkPipelineColorBlendStateCreateInfo colorBlendState = {};
+	colorBlendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlendState.logicOpEnable = VK_FALSE;
+	colorBlendState.attachmentCount = state.colorAttachmentCount;
+	colorBlendState.pAttachments = colorBlendAttachments.data();
+
+	VkDynamicState dynamicStates[3] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_DEPTH_BIAS };
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = state.depthBias ? 3 : 2;
+	dynamicState.pDynamicStates = dynamicStates;
+
+	VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.pNext = nullptr;
+	pipelineCreateInfo.flags = 0;
+	pipelineCreateInfo.stageCount = (fragmentShader != VK_NULL_HANDLE) ? 2 : 1;
+	pipelineCreateInfo.pStages = shaderStages;
+	pipelineCreateInfo.pVertexInputState = &vertexInputState;
+	pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
+	pipelineCreateInfo.pTessellationState = nullptr;
+	pipelineCreateInfo.pViewportState = &viewportState;
+	pipelineCreateInfo.pRasterizationState = &rasterizationState;
+	pipelineCreateInfo.pMultisampleState = &multisampleState;
+	pipelineCreateInfo.pDepthStencilState = &depthStencilState;
+	pipelineCreateInfo.pColorBlendState = &colorBlendState;
+	pipelineCreateInfo.pDynamicState = &dynamicState;
+	pipelineCreateInfo.layout = PipelineLayout;
+	pipelineCreateInfo.renderPass = state.renderPass;
+	pipelineCreateInfo.subpass = state.subpass;
+	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineCreateInfo.basePipelineIndex = -1;
+
+	const VkResult result = Dispatch.vkCreateGraphicsPipelines(Dispatch.device, Device.pipelineCache, 1, &pipelineCreateInfo, nullptr, &Pipeline);
+	Dispatch.vkDestroyShaderModule(Dispatch.device, vertexShader, nullptr);
+	if (fragmentShader != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyShaderModule(Dispatch.device, fragmentShader, nullptr);
+	}
+	if (result != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE GRAPHICS PIPELINE " << name << std::endl;
+		Pipeline = VK_NULL_HANDLE;
+		return false;
+	}
+	return true;
+}
+
+void GraphicsPipeline::Destroy() {
+	if (Pipeline != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyPipeline(Dispatch.device, Pipeline, nullptr);
+		Pipeline = VK_NULL_HANDLE;
+	}
+	if (PipelineLayout != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyPipelineLayout(Dispatch.device, PipelineLayout, nullptr);
+		PipelineLayout = VK_NULL_HANDLE;
+	}
+	// Sets are freed together with their pool
+	if (DescriptorPool != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyDescriptorPool(Dispatch.device, DescriptorPool, nullptr);
+		DescriptorPool = VK_NULL_HANDLE;
+	}
+	if (SetLayout != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyDescriptorSetLayout(Dispatch.device, SetLayout, nullptr);
+		SetLayout = VK_NULL_HANDLE;
+	}
+}
+
+bool GraphicsPipeline::AllocateDescriptorSet(VkDescriptorSet& set) {
+	VkDescriptorSetAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.pNext = nullptr;
+	allocateInfo.descriptorPool = DescriptorPool;
+	allocateInfo.descriptorSetCount = 1;
+	allocateInfo.pSetLayouts = &SetLayout;
+
+	if ((DescriptorPool == VK_NULL_HANDLE) || (Dispatch.vkAllocateDescriptorSets(Dispatch.device, &allocateInfo, &set) != VK_SUCCESS)) {
+		std::cout << "COULD NOT ALLOCATE DESCRIPTOR SET " << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void GraphicsPipeline::WriteBuffer(VkDescriptorSet set, uint32_t binding, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range) const {
+	VkDescriptorBufferInfo bufferInfo = { buffer, offset, range };
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.pNext = nullptr;
+	write.dstSet = set;
+	write.dstBinding = binding;
+	write.dstArrayElement = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = Bindings.at(binding);
+	write.pImageInfo = nullptr;
+	write.pBufferInfo = &bufferInfo;
+	write.pTexelBufferView = nullptr;
+	Dispatch.vkUpdateDescriptorSets(Dispatch.device, 1, &write, 0, nullptr);
+}
+
+void GraphicsPipeline::WriteImage(VkDescriptorSet set, uint32_t binding, VkImageView view, VkSampler sampler, VkImageLayout layout) const {
+	VkDescriptorImageInfo imageInfo = { sampler, view, layout };
+
+	VkWriteDescriptorSet write = {};
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.pNext = nullptr;
+	write.dstSet = set;
+	write.dstBinding = binding;
+	write.dstArrayElement = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = Bindings.at(binding);
+	write.pImageInfo = &imageInfo;
+	write.pBufferInfo = nullptr;
+	write.pTexelBufferView = nullptr;
+	Dispatch.vkUpdateDescriptorSets(Dispatch.device, 1, &write, 0, nullptr);
+}
+
+void GraphicsPipeline::CmdBind(VkCommandBuffer commandBuffer, VkDescriptorSet set) const {
+	Dispatch.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipeline);
+	if (set != VK_NULL_HANDLE) {
+		Dispatch.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, PipelineLayout, 0, 1, &set, 0, nullptr);
+	}
+}
+
+void GraphicsPipeline::CmdPushConstants(VkCommandBuffer commandBuffer, const void* data, uint32_t size) const {
+	Dispatch.vkCmdPushConstants(commandBuffer, PipelineLayout, Stages, 0, size, data);
+}
+
+VkPipeline GraphicsPipeline::GetPipeline() const {
+	return Pipeline;
+}
+
+VkPipelineLayout GraphicsPipeline::GetLayout() const {
+	return PipelineLayout;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "VulkanDispatch.h"
+#include "ShaderCompiler.h"
+#include <cstdint>
+#include <vector>
+
+// Device local 2D image with a view of all its layers and mip levels.
+// Transient attachments go into lazily allocated memory where the device has it.
+struct GpuImage {
+	VkImage handle;
+	VkImageView view;
+	VkDeviceMemory memory;
+	VkFormat format;
+	VkImageAspectFlags aspect;
+	uint32_t layers;
+	uint32_t mipLevels;
+	bool lazilyAllocated;
+
+	GpuImage() :
+		handle(VK_NULL_HANDLE),
+		view(VK_NULL_HANDLE),
+		memory(VK_NULL_HANDLE),
+		format(VK_FORMAT_UNDEFINED),
+		aspect(0),
+		layers(0),
+		mipLevels(0),
+		lazilyAllocated(false) {
+	}
+};
+
+// Depth formats get a depth aspect, everything else a color aspect. With more than one layer the view is a 2D array view.
+bool CreateGpuImage(const DeviceContext& device, VkFormat format, VkExtent2D extent, uint32_t layers, uint32_t mipLevels, VkSampleCountFlagBits samples,
+	VkImageUsageFlags usage, GpuImage& image);
+void DestroyGpuImage(const DeviceContext& device, GpuImage& image);
+// Additional 2D view of a single layer and mip range; owned by the caller
+bool CreateGpuImageView(const DeviceContext& device, const GpuImage& image, uint32_t layer, uint32_t baseMipLevel, uint32_t mipLevels, VkImageView& view);
+
+// Fixed function state of a GraphicsPipeline. Viewport and scissor are always dynamic.
+struct GraphicsPipelineState {
+	VkRenderPass renderPass;
+	uint32_t subpass;
+	VkPrimitiveTopology topology;
+	VkCullModeFlags cullMode;
+	VkSampleCountFlagBits samples;
+	uint32_t colorAttachmentCount;		// 0 for depth only passes
+	bool blend;							// Alpha "over" blending of every color attachment
+	bool colorWrite;					// False leaves the color attachments untouched, e.g. in depth pre-passes
+	bool depthTest;
+	bool depthWrite;
+	VkCompareOp depthCompare;			// Default expects reversed depth (near at 1, far at 0)
+	bool depthBias;						// Set with vkCmdSetDepthBias
+	std::vector<VkVertexInputBindingDescription> vertexBindings;
+	std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+	std::vector<VkSpecializationMapEntry> specializationEntries;		// Same constants for every stage
+	std::vector<uint8_t> specializationData;
+
+	GraphicsPipelineState() :
+		renderPass(VK_NULL_HANDLE),
+		subpass(0),
+		topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST),
+		cullMode(VK_CULL_MODE_NONE),
+		samples(VK_SAMPLE_COUNT_1_BIT),
+		colorAttachmentCount(1),
+		blend(false),
+		colorWrite(true),
+		depthTest(false),
+		depthWrite(false),
+		depthCompare(VK_COMPARE_OP_GREATER_OR_EQUAL),
+		depthBias(false),
+		vertexBindings(),
+		vertexAttributes(),
+		specializationEntries(),
+		specializationData() {
+	}
+};
+
+// Graphics counterpart of ComputePipeline: vertex and (optional) fragment shader with all resources in descriptor
+// set 0, one binding per entry of bindings, visible to both stages (input attachments only to the fragment shader),
+// and optional push constants shared by both.
+class GraphicsPipeline {
+public:
+	// Context's dispatch table must outlive the pipeline
+	explicit GraphicsPipeline(const DeviceContext& device);
+	~GraphicsPipeline();
+
+	GraphicsPipeline(const GraphicsPipeline&) = delete;
+	GraphicsPipeline& operator=(const GraphicsPipeline&) = delete;
+
+	// Without a fragment shader only depth is written. Up to maxSets descriptor sets can be allocated afterwards.
+	bool Create(const char* vertexSource, const char* fragmentSource, const char* name, const std::vector<VkDescriptorType>& bindings,
+		uint32_t pushConstantSize, uint32_t maxSets, const GraphicsPipelineState& state);
+	void Destroy();
+
+	bool AllocateDescriptorSet(VkDescriptorSet& set);
+	// Sets must not be in use by the GPU while they are written
+	void WriteBuffer(VkDescriptorSet set, uint32_t binding, VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE) const;
+	void WriteImage(VkDescriptorSet set, uint32_t binding, VkImageView view, VkSampler sampler, VkImageLayout layout) const;
+
+	// Set may be VK_NULL_HANDLE for pipelines without bindings
+	void CmdBind(VkCommandBuffer commandBuffer, VkDescriptorSet set) const;
+	void CmdPushConstants(VkCommandBuffer commandBuffer, const void* data, uint32_t size) const;
+
+	VkPipeline GetPipeline() const;
+	VkPipelineLayout GetLayout() const;
+
+private:
+	DeviceContext Device;
+	const DeviceDispatchTable& Dispatch;
+	ShaderCompiler Compiler;
+
+	std::vector<VkDescriptorType> Bindings;
+	VkShaderStageFlags Stages;
+	VkDescriptorSetLayout SetLayout;
+	VkDescriptorPool DescriptorPool;
+	VkPipelineLayout PipelineLayout;
+	VkPipeline Pipeline;
+};
@@ -0,0 +1,134 @@
+#include "ImageDiff.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define IMAGE_DIFF_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+	// RGB to YIQ, and the weights of the three channels in the distance
+	const float YR = 0.29889531f, YG = 0.58662247f, YB = 0.11448223f;
+	const float IR = 0.59597799f, IG = -0.27417610f, IB = -0.32180189f;
+	const float QR = 0.21147017f, QG = -0.52261711f, QB = 0.31114694f;
+	const float YWeight = 0.5053f, IWeight = 0.299f, QWeight = 0.1957f;
+
+	// Distance between black and white, used to normalize into 0 to 1
+	const float MaxDelta = 35215.0f;
+
+	float ColorDelta(const uint8_t* expected, const uint8_t* actual) {
+		const float r = static_cast<float>(expected[0]) - actual[0];
+		const float g = static_cast<float>(expected[1]) - actual[1];
+		const float b = static_cast<float>(expected[2]) - actual[2];
+		const float y = r * YR + g * YG + b * YB;
+		const float i = r * IR + g * IG + b * IB;
+		const float q = r * QR + g * QG + b * QB;
+		return YWeight * y * y + IWeight * i * i + QWeight * q * q;
+	}
+
+	float DeltaLimit(const ImageDiffTolerance& tolerance) {
+		const float threshold = static_cast<float>(std::min(std::max(tolerance.threshold, 0.0), 1.0));
+		return MaxDelta * threshold * threshold;
+	}
+
+#if defined(IMAGE_DIFF_SSE2)
+	inline __m128 Channel(__m128i pixels, int shift) {
+		return _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, shift), _mm_set1_epi32(0xFF)));
+	}
+
+	inline __m128 Dot(__m128 r, __m128 g, __m128 b, float wr, float wg, float wb) {
+		return _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(wr)), _mm_mul_ps(g, _mm_set1_ps(wg))), _mm_mul_ps(b, _mm_set1_ps(wb)));
+	}
+
+	// Handles whole groups of four pixels, returns how many pixels it processed
+	size_t CompareSse2(const uint8_t* expected, const uint8_t* actual, size_t pixelCount, float limit, size_t& differentPixels, float& maxDelta) {
+		static const int bitCount[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+
+		const __m128 limits = _mm_set1_ps(limit);
+		__m128 maxima = _mm_setzero_ps();
+		size_t different = 0;
+		size_t i = 0;
+		for (; i + 4 <= pixelCount; i += 4) {
+			const __m128i e = _mm_loadu_si128(reinterpret_cast<const __m128i*>(expected + 4 * i));
+			const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(actual + 4 * i));
+
+			const __m128 r = _mm_sub_ps(Channel(e, 0), Channel(a, 0));
+			const __m128 g = _mm_sub_ps(Channel(e, 8), Channel(a, 8));
+			const __m128 b = _mm_sub_ps(Channel(e, 16), Channel(a, 16));
+
+			const __m128 y = Dot(r, g, b, YR, YG, YB);
+			const __m128 iv = Dot(r, g, b, IR, IG, IB);
+			const __m128 q = Dot(r, g, b, QR, QG, QB);
+			const __m128 delta = Dot(_mm_mul_ps(y, y), _mm_mul_ps(iv, iv), _mm_mul_ps(q, q), YWeight, IWeight, QWeight);
+
+			different += bitCount[_mm_movemask_ps(_mm_cmpgt_ps(delta, limits))];
+			maxima = _mm_max_ps(maxima, delta);
+		}
+
+		float lanes[4];
+		_mm_storeu_ps(lanes, maxima);
+		maxDelta = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+		differentPixels = different;
+		return i;
+	}
+#endif
+}
+
+bool ImageDiffResult::Passed(const ImageDiffTolerance& tolerance) const {
+	if (totalPixels == 0) {
+		return false;
+	}
+	return static_cast<double>(differentPixels) <= tolerance.maxDifferentFraction * static_cast<double>(totalPixels);
+}
+
+ImageDiffResult CompareImages(const std::vector<uint8_t>& expected, const std::vector<uint8_t>& actual, uint32_t width, uint32_t height, const ImageDiffTolerance& tolerance) {
+	ImageDiffResult result;
+	const size_t pixelCount = static_cast<size_t>(width) * height;
+	if ((expected.size() < pixelCount * 4) || (actual.size() < pixelCount * 4)) {
+		return result;
+	}
+	result.totalPixels = pixelCount;
+
+	const float limit = DeltaLimit(tolerance);
+	float maxDelta = 0.0f;
+	size_t i = 0;
+
+#if defined(IMAGE_DIFF_SSE2)
+	i = CompareSse2(expected.data(), actual.data(), pixelCount, limit, result.differentPixels, maxDelta);
+#endif
+
+	for (; i < pixelCount; ++i) {
+		const float delta = ColorDelta(&expected[4 * i], &actual[4 * i]);
+		if (delta > limit) {
+			result.differentPixels++;
+		}
+		maxDelta = std::max(maxDelta, delta);
+	}
+
+	result.maxDistance = std::sqrt(static_cast<double>(maxDelta) / MaxDelta);
+	return result;
+}
+
+void MakeDiffImage(const std::vector<uint8_t>& expected, const std::vector<uint8_t>& actual, uint32_t width, uint32_t height, const ImageDiffTolerance& tolerance, std::vector<uint8_t>& diff) {
+	const size_t pixelCount = static_cast<size_t>(width) * height;
+	diff.assign(pixelCount * 4, 255);
+	if ((expected.size() < pixelCount * 4) || (actual.size() < pixelCount * 4)) {
+		return;
+	}
+
+	const float limit = DeltaLimit(tolerance);
+	for (size_t i = 0; i < pixelCount; ++i) {
+		const uint8_t* pixel = &expected[4 * i];
+		uint8_t* output = &diff[4 * i];
+		if (ColorDelta(pixel, &actual[4 * i]) > limit) {
+			output[0] = 255;
+			output[1] = 0;
+			output[2] = 0;
+		}
+		else {
+			const float luma = pixel[0] * YR + pixel[1] * YG + pixel[2] * YB;
+			output[0] = output[1] = output[2] = static_cast<uint8_t>(255.0f - 0.1f * (255.0f - luma));
+		}
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct ImageDiffTolerance {
+	double threshold;				// Perceptual color distance a pixel may differ by, 0 (exact) to 1 (anything)
+	double maxDifferentFraction;	// Share of pixels allowed above the threshold, absorbs rasterizer differences on edges
+
+	ImageDiffTolerance() :
+		threshold(0.1),
+		maxDifferentFraction(0.001) {
+	}
+};
+
+struct ImageDiffResult {
+	size_t differentPixels;
+	size_t totalPixels;
+	double maxDistance;				// Largest perceptual distance found, on the same 0 to 1 scale as the threshold
+
+	ImageDiffResult() :
+		differentPixels(0),
+		totalPixels(0),
+		maxDistance(0.0) {
+	}
+
+	bool Passed(const ImageDiffTolerance& tolerance) const;
+};
+
+// Compares two RGBA8 images of the same size by the distance of their colors in YIQ space, weighted the way
+// the eye perceives brightness and hue changes. Alpha is ignored - rendered targets are opaque.
+// Uses SSE2 when the compiler targets it, four pixels per step.
+ImageDiffResult CompareImages(const std::vector<uint8_t>& expected, const std::vector<uint8_t>& actual, uint32_t width, uint32_t height, const ImageDiffTolerance& tolerance);
+
+// Visualizes a comparison: pixels above the threshold are red, the rest a faded grayscale of the expected image
+void MakeDiffImage(const std::vector<uint8_t>& expected, const std::vector<uint8_t>& actual, uint32_t width, uint32_t height, const ImageDiffTolerance& tolerance, std::vector<uint8_t>& diff);
@@ -0,0 +1,538 @@
+#include "Json.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+namespace {
+	const JsonValue NullValue;
+	const std::string EmptyString;
+
+	class JsonParser {
+	public:
+		JsonParser(const std::string& text) :
+			Text(text),
+			Position(0) {
+		}
+
+		bool ParseDocument(JsonValue& value, std::string& error) {
+			if (!ParseValue(value, 0)) {
+				error = Error;
+				return false;
+			}
+			SkipWhitespace();
+			if (Position != Text.size()) {
+				error = Fail("unexpected characters after the document");
+				return false;
+			}
+			return true;
+		}
+
+	private:
+		// Deeper documents are rejected instead of overflowing the stack
+		static const int MaxDepth = 64;
+
+		std::string Fail(const char* message) {
+			Error = std::string(message) + " at offset " + std::to_string(Position);
+			return Error;
+		}
+
+		void SkipWhitespace() {
+			while ((Position < Text.size()) && ((Text[Position] == ' ') || (Text[Position] == '\t') || (Text[Position] == '\n') || (Text[Position] == '\r'))) {
+				++Position;
+			}
+		}
+
+		bool Consume(const char* literal) {
+			size_t length = strlen(literal);
+			if (Text.compare(Position, length, literal) != 0) {
+				return false;
+			}
+			Position += length;
+			return true;
+		}
+
+		bool ParseValue(JsonValue& value, int depth) {
+			if (depth > MaxDepth) {
+				Fail("document nested too deeply");
+				return false;
+			}
+
+			SkipWhitespace();
+			if (Position >= Text.size()) {
+				Fail("unexpected end of document");
+				return false;
+			}
+
+			char c = Text[Position];
+			if (c == '{') {
+				return ParseObject(value, depth);
+			}
+			if (c == '[') {
+				return ParseArray(value, depth);
+			}
+			if (c == '"') {
+				std::string string;
+				if (!ParseString(string)) {
+					return false;
+				}
+				value = JsonValue(string);
+				return true;
+			}
+			if (Consume("true")) {
+				value = JsonValue(true);
+				return true;
+			}
+			if (Consume("false")) {
+				value = JsonValue(false);
+				return true;
+			}
+			if (Consume("null")) {
+				value = JsonValue();
+				return true;
+			}
+			return ParseNumber(value);
+		}
+
+		bool ParseNumber(JsonValue& value) {
+			const char* begin = Text.c_str() + Position;
+			char* end = nullptr;
+			double number = strtod(begin, &end);
+			if (end == begin) {
+				Fail("invalid value");
+				return false;
+			}
+			Position += end - begin;
+			value = JsonValue(number);
+			return true;
+		}
+
+		bool ParseString(std::string& string) {
+			++Position;
+			while (Position < Text.size()) {
+				char c = Text[Position++];
+				if (c == '"') {
+					return true;
+				}
+				if (c != '\\') {
+					string += c;
+					continue;
+				}
+				if (Position >= Text.size()) {
+					break;
+				}
+				char escaped = Text[Position++];
+				switch (escaped) {
+				case '"':
+				case '\\':
+				case '/':
+					string += escaped;
+					break;
+				case 'b':
+					string += '\b';
+					break;
+				case 'f':
+					string += '\f';
+					break;
+				case 'n':
+					string += '\n';
+					break;
+				case 'r':
+					string += '\r';
+					break;
+				case 't':
+					string += '\t';
+					break;
+				case 'u': {
+					if (Position + 4 > Text.size()) {
+						Fail("invalid unicode escape");
+						return false;
+					}
+					unsigned long codePoint = strtoul(Text.substr(Position, 4).c_str(), nullptr, 16);
+					Position += 4;
+					// Encode as UTF-8, surrogate pairs are not combined
+					if (codePoint < 0x80) {
+						string += static_cast<char>(codePoint);
+					}
+					else if (codePoint < 0x800) {
+						string += static_cast<char>(0xC0 | (codePoint >> 6));
+						string += static_cast<char>(0x80 | (codePoint & 0x3F));
+					}
+					else {
+						string += static_cast<char>(0xE0 | (codePoint >> 12));
+						string += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+						string += static_cast<char>(0x80 | (codePoint & 0x3F));
+					}
+					break;
+				}
+				default:
+					Fail("invalid escape sequence");
+					return false;
+				}
+			}
+			Fail("unterminated string");
+			return false;
+		}
+
+		bool ParseArray(JsonValue& value, int depth) {
+			++Position;
+			value = JsonValue::MakeArray();
+			SkipWhitespace();
+			if ((Position < Text.size()) && (Text[Position] == ']')) {
+				++Position;
+				return true;
+			}
+			for (;;) {
+				JsonValue element;
+				if (!ParseValue(element, depth + 1)) {
+					return false;
+				}
+				value.Append(element);
+
+				SkipWhitespace();
+				if (Position >= Text.size()) {
+					Fail("unterminated array");
+					return false;
+				}
+				char c = Text[Position++];
+				if (c == ']') {
+					return true;
+				}
+				if (c != ',') {
+					Fail("expected ',' or ']'");
+					return false;
+				}
+			}
+		}
+
+		bool ParseObject(JsonValue& value, int depth) {
+			++Position;
+			value = JsonValue::MakeObject();
+			SkipWhitespace();
+			if ((Position < Text.size()) && (Text[Position] == '}')) {
+				++Position;
+				return true;
+			}
+			for (;;) {
+				SkipWhitespace();
+				if ((Position >= Text.size()) || (Text[Position] != '"')) {
+					Fail("expected member name");
+					return false;
+				}
+				std::string key;
+				if (!ParseString(key)) {
+					return false;
+				}
+
+				SkipWhitespace();
+				if ((Position >= Text.size()) || (Text[Position] != ':')) {
+					Fail("expected ':'");
+					return false;
+				}
+				++Position;
+
+				JsonValue member;
+				if (!ParseValue(member, depth + 1)) {
+					return false;
+				}
+				value.Set(key, member);
+
+				SkipWhitespace();
+				if (Position >= Text.size()) {
+					Fail("unterminated object");
+					return false;
+				}
+				char c = Text[Position++];
+				if (c == '}') {
+					return true;
+				}
+				if (c != ',') {
+					Fail("expected ',' or '}'");
+					return false;
+				}
+			}
+		}
+
+		const std::string& Text;
+		size_t Position;
+		std::string Error;
+	};
+
+	void WriteString(std::string& output, const std::string& string) {
+		output += '"';
+		for (char c : string) {
+			switch (c) {
+			case '"':
+				output += "\\\"";
+				break;
+			case '\\':
+				output += "\\\\";
+				break;
+			case '\n':
+				output += "\\n";
+				break;
+			case '\r':
+				output += "\\r";
+				break;
+			case '\t':
+				output += "\\t";
+				break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20) {
+					char escaped[8];
+					snprintf(escaped, sizeof(escaped), "\\u%04x", static_cast<unsigned int>(c));
+					output += escaped;
+				}
+				else {
+					output += c;
+				}
+			}
+		}
+		output += '"';
+	}
+
+	void WriteIndentation(std::string& output, int indentation, int depth) {
+		if (indentation > 0) {
+			output += '\n';
+			output.append(static_cast<size_t>(indentation * depth), ' ');
+		}
+	}
+}
+
+JsonValue::JsonValue() :
+	ValueType(Type::Null),
+	Bool(false),
+	Number(0.0) {
+}
+
+JsonValue::JsonValue(bool value) :
+	ValueType(Type::Bool),
+	Bool(value),
+	Number(0.0) {
+}
+
+JsonValue::JsonValue(double value) :
+	ValueType(Type::Number),
+	Bool(false),
+	Number(value) {
+}
+
+JsonValue::JsonValue(int value) :
+	ValueType(Type::Number),
+	Bool(false),
+	Number(static_cast<double>(value)) {
+}
+
+JsonValue::JsonValue(const char* value) :
+	ValueType(Type::String),
+	Bool(false),
+	Number(0.0),
+	String(value) {
+}
+
+JsonValue::JsonValue(const std::string& value) :
+	ValueType(Type::String),
+	Bool(false),
+	Number(0.0),
+	String(value) {
+}
+
+JsonValue JsonValue::MakeArray() {
+	JsonValue value;
+	value.ValueType = Type::Array;
+	return value;
+}
+
+JsonValue JsonValue::MakeObject() {
+	JsonValue value;
+	value.ValueType = Type::Object;
+	return value;
+}
+
+JsonValue::Type JsonValue::GetType() const {
+	return ValueType;
+}
+
+bool JsonValue::IsNull() const {
+	return ValueType == Type::Null;
+}
+
+bool JsonValue::IsNumber() const {
+	return ValueType == Type::Number;
+}
+
+bool JsonValue::IsString() const {
+	return ValueType == Type::String;
+}
+
+bool JsonValue::IsArray() const {
+	return ValueType == Type::Array;
+}
+
+bool JsonValue::IsObject() const {
+	return ValueType == Type::Object;
+}
+
+bool JsonValue::AsBool(bool defaultValue) const {
+	return (ValueType == Type::Bool) ? Bool : defaultValue;
+}
+
+double JsonValue::AsNumber(double defaultValue) const {
+	return (ValueType == Type::Number) ? Number : defaultValue;
+}
+
+const std::string& JsonValue::AsString() const {
+	return (ValueType == Type::String) ? String : EmptyString;
+}
+
+size_t JsonValue::Size() const {
+	if (ValueType == Type::Array) {
+		return Elements.size();
+	}
+	if (ValueType == Type::Object) {
+		return Members.size();
+	}
+	return 0;
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const {
+	if ((ValueType != Type::Array) || (index >= Elements.size())) {
+		return NullValue;
+	}
+	return Elements[index];
+}
+
+void JsonValue::Append(const JsonValue& value) {
+	if (ValueType != Type::Array) {
+		*this = MakeArray();
+	}
+	Elements.push_back(value);
+}
+
+bool JsonValue::Has(const std::string& key) const {
+	for (const Member& member : Members) {
+		if (member.first == key) {
+			return true;
+		}
+	}
+	return false;
+}
+
+const JsonValue& JsonValue::operator[](const std::string& key) const {
+	if (ValueType == Type::Object) {
+		for (const Member& member : Members) {
+			if (member.first == key) {
+				return member.second;
+			}
+		}
+	}
+	return NullValue;
+}
+
+JsonValue& JsonValue::Set(const std::string& key, const JsonValue& value) {
+	if (ValueType != Type::Object) {
+		*this = MakeObject();
+	}
+	for (Member& member : Members) {
+		if (member.first == key) {
+			member.second = value;
+			return member.second;
+		}
+	}
+	Members.push_back(Member(key, value));
+	return Members.back().second;
+}
+
+const std::vector<JsonValue::Member>& JsonValue::GetMembers() const {
+	return Members;
+}
+
+std::string JsonValue::Write(int indentation) const {
+	std::string output;
+	Write(output, indentation, 0);
+	if (indentation > 0) {
+		output += '\n';
+	}
+	return output;
+}
+
+void JsonValue::Write(std::string& output, int indentation, int depth) const {
+	switch (ValueType) {
+	case Type::Null:
+		output += "null";
+		break;
+	case Type::Bool:
+		output += Bool ? "true" : "false";
+		break;
+	case Type::Number: {
+		if (!std::isfinite(Number)) {
+			output += "null";
+			break;
+		}
+		char number[32];
+		snprintf(number, sizeof(number), "%.9g", Number);
+		output += number;
+		break;
+	}
+	case Type::String:
+		WriteString(output, String);
+		break;
+	case Type::Array:
+		output += '[';
+		for (size_t i = 0; i < Elements.size(); ++i) {
+			if (i > 0) {
+				output += ',';
+			}
+			WriteIndentation(output, indentation, depth + 1);
+			Elements[i].Write(output, indentation, depth + 1);
+		}
+		if (!Elements.empty()) {
+			WriteIndentation(output, indentation, depth);
+		}
+		output += ']';
+		break;
+	case Type::Object:
+		output += '{';
+		for (size_t i = 0; i < Members.size(); ++i) {
+			if (i > 0) {
+				output += ',';
+			}
+			WriteIndentation(output, indentation, depth + 1);
+			WriteString(output, Members[i].first);
+			output += (indentation > 0) ? ": " : ":";
+			Members[i].second.Write(output, indentation, depth + 1);
+		}
+		if (!Members.empty()) {
+			WriteIndentation(output, indentation, depth);
+		}
+		output += '}';
+		break;
+	}
+}
+
+bool JsonValue::Parse(const std::string& text, JsonValue& value, std::string& error) {
+	JsonParser parser(text);
+	return parser.ParseDocument(value, error);
+}
+
+bool JsonValue::ReadFile(const std::string& path, JsonValue& value, std::string& error) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		error = "could not open " + path;
+		return false;
+	}
+	std::stringstream contents;
+	contents << file.rdbuf();
+	return Parse(contents.str(), value, error);
+}
+
+bool JsonValue::WriteFile(const std::string& path) const {
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		return false;
+	}
+	file << Write(2);
+	return static_cast<bool>(file);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Minimal JSON document used for benchmark baselines and job files.
+// Object members keep their insertion order, so written files stay stable and diffable.
+class JsonValue {
+public:
+	enum class Type {
+		Null,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object
+	};
+
+	typedef std::pair<std::string, JsonValue> Member;
+
+	JsonValue();
+	JsonValue(bool value);
+	JsonValue(double value);
+	JsonValue(int value);
+	JsonValue(const char* value);
+	JsonValue(const std::string& value);
+
+	static JsonValue MakeArray();
+	static JsonValue MakeObject();
+
+	Type GetType() const;
+	bool IsNull() const;
+	bool IsNumber() const;
+	bool IsString() const;
+	bool IsArray() const;
+	bool IsObject() const;
+
+	// Return the default when the value has a different type
+	bool AsBool(bool defaultValue = false) const;
+	double AsNumber(double defaultValue = 0.0) const;
+	const std::string& AsString() const;
+
+	// Arrays
+	size_t Size() const;
+	const JsonValue& operator[](size_t index) const;
+	void Append(const JsonValue& value);
+
+	// Objects - missing members read as null
+	bool Has(const std::string& key) const;
+	const JsonValue& operator[](const std::string& key) const;
+	JsonValue& Set(const std::string& key, const JsonValue& value);
+	const std::vector<Member>& GetMembers() const;
+
+	std::string Write(int indentation = 0) const;
+	static bool Parse(const std::string& text, JsonValue& value, std::string& error);
+
+	static bool ReadFile(const std::string& path, JsonValue& value, std::string& error);
+	bool WriteFile(const std::string& path) const;
+
+private:
+	void Write(std::string& output, int indentation, int depth) const;
+
+	Type ValueType;
+	bool Bool;
+	double Number;
+	std::string String;
+	std::vector<JsonValue> Elements;
+	std::vector<Member> Members;
+};
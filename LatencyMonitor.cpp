@@ -0,0 +1,97 @@
+#include "LatencyMonitor.h"
+#include <algorithm>
+#include <iomanip>
+
+namespace {
+	const size_t TimelineHistory = 512;
+
+	double Milliseconds(FrameTimeline::TimePoint from, FrameTimeline::TimePoint to) {
+		return std::chrono::duration<double, std::milli>(to - from).count();
+	}
+}
+
+LatencyMonitor::LatencyMonitor() :
+	Current(),
+	History(TimelineHistory),
+	HistoryNext(0),
+	HistoryCount(0) {
+}
+
+void LatencyMonitor::MarkInput(FrameTimeline::TimePoint inputTime) {
+	// Several inputs may be folded into one frame, the oldest one waited the longest
+	if (!Current.hasInput || (inputTime < Current.input)) {
+		Current.input = inputTime;
+		Current.hasInput = true;
+	}
+}
+
+void LatencyMonitor::MarkAcquired() {
+	Current.acquired = std::chrono::steady_clock::now();
+}
+
+void LatencyMonitor::MarkStarted() {
+	Current.started = std::chrono::steady_clock::now();
+}
+
+void LatencyMonitor::MarkSubmitted() {
+	Current.submitted = std::chrono::steady_clock::now();
+}
+
+void LatencyMonitor::SetGpuTime(double milliseconds) {
+	Current.gpuMs = milliseconds;
+	Current.hasGpuTime = true;
+}
+
+void LatencyMonitor::MarkPresented() {
+	Current.presented = std::chrono::steady_clock::now();
+
+	History[HistoryNext] = Current;
+	HistoryNext = (HistoryNext + 1) % History.size();
+	HistoryCount = std::min(HistoryCount + 1, History.size());
+	Current = FrameTimeline();
+}
+
+double LatencyMonitor::GetInputToPresentMs(double percentile) const {
+	std::vector<double> latencies;
+	for (size_t i = 0; i < HistoryCount; ++i) {
+		if (History[i].hasInput) {
+			latencies.push_back(Milliseconds(History[i].input, History[i].presented));
+		}
+	}
+	return Percentile(latencies, percentile);
+}
+
+size_t LatencyMonitor::GetMeasuredFrameCount() const {
+	return HistoryCount;
+}
+
+void LatencyMonitor::Print(std::ostream& stream) const {
+	std::vector<double> startToSubmit;
+	std::vector<double> submitToPresent;
+	std::vector<double> gpu;
+	for (size_t i = 0; i < HistoryCount; ++i) {
+		const FrameTimeline& frame = History[i];
+		startToSubmit.push_back(Milliseconds(frame.started, frame.submitted));
+		submitToPresent.push_back(Milliseconds(frame.submitted, frame.presented));
+		if (frame.hasGpuTime) {
+			gpu.push_back(frame.gpuMs);
+		}
+	}
+
+	stream << std::fixed << std::setprecision(3)
+		<< "Frames measured: " << HistoryCount << std::endl
+		<< "Input to present [ms]  p50: " << GetInputToPresentMs(50.0) << "  p95: " << GetInputToPresentMs(95.0) << "  p99: " << GetInputToPresentMs(99.0) << std::endl
+		<< "Start to submit [ms]   p50: " << Percentile(startToSubmit, 50.0) << "  p99: " << Percentile(startToSubmit, 99.0) << std::endl
+		<< "Submit to present [ms] p50: " << Percentile(submitToPresent, 50.0) << "  p99: " << Percentile(submitToPresent, 99.0) << std::endl
+		<< "GPU [ms]               p50: " << Percentile(gpu, 50.0) << "  p99: " << Percentile(gpu, 99.0) << std::endl;
+}
+
+double LatencyMonitor::Percentile(std::vector<double> values, double percentile) {
+	if (values.empty()) {
+		return 0.0;
+	}
+	size_t index = static_cast<size_t>(percentile / 100.0 * static_cast<double>(values.size() - 1) + 0.5);
+	index = std::min(index, values.size() - 1);
+	std::nth_element(values.begin(), values.begin() + index, values.end());
+	return values[index];
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+// Timestamps of every stage a single frame goes through, from the input it reacts to until present
+struct FrameTimeline {
+	typedef std::chrono::steady_clock::time_point TimePoint;
+
+	TimePoint input;
+	TimePoint acquired;
+	TimePoint started;
+	TimePoint submitted;
+	TimePoint presented;
+	double gpuMs;
+	bool hasInput;
+	bool hasGpuTime;
+
+	FrameTimeline() :
+		input(),
+		acquired(),
+		started(),
+		submitted(),
+		presented(),
+		gpuMs(0.0),
+		hasInput(false),
+		hasGpuTime(false) {
+	}
+};
+
+// Collects frame timelines and reports input-to-present latency and per stage durations.
+// Tail latency matters more than the average, so percentiles are reported.
+class LatencyMonitor {
+public:
+	LatencyMonitor();
+
+	void MarkInput(FrameTimeline::TimePoint inputTime);
+	void MarkAcquired();
+	void MarkStarted();
+	void MarkSubmitted();
+	void MarkPresented();
+	void SetGpuTime(double milliseconds);
+
+	// Percentile in range [0, 100] of input-to-present latency in milliseconds, 0 when nothing was measured
+	double GetInputToPresentMs(double percentile) const;
+	size_t GetMeasuredFrameCount() const;
+	void Print(std::ostream& stream) const;
+
+private:
+	static double Percentile(std::vector<double> values, double percentile);
+
+	FrameTimeline Current;
+	std::vector<FrameTimeline> History;
+	size_t HistoryNext;
+	size_t HistoryCount;
+};
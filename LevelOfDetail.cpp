@@ -0,0 +1,265 @@
+#include "LevelOfDetail.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define LEVEL_OF_DETAIL_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+	const char* DrawVertexShader = R"(#version 450
+
+layout(push_constant) uniform Camera {
+	mat4 viewProjection;
+};
+
+layout(set = 0, binding = 0) readonly buffer Instances {
+	vec4 instances[];
+};
+
+layout(location = 0) in vec3 Position;
+
+layout(location = 0) out vec3 WorldPosition;
+
+void main() {
+	// Base instance of the level's draw is included in the instance index
+	const vec4 instance = instances[gl_InstanceIndex];
+	WorldPosition = instance.xyz + Position * instance.w;
+	gl_Position = viewProjection * vec4(WorldPosition, 1.0);
+}
+)";
+
+	const char* DrawFragmentShader = R"(#version 450
+
+layout(location = 0) in vec3 WorldPosition;
+
+layout(location = 0) out vec4 Color;
+
+const vec3 ToLight = normalize(vec3(0.4, 1.0, 0.3));
+
+void main() {
+	// Faceted, so simplification stays visible; y is down in the framebuffer, which makes this face the camera
+	const vec3 normal = normalize(cross(dFdy(WorldPosition), dFdx(WorldPosition)));
+	const float diffuse = max(dot(normal, ToLight), 0.0);
+	Color = vec4(vec3(0.55, 0.5, 0.45) * (0.3 + 0.7 * diffuse), 1.0);
+}
+)";
+
+	// Pixels per world unit at distance 1, for a camera extent.height pixels high
+	float ProjectionScale(const SceneCamera& camera, VkExtent2D extent) {
+		return static_cast<float>(extent.height) / (2.0f * std::tan(0.5f * camera.verticalFov));
+	}
+}
+
+LodRenderer::LodRenderer(const DeviceContext& device) :
+	Device(device),
+	Dispatch(*device.dispatch),
+	DrawPipeline(device),
+	Levels(),
+	BoundingRadius(0.0f),
+	MaxScreenError(1.0f),
+	PositionsX(),
+	PositionsY(),
+	PositionsZ(),
+	Scales(),
+	SelectedLevels(),
+	InstanceCount(0),
+	MaxInstances(0),
+	Vertices(),
+	Indices(),
+	DrawInstances(),
+	DrawSet(VK_NULL_HANDLE),
+	LevelFirstInstances(),
+	LevelInstanceCounts(),
+	ViewProjection() {
+}
+
+LodRenderer::~LodRenderer() {
+	Destroy();
+}
+
+bool LodRenderer::Create(const LodMesh& mesh, uint32_t maxInstances, VkRenderPass renderPass, VkSampleCountFlagBits samples) {
+	Destroy();
+	if (mesh.levels.empty() || mesh.positions.empty()) {
+		std::cout << "LEVEL OF DETAIL MESH HAS NO LEVELS " << std::endl;
+		return false;
+	}
+	Levels = mesh.levels;
+	MaxInstances = std::max<uint32_t>(maxInstances, 1);
+	LevelFirstInstances.assign(Levels.size(), 0);
+	LevelInstanceCounts.assign(Levels.size(), 0);
+
+	BoundingRadius = 0.0f;
+	for (size_t i = 0; i < mesh.positions.size(); i += 3) {
+		const float* p = &mesh.positions[i];
+		BoundingRadius = std::max(BoundingRadius, std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]));
+	}
+
+	const VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	if (!CreateGpuBuffer(Device, mesh.positions.size() * sizeof(float), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, hostVisible, Vertices)
+		|| !CreateGpuBuffer(Device, mesh.indices.size() * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, hostVisible, Indices)
+		|| !CreateGpuBuffer(Device, MaxInstances * sizeof(LodInstance), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, DrawInstances)) {
+		return false;
+	}
+	memcpy(Vertices.mapped, mesh.positions.data(), mesh.positions.size() * sizeof(float));
+	memcpy(Indices.mapped, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+
+	GraphicsPipelineState state;
+	state.renderPass = renderPass;
+	state.samples = samples;
+	state.cullMode = VK_CULL_MODE_BACK_BIT;
+	state.depthTest = true;
+	state.depthWrite = true;
+	state.vertexBindings.push_back({ 0, 3 * sizeof(float), VK_VERTEX_INPUT_RATE_VERTEX });
+	state.vertexAttributes.push_back({ 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 });
+
+	if (!DrawPipeline.Create(DrawVertexShader, DrawFragmentShader, "lod_draw", { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER }, sizeof(ViewProjection), 1, state)
+		|| !DrawPipeline.AllocateDescriptorSet(DrawSet)) {
+		return false;
+	}
+	DrawPipeline.WriteBuffer(DrawSet, 0, DrawInstances.handle);
+	return true;
+}
+
+void LodRenderer::Destroy() {
+	if (Dispatch.device == VK_NULL_HANDLE) {
+		return;
+	}
+
+	DrawPipeline.Destroy();
+	DrawSet = VK_NULL_HANDLE;
+	DestroyGpuBuffer(Device, Vertices);
+	DestroyGpuBuffer(Device, Indices);
+	DestroyGpuBuffer(Device, DrawInstances);
+	std::fill(LevelInstanceCounts.begin(), LevelInstanceCounts.end(), 0);
+}
+
+bool LodRenderer::SetInstances(const std::vector<LodInstance>& instances) {
+	if (instances.size() > MaxInstances) {
+		std::cout << "LEVEL OF DETAIL RENDERER WAS CREATED FOR AT MOST " << MaxInstances << " INSTANCES " << std::endl;
+		return false;
+	}
+	InstanceCount = static_cast<uint32_t>(instances.size());
+
+	// Padding lanes sit at the origin with no size and are never drawn
+	const size_t padded = (instances.size() + 3) & ~static_cast<size_t>(3);
+	PositionsX.assign(padded, 0.0f);
+	PositionsY.assign(padded, 0.0f);
+	PositionsZ.assign(padded, 0.0f);
+	Scales.assign(padded, 0.0f);
+	SelectedLevels.assign(padded, 0);
+	for (size_t i = 0; i < instances.size(); ++i) {
+		PositionsX[i] = instances[i].position[0];
+		PositionsY[i] = instances[i].position[1];
+		PositionsZ[i] = instances[i].position[2];
+		Scales[i] = instances[i].scale;
+	}
+	return true;
+}
+
+void LodRenderer::SetMaxScreenError(float pixels) {
+	MaxScreenError = std::max(pixels, 0.0f);
+}
+
+void LodRenderer::SelectLevels(const SceneCamera& camera, VkExtent2D extent) {
+	const float aspect = static_cast<float>(extent.width) / static_cast<float>(std::max<uint32_t>(extent.height, 1));
+	GetCameraViewProjection(camera, aspect, ViewProjection);
+
+	// Level i is fine while error_i * scale * projectionScale / distance <= maxScreenError; errors only grow with i,
+	// so the level picked is the number of coarser levels that are still fine
+	const uint32_t levelCount = static_cast<uint32_t>(Levels.size());
+	const float projectionScale = ProjectionScale(camera, extent);
+	size_t i = 0;
+
+#if defined(LEVEL_OF_DETAIL_SSE2)
+	const __m128 cameraX = _mm_set1_ps(camera.position[0]);
+	const __m128 cameraY = _mm_set1_ps(camera.position[1]);
+	const __m128 cameraZ = _mm_set1_ps(camera.position[2]);
+	const __m128 radius = _mm_set1_ps(BoundingRadius);
+	const __m128 nearest = _mm_set1_ps(camera.nearPlane);
+	const __m128 maxError = _mm_set1_ps(MaxScreenError);
+	const __m128 scale = _mm_set1_ps(projectionScale);
+	for (; i < PositionsX.size(); i += 4) {
+		const __m128 dx = _mm_sub_ps(_mm_loadu_ps(&PositionsX[i]), cameraX);
+		const __m128 dy = _mm_sub_ps(_mm_loadu_ps(&PositionsY[i]), cameraY);
+		const __m128 dz = _mm_sub_ps(_mm_loadu_ps(&PositionsZ[i]), cameraZ);
+		const __m128 scales = _mm_loadu_ps(&Scales[i]);
+		const __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz)));
+		const __m128 surface = _mm_max_ps(_mm_sub_ps(distance, _mm_mul_ps(radius, scales)), nearest);
+		const __m128 pixelsPerError = _mm_div_ps(_mm_mul_ps(scales, scale), surface);
+
+		// All ones lanes are -1, so subtracting the masks counts the levels which are fine
+		__m128i level = _mm_setzero_si128();
+		for (uint32_t l = 1; l < levelCount; ++l) {
+			const __m128 pixels = _mm_mul_ps(_mm_set1_ps(Levels[l].error), pixelsPerError);
+			level = _mm_sub_epi32(level, _mm_castps_si128(_mm_cmple_ps(pixels, maxError)));
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&SelectedLevels[i]), level);
+	}
+#endif
+
+	for (; i < PositionsX.size(); ++i) {
+		const float dx = PositionsX[i] - camera.position[0];
+		const float dy = PositionsY[i] - camera.position[1];
+		const float dz = PositionsZ[i] - camera.position[2];
+		const float surface = std::max(std::sqrt(dx * dx + dy * dy + dz * dz) - BoundingRadius * Scales[i], camera.nearPlane);
+		const float pixelsPerError = Scales[i] * projectionScale / surface;
+		uint32_t level = 0;
+		for (uint32_t l = 1; l < levelCount; ++l) {
+			level += (Levels[l].error * pixelsPerError <= MaxScreenError) ? 1 : 0;
+		}
+		SelectedLevels[i] = level;
+	}
+
+	// Counting sort by level straight into the draw buffer
+	std::fill(LevelInstanceCounts.begin(), LevelInstanceCounts.end(), 0);
+	for (uint32_t instance = 0; instance < InstanceCount; ++instance) {
+		LevelInstanceCounts[SelectedLevels[instance]]++;
+	}
+	uint32_t first = 0;
+	for (uint32_t l = 0; l < levelCount; ++l) {
+		LevelFirstInstances[l] = first;
+		first += LevelInstanceCounts[l];
+	}
+	std::vector<uint32_t> next(LevelFirstInstances);
+	LodInstance* drawInstances = static_cast<LodInstance*>(DrawInstances.mapped);
+	for (uint32_t instance = 0; instance < InstanceCount; ++instance) {
+		LodInstance& drawInstance = drawInstances[next[SelectedLevels[instance]]++];
+		drawInstance.position[0] = PositionsX[instance];
+		drawInstance.position[1] = PositionsY[instance];
+		drawInstance.position[2] = PositionsZ[instance];
+		drawInstance.scale = Scales[instance];
+	}
+}
+
+void LodRenderer::CmdDraw(VkCommandBuffer commandBuffer, const OffscreenFrame& /*frame*/) const {
+	VkDeviceSize offset = 0;
+	DrawPipeline.CmdBind(commandBuffer, DrawSet);
+	DrawPipeline.CmdPushConstants(commandBuffer, ViewProjection, sizeof(ViewProjection));
+	Dispatch.vkCmdBindVertexBuffers(commandBuffer, 0, 1, &Vertices.handle, &offset);
+	Dispatch.vkCmdBindIndexBuffer(commandBuffer, Indices.handle, 0, VK_INDEX_TYPE_UINT32);
+	for (uint32_t l = 0; l < static_cast<uint32_t>(Levels.size()); ++l) {
+		if (LevelInstanceCounts[l] > 0) {
+			Dispatch.vkCmdDrawIndexed(commandBuffer, Levels[l].indexCount, LevelInstanceCounts[l], Levels[l].firstIndex, 0, LevelFirstInstances[l]);
+		}
+	}
+}
+
+uint64_t LodRenderer::GetTriangleCount() const {
+	uint64_t triangles = 0;
+	for (size_t l = 0; l < Levels.size(); ++l) {
+		triangles += static_cast<uint64_t>(LevelInstanceCounts[l]) * (Levels[l].indexCount / 3);
+	}
+	return triangles;
+}
+
+uint32_t LodRenderer::GetLevelInstanceCount(uint32_t level) const {
+	return (level < LevelInstanceCounts.size()) ? LevelInstanceCounts[level] : 0;
+}
+
+uint32_t LodRenderer::GetLevelCount() const {
+	return static_cast<uint32_t>(Levels.size());
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "ComputePipeline.h"
+#include "GraphicsPipeline.h"
+#include "MeshSimplification.h"
+#include "OffscreenRenderer.h"
+#include "SceneCamera.h"
+#include <cstdint>
+#include <vector>
+
+// Uniformly scaled copy of the mesh in world space
+struct LodInstance {
+	float position[3];
+	float scale;
+
+	LodInstance() :
+		position(),
+		scale(1.0f) {
+	}
+};
+
+// Many instances of one mesh, each drawn at the coarsest level of detail whose error projects to at most
+// maxScreenError pixels. The error of a level is taken at the nearest point of the instance's bounding sphere, so it
+// never underestimates. Selection runs on the CPU over the instances' positions kept as structure of arrays, four
+// instances per step with SSE2 where the compiler targets it; the selected instances are written grouped by level and
+// every level is a single instanced indexed draw.
+// Drawn in the first subpass of render passes compatible with the given one.
+class LodRenderer : public OffscreenDrawable {
+public:
+	// Context's dispatch table must outlive the renderer
+	explicit LodRenderer(const DeviceContext& device);
+	~LodRenderer();
+
+	LodRenderer(const LodRenderer&) = delete;
+	LodRenderer& operator=(const LodRenderer&) = delete;
+
+	bool Create(const LodMesh& mesh, uint32_t maxInstances, VkRenderPass renderPass, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+	void Destroy();
+
+	bool SetInstances(const std::vector<LodInstance>& instances);
+	// 0 always draws the original mesh
+	void SetMaxScreenError(float pixels);
+
+	// Once per frame, before recording. Writes straight into mapped memory, so no frame using the previous selection
+	// may still be executing.
+	void SelectLevels(const SceneCamera& camera, VkExtent2D extent);
+	void CmdDraw(VkCommandBuffer commandBuffer, const OffscreenFrame& frame) const override;
+
+	// Of the last selection
+	uint64_t GetTriangleCount() const;
+	uint32_t GetLevelInstanceCount(uint32_t level) const;
+	uint32_t GetLevelCount() const;
+
+private:
+	DeviceContext Device;
+	const DeviceDispatchTable& Dispatch;
+	GraphicsPipeline DrawPipeline;
+
+	std::vector<LodLevel> Levels;
+	float BoundingRadius;						// Around the mesh's origin
+	float MaxScreenError;
+
+	// Structure of arrays, padded to a multiple of four
+	std::vector<float> PositionsX;
+	std::vector<float> PositionsY;
+	std::vector<float> PositionsZ;
+	std::vector<float> Scales;
+	std::vector<uint32_t> SelectedLevels;
+	uint32_t InstanceCount;
+	uint32_t MaxInstances;
+
+	GpuBuffer Vertices;
+	GpuBuffer Indices;
+	GpuBuffer DrawInstances;					// Host visible, grouped by level
+	VkDescriptorSet DrawSet;
+	std::vector<uint32_t> LevelFirstInstances;
+	std::vector<uint32_t> LevelInstanceCounts;
+	float ViewProjection[16];
+};
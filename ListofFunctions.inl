@@ -32,21 +32,29 @@ VK_INSTANCE_LEVEL_FUNCTION( vkCreateDevice )
 VK_INSTANCE_LEVEL_FUNCTION( vkGetDeviceProcAddr )
 VK_INSTANCE_LEVEL_FUNCTION( vkEnumerateDeviceExtensionProperties )
 VK_INSTANCE_LEVEL_FUNCTION( vkDestroyInstance )
+VK_INSTANCE_LEVEL_FUNCTION( vkGetPhysicalDeviceMemoryProperties )
+VK_INSTANCE_LEVEL_FUNCTION( vkGetPhysicalDeviceFormatProperties )
 
-//SWAPCHAIN EXTENSION FUNCTIONS
-VK_INSTANCE_LEVEL_FUNCTION( vkDestroySurfaceKHR )
-VK_INSTANCE_LEVEL_FUNCTION( vkGetPhysicalDeviceSurfaceSupportKHR )
-VK_INSTANCE_LEVEL_FUNCTION( vkGetPhysicalDeviceSurfaceCapabilitiesKHR )
-VK_INSTANCE_LEVEL_FUNCTION( vkGetPhysicalDeviceSurfaceFormatsKHR )
-VK_INSTANCE_LEVEL_FUNCTION( vkGetPhysicalDeviceSurfacePresentModesKHR )
+#undef VK_INSTANCE_LEVEL_FUNCTION
+
+#if !defined(VK_INSTANCE_LEVEL_FUNCTION_FROM_EXTENSION)
+#define VK_INSTANCE_LEVEL_FUNCTION_FROM_EXTENSION( fun, extension )
+#endif
+
+//SWAPCHAIN EXTENSION FUNCTIONS (not enabled when running without a window)
+VK_INSTANCE_LEVEL_FUNCTION_FROM_EXTENSION( vkDestroySurfaceKHR, VK_KHR_SURFACE_EXTENSION_NAME )
+VK_INSTANCE_LEVEL_FUNCTION_FROM_EXTENSION( vkGetPhysicalDeviceSurfaceSupportKHR, VK_KHR_SURFACE_EXTENSION_NAME )
+VK_INSTANCE_LEVEL_FUNCTION_FROM_EXTENSION( vkGetPhysicalDeviceSurfaceCapabilitiesKHR, VK_KHR_SURFACE_EXTENSION_NAME )
+VK_INSTANCE_LEVEL_FUNCTION_FROM_EXTENSION( vkGetPhysicalDeviceSurfaceFormatsKHR, VK_KHR_SURFACE_EXTENSION_NAME )
+VK_INSTANCE_LEVEL_FUNCTION_FROM_EXTENSION( vkGetPhysicalDeviceSurfacePresentModesKHR, VK_KHR_SURFACE_EXTENSION_NAME )
 
 #if defined(VK_USE_PLATFORM_WIN32_KHR)
-VK_INSTANCE_LEVEL_FUNCTION( vkCreateWin32SurfaceKHR )
+VK_INSTANCE_LEVEL_FUNCTION_FROM_EXTENSION( vkCreateWin32SurfaceKHR, VK_KHR_WIN32_SURFACE_EXTENSION_NAME )
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
-VK_INSTANCE_LEVEL_FUNCTION( vkCreateXcbSurfaceKHR )
+VK_INSTANCE_LEVEL_FUNCTION_FROM_EXTENSION( vkCreateXcbSurfaceKHR, VK_KHR_XCB_SURFACE_EXTENSION_NAME )
 #endif
 
-#undef VK_INSTANCE_LEVEL_FUNCTION
+#undef VK_INSTANCE_LEVEL_FUNCTION_FROM_EXTENSION
 
 #if !defined(VK_DEVICE_LEVEL_FUNCTION)
 #define VK_DEVICE_LEVEL_FUNCTION( fun )
@@ -56,8 +64,10 @@ VK_DEVICE_LEVEL_FUNCTION( vkGetDeviceQueue )
 VK_DEVICE_LEVEL_FUNCTION( vkDestroyDevice )
 VK_DEVICE_LEVEL_FUNCTION( vkDeviceWaitIdle )
 VK_DEVICE_LEVEL_FUNCTION( vkQueueSubmit )
+VK_DEVICE_LEVEL_FUNCTION( vkQueueWaitIdle )
 VK_DEVICE_LEVEL_FUNCTION( vkCreateCommandPool )
 VK_DEVICE_LEVEL_FUNCTION( vkAllocateCommandBuffers )
+VK_DEVICE_LEVEL_FUNCTION( vkResetCommandPool )
 VK_DEVICE_LEVEL_FUNCTION( vkBeginCommandBuffer )
 VK_DEVICE_LEVEL_FUNCTION( vkCmdPipelineBarrier )
 VK_DEVICE_LEVEL_FUNCTION( vkCmdClearColorImage )
@@ -65,28 +75,107 @@ VK_DEVICE_LEVEL_FUNCTION( vkEndCommandBuffer )
 VK_DEVICE_LEVEL_FUNCTION( vkFreeCommandBuffers )
 VK_DEVICE_LEVEL_FUNCTION( vkDestroyCommandPool )
 VK_DEVICE_LEVEL_FUNCTION( vkDestroySemaphore )
-
-//SwapChain extension function
-VK_DEVICE_LEVEL_FUNCTION( vkCreateSwapchainKHR )
-VK_DEVICE_LEVEL_FUNCTION( vkGetSwapchainImagesKHR )
-VK_DEVICE_LEVEL_FUNCTION( vkAcquireNextImageKHR )
-VK_DEVICE_LEVEL_FUNCTION( vkQueuePresentKHR )
 VK_DEVICE_LEVEL_FUNCTION( vkCreateSemaphore )
-VK_DEVICE_LEVEL_FUNCTION( vkDestroySwapchainKHR )
 
 VK_DEVICE_LEVEL_FUNCTION( vkCreateRenderPass )
+VK_DEVICE_LEVEL_FUNCTION( vkCreateShaderModule )
 VK_DEVICE_LEVEL_FUNCTION( vkCreateImageView )
 VK_DEVICE_LEVEL_FUNCTION( vkCreateFramebuffer )
 VK_DEVICE_LEVEL_FUNCTION( vkCreatePipelineLayout )
 VK_DEVICE_LEVEL_FUNCTION( vkCreateGraphicsPipelines )
+VK_DEVICE_LEVEL_FUNCTION( vkCreatePipelineCache )
+VK_DEVICE_LEVEL_FUNCTION( vkDestroyPipelineCache )
+VK_DEVICE_LEVEL_FUNCTION( vkGetPipelineCacheData )
 VK_DEVICE_LEVEL_FUNCTION( vkCmdBeginRenderPass )
 VK_DEVICE_LEVEL_FUNCTION( vkCmdBindPipeline )
 VK_DEVICE_LEVEL_FUNCTION( vkCmdDraw )
+VK_DEVICE_LEVEL_FUNCTION( vkCmdDrawIndirect )
 VK_DEVICE_LEVEL_FUNCTION( vkDestroyShaderModule )
 VK_DEVICE_LEVEL_FUNCTION( vkDestroyPipelineLayout )
 VK_DEVICE_LEVEL_FUNCTION( vkDestroyPipeline )
 VK_DEVICE_LEVEL_FUNCTION( vkDestroyFramebuffer )
 VK_DEVICE_LEVEL_FUNCTION( vkDestroyImageView )
 VK_DEVICE_LEVEL_FUNCTION( vkDestroyRenderPass )
+VK_DEVICE_LEVEL_FUNCTION( vkCmdEndRenderPass )
+VK_DEVICE_LEVEL_FUNCTION( vkCmdNextSubpass )
+VK_DEVICE_LEVEL_FUNCTION( vkCmdExecuteCommands )
+VK_DEVICE_LEVEL_FUNCTION( vkCmdSetViewport )
+VK_DEVICE_LEVEL_FUNCTION( vkCmdSetScissor )
+VK_DEVICE_LEVEL_FUNCTION( vkCmdSetDepthBias )
+VK_DEVICE_LEVEL_FUNCTION( vkCmdBindVertexBuffers )
+VK_DEVICE_LEVEL_FUNCTION( vkCmdBindIndexBuffer )
+VK_DEVICE_LEVEL_FUNCTION( vkCmdDrawIndexed )
+VK_DEVICE_LEVEL_FUNCTION( vkCmdPushConstants )
+
+//Offscreen images
+VK_DEVICE_LEVEL_FUNCTION( vkCreateImage )
+VK_DEVICE_LEVEL_FUNCTION( vkDestroyImage )
+VK_DEVICE_LEVEL_FUNCTION( vkGetImageMemoryRequirements )
+VK_DEVICE_LEVEL_FUNCTION( vkAllocateMemory )
+VK_DEVICE_LEVEL_FUNCTION( vkFreeMemory )
+VK_DEVICE_LEVEL_FUNCTION( vkBindImageMemory )
+VK_DEVICE_LEVEL_FUNCTION( vkCmdBlitImage )
+VK_DEVICE_LEVEL_FUNCTION( vkCmdCopyImage )
+VK_DEVICE_LEVEL_FUNCTION( vkCmdCopyImageToBuffer )
+VK_DEVICE_LEVEL_FUNCTION( vkCreateSampler )
+VK_DEVICE_LEVEL_FUNCTION( vkDestroySampler )
+
+//Buffers
+VK_DEVICE_LEVEL_FUNCTION( vkCreateBuffer )
+VK_DEVICE_LEVEL_FUNCTION( vkDestroyBuffer )
+VK_DEVICE_LEVEL_FUNCTION( vkGetBufferMemoryRequirements )
+VK_DEVICE_LEVEL_FUNCTION( vkBindBufferMemory )
+VK_DEVICE_LEVEL_FUNCTION( vkMapMemory )
+VK_DEVICE_LEVEL_FUNCTION( vkUnmapMemory )
+VK_DEVICE_LEVEL_FUNCTION( vkInvalidateMappedMemoryRanges )
+
+//Compute
+VK_DEVICE_LEVEL_FUNCTION( vkCreateComputePipelines )
+VK_DEVICE_LEVEL_FUNCTION( vkCreateDescriptorSetLayout )
+VK_DEVICE_LEVEL_FUNCTION( vkDestroyDescriptorSetLayout )
+VK_DEVICE_LEVEL_FUNCTION( vkCreateDescriptorPool )
+VK_DEVICE_LEVEL_FUNCTION( vkDestroyDescriptorPool )
+VK_DEVICE_LEVEL_FUNCTION( vkAllocateDescriptorSets )
+VK_DEVICE_LEVEL_FUNCTION( vkUpdateDescriptorSets )
+VK_DEVICE_LEVEL_FUNCTION( vkCmdBindDescriptorSets )
+VK_DEVICE_LEVEL_FUNCTION( vkCmdDispatch )
+VK_DEVICE_LEVEL_FUNCTION( vkCmdDispatchIndirect )
+VK_DEVICE_LEVEL_FUNCTION( vkCmdCopyBuffer )
+VK_DEVICE_LEVEL_FUNCTION( vkCmdFillBuffer )
+
+//Fences
+VK_DEVICE_LEVEL_FUNCTION( vkCreateFence )
+VK_DEVICE_LEVEL_FUNCTION( vkDestroyFence )
+VK_DEVICE_LEVEL_FUNCTION( vkWaitForFences )
+VK_DEVICE_LEVEL_FUNCTION( vkResetFences )
+
+//Timestamp queries
+VK_DEVICE_LEVEL_FUNCTION( vkCreateQueryPool )
+VK_DEVICE_LEVEL_FUNCTION( vkDestroyQueryPool )
+VK_DEVICE_LEVEL_FUNCTION( vkCmdResetQueryPool )
+VK_DEVICE_LEVEL_FUNCTION( vkCmdWriteTimestamp )
+VK_DEVICE_LEVEL_FUNCTION( vkGetQueryPoolResults )
+
+#undef VK_DEVICE_LEVEL_FUNCTION
+
+#if !defined(VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION)
+#define VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION( fun, extension )
+#endif
+
+//Optional functions, loaded only when their device extension got enabled
+
+//SwapChain extension function
+VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION( vkCreateSwapchainKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME )
+VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION( vkGetSwapchainImagesKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME )
+VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION( vkAcquireNextImageKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME )
+VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION( vkQueuePresentKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME )
+VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION( vkDestroySwapchainKHR, VK_KHR_SWAPCHAIN_EXTENSION_NAME )
+
+VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION( vkGetRefreshCycleDurationGOOGLE, VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME )
+VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION( vkGetPastPresentationTimingGOOGLE, VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME )
+
+//Timeline semaphores
+VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION( vkGetSemaphoreCounterValueKHR, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME )
+VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION( vkWaitSemaphoresKHR, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME )
 
-#undef VK_DEVICE_LEVEL_FUNCTION
\ No newline at end of file
+#undef VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION
\ No newline at end of file
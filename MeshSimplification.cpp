@@ -0,0 +1,312 @@
+#include "MeshSimplification.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+	// Planes along borders count this many times as much as the surface's, so open edges barely move
+	const double BorderWeight = 10.0;
+
+	// Sum of squared distances to a set of planes, as the symmetric 4x4 matrix of the planes' outer products
+	struct Quadric {
+		double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+		Quadric() :
+			a2(0.0), ab(0.0), ac(0.0), ad(0.0), b2(0.0), bc(0.0), bd(0.0), c2(0.0), cd(0.0), d2(0.0) {
+		}
+
+		// Plane a x + b y + c z + d = 0 with a unit normal
+		void AddPlane(double a, double b, double c, double d, double weight) {
+			a2 += weight * a * a;
+			ab += weight * a * b;
+			ac += weight * a * c;
+			ad += weight * a * d;
+			b2 += weight * b * b;
+			bc += weight * b * c;
+			bd += weight * b * d;
+			c2 += weight * c * c;
+			cd += weight * c * d;
+			d2 += weight * d * d;
+		}
+
+		void Add(const Quadric& other) {
+			a2 += other.a2;
+			ab += other.ab;
+			ac += other.ac;
+			ad += other.ad;
+			b2 += other.b2;
+			bc += other.bc;
+			bd += other.bd;
+			c2 += other.c2;
+			cd += other.cd;
+			d2 += other.d2;
+		}
+
+		double Evaluate(const float* p) const {
+			const double x = p[0], y = p[1], z = p[2];
+			return a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x
+				+ b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y
+				+ c2 * z * z + 2.0 * cd * z + d2;
+		}
+	};
+
+	struct Collapse {
+		uint32_t from;
+		uint32_t to;
+		double cost;
+	};
+
+	void Cross(const float* a, const float* b, const float* c, double* normal) {
+		const double e0[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		const double e1[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		normal[0] = e0[1] * e1[2] - e0[2] * e1[1];
+		normal[1] = e0[2] * e1[0] - e0[0] * e1[2];
+		normal[2] = e0[0] * e1[1] - e0[1] * e1[0];
+	}
+
+	double Length(const double* v) {
+		return std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	}
+
+	void AddPlaneQuadrics(const std::vector<float>& positions, const std::vector<uint32_t>& indices, std::vector<Quadric>& quadrics) {
+		for (size_t t = 0; t < indices.size(); t += 3) {
+			const float* p[3] = { &positions[3 * indices[t]], &positions[3 * indices[t + 1]], &positions[3 * indices[t + 2]] };
+			double normal[3];
+			Cross(p[0], p[1], p[2], normal);
+			const double length = Length(normal);
+			if (length <= 0.0) {
+				continue;
+			}
+			normal[0] /= length;
+			normal[1] /= length;
+			normal[2] /= length;
+			const double d = -(normal[0] * p[0][0] + normal[1] * p[0][1] + normal[2] * p[0][2]);
+			for (uint32_t corner = 0; corner < 3; ++corner) {
+				quadrics[indices[t + corner]].AddPlane(normal[0], normal[1], normal[2], d, 1.0);
+			}
+		}
+	}
+
+	// Edges used by a single triangle get a plane through them, perpendicular to that triangle
+	void AddBorderQuadrics(const std::vector<float>& positions, const std::vector<uint32_t>& indices, std::vector<Quadric>& quadrics) {
+		struct Edge {
+			uint32_t a;
+			uint32_t b;
+			uint32_t triangle;
+		};
+		std::vector<Edge> edges;
+		edges.reserve(indices.size());
+		for (uint32_t t = 0; t < static_cast<uint32_t>(indices.size()); t += 3) {
+			for (uint32_t corner = 0; corner < 3; ++corner) {
+				const uint32_t a = indices[t + corner];
+				const uint32_t b = indices[t + (corner + 1) % 3];
+				edges.push_back({ std::min(a, b), std::max(a, b), t });
+			}
+		}
+		std::sort(edges.begin(), edges.end(), [](const Edge& x, const Edge& y) {
+			return (x.a != y.a) ? (x.a < y.a) : (x.b < y.b);
+		});
+
+		for (size_t i = 0; i < edges.size();) {
+			size_t end = i + 1;
+			while ((end < edges.size()) && (edges[end].a == edges[i].a) && (edges[end].b == edges[i].b)) {
+				++end;
+			}
+			if (end == i + 1) {
+				const Edge& edge = edges[i];
+				const float* a = &positions[3 * edge.a];
+				const float* b = &positions[3 * edge.b];
+				double faceNormal[3];
+				Cross(&positions[3 * indices[edge.triangle]], &positions[3 * indices[edge.triangle + 1]], &positions[3 * indices[edge.triangle + 2]], faceNormal);
+				const double direction[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+				double normal[3] = {
+					direction[1] * faceNormal[2] - direction[2] * faceNormal[1],
+					direction[2] * faceNormal[0] - direction[0] * faceNormal[2],
+					direction[0] * faceNormal[1] - direction[1] * faceNormal[0]
+				};
+				const double length = Length(normal);
+				if (length > 0.0) {
+					normal[0] /= length;
+					normal[1] /= length;
+					normal[2] /= length;
+					const double d = -(normal[0] * a[0] + normal[1] * a[1] + normal[2] * a[2]);
+					quadrics[edge.a].AddPlane(normal[0], normal[1], normal[2], d, BorderWeight);
+					quadrics[edge.b].AddPlane(normal[0], normal[1], normal[2], d, BorderWeight);
+				}
+			}
+			i = end;
+		}
+	}
+
+	// Moving from onto to must not turn any of from's other triangles around
+	bool FlipsTriangles(const std::vector<float>& positions, const std::vector<uint32_t>& indices, const std::vector<uint32_t>& adjacencyOffsets,
+		const std::vector<uint32_t>& adjacency, uint32_t from, uint32_t to) {
+		for (uint32_t i = adjacencyOffsets[from]; i < adjacencyOffsets[from + 1]; ++i) {
+			const uint32_t t = adjacency[i];
+			const uint32_t corners[3] = { indices[t], indices[t + 1], indices[t + 2] };
+			if ((corners[0] == to) || (corners[1] == to) || (corners[2] == to)) {
+				continue;
+			}
+
+			const float* before[3];
+			const float* after[3];
+			for (uint32_t corner = 0; corner < 3; ++corner) {
+				before[corner] = &positions[3 * corners[corner]];
+				after[corner] = &positions[3 * ((corners[corner] == from) ? to : corners[corner])];
+			}
+			double normalBefore[3];
+			double normalAfter[3];
+			Cross(before[0], before[1], before[2], normalBefore);
+			Cross(after[0], after[1], after[2], normalAfter);
+			const double dot = normalBefore[0] * normalAfter[0] + normalBefore[1] * normalAfter[1] + normalBefore[2] * normalAfter[2];
+			if (dot <= 0.25 * Length(normalBefore) * Length(normalAfter)) {
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+float SimplifyMesh(const std::vector<float>& positions, const std::vector<uint32_t>& indices, uint32_t targetTriangleCount, std::vector<uint32_t>& result) {
+	const uint32_t vertexCount = static_cast<uint32_t>(positions.size() / 3);
+	result = indices;
+
+	std::vector<Quadric> quadrics(vertexCount);
+	AddPlaneQuadrics(positions, indices, quadrics);
+	AddBorderQuadrics(positions, indices, quadrics);
+
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<uint8_t> locked(vertexCount);
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<Collapse> collapses;
+	double maxCost = 0.0;
+
+	// Every pass collapses the cheapest edges whose neighborhoods don't overlap, so costs stay exact within a pass
+	while (result.size() / 3 > targetTriangleCount) {
+		collapses.clear();
+		for (size_t t = 0; t < result.size(); t += 3) {
+			for (uint32_t corner = 0; corner < 3; ++corner) {
+				const uint32_t a = result[t + corner];
+				const uint32_t b = result[t + (corner + 1) % 3];
+				if (a > b) {
+					continue;
+				}
+				Quadric quadric = quadrics[a];
+				quadric.Add(quadrics[b]);
+				const double toB = quadric.Evaluate(&positions[3 * b]);
+				const double toA = quadric.Evaluate(&positions[3 * a]);
+				collapses.push_back((toB <= toA) ? Collapse{ a, b, toB } : Collapse{ b, a, toA });
+			}
+		}
+		// Interior edges show up once each way, only the increasing one is kept; borders barely move anyway
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) {
+			return x.cost < y.cost;
+		});
+
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (uint32_t index : result) {
+			adjacencyOffsets[index + 1]++;
+		}
+		for (uint32_t v = 0; v < vertexCount; ++v) {
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		}
+		adjacency.resize(result.size());
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (uint32_t t = 0; t < static_cast<uint32_t>(result.size()); t += 3) {
+			adjacency[fill[result[t]]++] = t;
+			adjacency[fill[result[t + 1]]++] = t;
+			adjacency[fill[result[t + 2]]++] = t;
+		}
+
+		for (uint32_t v = 0; v < vertexCount; ++v) {
+			remap[v] = v;
+		}
+		std::fill(locked.begin(), locked.end(), 0);
+
+		const size_t excess = result.size() / 3 - targetTriangleCount;
+		size_t removed = 0;
+		for (const Collapse& collapse : collapses) {
+			if (removed >= excess) {
+				break;
+			}
+			if (locked[collapse.from] || locked[collapse.to]
+				|| FlipsTriangles(positions, result, adjacencyOffsets, adjacency, collapse.from, collapse.to)) {
+				continue;
+			}
+
+			// Triangles around both ends change, so none of their vertices may move again this pass
+			for (uint32_t end : { collapse.from, collapse.to }) {
+				for (uint32_t i = adjacencyOffsets[end]; i < adjacencyOffsets[end + 1]; ++i) {
+					const uint32_t t = adjacency[i];
+					locked[result[t]] = 1;
+					locked[result[t + 1]] = 1;
+					locked[result[t + 2]] = 1;
+					if ((end == collapse.from) && ((result[t] == collapse.to) || (result[t + 1] == collapse.to) || (result[t + 2] == collapse.to))) {
+						removed++;
+					}
+				}
+			}
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to].Add(quadrics[collapse.from]);
+			maxCost = std::max(maxCost, collapse.cost);
+		}
+		if (removed == 0) {
+			break;
+		}
+
+		size_t kept = 0;
+		for (size_t t = 0; t < result.size(); t += 3) {
+			const uint32_t a = remap[result[t]];
+			const uint32_t b = remap[result[t + 1]];
+			const uint32_t c = remap[result[t + 2]];
+			if ((a != b) && (b != c) && (c != a)) {
+				result[kept++] = a;
+				result[kept++] = b;
+				result[kept++] = c;
+			}
+		}
+		result.resize(kept);
+	}
+	return static_cast<float>(std::sqrt(std::max(maxCost, 0.0)));
+}
+
+bool BuildLodMesh(const std::vector<float>& positions, const std::vector<uint32_t>& indices, uint32_t maxLevels, float reduction, LodMesh& mesh) {
+	const size_t vertexCount = positions.size() / 3;
+	if ((indices.size() % 3 != 0) || (positions.size() % 3 != 0)) {
+		std::cout << "MESH IS NOT MADE OF WHOLE TRIANGLES " << std::endl;
+		return false;
+	}
+	for (uint32_t index : indices) {
+		if (index >= vertexCount) {
+			std::cout << "MESH INDEX " << index << " IS OUT OF RANGE " << std::endl;
+			return false;
+		}
+	}
+
+	mesh.positions = positions;
+	mesh.indices = indices;
+	mesh.levels.assign(1, LodLevel());
+	mesh.levels[0].indexCount = static_cast<uint32_t>(indices.size());
+
+	// Every level starts from the original, so errors are measured against it rather than the level before
+	std::vector<uint32_t> simplified;
+	uint32_t target = static_cast<uint32_t>(indices.size() / 3);
+	for (uint32_t level = 1; level < maxLevels; ++level) {
+		target = static_cast<uint32_t>(static_cast<float>(target) * reduction);
+		const LodLevel& previous = mesh.levels.back();
+		const float error = SimplifyMesh(positions, indices, target, simplified);
+
+		// Less than a tenth fewer triangles isn't worth a level
+		if (simplified.empty() || (simplified.size() * 10 > static_cast<size_t>(previous.indexCount) * 9)) {
+			break;
+		}
+		LodLevel next;
+		next.firstIndex = static_cast<uint32_t>(mesh.indices.size());
+		next.indexCount = static_cast<uint32_t>(simplified.size());
+		next.error = std::max(error, previous.error);
+		mesh.indices.insert(mesh.indices.end(), simplified.begin(), simplified.end());
+		mesh.levels.push_back(next);
+	}
+	return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Range of LodMesh::indices drawing one level of detail
+struct LodLevel {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;				// Largest distance of the simplified surface from the original, in mesh units
+
+	LodLevel() :
+		firstIndex(0),
+		indexCount(0),
+		error(0.0f) {
+	}
+};
+
+// Triangle mesh with every level of detail baked in. Levels only differ by their triangles: simplification collapses
+// vertices onto existing ones, so all levels share the vertices.
+struct LodMesh {
+	std::vector<float> positions;		// xyz per vertex
+	std::vector<uint32_t> indices;		// Every level's triangles, the original first
+	std::vector<LodLevel> levels;		// Increasing error, decreasing triangle count
+};
+
+// Simplifies an indexed triangle mesh to about targetTriangleCount triangles by quadric error edge collapses
+// (Garland and Heckbert). Every vertex accumulates the planes of its original triangles, an edge collapse moves one
+// end onto the other and costs the sum of squared distances of that vertex to both ends' planes; the cheapest
+// collapses which don't flip any triangle go first. Borders are kept in place by planes perpendicular to them.
+// Only positions are considered, so vertices split for other attributes must be welded first. Returns the error.
+float SimplifyMesh(const std::vector<float>& positions, const std::vector<uint32_t>& indices, uint32_t targetTriangleCount, std::vector<uint32_t>& result);
+
+// Mesh baking: the original triangles followed by up to maxLevels - 1 simplified levels, each with about reduction times
+// the triangles of the one before. Stops early when the mesh can't be simplified further.
+bool BuildLodMesh(const std::vector<float>& positions, const std::vector<uint32_t>& indices, uint32_t maxLevels, float reduction, LodMesh& mesh);
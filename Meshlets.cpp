@@ -0,0 +1,533 @@
+#include "Meshlets.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {
+	const uint32_t CullGroupSize = 64;
+
+	// Cones wider than this (smallest dot of a triangle normal with the axis) aren't worth testing
+	const float MinConeDot = 0.1f;
+
+	const char* SceneHeader = R"(#version 450
+
+struct Meshlet {
+	vec4 sphere;
+	vec4 coneAxisCutoff;
+	vec4 coneApex;				// w: vertex offset, as float bits
+	uvec4 ranges;				// triangle offset, vertex count, triangle count
+};
+
+layout(set = 0, binding = 0) uniform Frame {
+	mat4 viewProjection;
+	vec4 frustumPlanes[6];
+	vec4 cameraPosition;
+	uint instanceCount;
+	uint meshletCount;
+	uint frustumCulling;
+	uint coneCulling;
+	uint drawVertexCount;
+};
+layout(set = 0, binding = 1) readonly buffer Meshlets {
+	Meshlet meshlets[];
+};
+layout(set = 0, binding = 2) readonly buffer Instances {
+	vec4 instances[];			// xyz: position, w: scale
+};
+layout(set = 0, binding = 3) buffer VisibleMeshlets {
+	uint visibleMeshlets[];
+};
+)";
+
+	const char* CullShader = R"(
+layout(local_size_x_id = 0) in;
+
+layout(set = 0, binding = 4) buffer DrawArguments {
+	uint vertexCount;
+	uint visibleCount;
+	uint firstVertex;
+	uint firstInstance;
+};
+
+void main() {
+	const uint index = gl_GlobalInvocationID.x;
+	if (index == 0u) {
+		vertexCount = drawVertexCount;
+	}
+	if (index >= instanceCount * meshletCount) {
+		return;
+	}
+
+	const vec4 instance = instances[index / meshletCount];
+	const Meshlet meshlet = meshlets[index % meshletCount];
+	const vec3 center = instance.xyz + meshlet.sphere.xyz * instance.w;
+	const float radius = meshlet.sphere.w * instance.w;
+
+	if (frustumCulling != 0u) {
+		for (uint i = 0u; i < 6u; ++i) {
+			if (dot(frustumPlanes[i].xyz, center) + frustumPlanes[i].w < -radius) {
+				return;
+			}
+		}
+	}
+	// Uniform scale keeps the cone's axis and angle
+	if (coneCulling != 0u) {
+		const vec3 apex = instance.xyz + meshlet.coneApex.xyz * instance.w;
+		if (dot(normalize(apex - cameraPosition.xyz), meshlet.coneAxisCutoff.xyz) > meshlet.coneAxisCutoff.w) {
+			return;
+		}
+	}
+	visibleMeshlets[atomicAdd(visibleCount, 1u)] = index;
+}
+)";
+
+	const char* DrawVertexShader = R"(
+layout(set = 0, binding = 4) readonly buffer Positions {
+	float positions[];
+};
+layout(set = 0, binding = 5) readonly buffer MeshletVertices {
+	uint meshletVertices[];
+};
+layout(set = 0, binding = 6) readonly buffer MeshletTriangles {
+	uint meshletTriangles[];
+};
+
+layout(location = 0) out vec3 WorldPosition;
+layout(location = 1) flat out uint Cluster;
+
+void main() {
+	const uint visible = visibleMeshlets[gl_InstanceIndex];
+	const vec4 instance = instances[visible / meshletCount];
+	const Meshlet meshlet = meshlets[visible % meshletCount];
+	Cluster = visible % meshletCount;
+
+	const uint triangle = uint(gl_VertexIndex) / 3u;
+	if (triangle >= meshlet.ranges.z) {
+		// Every corner of the triangle ends up at the same point, which covers no pixels
+		WorldPosition = vec3(0.0);
+		gl_Position = vec4(0.0, 0.0, 0.0, 1.0);
+		return;
+	}
+	const uint corner = uint(gl_VertexIndex) % 3u;
+	const uint local = (meshletTriangles[meshlet.ranges.x + triangle] >> (8u * corner)) & 0xFFu;
+	const uint vertex = meshletVertices[floatBitsToUint(meshlet.coneApex.w) + local];
+	const vec3 position = vec3(positions[3u * vertex], positions[3u * vertex + 1u], positions[3u * vertex + 2u]);
+	WorldPosition = instance.xyz + position * instance.w;
+	gl_Position = viewProjection * vec4(WorldPosition, 1.0);
+}
+)";
+
+	const char* DrawFragmentShader = R"(#version 450
+
+layout(location = 0) in vec3 WorldPosition;
+layout(location = 1) flat in uint Cluster;
+
+layout(location = 0) out vec4 Color;
+
+const vec3 ToLight = normalize(vec3(0.4, 1.0, 0.3));
+
+void main() {
+	// y is down in the framebuffer, which makes this face the camera
+	const vec3 normal = normalize(cross(dFdy(WorldPosition), dFdx(WorldPosition)));
+	const float diffuse = max(dot(normal, ToLight), 0.0);
+	const uint hash = Cluster * 2654435761u;
+	const vec3 tint = vec3((hash >> 8) & 0xFFu, (hash >> 16) & 0xFFu, (hash >> 24) & 0xFFu) / 255.0;
+	Color = vec4((0.5 + 0.5 * tint) * (0.3 + 0.7 * diffuse), 1.0);
+}
+)";
+
+	void Normalize(float* v) {
+		const float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		if (length > 0.0f) {
+			v[0] /= length;
+			v[1] /= length;
+			v[2] /= length;
+		}
+	}
+
+	// Sphere around the bounding box, and the normal cone with the apex behind every triangle's plane
+	void ComputeBounds(const std::vector<float>& positions, const MeshletMesh& mesh, Meshlet& meshlet) {
+		float minimum[3] = { positions[3 * mesh.vertices[meshlet.vertexOffset]], positions[3 * mesh.vertices[meshlet.vertexOffset] + 1],
+			positions[3 * mesh.vertices[meshlet.vertexOffset] + 2] };
+		float maximum[3] = { minimum[0], minimum[1], minimum[2] };
+		for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+			const float* p = &positions[3 * mesh.vertices[meshlet.vertexOffset + i]];
+			for (uint32_t axis = 0; axis < 3; ++axis) {
+				minimum[axis] = std::min(minimum[axis], p[axis]);
+				maximum[axis] = std::max(maximum[axis], p[axis]);
+			}
+		}
+		for (uint32_t axis = 0; axis < 3; ++axis) {
+			meshlet.center[axis] = 0.5f * (minimum[axis] + maximum[axis]);
+		}
+		meshlet.radius = 0.0f;
+		for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+			const float* p = &positions[3 * mesh.vertices[meshlet.vertexOffset + i]];
+			const float d[3] = { p[0] - meshlet.center[0], p[1] - meshlet.center[1], p[2] - meshlet.center[2] };
+			meshlet.radius = std::max(meshlet.radius, std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]));
+		}
+
+		std::vector<float> normals(3 * meshlet.triangleCount);
+		std::vector<const float*> firstCorners(meshlet.triangleCount);
+		float axis[3] = {};
+		for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+			const uint32_t packed = mesh.triangles[meshlet.triangleOffset + t];
+			const float* p[3];
+			for (uint32_t corner = 0; corner < 3; ++corner) {
+				p[corner] = &positions[3 * mesh.vertices[meshlet.vertexOffset + ((packed >> (8 * corner)) & 0xFF)]];
+			}
+			const float e0[3] = { p[1][0] - p[0][0], p[1][1] - p[0][1], p[1][2] - p[0][2] };
+			const float e1[3] = { p[2][0] - p[0][0], p[2][1] - p[0][1], p[2][2] - p[0][2] };
+			float* normal = &normals[3 * t];
+			normal[0] = e0[1] * e1[2] - e0[2] * e1[1];
+			normal[1] = e0[2] * e1[0] - e0[0] * e1[2];
+			normal[2] = e0[0] * e1[1] - e0[1] * e1[0];
+			Normalize(normal);
+			firstCorners[t] = p[0];
+			axis[0] += normal[0];
+			axis[1] += normal[1];
+			axis[2] += normal[2];
+		}
+		Normalize(axis);
+
+		float minimumDot = 1.0f;
+		for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+			const float* normal = &normals[3 * t];
+			minimumDot = std::min(minimumDot, axis[0] * normal[0] + axis[1] * normal[1] + axis[2] * normal[2]);
+		}
+		memcpy(meshlet.coneAxis, axis, sizeof(axis));
+		memcpy(meshlet.coneApex, meshlet.center, sizeof(meshlet.center));
+		if (minimumDot <= MinConeDot) {
+			meshlet.coneCutoff = 1.0f;
+			return;
+		}
+		meshlet.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+
+		// Apex moves back along the axis until it is behind every triangle's plane
+		float distance = 0.0f;
+		for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+			const float* normal = &normals[3 * t];
+			const float* p = firstCorners[t];
+			const float toCenter = (meshlet.center[0] - p[0]) * normal[0] + (meshlet.center[1] - p[1]) * normal[1] + (meshlet.center[2] - p[2]) * normal[2];
+			distance = std::max(distance, toCenter / (axis[0] * normal[0] + axis[1] * normal[1] + axis[2] * normal[2]));
+		}
+		for (uint32_t i = 0; i < 3; ++i) {
+			meshlet.coneApex[i] = meshlet.center[i] - axis[i] * distance;
+		}
+	}
+}
+
+bool BuildMeshlets(const std::vector<float>& positions, const std::vector<uint32_t>& indices, MeshletMesh& mesh, uint32_t maxVertices, uint32_t maxTriangles) {
+	const uint32_t vertexCount = static_cast<uint32_t>(positions.size() / 3);
+	const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	if ((indices.size() % 3 != 0) || (maxVertices < 3) || (maxVertices > 256) || (maxTriangles == 0)) {
+		std::cout << "COULD NOT BUILD MESHLETS OF " << maxVertices << " VERTICES AND " << maxTriangles << " TRIANGLES " << std::endl;
+		return false;
+	}
+	for (uint32_t index : indices) {
+		if (index >= vertexCount) {
+			std::cout << "MESH INDEX " << index << " IS OUT OF RANGE " << std::endl;
+			return false;
+		}
+	}
+
+	mesh.positions = positions;
+	mesh.meshlets.clear();
+	mesh.vertices.clear();
+	mesh.triangles.clear();
+
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (uint32_t index : indices) {
+		adjacencyOffsets[index + 1]++;
+	}
+	for (uint32_t v = 0; v < vertexCount; ++v) {
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+	}
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (uint32_t t = 0; t < triangleCount; ++t) {
+		adjacency[fill[indices[3 * t]]++] = t;
+		adjacency[fill[indices[3 * t + 1]]++] = t;
+		adjacency[fill[indices[3 * t + 2]]++] = t;
+	}
+
+	std::vector<uint8_t> used(triangleCount, 0);
+	std::vector<int32_t> localIndex(vertexCount, -1);
+	uint32_t nextUnused = 0;
+	for (;;) {
+		while ((nextUnused < triangleCount) && used[nextUnused]) {
+			++nextUnused;
+		}
+		if (nextUnused == triangleCount) {
+			break;
+		}
+
+		Meshlet meshlet;
+		meshlet.vertexOffset = static_cast<uint32_t>(mesh.vertices.size());
+		meshlet.triangleOffset = static_cast<uint32_t>(mesh.triangles.size());
+		uint32_t triangle = nextUnused;
+		for (;;) {
+			uint32_t packed = 0;
+			for (uint32_t corner = 0; corner < 3; ++corner) {
+				const uint32_t vertex = indices[3 * triangle + corner];
+				if (localIndex[vertex] < 0) {
+					localIndex[vertex] = static_cast<int32_t>(meshlet.vertexCount++);
+					mesh.vertices.push_back(vertex);
+				}
+				packed |= static_cast<uint32_t>(localIndex[vertex]) << (8 * corner);
+			}
+			mesh.triangles.push_back(packed);
+			meshlet.triangleCount++;
+			used[triangle] = 1;
+			if (meshlet.triangleCount == maxTriangles) {
+				break;
+			}
+
+			// Unused triangle around the meshlet's vertices which adds the fewest new ones
+			uint32_t bestNew = 4;
+			for (uint32_t i = 0; (i < meshlet.vertexCount) && (bestNew > 0); ++i) {
+				const uint32_t vertex = mesh.vertices[meshlet.vertexOffset + i];
+				for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; ++a) {
+					const uint32_t candidate = adjacency[a];
+					if (used[candidate]) {
+						continue;
+					}
+					uint32_t added = 0;
+					for (uint32_t corner = 0; corner < 3; ++corner) {
+						added += (localIndex[indices[3 * candidate + corner]] < 0) ? 1 : 0;
+					}
+					if ((added < bestNew) && (meshlet.vertexCount + added <= maxVertices)) {
+						bestNew = added;
+						triangle = candidate;
+					}
+				}
+			}
+			if (bestNew > 3) {
+				break;
+			}
+		}
+
+		for (uint32_t i = 0; i < meshlet.vertexCount; ++i) {
+			localIndex[mesh.vertices[meshlet.vertexOffset + i]] = -1;
+		}
+		ComputeBounds(positions, mesh, meshlet);
+		mesh.meshlets.push_back(meshlet);
+	}
+	return true;
+}
+
+MeshletRenderer::MeshletRenderer(const DeviceContext& device) :
+	Device(device),
+	Dispatch(*device.dispatch),
+	CullPipeline(device),
+	DrawPipeline(device),
+	MaxInstances(0),
+	MaxTriangles(0),
+	Positions(),
+	Meshlets(),
+	MeshletVertices(),
+	MeshletTriangles(),
+	Instances(),
+	VisibleMeshlets(),
+	DrawArguments(),
+	Statistics(),
+	Uniforms(),
+	CullSet(VK_NULL_HANDLE),
+	DrawSet(VK_NULL_HANDLE),
+	Camera(),
+	Parameters() {
+}
+
+MeshletRenderer::~MeshletRenderer() {
+	Destroy();
+}
+
+bool MeshletRenderer::Create(const MeshletMesh& mesh, uint32_t maxInstances, VkRenderPass renderPass, VkSampleCountFlagBits samples) {
+	Destroy();
+	if (mesh.meshlets.empty()) {
+		std::cout << "MESHLET MESH HAS NO MESHLETS " << std::endl;
+		return false;
+	}
+	MaxInstances = std::max<uint32_t>(maxInstances, 1);
+	MaxTriangles = 0;
+	for (const Meshlet& meshlet : mesh.meshlets) {
+		MaxTriangles = std::max(MaxTriangles, meshlet.triangleCount);
+	}
+	Parameters.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+	Parameters.instanceCount = 0;
+	Parameters.frustumCulling = 1;
+	Parameters.coneCulling = 1;
+	Parameters.drawVertexCount = 3 * MaxTriangles;
+
+	const VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	const VkDeviceSize visibleSize = static_cast<VkDeviceSize>(MaxInstances) * Parameters.meshletCount * sizeof(uint32_t);
+	if (!CreateGpuBuffer(Device, mesh.positions.size() * sizeof(float), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, Positions)
+		|| !CreateGpuBuffer(Device, mesh.meshlets.size() * sizeof(Meshlet), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, Meshlets)
+		|| !CreateGpuBuffer(Device, mesh.vertices.size() * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, MeshletVertices)
+		|| !CreateGpuBuffer(Device, mesh.triangles.size() * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, MeshletTriangles)
+		|| !CreateGpuBuffer(Device, MaxInstances * sizeof(MeshletInstance), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, Instances)
+		|| !CreateGpuBuffer(Device, visibleSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VisibleMeshlets)
+		|| !CreateGpuBuffer(Device, sizeof(VkDrawIndirectCommand),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, DrawArguments)
+		|| !CreateGpuBuffer(Device, sizeof(VkDrawIndirectCommand), VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostVisible, Statistics)
+		|| !CreateGpuBuffer(Device, sizeof(Constants), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostVisible, Uniforms)) {
+		return false;
+	}
+	memcpy(Positions.mapped, mesh.positions.data(), mesh.positions.size() * sizeof(float));
+	memcpy(Meshlets.mapped, mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Meshlet));
+	memcpy(MeshletVertices.mapped, mesh.vertices.data(), mesh.vertices.size() * sizeof(uint32_t));
+	memcpy(MeshletTriangles.mapped, mesh.triangles.data(), mesh.triangles.size() * sizeof(uint32_t));
+	memset(Statistics.mapped, 0, sizeof(VkDrawIndirectCommand));
+
+	GraphicsPipelineState state;
+	state.renderPass = renderPass;
+	state.samples = samples;
+	state.cullMode = VK_CULL_MODE_BACK_BIT;
+	state.depthTest = true;
+	state.depthWrite = true;
+
+	const std::string header = SceneHeader;
+	const std::vector<VkDescriptorType> sceneBindings = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER };
+	std::vector<VkDescriptorType> drawBindings(sceneBindings);
+	drawBindings.insert(drawBindings.end(), { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER });
+	if (!CullPipeline.Create((header + CullShader).c_str(), "meshlet_cull.comp", sceneBindings, 0, 1, CullGroupSize)
+		|| !DrawPipeline.Create((header + DrawVertexShader).c_str(), DrawFragmentShader, "meshlet_draw", drawBindings, 0, 1, state)
+		|| !CullPipeline.AllocateDescriptorSet(CullSet)
+		|| !DrawPipeline.AllocateDescriptorSet(DrawSet)) {
+		return false;
+	}
+
+	const VkBuffer sceneBuffers[4] = { Uniforms.handle, Meshlets.handle, Instances.handle, VisibleMeshlets.handle };
+	for (uint32_t binding = 0; binding < 4; ++binding) {
+		CullPipeline.WriteBuffer(CullSet, binding, sceneBuffers[binding]);
+		DrawPipeline.WriteBuffer(DrawSet, binding, sceneBuffers[binding]);
+	}
+	CullPipeline.WriteBuffer(CullSet, 4, DrawArguments.handle);
+	DrawPipeline.WriteBuffer(DrawSet, 4, Positions.handle);
+	DrawPipeline.WriteBuffer(DrawSet, 5, MeshletVertices.handle);
+	DrawPipeline.WriteBuffer(DrawSet, 6, MeshletTriangles.handle);
+	return true;
+}
+
+void MeshletRenderer::Destroy() {
+	if (Dispatch.device == VK_NULL_HANDLE) {
+		return;
+	}
+
+	CullPipeline.Destroy();
+	DrawPipeline.Destroy();
+	CullSet = VK_NULL_HANDLE;
+	DrawSet = VK_NULL_HANDLE;
+	DestroyGpuBuffer(Device, Positions);
+	DestroyGpuBuffer(Device, Meshlets);
+	DestroyGpuBuffer(Device, MeshletVertices);
+	DestroyGpuBuffer(Device, MeshletTriangles);
+	DestroyGpuBuffer(Device, Instances);
+	DestroyGpuBuffer(Device, VisibleMeshlets);
+	DestroyGpuBuffer(Device, DrawArguments);
+	DestroyGpuBuffer(Device, Statistics);
+	DestroyGpuBuffer(Device, Uniforms);
+	Parameters.instanceCount = 0;
+}
+
+bool MeshletRenderer::SetInstances(const std::vector<MeshletInstance>& instances) {
+	if (instances.size() > MaxInstances) {
+		std::cout << "MESHLET RENDERER WAS CREATED FOR AT MOST " << MaxInstances << " INSTANCES " << std::endl;
+		return false;
+	}
+	if (!instances.empty()) {
+		memcpy(Instances.mapped, instances.data(), instances.size() * sizeof(MeshletInstance));
+	}
+	Parameters.instanceCount = static_cast<uint32_t>(instances.size());
+	return true;
+}
+
+void MeshletRenderer::SetCamera(const SceneCamera& camera) {
+	Camera = camera;
+}
+
+void MeshletRenderer::SetCulling(bool frustum, bool cone) {
+	Parameters.frustumCulling = frustum ? 1 : 0;
+	Parameters.coneCulling = cone ? 1 : 0;
+}
+
+void MeshletRenderer::CmdCull(VkCommandBuffer commandBuffer, VkExtent2D extent) {
+	const float aspect = static_cast<float>(extent.width) / static_cast<float>(std::max<uint32_t>(extent.height, 1));
+	GetCameraViewProjection(Camera, aspect, Parameters.viewProjection);
+	memcpy(Parameters.cameraPosition, Camera.position, sizeof(Camera.position));
+
+	// Rows of the column major matrix; reversed depth, so z runs from w at the near plane to 0 at the far plane
+	const float* m = Parameters.viewProjection;
+	for (uint32_t c = 0; c < 4; ++c) {
+		const float row0 = m[4 * c], row1 = m[4 * c + 1], row2 = m[4 * c + 2], row3 = m[4 * c + 3];
+		Parameters.frustumPlanes[0][c] = row3 + row0;
+		Parameters.frustumPlanes[1][c] = row3 - row0;
+		Parameters.frustumPlanes[2][c] = row3 + row1;
+		Parameters.frustumPlanes[3][c] = row3 - row1;
+		Parameters.frustumPlanes[4][c] = row3 - row2;
+		Parameters.frustumPlanes[5][c] = row2;
+	}
+	for (float* plane : Parameters.frustumPlanes) {
+		const float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+		if (length > 0.0f) {
+			plane[0] /= length;
+			plane[1] /= length;
+			plane[2] /= length;
+			plane[3] /= length;
+		}
+	}
+	memcpy(Uniforms.mapped, &Parameters, sizeof(Constants));
+
+	// Arguments were read by the last frame's draw and copied to the statistics
+	VkMemoryBarrier memoryBarrier = {};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.pNext = nullptr;
+	memoryBarrier.srcAccessMask = 0;
+	memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	Dispatch.vkCmdFillBuffer(commandBuffer, DrawArguments.handle, 0, VK_WHOLE_SIZE, 0);
+
+	memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+	CullPipeline.CmdBind(commandBuffer, CullSet);
+	CullPipeline.CmdDispatch(commandBuffer, std::max<uint32_t>(Parameters.instanceCount * Parameters.meshletCount, 1));
+
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+	VkBufferCopy region = { 0, 0, sizeof(VkDrawIndirectCommand) };
+	Dispatch.vkCmdCopyBuffer(commandBuffer, DrawArguments.handle, Statistics.handle, 1, &region);
+	memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+void MeshletRenderer::CmdPrePass(VkCommandBuffer commandBuffer, const OffscreenFrame& frame) {
+	CmdCull(commandBuffer, frame.extent);
+}
+
+void MeshletRenderer::CmdDraw(VkCommandBuffer commandBuffer, const OffscreenFrame& /*frame*/) const {
+	DrawPipeline.CmdBind(commandBuffer, DrawSet);
+	Dispatch.vkCmdDrawIndirect(commandBuffer, DrawArguments.handle, 0, 1, sizeof(VkDrawIndirectCommand));
+}
+
+uint32_t MeshletRenderer::GetVisibleCount() const {
+	return static_cast<const VkDrawIndirectCommand*>(Statistics.mapped)->instanceCount;
+}
+
+uint32_t MeshletRenderer::GetMeshletCount() const {
+	return Parameters.meshletCount;
+}
+
+uint32_t MeshletRenderer::GetInstanceCount() const {
+	return Parameters.instanceCount;
+}
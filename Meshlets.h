@@ -0,0 +1,133 @@
+#pragma once
+
+#include "ComputePipeline.h"
+#include "GraphicsPipeline.h"
+#include "OffscreenRenderer.h"
+#include "SceneCamera.h"
+#include <cstdint>
+#include <vector>
+
+// Cluster of a mesh's triangles with bounds for culling, std430 layout
+struct Meshlet {
+	float center[3];			// Bounding sphere
+	float radius;
+	float coneAxis[3];			// Average normal of the triangles
+	float coneCutoff;			// Every triangle faces away from cameras where dot(normalize(coneApex - camera), coneAxis) > coneCutoff
+	float coneApex[3];
+	uint32_t vertexOffset;		// Into MeshletMesh::vertices
+	uint32_t triangleOffset;	// Into MeshletMesh::triangles
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+	uint32_t padding;
+
+	Meshlet() :
+		center(),
+		radius(0.0f),
+		coneAxis(),
+		coneCutoff(1.0f),
+		coneApex(),
+		vertexOffset(0),
+		triangleOffset(0),
+		vertexCount(0),
+		triangleCount(0),
+		padding(0) {
+	}
+};
+
+struct MeshletMesh {
+	std::vector<float> positions;		// xyz per vertex
+	std::vector<Meshlet> meshlets;
+	std::vector<uint32_t> vertices;		// Mesh vertex of every meshlet vertex
+	std::vector<uint32_t> triangles;	// Three 8 bit meshlet vertex indices per triangle, first corner in the low byte
+};
+
+// Splits an indexed triangle mesh into meshlets of at most maxVertices vertices and maxTriangles triangles. Every
+// meshlet grows from its first triangle by the neighboring triangle that adds the fewest new vertices, so meshlets stay
+// compact, which keeps their bounds and cones tight. Cones of meshlets whose triangles face too far apart never cull.
+bool BuildMeshlets(const std::vector<float>& positions, const std::vector<uint32_t>& indices, MeshletMesh& mesh,
+	uint32_t maxVertices = 64, uint32_t maxTriangles = 124);
+
+// Uniformly scaled copy of the mesh in world space
+struct MeshletInstance {
+	float position[3];
+	float scale;
+
+	MeshletInstance() :
+		position(),
+		scale(1.0f) {
+	}
+};
+
+// Draws instances of a meshlet mesh culled per meshlet on the GPU.
+// Before the render pass one compute invocation per instance and meshlet tests the meshlet's bounding sphere against the
+// view frustum and its normal cone against the camera position, appending survivors to a visible list whose count feeds
+// an indirect draw. Every instance of that draw expands one visible meshlet: the vertex shader fetches its triangles'
+// vertices from storage buffers, and vertices of triangles past the meshlet's count collapse into a point.
+// The project's Vulkan headers predate VK_EXT_mesh_shader, so the expansion is done by the vertex shader instead.
+// Drawn in the first subpass of render passes compatible with the given one.
+class MeshletRenderer : public OffscreenDrawable {
+public:
+	// Context's dispatch table must outlive the renderer
+	explicit MeshletRenderer(const DeviceContext& device);
+	~MeshletRenderer();
+
+	MeshletRenderer(const MeshletRenderer&) = delete;
+	MeshletRenderer& operator=(const MeshletRenderer&) = delete;
+
+	bool Create(const MeshletMesh& mesh, uint32_t maxInstances, VkRenderPass renderPass, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+	void Destroy();
+
+	// Instances are written straight into mapped memory, so no frame using the previous ones may still be executing
+	bool SetInstances(const std::vector<MeshletInstance>& instances);
+	void SetCamera(const SceneCamera& camera);
+	// Without either test every meshlet is drawn
+	void SetCulling(bool frustum, bool cone);
+
+	// Outside a render pass. The previous frame must have finished.
+	void CmdCull(VkCommandBuffer commandBuffer, VkExtent2D extent);
+
+	// Culls before the render pass, then draws the visible meshlets in it
+	void CmdPrePass(VkCommandBuffer commandBuffer, const OffscreenFrame& frame) override;
+	void CmdDraw(VkCommandBuffer commandBuffer, const OffscreenFrame& frame) const override;
+
+	// Meshlets drawn by the last finished frame, of GetMeshletCount() times the instance count
+	uint32_t GetVisibleCount() const;
+	uint32_t GetMeshletCount() const;
+	uint32_t GetInstanceCount() const;
+
+private:
+	// Uniform block of the culling and drawing shaders, std140
+	struct Constants {
+		float viewProjection[16];
+		float frustumPlanes[6][4];				// Inside where dot(plane.xyz, position) + plane.w >= 0
+		float cameraPosition[4];
+		uint32_t instanceCount;
+		uint32_t meshletCount;
+		uint32_t frustumCulling;
+		uint32_t coneCulling;
+		uint32_t drawVertexCount;				// Three per triangle of the largest meshlet
+		uint32_t padding[3];
+	};
+
+	DeviceContext Device;
+	const DeviceDispatchTable& Dispatch;
+	ComputePipeline CullPipeline;
+	GraphicsPipeline DrawPipeline;
+
+	uint32_t MaxInstances;
+	uint32_t MaxTriangles;						// Of any meshlet, the vertex count of every draw instance
+	GpuBuffer Positions;
+	GpuBuffer Meshlets;
+	GpuBuffer MeshletVertices;
+	GpuBuffer MeshletTriangles;
+	GpuBuffer Instances;						// Host visible
+	GpuBuffer VisibleMeshlets;					// Instance index times meshlet count plus meshlet index
+	GpuBuffer DrawArguments;
+	GpuBuffer Statistics;						// Host visible copy of the draw arguments
+	GpuBuffer Uniforms;
+	VkDescriptorSet CullSet;
+	VkDescriptorSet DrawSet;
+
+	SceneCamera Camera;
+	Constants Parameters;
+};
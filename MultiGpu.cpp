@@ -0,0 +1,300 @@
+#include "MultiGpu.h"
+#include "Benchmark.h"
+#include "ImageDiff.h"
+#include "OffscreenRenderer.h"
+#include "VulkanFunctions.h"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+namespace {
+	const uint32_t SceneTriangles = 1024;
+	const VkExtent2D SceneExtent = { 512, 512 };
+}
+
+// ***** GpuDevice ***** //
+
+GpuDevice::GpuDevice() :
+	Info(),
+	Dispatch(),
+	Context() {
+}
+
+GpuDevice::~GpuDevice() {
+	Destroy();
+}
+
+bool GpuDevice::Create(const InstanceDispatchTable& instance, const PhysicalDeviceInfo& info) {
+	Destroy();
+	if (!info.CanRender()) {
+		return false;
+	}
+
+	const float queuePriority = 1.0f;
+	VkDeviceQueueCreateInfo queueCreateInfo = {};
+	queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+	queueCreateInfo.pNext = nullptr;
+	queueCreateInfo.flags = 0;
+	queueCreateInfo.queueFamilyIndex = info.graphicsQueueFamilyIndex;
+	queueCreateInfo.queueCount = 1;
+	queueCreateInfo.pQueuePriorities = &queuePriority;
+
+	VkDeviceCreateInfo deviceCreateInfo = {};
+	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	deviceCreateInfo.pNext = nullptr;
+	deviceCreateInfo.flags = 0;
+	deviceCreateInfo.queueCreateInfoCount = 1;
+	deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
+	deviceCreateInfo.enabledLayerCount = 0;
+	deviceCreateInfo.ppEnabledLayerNames = nullptr;
+	deviceCreateInfo.enabledExtensionCount = 0;
+	deviceCreateInfo.ppEnabledExtensionNames = nullptr;
+	deviceCreateInfo.pEnabledFeatures = nullptr;
+
+	VkDevice device = VK_NULL_HANDLE;
+	if (instance.vkCreateDevice(info.handle, &deviceCreateInfo, nullptr, &device) != VK_SUCCESS) {
+		std::cout << "**COULD NOT CREATE LOGICAL DEVICE** on " << info.properties.deviceName << std::endl;
+		return false;
+	}
+
+	if (!Dispatch.Load(instance, device, std::vector<const char*>())) {
+		// Table is incomplete, the device is destroyed through a separately queried entry point
+		PFN_vkDestroyDevice destroyDevice = reinterpret_cast<PFN_vkDestroyDevice>(instance.vkGetDeviceProcAddr(device, "vkDestroyDevice"));
+		if (destroyDevice != nullptr) {
+			destroyDevice(device, nullptr);
+		}
+		Dispatch = DeviceDispatchTable();
+		return false;
+	}
+
+	Info = info;
+	Context.physicalDevice = info.handle;
+	Context.dispatch = &Dispatch;
+	Context.graphicsQueueFamilyIndex = info.graphicsQueueFamilyIndex;
+	Dispatch.vkGetDeviceQueue(device, info.graphicsQueueFamilyIndex, 0, &Context.graphicsQueue);
+	return true;
+}
+
+void GpuDevice::Destroy() {
+	if (Dispatch.device == VK_NULL_HANDLE) {
+		return;
+	}
+	Dispatch.vkDeviceWaitIdle(Dispatch.device);
+	Dispatch.vkDestroyDevice(Dispatch.device, nullptr);
+	Dispatch = DeviceDispatchTable();
+	Context = DeviceContext();
+}
+
+const PhysicalDeviceInfo& GpuDevice::GetInfo() const {
+	return Info;
+}
+
+const DeviceContext& GpuDevice::GetContext() const {
+	return Context;
+}
+
+// ***** DeviceGroup ***** //
+
+DeviceGroup::DeviceGroup() :
+	Devices(),
+	JobCounts() {
+}
+
+bool DeviceGroup::Create(const InstanceDispatchTable& instance, const std::vector<PhysicalDeviceInfo>& devices, uint32_t deviceCount) {
+	Destroy();
+
+	std::vector<const PhysicalDeviceInfo*> usable;
+	for (const PhysicalDeviceInfo& device : devices) {
+		if (device.CanRender()) {
+			usable.push_back(&device);
+		}
+	}
+	if (usable.empty() || (deviceCount == 0)) {
+		std::cout << "NO DEVICE CAN RENDER " << std::endl;
+		return false;
+	}
+
+	for (uint32_t i = 0; i < deviceCount; ++i) {
+		std::unique_ptr<GpuDevice> device(new GpuDevice());
+		if (!device->Create(instance, *usable[i % usable.size()])) {
+			Destroy();
+			return false;
+		}
+		Devices.push_back(std::move(device));
+	}
+	JobCounts.assign(Devices.size(), 0);
+	return true;
+}
+
+void DeviceGroup::Destroy() {
+	Devices.clear();
+	JobCounts.clear();
+}
+
+size_t DeviceGroup::GetDeviceCount() const {
+	return Devices.size();
+}
+
+GpuDevice& DeviceGroup::GetDevice(size_t index) {
+	return *Devices[index];
+}
+
+size_t DeviceGroup::GetDeviceForFrame(uint64_t frame) const {
+	return Devices.empty() ? 0 : static_cast<size_t>(frame % Devices.size());
+}
+
+bool DeviceGroup::RunJobs(size_t jobCount, const Job& job) {
+	JobCounts.assign(Devices.size(), 0);
+
+	std::atomic<size_t> nextJob(0);
+	std::atomic<bool> failed(false);
+	std::vector<std::thread> threads;
+	for (size_t deviceIndex = 0; deviceIndex < Devices.size(); ++deviceIndex) {
+		threads.emplace_back([&, deviceIndex]() {
+			while (!failed) {
+				const size_t index = nextJob++;
+				if (index >= jobCount) {
+					break;
+				}
+				if (!job(deviceIndex, index)) {
+					failed = true;
+					break;
+				}
+				JobCounts[deviceIndex]++;
+			}
+		});
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+	return !failed;
+}
+
+const std::vector<size_t>& DeviceGroup::GetJobCounts() const {
+	return JobCounts;
+}
+
+// ***** --multi-gpu mode ***** //
+
+int RunMultiGpu(int argc, char* argv[]) {
+	uint32_t deviceCount = 0;
+	uint32_t frameCount = 120;
+	uint32_t jobCount = 64;
+	bool listOnly = false;
+
+	// --gpus N        : devices to use (default: every device that can render, more than exist reuses them)
+	// --frames N      : frames rendered with alternate frame rendering
+	// --jobs N        : independent offscreen jobs shared by all devices
+	// --list-devices  : only print the devices and their scores
+	for (int i = 1; i < argc; ++i) {
+		if ((strcmp(argv[i], "--gpus") == 0) && (i + 1 < argc)) {
+			deviceCount = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if ((strcmp(argv[i], "--frames") == 0) && (i + 1 < argc)) {
+			frameCount = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if ((strcmp(argv[i], "--jobs") == 0) && (i + 1 < argc)) {
+			jobCount = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--list-devices") == 0) {
+			listOnly = true;
+		}
+	}
+
+	VulkanBase vulkan;
+	vulkan.SetPipelineCachePath("");
+	if (!vulkan.PrepareVulkanHeadless()) {
+		return 2;
+	}
+
+	const std::vector<PhysicalDeviceInfo> devices = EnumeratePhysicalDevices(handle.instance);
+	std::cout << "Physical devices, best first" << std::endl;
+	PrintPhysicalDevices(devices, std::cout);
+	if (listOnly) {
+		return 0;
+	}
+
+	if (deviceCount == 0) {
+		for (const PhysicalDeviceInfo& device : devices) {
+			deviceCount += device.CanRender() ? 1 : 0;
+		}
+	}
+
+	DeviceGroup group;
+	if (!group.Create(vulkan.GetInstanceDispatch(), devices, deviceCount)) {
+		return 2;
+	}
+
+	// Declared after the group, so they are destroyed before their devices
+	std::vector<std::unique_ptr<OffscreenRenderer>> renderers;
+	for (size_t i = 0; i < group.GetDeviceCount(); ++i) {
+		std::unique_ptr<OffscreenRenderer> renderer(new OffscreenRenderer(group.GetDevice(i).GetContext()));
+		if (!renderer->Create(SceneExtent) || !renderer->SetTriangleCount(SceneTriangles) || !renderer->SetPipelineCount(1)) {
+			return 2;
+		}
+		renderers.push_back(std::move(renderer));
+	}
+
+	OffscreenDrawList drawList;
+	drawList.drawCount = 1;
+	drawList.trianglesPerDraw = SceneTriangles;
+
+	// Alternate frame rendering - a device waits for its previous frame only when its turn comes again,
+	// so all devices work at the same time
+	std::vector<bool> inFlight(group.GetDeviceCount(), false);
+	BenchmarkTimer frameTimer;
+	for (uint32_t frame = 0; frame < frameCount; ++frame) {
+		const size_t deviceIndex = group.GetDeviceForFrame(frame);
+		OffscreenRenderer& renderer = *renderers[deviceIndex];
+		if ((inFlight[deviceIndex] && !renderer.Wait()) || !renderer.Record(drawList) || !renderer.Submit()) {
+			return 2;
+		}
+		inFlight[deviceIndex] = true;
+	}
+	for (size_t i = 0; i < renderers.size(); ++i) {
+		if (inFlight[i] && !renderers[i]->Wait()) {
+			return 2;
+		}
+	}
+	const double frameMs = frameTimer.ElapsedMs();
+	std::cout << "Alternate frames: " << frameCount << " frames on " << group.GetDeviceCount() << " devices in " << frameMs << " ms" << std::endl;
+
+	// Batch jobs - the first image of every device is kept to check they all render the same
+	std::vector<std::vector<uint8_t>> images(group.GetDeviceCount());
+	BenchmarkTimer jobTimer;
+	const bool jobsDone = group.RunJobs(jobCount, [&](size_t deviceIndex, size_t) {
+		OffscreenRenderer& renderer = *renderers[deviceIndex];
+		if (!renderer.Record(drawList) || !renderer.Submit() || !renderer.Wait()) {
+			return false;
+		}
+		return !images[deviceIndex].empty() || renderer.ReadPixels(images[deviceIndex]);
+	});
+	if (!jobsDone) {
+		std::cout << "BATCH JOB FAILED " << std::endl;
+		return 2;
+	}
+	const double jobMs = jobTimer.ElapsedMs();
+
+	std::cout << "Batch: " << jobCount << " jobs in " << jobMs << " ms" << std::endl;
+	for (size_t i = 0; i < group.GetDeviceCount(); ++i) {
+		std::cout << "  device " << i << " (" << group.GetDevice(i).GetInfo().properties.deviceName << "): "
+			<< group.GetJobCounts()[i] << " jobs" << std::endl;
+	}
+
+	// Different drivers may round differently, but they must agree on what was drawn
+	bool consistent = true;
+	for (size_t i = 1; i < images.size(); ++i) {
+		if (images[0].empty() || images[i].empty()) {
+			continue;
+		}
+		const ImageDiffTolerance tolerance;
+		const ImageDiffResult result = CompareImages(images[0], images[i], SceneExtent.width, SceneExtent.height, tolerance);
+		if (!result.Passed(tolerance)) {
+			std::cout << "DEVICE " << i << " RENDERED A DIFFERENT IMAGE THAN DEVICE 0 (" << result.differentPixels << " pixels differ)" << std::endl;
+			consistent = false;
+		}
+	}
+	return consistent ? 0 : 1;
+}
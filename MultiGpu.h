@@ -0,0 +1,63 @@
+#pragma once
+
+#include "DeviceSelection.h"
+#include "VulkanDispatch.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Logical device for offscreen work on any physical device: one graphics queue, no presentation.
+// Has its own dispatch table, so any number of them can be used at once next to VulkanBase's device.
+class GpuDevice {
+public:
+	GpuDevice();
+	~GpuDevice();
+
+	GpuDevice(const GpuDevice&) = delete;
+	GpuDevice& operator=(const GpuDevice&) = delete;
+
+	bool Create(const InstanceDispatchTable& instance, const PhysicalDeviceInfo& info);
+	void Destroy();
+
+	const PhysicalDeviceInfo& GetInfo() const;
+	const DeviceContext& GetContext() const;
+
+private:
+	PhysicalDeviceInfo Info;
+	DeviceDispatchTable Dispatch;
+	DeviceContext Context;
+};
+
+// Splits work across several devices, either frame by frame (alternate frame rendering) or as a queue of
+// independent jobs which every device takes from as soon as it's done with the previous one.
+class DeviceGroup {
+public:
+	// Called on the device's own thread, returns false to stop the whole batch
+	typedef std::function<bool(size_t deviceIndex, size_t job)> Job;
+
+	DeviceGroup();
+
+	// Uses the deviceCount best devices that can render. When there are fewer physical devices, they get more
+	// than one logical device each - handy for testing the splitting with a single (software) driver.
+	bool Create(const InstanceDispatchTable& instance, const std::vector<PhysicalDeviceInfo>& devices, uint32_t deviceCount);
+	void Destroy();
+
+	size_t GetDeviceCount() const;
+	GpuDevice& GetDevice(size_t index);
+
+	// Alternate frame rendering: frame N belongs to device N % count
+	size_t GetDeviceForFrame(uint64_t frame) const;
+
+	// Runs jobs 0 .. jobCount - 1 with one thread per device, faster devices end up with more of them
+	bool RunJobs(size_t jobCount, const Job& job);
+	// How many jobs each device ran in the last RunJobs()
+	const std::vector<size_t>& GetJobCounts() const;
+
+private:
+	std::vector<std::unique_ptr<GpuDevice>> Devices;
+	std::vector<size_t> JobCounts;
+};
+
+// Entry point of the --multi-gpu mode, returns the process exit code
+int RunMultiGpu(int argc, char* argv[]);
@@ -0,0 +1,480 @@
+#include "OcclusionCulling.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {
+	const uint32_t ReduceGroupSize = 8;
+	const uint32_t CullGroupSize = 64;
+
+	// Builds one pyramid level: every texel keeps the farthest (smallest, in reversed depth) depth of its footprint
+	// in the source, which is the depth buffer for level 0 and the level before otherwise
+	const char* ReduceShader = R"(#version 450
+
+layout(local_size_x_id = 0, local_size_y_id = 1) in;
+
+layout(set = 0, binding = 0) uniform sampler2D source;
+layout(set = 0, binding = 1, r32f) uniform writeonly image2D destination;
+
+void main() {
+	const ivec2 size = imageSize(destination);
+	const ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+	if (any(greaterThanEqual(texel, size))) {
+		return;
+	}
+
+	// Footprints cover the whole source, odd sizes included
+	const ivec2 sourceSize = textureSize(source, 0);
+	const ivec2 first = texel * sourceSize / size;
+	const ivec2 last = max(((texel + 1) * sourceSize + size - 1) / size, first + 1);
+	float farthest = 1.0;
+	for (int y = first.y; y < last.y; ++y) {
+		for (int x = first.x; x < last.x; ++x) {
+			farthest = min(farthest, texelFetch(source, ivec2(x, y), 0).r);
+		}
+	}
+	imageStore(destination, texel, vec4(farthest));
+}
+)";
+
+	const char* SceneHeader = R"(#version 450
+
+struct Instance {
+	vec4 centerShade;
+	vec4 halfExtent;
+};
+
+layout(set = 0, binding = 0) uniform Frame {
+	mat4 viewProjection;
+	mat4 previousViewProjection;
+	uint instanceCount;
+	uint occlusion;
+};
+layout(set = 0, binding = 1) readonly buffer Instances {
+	Instance instances[];
+};
+
+vec3 Corner(Instance instance, uint corner) {
+	const vec3 local = vec3(corner & 1u, (corner >> 1) & 1u, (corner >> 2) & 1u) * 2.0 - 1.0;
+	return instance.centerShade.xyz + local * instance.halfExtent.xyz;
+}
+)";
+
+	const char* CullShader = R"(
+layout(local_size_x_id = 0) in;
+
+layout(set = 0, binding = 2) writeonly buffer VisibleInstances {
+	uint visibleInstances[];
+};
+layout(set = 0, binding = 3) buffer DrawArguments {
+	uint vertexCount;
+	uint visibleCount;
+	uint firstVertex;
+	uint firstInstance;
+};
+layout(set = 0, binding = 4) uniform sampler2D pyramid;
+
+bool OutsideFrustum(Instance instance) {
+	// Corners outside of each plane; reversed depth, so z runs from w at the near plane to 0 at the far plane
+	uvec3 below = uvec3(0u);
+	uvec3 above = uvec3(0u);
+	for (uint i = 0u; i < 8u; ++i) {
+		const vec4 clip = viewProjection * vec4(Corner(instance, i), 1.0);
+		below += uvec3(lessThan(clip.xyz, vec3(-clip.w, -clip.w, 0.0)));
+		above += uvec3(greaterThan(clip.xyz, vec3(clip.w)));
+	}
+	return any(equal(below, uvec3(8u))) || any(equal(above, uvec3(8u)));
+}
+
+bool Occluded(Instance instance) {
+	vec2 uvMin = vec2(1.0);
+	vec2 uvMax = vec2(0.0);
+	float nearest = 0.0;
+	for (uint i = 0u; i < 8u; ++i) {
+		const vec4 clip = previousViewProjection * vec4(Corner(instance, i), 1.0);
+		if (clip.w <= 0.0) {
+			// Reaches behind the camera
+			return false;
+		}
+		const vec3 ndc = clip.xyz / clip.w;
+		uvMin = min(uvMin, ndc.xy * 0.5 + 0.5);
+		uvMax = max(uvMax, ndc.xy * 0.5 + 0.5);
+		nearest = max(nearest, ndc.z);
+	}
+	uvMin = clamp(uvMin, 0.0, 1.0);
+	uvMax = clamp(uvMax, 0.0, 1.0);
+
+	// Coarsest level is a single texel, so this always ends with at most 2x2 texels to test
+	const int levels = textureQueryLevels(pyramid);
+	const vec2 extent = (uvMax - uvMin) * vec2(textureSize(pyramid, 0));
+	int level = clamp(int(ceil(log2(max(max(extent.x, extent.y), 1.0)))), 0, levels - 1);
+	ivec2 minTexel;
+	ivec2 maxTexel;
+	for (;;) {
+		const ivec2 size = textureSize(pyramid, level);
+		minTexel = min(ivec2(uvMin * vec2(size)), size - 1);
+		maxTexel = min(ivec2(uvMax * vec2(size)), size - 1);
+		if (all(lessThanEqual(maxTexel - minTexel, ivec2(1))) || (level >= levels - 1)) {
+			break;
+		}
+		++level;
+	}
+
+	const float farthest = min(
+		min(texelFetch(pyramid, minTexel, level).r, texelFetch(pyramid, ivec2(maxTexel.x, minTexel.y), level).r),
+		min(texelFetch(pyramid, ivec2(minTexel.x, maxTexel.y), level).r, texelFetch(pyramid, maxTexel, level).r));
+	return nearest < farthest;
+}
+
+void main() {
+	const uint index = gl_GlobalInvocationID.x;
+	if (index == 0u) {
+		vertexCount = 36u;
+	}
+	if (index >= instanceCount) {
+		return;
+	}
+
+	const Instance instance = instances[index];
+	if (OutsideFrustum(instance) || ((occlusion != 0u) && Occluded(instance))) {
+		return;
+	}
+	visibleInstances[atomicAdd(visibleCount, 1u)] = index;
+}
+)";
+
+	// Shared by the depth pre-pass and the shading pass, which must produce exactly the same depth
+	const char* DrawVertexShader = R"(
+layout(set = 0, binding = 2) readonly buffer VisibleInstances {
+	uint visibleInstances[];
+};
+
+layout(location = 0) flat out uint Face;
+layout(location = 1) flat out float Shade;
+
+invariant gl_Position;
+
+// Two triangles per face of the unit cube, corners numbered by their x, y and z bits; faces -z, +z, -y, +y, -x, +x
+const uint Corners[36] = uint[36](
+	0u, 2u, 1u, 1u, 2u, 3u,  4u, 5u, 6u, 5u, 7u, 6u,
+	0u, 1u, 4u, 1u, 5u, 4u,  2u, 6u, 3u, 3u, 6u, 7u,
+	0u, 4u, 2u, 2u, 4u, 6u,  1u, 3u, 5u, 3u, 7u, 5u);
+
+void main() {
+	const Instance instance = instances[visibleInstances[gl_InstanceIndex]];
+	gl_Position = viewProjection * vec4(Corner(instance, Corners[gl_VertexIndex]), 1.0);
+	Face = uint(gl_VertexIndex) / 6u;
+	Shade = instance.centerShade.w;
+}
+)";
+
+	const char* ShadeFragmentShader = R"(#version 450
+
+layout(location = 0) flat in uint Face;
+layout(location = 1) flat in float Shade;
+
+layout(location = 0) out vec4 Color;
+
+const vec3 Normals[6] = vec3[6](vec3(0.0, 0.0, -1.0), vec3(0.0, 0.0, 1.0), vec3(0.0, -1.0, 0.0), vec3(0.0, 1.0, 0.0), vec3(-1.0, 0.0, 0.0), vec3(1.0, 0.0, 0.0));
+const vec3 ToLight = normalize(vec3(0.4, 1.0, 0.3));
+
+void main() {
+	const float diffuse = max(dot(Normals[Face], ToLight), 0.0);
+	Color = vec4(vec3(0.35 + 0.5 * Shade) * (0.3 + 0.7 * diffuse), 1.0);
+}
+)";
+}
+
+OcclusionCulling::OcclusionCulling(const DeviceContext& device) :
+	Device(device),
+	Dispatch(*device.dispatch),
+	ReducePipeline(device),
+	CullPipeline(device),
+	DepthPipeline(device),
+	ShadePipeline(device),
+	Pyramid(),
+	LevelViews(),
+	LevelExtents(),
+	ReduceSets(),
+	Sampler(VK_NULL_HANDLE),
+	Instances(),
+	VisibleInstances(),
+	DrawArguments(),
+	Statistics(),
+	Uniforms(),
+	CullSet(VK_NULL_HANDLE),
+	DepthSet(VK_NULL_HANDLE),
+	ShadeSet(VK_NULL_HANDLE),
+	MaxInstances(0),
+	Camera(),
+	Parameters(),
+	OcclusionEnabled(true),
+	HistoryValid(false) {
+}
+
+OcclusionCulling::~OcclusionCulling() {
+	Destroy();
+}
+
+bool OcclusionCulling::Create(uint32_t maxInstances, VkRenderPass renderPass, VkImageView depthView, VkExtent2D depthExtent) {
+	Destroy();
+	if (depthView == VK_NULL_HANDLE) {
+		std::cout << "OCCLUSION CULLING NEEDS A SINGLE SAMPLED DEPTH BUFFER " << std::endl;
+		return false;
+	}
+	MaxInstances = std::max<uint32_t>(maxInstances, 1);
+
+	// Full mip chain down to a single texel; the reduction handles the odd sizes of rounded down levels
+	const VkExtent2D baseExtent = { std::max<uint32_t>((depthExtent.width + 1) / 2, 1), std::max<uint32_t>((depthExtent.height + 1) / 2, 1) };
+	uint32_t levelCount = 1;
+	while ((std::max(baseExtent.width, baseExtent.height) >> levelCount) > 0) {
+		++levelCount;
+	}
+
+	if (!CreateGpuImage(Device, VK_FORMAT_R32_SFLOAT, baseExtent, 1, levelCount, VK_SAMPLE_COUNT_1_BIT,
+		VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, Pyramid)) {
+		return false;
+	}
+	LevelViews.assign(levelCount, VK_NULL_HANDLE);
+	for (uint32_t level = 0; level < levelCount; ++level) {
+		LevelExtents.push_back({ std::max<uint32_t>(baseExtent.width >> level, 1), std::max<uint32_t>(baseExtent.height >> level, 1) });
+		if (!CreateGpuImageView(Device, Pyramid, 0, level, 1, LevelViews[level])) {
+			return false;
+		}
+	}
+
+	VkSamplerCreateInfo samplerCreateInfo = {};
+	samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCreateInfo.pNext = nullptr;
+	samplerCreateInfo.flags = 0;
+	samplerCreateInfo.magFilter = VK_FILTER_NEAREST;
+	samplerCreateInfo.minFilter = VK_FILTER_NEAREST;
+	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.mipLodBias = 0.0f;
+	samplerCreateInfo.anisotropyEnable = VK_FALSE;
+	samplerCreateInfo.maxAnisotropy = 1.0f;
+	samplerCreateInfo.compareEnable = VK_FALSE;
+	samplerCreateInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	samplerCreateInfo.minLod = 0.0f;
+	samplerCreateInfo.maxLod = VK_LOD_CLAMP_NONE;
+	samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+	samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+
+	if (Dispatch.vkCreateSampler(Dispatch.device, &samplerCreateInfo, nullptr, &Sampler) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE HI-Z SAMPLER " << std::endl;
+		return false;
+	}
+
+	const VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	if (!CreateGpuBuffer(Device, MaxInstances * sizeof(OcclusionInstance), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, Instances)
+		|| !CreateGpuBuffer(Device, MaxInstances * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VisibleInstances)
+		|| !CreateGpuBuffer(Device, sizeof(VkDrawIndirectCommand),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, DrawArguments)
+		|| !CreateGpuBuffer(Device, sizeof(VkDrawIndirectCommand), VK_BUFFER_USAGE_TRANSFER_DST_BIT, hostVisible, Statistics)
+		|| !CreateGpuBuffer(Device, sizeof(Constants), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostVisible, Uniforms)) {
+		return false;
+	}
+	memset(Statistics.mapped, 0, sizeof(VkDrawIndirectCommand));
+
+	const std::string header = SceneHeader;
+	if (!ReducePipeline.Create(ReduceShader, "hiz_reduce.comp", { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE }, 0,
+			levelCount, ReduceGroupSize, ReduceGroupSize)
+		|| !CullPipeline.Create((header + CullShader).c_str(), "hiz_cull.comp", { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER }, 0, 1, CullGroupSize)) {
+		return false;
+	}
+
+	GraphicsPipelineState depthState;
+	depthState.renderPass = renderPass;
+	depthState.colorAttachmentCount = 1;
+	depthState.colorWrite = false;
+	depthState.depthTest = true;
+	depthState.depthWrite = true;
+
+	GraphicsPipelineState shadeState = depthState;
+	shadeState.colorWrite = true;
+	shadeState.depthWrite = false;
+	shadeState.depthCompare = VK_COMPARE_OP_EQUAL;
+
+	const std::string vertexShader = header + DrawVertexShader;
+	const std::vector<VkDescriptorType> drawBindings = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER };
+	if (!DepthPipeline.Create(vertexShader.c_str(), nullptr, "hiz_depth", drawBindings, 0, 1, depthState)
+		|| !ShadePipeline.Create(vertexShader.c_str(), ShadeFragmentShader, "hiz_shade", drawBindings, 0, 1, shadeState)) {
+		return false;
+	}
+
+	ReduceSets.assign(levelCount, VK_NULL_HANDLE);
+	for (uint32_t level = 0; level < levelCount; ++level) {
+		if (!ReducePipeline.AllocateDescriptorSet(ReduceSets[level])) {
+			return false;
+		}
+		if (level == 0) {
+			ReducePipeline.WriteImage(ReduceSets[level], 0, depthView, Sampler, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+		} else {
+			ReducePipeline.WriteImage(ReduceSets[level], 0, LevelViews[level - 1], Sampler, VK_IMAGE_LAYOUT_GENERAL);
+		}
+		ReducePipeline.WriteStorageImage(ReduceSets[level], 1, LevelViews[level]);
+	}
+
+	if (!CullPipeline.AllocateDescriptorSet(CullSet) || !DepthPipeline.AllocateDescriptorSet(DepthSet) || !ShadePipeline.AllocateDescriptorSet(ShadeSet)) {
+		return false;
+	}
+	CullPipeline.WriteBuffer(CullSet, 0, Uniforms.handle);
+	CullPipeline.WriteBuffer(CullSet, 1, Instances.handle);
+	CullPipeline.WriteBuffer(CullSet, 2, VisibleInstances.handle);
+	CullPipeline.WriteBuffer(CullSet, 3, DrawArguments.handle);
+	CullPipeline.WriteImage(CullSet, 4, Pyramid.view, Sampler, VK_IMAGE_LAYOUT_GENERAL);
+	for (const GraphicsPipeline* pipeline : { &DepthPipeline, &ShadePipeline }) {
+		const VkDescriptorSet set = (pipeline == &DepthPipeline) ? DepthSet : ShadeSet;
+		pipeline->WriteBuffer(set, 0, Uniforms.handle);
+		pipeline->WriteBuffer(set, 1, Instances.handle);
+		pipeline->WriteBuffer(set, 2, VisibleInstances.handle);
+	}
+
+	HistoryValid = false;
+	return true;
+}
+
+void OcclusionCulling::Destroy() {
+	if (Dispatch.device == VK_NULL_HANDLE) {
+		return;
+	}
+
+	ReducePipeline.Destroy();
+	CullPipeline.Destroy();
+	DepthPipeline.Destroy();
+	ShadePipeline.Destroy();
+	ReduceSets.clear();
+	CullSet = VK_NULL_HANDLE;
+	DepthSet = VK_NULL_HANDLE;
+	ShadeSet = VK_NULL_HANDLE;
+
+	DestroyGpuBuffer(Device, Instances);
+	DestroyGpuBuffer(Device, VisibleInstances);
+	DestroyGpuBuffer(Device, DrawArguments);
+	DestroyGpuBuffer(Device, Statistics);
+	DestroyGpuBuffer(Device, Uniforms);
+
+	if (Sampler != VK_NULL_HANDLE) {
+		Dispatch.vkDestroySampler(Dispatch.device, Sampler, nullptr);
+		Sampler = VK_NULL_HANDLE;
+	}
+	for (VkImageView view : LevelViews) {
+		if (view != VK_NULL_HANDLE) {
+			Dispatch.vkDestroyImageView(Dispatch.device, view, nullptr);
+		}
+	}
+	LevelViews.clear();
+	LevelExtents.clear();
+	DestroyGpuImage(Device, Pyramid);
+	Parameters.instanceCount = 0;
+	HistoryValid = false;
+}
+
+bool OcclusionCulling::SetInstances(const std::vector<OcclusionInstance>& instances) {
+	if (instances.size() > MaxInstances) {
+		std::cout << "OCCLUSION CULLING WAS CREATED FOR AT MOST " << MaxInstances << " INSTANCES " << std::endl;
+		return false;
+	}
+	if (!instances.empty()) {
+		memcpy(Instances.mapped, instances.data(), instances.size() * sizeof(OcclusionInstance));
+	}
+	Parameters.instanceCount = static_cast<uint32_t>(instances.size());
+	return true;
+}
+
+void OcclusionCulling::SetCamera(const SceneCamera& camera) {
+	Camera = camera;
+}
+
+void OcclusionCulling::SetOcclusionEnabled(bool enabled) {
+	OcclusionEnabled = enabled;
+}
+
+void OcclusionCulling::CmdCull(VkCommandBuffer commandBuffer, VkExtent2D extent) {
+	const float aspect = static_cast<float>(extent.width) / static_cast<float>(std::max<uint32_t>(extent.height, 1));
+	if (HistoryValid) {
+		memcpy(Parameters.previousViewProjection, Parameters.viewProjection, sizeof(Parameters.viewProjection));
+	}
+	GetCameraViewProjection(Camera, aspect, Parameters.viewProjection);
+	const bool occlusion = OcclusionEnabled && HistoryValid;
+	Parameters.occlusion = occlusion ? 1 : 0;
+	memcpy(Uniforms.mapped, &Parameters, sizeof(Constants));
+
+	// Pyramid is rebuilt from scratch; the last frame's culling was its only reader
+	VkImageMemoryBarrier imageMemoryBarrier = {};
+	imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageMemoryBarrier.pNext = nullptr;
+	imageMemoryBarrier.srcAccessMask = 0;
+	imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarrier.image = Pyramid.handle;
+	imageMemoryBarrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, Pyramid.mipLevels, 0, 1 };
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+
+	if (occlusion) {
+		for (uint32_t level = 0; level < static_cast<uint32_t>(LevelExtents.size()); ++level) {
+			ReducePipeline.CmdBind(commandBuffer, ReduceSets[level]);
+			ReducePipeline.CmdDispatch(commandBuffer, LevelExtents[level].width, LevelExtents[level].height);
+			CmdComputeBarrier(Dispatch, commandBuffer);
+		}
+	}
+
+	// Arguments were read by the last frame's draws and copied to the statistics
+	VkMemoryBarrier memoryBarrier = {};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.pNext = nullptr;
+	memoryBarrier.srcAccessMask = 0;
+	memoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+	Dispatch.vkCmdFillBuffer(commandBuffer, DrawArguments.handle, 0, VK_WHOLE_SIZE, 0);
+
+	memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+	CullPipeline.CmdBind(commandBuffer, CullSet);
+	CullPipeline.CmdDispatch(commandBuffer, std::max<uint32_t>(Parameters.instanceCount, 1));
+
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+	VkBufferCopy region = { 0, 0, sizeof(VkDrawIndirectCommand) };
+	Dispatch.vkCmdCopyBuffer(commandBuffer, DrawArguments.handle, Statistics.handle, 1, &region);
+	memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+	// This frame's render pass leaves the depth the next frame builds its pyramid from
+	HistoryValid = true;
+}
+
+void OcclusionCulling::CmdPrePass(VkCommandBuffer commandBuffer, const OffscreenFrame& frame) {
+	CmdCull(commandBuffer, frame.extent);
+}
+
+void OcclusionCulling::CmdDraw(VkCommandBuffer commandBuffer, const OffscreenFrame& /*frame*/) const {
+	DepthPipeline.CmdBind(commandBuffer, DepthSet);
+	Dispatch.vkCmdDrawIndirect(commandBuffer, DrawArguments.handle, 0, 1, sizeof(VkDrawIndirectCommand));
+	ShadePipeline.CmdBind(commandBuffer, ShadeSet);
+	Dispatch.vkCmdDrawIndirect(commandBuffer, DrawArguments.handle, 0, 1, sizeof(VkDrawIndirectCommand));
+}
+
+uint32_t OcclusionCulling::GetVisibleCount() const {
+	return static_cast<const VkDrawIndirectCommand*>(Statistics.mapped)->instanceCount;
+}
+
+uint32_t OcclusionCulling::GetInstanceCount() const {
+	return Parameters.instanceCount;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "ComputePipeline.h"
+#include "GraphicsPipeline.h"
+#include "OffscreenRenderer.h"
+#include "SceneCamera.h"
+#include <cstdint>
+#include <vector>
+
+// Axis aligned box in world space
+struct OcclusionInstance {
+	float center[3];
+	float shade;				// 0 to 1, brightness of the box
+	float halfExtent[3];
+	float padding;
+
+	OcclusionInstance() :
+		center(),
+		shade(0.5f),
+		halfExtent(),
+		padding(0.0f) {
+	}
+};
+
+// GPU driven drawing of many boxes with a depth pre-pass and hierarchical Z occlusion culling.
+// Each frame a compute pass reduces the previous frame's depth buffer into a pyramid of the farthest depth per texel,
+// then one invocation per instance tests its bounds against the view frustum and, reprojected with the previous frame's
+// camera, against the pyramid level where the bounds cover at most 2x2 texels. Survivors are appended to a visible list
+// whose count feeds an indirect draw. Inside the render pass the visible boxes are drawn twice: depth only, then shaded
+// with an EQUAL depth test, so every pixel is shaded once.
+// Boxes hidden last frame but revealed by camera movement can show up a frame late.
+class OcclusionCulling : public OffscreenDrawable {
+public:
+	// Context's dispatch table must outlive the culling
+	explicit OcclusionCulling(const DeviceContext& device);
+	~OcclusionCulling();
+
+	OcclusionCulling(const OcclusionCulling&) = delete;
+	OcclusionCulling& operator=(const OcclusionCulling&) = delete;
+
+	// Boxes are drawn in the first subpass of render passes compatible with renderPass. depthView is the reversed
+	// depth that render pass leaves behind (OffscreenRenderer::GetDepthView()), in DEPTH_STENCIL_READ_ONLY_OPTIMAL layout;
+	// multisampled render passes have no such depth.
+	bool Create(uint32_t maxInstances, VkRenderPass renderPass, VkImageView depthView, VkExtent2D depthExtent);
+	void Destroy();
+
+	// Instances are written straight into mapped memory, so no frame using the previous ones may still be executing
+	bool SetInstances(const std::vector<OcclusionInstance>& instances);
+	void SetCamera(const SceneCamera& camera);
+	// Without occlusion only frustum culling is done
+	void SetOcclusionEnabled(bool enabled);
+
+	// Outside a render pass, before the render pass which fills depthView. The previous frame must have finished.
+	void CmdCull(VkCommandBuffer commandBuffer, VkExtent2D extent);
+
+	// Culls before the render pass, then draws the visible boxes in it
+	void CmdPrePass(VkCommandBuffer commandBuffer, const OffscreenFrame& frame) override;
+	void CmdDraw(VkCommandBuffer commandBuffer, const OffscreenFrame& frame) const override;
+
+	// Instances drawn by the last finished frame
+	uint32_t GetVisibleCount() const;
+	uint32_t GetInstanceCount() const;
+
+private:
+	// Uniform block of the culling and drawing shaders, std140
+	struct Constants {
+		float viewProjection[16];
+		float previousViewProjection[16];		// Of the depth the pyramid is built from
+		uint32_t instanceCount;
+		uint32_t occlusion;						// Test against the pyramid
+		uint32_t padding[2];
+	};
+
+	DeviceContext Device;
+	const DeviceDispatchTable& Dispatch;
+	ComputePipeline ReducePipeline;
+	ComputePipeline CullPipeline;
+	GraphicsPipeline DepthPipeline;
+	GraphicsPipeline ShadePipeline;
+
+	GpuImage Pyramid;							// Farthest depth, level 0 at half the depth buffer's size
+	std::vector<VkImageView> LevelViews;
+	std::vector<VkExtent2D> LevelExtents;
+	std::vector<VkDescriptorSet> ReduceSets;	// Level 0 reads the depth buffer, the others the level before
+	VkSampler Sampler;
+
+	GpuBuffer Instances;						// Host visible
+	GpuBuffer VisibleInstances;
+	GpuBuffer DrawArguments;					// VkDrawIndirectCommand
+	GpuBuffer Statistics;						// Host visible copy of the draw arguments
+	GpuBuffer Uniforms;
+	VkDescriptorSet CullSet;
+	VkDescriptorSet DepthSet;
+	VkDescriptorSet ShadeSet;
+
+	uint32_t MaxInstances;
+	SceneCamera Camera;
+	Constants Parameters;
+	bool OcclusionEnabled;
+	bool HistoryValid;							// Depth of a previous frame is available
+};
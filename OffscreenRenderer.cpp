@@ -0,0 +1,1103 @@
+#include "OffscreenRenderer.h"
+#include "VulkanFunctions.h"
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+namespace {
+	const char* TriangleVertexShader = R"(
+#version 450
+
+layout(location = 0) in vec2 Position;
+
+layout(push_constant) uniform Camera {
+	vec2 Center;
+	float Zoom;
+} camera;
+
+void main() {
+	gl_Position = vec4((Position - camera.Center) * camera.Zoom, 0.0, 1.0);
+}
+)";
+
+	const char* TriangleFragmentShader = R"(
+#version 450
+
+// Different values make otherwise identical pipelines distinct objects
+layout(constant_id = 0) const float Tint = 0.0;
+
+layout(location = 0) out vec4 Color;
+
+void main() {
+	Color = vec4(0.9, 0.4 + 0.5 * Tint, 0.2, 1.0);
+}
+)";
+
+	// Layout of the Camera push constant block
+	const uint32_t CameraPushConstantSize = 4 * sizeof(float);
+
+	// Color of the scene subpass when it is post-processed
+	const VkFormat PostSceneFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+	// Depth attachment that can also be sampled, the first one supported is used
+	const VkFormat DepthFormats[2] = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM };
+
+	const VkClearColorValue ClearColor = {
+		{28.0f / 256.0f, 38.0f / 256.0f, 54.0f / 256.0f, 1.0f}
+	};
+}
+
+OffscreenRenderer::OffscreenRenderer(VulkanBase& vulkan) :
+	OffscreenRenderer(vulkan.GetDeviceContext()) {
+	Device.pipelineCache = vulkan.GetPipelineCache();
+}
+
+OffscreenRenderer::OffscreenRenderer(const DeviceContext& device) :
+	Device(device),
+	Dispatch(*device.dispatch),
+	Compiler(),
+	Timer(),
+	Post(device),
+	Format(VK_FORMAT_UNDEFINED),
+	SceneFormat(VK_FORMAT_UNDEFINED),
+	DepthFormat(VK_FORMAT_UNDEFINED),
+	Samples(VK_SAMPLE_COUNT_1_BIT),
+	Extent(),
+	Target(),
+	OutputImage(VK_NULL_HANDLE),
+	OutputExtent(),
+	SceneColor(),
+	SceneResolve(),
+	StageTargets(),
+	Depth(),
+	RenderPass(VK_NULL_HANDLE),
+	Framebuffer(VK_NULL_HANDLE),
+	VertexShader(VK_NULL_HANDLE),
+	FragmentShader(VK_NULL_HANDLE),
+	PipelineLayout(VK_NULL_HANDLE),
+	Pipelines(),
+	VertexBuffer(VK_NULL_HANDLE),
+	VertexBufferMemory(VK_NULL_HANDLE),
+	TriangleCount(0),
+	ReadbackBuffer(VK_NULL_HANDLE),
+	ReadbackMemory(VK_NULL_HANDLE),
+	ReadbackSize(0),
+	ReadbackData(nullptr),
+	CommandPool(VK_NULL_HANDLE),
+	CommandBuffer(VK_NULL_HANDLE),
+	Fence(VK_NULL_HANDLE),
+	Pending(false),
+	SignalSemaphore(VK_NULL_HANDLE),
+	SignalValue(0) {
+}
+
+OffscreenRenderer::~OffscreenRenderer() {
+	Destroy();
+}
+
+bool OffscreenRenderer::Create(VkExtent2D extent, VkFormat format, VkSampleCountFlagBits samples, const PostProcessSettings& post) {
+	Destroy();
+	Extent = extent;
+	Format = format;
+	Samples = samples;
+	// Post-processing starts from linear HDR color
+	Post.Configure(post);
+	SceneFormat = (Post.GetStageCount() > 0) ? PostSceneFormat : Format;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(Device.physicalDevice, &properties);
+	if ((properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts & Samples) == 0) {
+		std::cout << "SAMPLE COUNT " << Samples << " NOT SUPPORTED FOR OFFSCREEN RENDERING " << std::endl;
+		return false;
+	}
+
+	// Multisampled depth is transient, only single sampled depth is kept for sampling
+	DepthFormat = VK_FORMAT_UNDEFINED;
+	for (VkFormat candidate : DepthFormats) {
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(Device.physicalDevice, candidate, &formatProperties);
+		const VkFormatFeatureFlags features = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+			| ((Samples == VK_SAMPLE_COUNT_1_BIT) ? VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT : 0);
+		if ((formatProperties.optimalTilingFeatures & features) == features) {
+			DepthFormat = candidate;
+			break;
+		}
+	}
+	if (DepthFormat == VK_FORMAT_UNDEFINED) {
+		std::cout << "NO DEPTH FORMAT FOR OFFSCREEN RENDERING " << std::endl;
+		return false;
+	}
+
+	if (!CreateRenderPass() || !Post.Create(RenderPass, 1) || !CreateTarget()) {
+		return false;
+	}
+
+	if (!Compiler.CreateShaderModule(Dispatch, TriangleVertexShader, VK_SHADER_STAGE_VERTEX_BIT, "triangle.vert", VertexShader)
+		|| !Compiler.CreateShaderModule(Dispatch, TriangleFragmentShader, VK_SHADER_STAGE_FRAGMENT_BIT, "triangle.frag", FragmentShader)) {
+		return false;
+	}
+
+	VkPushConstantRange pushConstantRange = { VK_SHADER_STAGE_VERTEX_BIT, 0, CameraPushConstantSize };
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.pNext = nullptr;
+	pipelineLayoutCreateInfo.flags = 0;
+	pipelineLayoutCreateInfo.setLayoutCount = 0;
+	pipelineLayoutCreateInfo.pSetLayouts = nullptr;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (Dispatch.vkCreatePipelineLayout(Dispatch.device, &pipelineLayoutCreateInfo, nullptr, &PipelineLayout) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE PIPELINE LAYOUT " << std::endl;
+		return false;
+	}
+
+	if (!SetPipelineCount(1)) {
+		return false;
+	}
+
+	VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+	commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	commandPoolCreateInfo.pNext = nullptr;
+	commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	commandPoolCreateInfo.queueFamilyIndex = Device.graphicsQueueFamilyIndex;
+
+	if (Dispatch.vkCreateCommandPool(Dispatch.device, &commandPoolCreateInfo, nullptr, &CommandPool) != VK_SUCCESS) {
+		std::cout << "ERROR WHILE CREATING COMMAND POOL " << std::endl;
+		return false;
+	}
+
+	VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+	commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	commandBufferAllocateInfo.pNext = nullptr;
+	commandBufferAllocateInfo.commandPool = CommandPool;
+	commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	commandBufferAllocateInfo.commandBufferCount = 1;
+
+	if (Dispatch.vkAllocateCommandBuffers(Dispatch.device, &commandBufferAllocateInfo, &CommandBuffer) != VK_SUCCESS) {
+		std::cout << "COULD NOT ALLOCATE COMMAND BUFFERS FROM COMMAND POOL " << std::endl;
+		return false;
+	}
+
+	VkFenceCreateInfo fenceCreateInfo = {};
+	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceCreateInfo.pNext = nullptr;
+	fenceCreateInfo.flags = 0;
+
+	if (Dispatch.vkCreateFence(Dispatch.device, &fenceCreateInfo, nullptr, &Fence) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE FENCE " << std::endl;
+		return false;
+	}
+
+	Timer.Create(Device.physicalDevice, Dispatch, Device.graphicsQueue, Device.graphicsQueueFamilyIndex, 1);
+	return true;
+}
+
+bool OffscreenRenderer::Resize(VkExtent2D extent) {
+	// Viewport and scissor are dynamic, so pipelines survive - only the image and framebuffer are recreated
+	if (!Wait()) {
+		return false;
+	}
+	DestroyTarget();
+	Extent = extent;
+	return CreateTarget();
+}
+
+void OffscreenRenderer::Destroy() {
+	if (Dispatch.device == VK_NULL_HANDLE) {
+		return;
+	}
+	// Only this renderer's own work is waited for, other users of the device keep running
+	if (Fence != VK_NULL_HANDLE) {
+		Wait();
+	}
+	Pending = false;
+
+	Timer.Destroy();
+	DestroyReadbackBuffer();
+	if (Fence != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyFence(Dispatch.device, Fence, nullptr);
+		Fence = VK_NULL_HANDLE;
+	}
+	if (CommandPool != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyCommandPool(Dispatch.device, CommandPool, nullptr);
+		CommandPool = VK_NULL_HANDLE;
+		CommandBuffer = VK_NULL_HANDLE;
+	}
+	if (VertexBuffer != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyBuffer(Dispatch.device, VertexBuffer, nullptr);
+		VertexBuffer = VK_NULL_HANDLE;
+	}
+	if (VertexBufferMemory != VK_NULL_HANDLE) {
+		Dispatch.vkFreeMemory(Dispatch.device, VertexBufferMemory, nullptr);
+		VertexBufferMemory = VK_NULL_HANDLE;
+	}
+	TriangleCount = 0;
+
+	for (VkPipeline pipeline : Pipelines) {
+		Dispatch.vkDestroyPipeline(Dispatch.device, pipeline, nullptr);
+	}
+	Pipelines.clear();
+	if (PipelineLayout != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyPipelineLayout(Dispatch.device, PipelineLayout, nullptr);
+		PipelineLayout = VK_NULL_HANDLE;
+	}
+	if (VertexShader != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyShaderModule(Dispatch.device, VertexShader, nullptr);
+		VertexShader = VK_NULL_HANDLE;
+	}
+	if (FragmentShader != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyShaderModule(Dispatch.device, FragmentShader, nullptr);
+		FragmentShader = VK_NULL_HANDLE;
+	}
+
+	DestroyTarget();
+	Post.Destroy();
+	if (RenderPass != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyRenderPass(Dispatch.device, RenderPass, nullptr);
+		RenderPass = VK_NULL_HANDLE;
+	}
+}
+
+bool OffscreenRenderer::SetTriangleCount(uint32_t count) {
+	if (count == TriangleCount) {
+		return true;
+	}
+
+	if (VertexBuffer != VK_NULL_HANDLE) {
+		if (!Wait()) {
+			return false;
+		}
+		Dispatch.vkDestroyBuffer(Dispatch.device, VertexBuffer, nullptr);
+		Dispatch.vkFreeMemory(Dispatch.device, VertexBufferMemory, nullptr);
+		VertexBuffer = VK_NULL_HANDLE;
+		VertexBufferMemory = VK_NULL_HANDLE;
+		TriangleCount = 0;
+	}
+	if (count == 0) {
+		return true;
+	}
+
+	const VkDeviceSize size = static_cast<VkDeviceSize>(count) * 3 * 2 * sizeof(float);
+	if (!CreateBuffer(size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VertexBuffer, VertexBufferMemory)) {
+		return false;
+	}
+
+	void* data = nullptr;
+	if (Dispatch.vkMapMemory(Dispatch.device, VertexBufferMemory, 0, size, 0, &data) != VK_SUCCESS) {
+		std::cout << "COULD NOT MAP VERTEX BUFFER MEMORY " << std::endl;
+		return false;
+	}
+
+	// One triangle per grid cell, covering most of the cell
+	const uint32_t columns = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+	const uint32_t rows = (count + columns - 1) / columns;
+	const float cellWidth = 2.0f / columns;
+	const float cellHeight = 2.0f / rows;
+
+	float* vertices = static_cast<float*>(data);
+	for (uint32_t i = 0; i < count; ++i) {
+		const float left = -1.0f + (i % columns) * cellWidth;
+		const float top = -1.0f + (i / columns) * cellHeight;
+		const float triangle[6] = {
+			left + 0.5f * cellWidth, top + 0.1f * cellHeight,
+			left + 0.9f * cellWidth, top + 0.9f * cellHeight,
+			left + 0.1f * cellWidth, top + 0.9f * cellHeight
+		};
+		memcpy(vertices + 6 * i, triangle, sizeof(triangle));
+	}
+	Dispatch.vkUnmapMemory(Dispatch.device, VertexBufferMemory);
+
+	TriangleCount = count;
+	return true;
+}
+
+bool OffscreenRenderer::SetPipelineCount(uint32_t count) {
+	if (count < 1) {
+		count = 1;
+	}
+
+	if (count < Pipelines.size()) {
+		if (!Wait()) {
+			return false;
+		}
+		for (size_t i = count; i < Pipelines.size(); ++i) {
+			Dispatch.vkDestroyPipeline(Dispatch.device, Pipelines[i], nullptr);
+		}
+		Pipelines.resize(count);
+	}
+
+	while (Pipelines.size() < count) {
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		if (!CreatePipeline(static_cast<uint32_t>(Pipelines.size()), pipeline)) {
+			return false;
+		}
+		Pipelines.push_back(pipeline);
+	}
+	return true;
+}
+
+bool OffscreenRenderer::Record(const OffscreenDrawList& drawList) {
+	if (static_cast<uint64_t>(drawList.drawCount) * drawList.trianglesPerDraw > TriangleCount) {
+		std::cout << "NOT ENOUGH TRIANGLES FOR " << drawList.drawCount << " DRAWS " << std::endl;
+		return false;
+	}
+	if (drawList.pipelineCount > Pipelines.size()) {
+		std::cout << "NOT ENOUGH PIPELINES FOR THE DRAW LIST " << std::endl;
+		return false;
+	}
+	// The last drawable replacing the result wins
+	VkImage outputImage = Target.handle;
+	VkExtent2D outputExtent = Extent;
+	for (const OffscreenDrawable* drawable : drawList.drawables) {
+		VkImage image = VK_NULL_HANDLE;
+		VkExtent2D extent = {};
+		if (drawable->GetOutput(image, extent)) {
+			outputImage = image;
+			outputExtent = extent;
+		}
+	}
+	const VkDeviceSize imageSize = static_cast<VkDeviceSize>(outputExtent.width) * outputExtent.height * 4;
+	if ((drawList.readback != nullptr) && ((drawList.readback->size < imageSize) || ((Format != VK_FORMAT_R8G8B8A8_UNORM) && (Format != VK_FORMAT_B8G8R8A8_UNORM)))) {
+		std::cout << "READBACK SLOT DOESN'T FIT THE OFFSCREEN IMAGE " << std::endl;
+		return false;
+	}
+	SignalSemaphore = (drawList.readback != nullptr) ? drawList.readback->semaphore : VK_NULL_HANDLE;
+	SignalValue = (drawList.readback != nullptr) ? drawList.readback->value : 0;
+
+	OffscreenFrame frame = {};
+	frame.extent = Extent;
+	frame.camera = drawList.camera;
+	frame.deltaSeconds = drawList.deltaSeconds;
+
+	// Everything that can fail happens before the command buffer begins, so it is never left recording
+	for (OffscreenDrawable* drawable : drawList.drawables) {
+		if (!drawable->Prepare(frame)) {
+			return false;
+		}
+	}
+	OutputImage = outputImage;
+	OutputExtent = outputExtent;
+
+	VkCommandBufferBeginInfo cmdBufferBeginInfo = {};
+	cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	cmdBufferBeginInfo.pNext = nullptr;
+	cmdBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	cmdBufferBeginInfo.pInheritanceInfo = nullptr;
+
+	if (Dispatch.vkBeginCommandBuffer(CommandBuffer, &cmdBufferBeginInfo) != VK_SUCCESS) {
+		std::cout << "COULD NOT BEGIN COMMAND BUFFER " << std::endl;
+		return false;
+	}
+	Timer.CmdBegin(CommandBuffer, 0);
+	for (OffscreenDrawable* drawable : drawList.drawables) {
+		drawable->CmdPrePass(CommandBuffer, frame);
+	}
+
+	VkClearValue clearValues[2] = {};
+	clearValues[0].color = ClearColor;
+	clearValues[1].depthStencil = { 0.0f, 0 };
+
+	VkRenderPassBeginInfo renderPassBeginInfo = {};
+	renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassBeginInfo.pNext = nullptr;
+	renderPassBeginInfo.renderPass = RenderPass;
+	renderPassBeginInfo.framebuffer = Framebuffer;
+	renderPassBeginInfo.renderArea.offset = { 0, 0 };
+	renderPassBeginInfo.renderArea.extent = Extent;
+	renderPassBeginInfo.clearValueCount = 2;
+	renderPassBeginInfo.pClearValues = clearValues;
+
+	Dispatch.vkCmdBeginRenderPass(CommandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+	if ((drawList.drawCount > 0) || !drawList.drawables.empty()) {
+		VkViewport viewport = { 0.0f, 0.0f, static_cast<float>(Extent.width), static_cast<float>(Extent.height), 0.0f, 1.0f };
+		VkRect2D scissor = { { 0, 0 }, Extent };
+		Dispatch.vkCmdSetViewport(CommandBuffer, 0, 1, &viewport);
+		Dispatch.vkCmdSetScissor(CommandBuffer, 0, 1, &scissor);
+	}
+	for (const OffscreenDrawable* drawable : drawList.drawables) {
+		drawable->CmdDraw(CommandBuffer, frame);
+	}
+
+	if (drawList.drawCount > 0) {
+		VkDeviceSize offset = 0;
+		Dispatch.vkCmdBindVertexBuffers(CommandBuffer, 0, 1, &VertexBuffer, &offset);
+
+		const float camera[4] = { drawList.camera.centerX, drawList.camera.centerY, drawList.camera.zoom, 0.0f };
+		Dispatch.vkCmdPushConstants(CommandBuffer, PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, CameraPushConstantSize, camera);
+
+		const uint32_t pipelineCount = (drawList.pipelineCount > 0) ? drawList.pipelineCount : 1;
+		const uint32_t vertexCount = 3 * drawList.trianglesPerDraw;
+		for (uint32_t i = 0; i < drawList.drawCount; ++i) {
+			if ((pipelineCount > 1) || (i == 0)) {
+				Dispatch.vkCmdBindPipeline(CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, Pipelines[i % pipelineCount]);
+			}
+			Dispatch.vkCmdDraw(CommandBuffer, vertexCount, 1, i * vertexCount, 0);
+		}
+	}
+	for (const OffscreenDrawable* drawable : drawList.drawables) {
+		drawable->CmdDrawOverlay(CommandBuffer, frame);
+	}
+	Post.CmdDraw(CommandBuffer, Extent);
+
+	Dispatch.vkCmdEndRenderPass(CommandBuffer);
+	for (OffscreenDrawable* drawable : drawList.drawables) {
+		drawable->CmdPostPass(CommandBuffer, frame);
+	}
+	Timer.CmdEnd(CommandBuffer, 0);
+	if (drawList.readback != nullptr) {
+		CmdCopyToBuffer(drawList.readback->buffer, drawList.readback->offset);
+	}
+
+	if (Dispatch.vkEndCommandBuffer(CommandBuffer) != VK_SUCCESS) {
+		std::cout << "COULD NOT RECORD COMMAND BUFFER " << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool OffscreenRenderer::Submit() {
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = nullptr;
+	submitInfo.waitSemaphoreCount = 0;
+	submitInfo.pWaitSemaphores = nullptr;
+	submitInfo.pWaitDstStageMask = nullptr;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &CommandBuffer;
+	submitInfo.signalSemaphoreCount = 0;
+	submitInfo.pSignalSemaphores = nullptr;
+
+	VkTimelineSemaphoreSubmitInfoKHR timelineSubmitInfo = {};
+	timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+	timelineSubmitInfo.pNext = nullptr;
+	timelineSubmitInfo.waitSemaphoreValueCount = 0;
+	timelineSubmitInfo.pWaitSemaphoreValues = nullptr;
+	timelineSubmitInfo.signalSemaphoreValueCount = 1;
+	timelineSubmitInfo.pSignalSemaphoreValues = &SignalValue;
+	if (SignalSemaphore != VK_NULL_HANDLE) {
+		submitInfo.pNext = &timelineSubmitInfo;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &SignalSemaphore;
+	}
+
+	if (Dispatch.vkQueueSubmit(Device.graphicsQueue, 1, &submitInfo, Fence) != VK_SUCCESS) {
+		std::cout << "COULD NOT SUBMIT COMMAND BUFFER " << std::endl;
+		return false;
+	}
+	Pending = true;
+	SignalSemaphore = VK_NULL_HANDLE;
+	return true;
+}
+
+bool OffscreenRenderer::Wait() {
+	if (!Pending) {
+		return true;
+	}
+	if (Dispatch.vkWaitForFences(Dispatch.device, 1, &Fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS) {
+		std::cout << "WAITING FOR FENCE TOOK TOO LONG " << std::endl;
+		return false;
+	}
+	Pending = false;
+	return Dispatch.vkResetFences(Dispatch.device, 1, &Fence) == VK_SUCCESS;
+}
+
+bool OffscreenRenderer::GetGpuTime(double& milliseconds) const {
+	return Timer.GetResult(0, milliseconds);
+}
+
+bool OffscreenRenderer::ReadPixels(std::vector<uint8_t>& rgba) {
+	// The command buffer is reused for the copy, so the frame must be done with it
+	if (!Wait() || !PrepareReadbackBuffer()) {
+		return false;
+	}
+
+	VkCommandBufferBeginInfo cmdBufferBeginInfo = {};
+	cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	cmdBufferBeginInfo.pNext = nullptr;
+	cmdBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	cmdBufferBeginInfo.pInheritanceInfo = nullptr;
+
+	if (Dispatch.vkBeginCommandBuffer(CommandBuffer, &cmdBufferBeginInfo) != VK_SUCCESS) {
+		std::cout << "COULD NOT READ BACK OFFSCREEN IMAGE " << std::endl;
+		return false;
+	}
+	CmdCopyToBuffer(ReadbackBuffer, 0);
+	SignalSemaphore = VK_NULL_HANDLE;
+	if (Dispatch.vkEndCommandBuffer(CommandBuffer) != VK_SUCCESS) {
+		std::cout << "COULD NOT READ BACK OFFSCREEN IMAGE " << std::endl;
+		return false;
+	}
+	if (!Submit() || !Wait()) {
+		return false;
+	}
+
+	rgba.resize(static_cast<size_t>(ReadbackSize));
+	memcpy(rgba.data(), ReadbackData, rgba.size());
+	if (Format == VK_FORMAT_B8G8R8A8_UNORM) {
+		for (size_t i = 0; i < rgba.size(); i += 4) {
+			std::swap(rgba[i], rgba[i + 2]);
+		}
+	}
+	return true;
+}
+
+VkExtent2D OffscreenRenderer::GetOutputExtent() const {
+	return OutputExtent;
+}
+
+VkImage OffscreenRenderer::GetImage() const {
+	return Target.handle;
+}
+
+VkImageView OffscreenRenderer::GetImageView() const {
+	return Target.view;
+}
+
+VkFormat OffscreenRenderer::GetFormat() const {
+	return Format;
+}
+
+VkExtent2D OffscreenRenderer::GetExtent() const {
+	return Extent;
+}
+
+VkRenderPass OffscreenRenderer::GetRenderPass() const {
+	return RenderPass;
+}
+
+VkSampleCountFlagBits OffscreenRenderer::GetSampleCount() const {
+	return Samples;
+}
+
+bool OffscreenRenderer::HasLazyAttachments() const {
+	// Single sampled depth is sampled later, so it isn't transient
+	bool transient = false;
+	bool lazy = true;
+	for (const GpuImage* image : { &SceneColor, &SceneResolve, &Depth }) {
+		if ((image->handle != VK_NULL_HANDLE) && ((image != &Depth) || (Samples != VK_SAMPLE_COUNT_1_BIT))) {
+			transient = true;
+			lazy = lazy && image->lazilyAllocated;
+		}
+	}
+	for (const GpuImage& stageTarget : StageTargets) {
+		transient = true;
+		lazy = lazy && stageTarget.lazilyAllocated;
+	}
+	return transient && lazy;
+}
+
+bool OffscreenRenderer::SetPostParameters(uint32_t effect, float x, float y, float z, float w) {
+	return Post.SetParameters(effect, x, y, z, w);
+}
+
+VkImageView OffscreenRenderer::GetDepthView() const {
+	if (Samples != VK_SAMPLE_COUNT_1_BIT) {
+		return VK_NULL_HANDLE;
+	}
+	return Depth.view;
+}
+
+VkFormat OffscreenRenderer::GetDepthFormat() const {
+	return DepthFormat;
+}
+
+bool OffscreenRenderer::CreateTarget() {
+	VkImageCreateInfo imageCreateInfo = {};
+	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.pNext = nullptr;
+	imageCreateInfo.flags = 0;
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.format = Format;
+	imageCreateInfo.extent = { Extent.width, Extent.height, 1 };
+	imageCreateInfo.mipLevels = 1;
+	imageCreateInfo.arrayLayers = 1;
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	// Sampled by temporal upscaling
+	imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageCreateInfo.queueFamilyIndexCount = 0;
+	imageCreateInfo.pQueueFamilyIndices = nullptr;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	if (Dispatch.vkCreateImage(Dispatch.device, &imageCreateInfo, nullptr, &Target.handle) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE OFFSCREEN IMAGE " << std::endl;
+		return false;
+	}
+
+	VkMemoryRequirements memoryRequirements;
+	Dispatch.vkGetImageMemoryRequirements(Dispatch.device, Target.handle, &memoryRequirements);
+
+	VkMemoryAllocateInfo memoryAllocateInfo = {};
+	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memoryAllocateInfo.pNext = nullptr;
+	memoryAllocateInfo.allocationSize = memoryRequirements.size;
+	if (!Device.GetMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, memoryAllocateInfo.memoryTypeIndex)) {
+		std::cout << "NO DEVICE LOCAL MEMORY TYPE FOR OFFSCREEN IMAGE " << std::endl;
+		return false;
+	}
+
+	if ((Dispatch.vkAllocateMemory(Dispatch.device, &memoryAllocateInfo, nullptr, &Target.deviceMemory) != VK_SUCCESS)
+		|| (Dispatch.vkBindImageMemory(Dispatch.device, Target.handle, Target.deviceMemory, 0) != VK_SUCCESS)) {
+		std::cout << "COULD NOT ALLOCATE MEMORY FOR OFFSCREEN IMAGE " << std::endl;
+		return false;
+	}
+
+	VkImageViewCreateInfo imageViewCreateInfo = {};
+	imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	imageViewCreateInfo.pNext = nullptr;
+	imageViewCreateInfo.flags = 0;
+	imageViewCreateInfo.image = Target.handle;
+	imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	imageViewCreateInfo.format = Format;
+	imageViewCreateInfo.components = {
+		VK_COMPONENT_SWIZZLE_IDENTITY,
+		VK_COMPONENT_SWIZZLE_IDENTITY,
+		VK_COMPONENT_SWIZZLE_IDENTITY,
+		VK_COMPONENT_SWIZZLE_IDENTITY
+	};
+	imageViewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	if (Dispatch.vkCreateImageView(Dispatch.device, &imageViewCreateInfo, nullptr, &Target.view) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE OFFSCREEN IMAGE VIEW " << std::endl;
+		return false;
+	}
+	OutputImage = Target.handle;
+	OutputExtent = Extent;
+
+	// Everything but the image only lives inside the render pass, in the order CreateRenderPass() gives the attachments
+	const bool multisampled = Samples != VK_SAMPLE_COUNT_1_BIT;
+	const uint32_t stageCount = Post.GetStageCount();
+	const VkImageUsageFlags transientUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+	const VkImageUsageFlags inputUsage = (stageCount > 0) ? VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT : 0;
+	std::vector<VkImageView> attachments;
+	if (multisampled || (stageCount > 0)) {
+		if (!CreateGpuImage(Device, SceneFormat, Extent, 1, 1, Samples, transientUsage | (multisampled ? 0 : inputUsage), SceneColor)) {
+			return false;
+		}
+		attachments.push_back(SceneColor.view);
+	} else {
+		attachments.push_back(Target.view);
+	}
+
+	if (!CreateGpuImage(Device, DepthFormat, Extent, 1, 1, Samples, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+		| (multisampled ? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT : VK_IMAGE_USAGE_SAMPLED_BIT), Depth)) {
+		return false;
+	}
+	attachments.push_back(Depth.view);
+
+	if (multisampled && (stageCount > 0)) {
+		if (!CreateGpuImage(Device, SceneFormat, Extent, 1, 1, VK_SAMPLE_COUNT_1_BIT, transientUsage | inputUsage, SceneResolve)) {
+			return false;
+		}
+		attachments.push_back(SceneResolve.view);
+	} else if (multisampled) {
+		attachments.push_back(Target.view);
+	}
+
+	// The first stage reads the single sampled scene color, every later one the attachment before its own
+	std::vector<VkImageView> stageInputs(1, multisampled ? SceneResolve.view : SceneColor.view);
+	StageTargets.assign((stageCount > 0) ? stageCount - 1 : 0, GpuImage());
+	for (GpuImage& stageTarget : StageTargets) {
+		if (!CreateGpuImage(Device, SceneFormat, Extent, 1, 1, VK_SAMPLE_COUNT_1_BIT, transientUsage | inputUsage, stageTarget)) {
+			return false;
+		}
+		attachments.push_back(stageTarget.view);
+		stageInputs.push_back(stageTarget.view);
+	}
+	if (stageCount > 0) {
+		attachments.push_back(Target.view);
+		Post.SetInputs(stageInputs);
+	}
+
+	VkFramebufferCreateInfo frameBufferCreateInfo = {};
+	frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	frameBufferCreateInfo.pNext = nullptr;
+	frameBufferCreateInfo.flags = 0;
+	frameBufferCreateInfo.renderPass = RenderPass;
+	frameBufferCreateInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+	frameBufferCreateInfo.pAttachments = attachments.data();
+	frameBufferCreateInfo.width = Extent.width;
+	frameBufferCreateInfo.height = Extent.height;
+	frameBufferCreateInfo.layers = 1;
+
+	if (Dispatch.vkCreateFramebuffer(Dispatch.device, &frameBufferCreateInfo, nullptr, &Framebuffer) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE OFFSCREEN FRAME BUFFER " << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void OffscreenRenderer::DestroyTarget() {
+	DestroyGpuImage(Device, Depth);
+	DestroyGpuImage(Device, SceneColor);
+	DestroyGpuImage(Device, SceneResolve);
+	for (GpuImage& stageTarget : StageTargets) {
+		DestroyGpuImage(Device, stageTarget);
+	}
+	StageTargets.clear();
+	if (Framebuffer != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyFramebuffer(Dispatch.device, Framebuffer, nullptr);
+		Framebuffer = VK_NULL_HANDLE;
+	}
+	if (Target.view != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyImageView(Dispatch.device, Target.view, nullptr);
+		Target.view = VK_NULL_HANDLE;
+	}
+	if (Target.handle != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyImage(Dispatch.device, Target.handle, nullptr);
+		Target.handle = VK_NULL_HANDLE;
+	}
+	OutputImage = VK_NULL_HANDLE;
+	if (Target.deviceMemory != VK_NULL_HANDLE) {
+		Dispatch.vkFreeMemory(Dispatch.device, Target.deviceMemory, nullptr);
+		Target.deviceMemory = VK_NULL_HANDLE;
+	}
+}
+
+bool OffscreenRenderer::CreateRenderPass() {
+	// Attachments: scene color, depth, the multisample resolve, then one per post-processing stage. The last of them
+	// is the image, which ends up ready to be copied out, for readback or a blit to a swapchain image; all the others
+	// are transient, never loaded or stored, so on tilers they don't leave tile memory.
+	// Single sampled depth is kept for the next frame's occlusion culling, which samples it from compute shaders.
+	const bool multisampled = Samples != VK_SAMPLE_COUNT_1_BIT;
+	const uint32_t stageCount = Post.GetStageCount();
+	const VkImageLayout sceneLayout = (stageCount > 0) ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkAttachmentDescription transient = {};
+	transient.flags = 0;
+	transient.format = SceneFormat;
+	transient.samples = VK_SAMPLE_COUNT_1_BIT;
+	transient.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	transient.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	transient.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	transient.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	transient.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	transient.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	std::vector<VkAttachmentDescription> attachmentDescriptions(2, transient);
+	attachmentDescriptions[0].samples = Samples;
+	attachmentDescriptions[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachmentDescriptions[0].finalLayout = multisampled ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : sceneLayout;
+	attachmentDescriptions[1].format = DepthFormat;
+	attachmentDescriptions[1].samples = Samples;
+	attachmentDescriptions[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachmentDescriptions[1].storeOp = multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+	attachmentDescriptions[1].finalLayout = multisampled ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	if (multisampled) {
+		attachmentDescriptions.push_back(transient);
+		attachmentDescriptions.back().finalLayout = sceneLayout;
+	}
+	attachmentDescriptions.insert(attachmentDescriptions.end(), stageCount, transient);
+
+	VkAttachmentDescription& image = (attachmentDescriptions.size() > 2) ? attachmentDescriptions.back() : attachmentDescriptions[0];
+	image.format = Format;
+	image.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	image.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+	VkAttachmentReference colorAttachmentReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+	VkAttachmentReference depthAttachmentReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+	VkAttachmentReference resolveAttachmentReference = { 2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+	// Scene, with the multisampled color resolved at its end, then every stage reads the result of the one before
+	std::vector<VkSubpassDescription> subpassDescriptions(1 + stageCount);
+	subpassDescriptions[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpassDescriptions[0].colorAttachmentCount = 1;
+	subpassDescriptions[0].pColorAttachments = &colorAttachmentReference;
+	subpassDescriptions[0].pResolveAttachments = multisampled ? &resolveAttachmentReference : nullptr;
+	subpassDescriptions[0].pDepthStencilAttachment = &depthAttachmentReference;
+
+	std::vector<VkAttachmentReference> inputAttachmentReferences(stageCount);
+	std::vector<VkAttachmentReference> stageAttachmentReferences(stageCount);
+	uint32_t previous = multisampled ? 2 : 0;
+	for (uint32_t i = 0; i < stageCount; ++i) {
+		const uint32_t output = (multisampled ? 3 : 2) + i;
+		inputAttachmentReferences[i] = { previous, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+		stageAttachmentReferences[i] = { output, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		previous = output;
+
+		VkSubpassDescription& subpassDescription = subpassDescriptions[1 + i];
+		subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpassDescription.inputAttachmentCount = 1;
+		subpassDescription.pInputAttachments = &inputAttachmentReferences[i];
+		subpassDescription.colorAttachmentCount = 1;
+		subpassDescription.pColorAttachments = &stageAttachmentReferences[i];
+	}
+
+	const VkPipelineStageFlags depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	std::vector<VkSubpassDependency> dependencies(2);
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | depthStages;
+	dependencies[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dependencyFlags = 0;
+
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | depthStages;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+	dependencies[1].dependencyFlags = 0;
+
+	if (stageCount > 0) {
+		// Every stage only reads its own pixel of the previous result, so tilers can keep the chain in tile memory
+		VkSubpassDependency stageDependency = {};
+		stageDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		stageDependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		stageDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		stageDependency.dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+		stageDependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+		for (uint32_t i = 0; i < stageCount; ++i) {
+			stageDependency.srcSubpass = i;
+			stageDependency.dstSubpass = i + 1;
+			dependencies.push_back(stageDependency);
+		}
+
+		// Image is written by the last stage instead of the scene
+		VkSubpassDependency imageDependency = dependencies[0];
+		imageDependency.dstSubpass = stageCount;
+		imageDependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		imageDependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies.push_back(imageDependency);
+
+		imageDependency = dependencies[1];
+		imageDependency.srcSubpass = stageCount;
+		imageDependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		imageDependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		imageDependency.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		imageDependency.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		dependencies.push_back(imageDependency);
+	}
+
+	VkRenderPassCreateInfo renderPassCreateInfo = {};
+	renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassCreateInfo.pNext = nullptr;
+	renderPassCreateInfo.flags = 0;
+	renderPassCreateInfo.attachmentCount = static_cast<uint32_t>(attachmentDescriptions.size());
+	renderPassCreateInfo.pAttachments = attachmentDescriptions.data();
+	renderPassCreateInfo.subpassCount = static_cast<uint32_t>(subpassDescriptions.size());
+	renderPassCreateInfo.pSubpasses = subpassDescriptions.data();
+	renderPassCreateInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	renderPassCreateInfo.pDependencies = dependencies.data();
+
+	if (Dispatch.vkCreateRenderPass(Dispatch.device, &renderPassCreateInfo, nullptr, &RenderPass) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE OFFSCREEN RENDER PASS " << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool OffscreenRenderer::CreatePipeline(uint32_t index, VkPipeline& pipeline) {
+	// Tint is derived from the index, so every pipeline is really compiled on its own
+	const float tint = static_cast<float>(index % 64) / 64.0f;
+	VkSpecializationMapEntry specializationEntry = { 0, 0, sizeof(float) };
+	VkSpecializationInfo specializationInfo = { 1, &specializationEntry, sizeof(float), &tint };
+
+	VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = VertexShader;
+	shaderStages[0].pName = "main";
+	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = FragmentShader;
+	shaderStages[1].pName = "main";
+	shaderStages[1].pSpecializationInfo = &specializationInfo;
+
+	VkVertexInputBindingDescription vertexBinding = { 0, 2 * sizeof(float), VK_VERTEX_INPUT_RATE_VERTEX };
+	VkVertexInputAttributeDescription vertexAttribute = { 0, 0, VK_FORMAT_R32G32_SFLOAT, 0 };
+
+	VkPipelineVertexInputStateCreateInfo vertexInputState = {};
+	vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputState.vertexBindingDescriptionCount = 1;
+	vertexInputState.pVertexBindingDescriptions = &vertexBinding;
+	vertexInputState.vertexAttributeDescriptionCount = 1;
+	vertexInputState.pVertexAttributeDescriptions = &vertexAttribute;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = {};
+	inputAssemblyState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssemblyState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	inputAssemblyState.primitiveRestartEnable = VK_FALSE;
+
+	VkPipelineViewportStateCreateInfo viewportState = {};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.pViewports = nullptr;
+	viewportState.scissorCount = 1;
+	viewportState.pScissors = nullptr;
+
+	VkPipelineRasterizationStateCreateInfo rasterizationState = {};
+	rasterizationState.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizationState.depthClampEnable = VK_FALSE;
+	rasterizationState.rasterizerDiscardEnable = VK_FALSE;
+	rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizationState.cullMode = VK_CULL_MODE_NONE;
+	rasterizationState.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterizationState.depthBiasEnable = VK_FALSE;
+	rasterizationState.lineWidth = 1.0f;
+
+	VkPipelineMultisampleStateCreateInfo multisampleState = {};
+	multisampleState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampleState.rasterizationSamples = Samples;
+	multisampleState.sampleShadingEnable = VK_FALSE;
+	multisampleState.minSampleShading = 1.0f;
+
+	// Triangles are a 2D overlay on top of any depth tested geometry
+	VkPipelineDepthStencilStateCreateInfo depthStencilState = {};
+	depthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencilState.depthTestEnable = VK_FALSE;
+	depthStencilState.depthWriteEnable = VK_FALSE;
+	depthStencilState.depthCompareOp = VK_COMPARE_OP_ALWAYS;
+	depthStencilState.depthBoundsTestEnable = VK_FALSE;
+	depthStencilState.stencilTestEnable = VK_FALSE;
+	depthStencilState.minDepthBounds = 0.0f;
+	depthStencilState.maxDepthBounds = 1.0f;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+	colorBlendAttachment.blendEnable = VK_FALSE;
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+	VkPipelineColorBlendStateCreateInfo colorBlendState = {};
+	colorBlendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlendState.logicOpEnable = VK_FALSE;
+	colorBlendState.attachmentCount = 1;
+	colorBlendState.pAttachments = &colorBlendAttachment;
+
+	VkDynamicState dynamicStates[2] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStates;
+
+	VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.pNext = nullptr;
+	pipelineCreateInfo.flags = 0;
+	pipelineCreateInfo.stageCount = 2;
+	pipelineCreateInfo.pStages = shaderStages;
+	pipelineCreateInfo.pVertexInputState = &vertexInputState;
+	pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
+	pipelineCreateInfo.pTessellationState = nullptr;
+	pipelineCreateInfo.pViewportState = &viewportState;
+	pipelineCreateInfo.pRasterizationState = &rasterizationState;
+	pipelineCreateInfo.pMultisampleState = &multisampleState;
+	pipelineCreateInfo.pDepthStencilState = &depthStencilState;
+	pipelineCreateInfo.pColorBlendState = &colorBlendState;
+	pipelineCreateInfo.pDynamicState = &dynamicState;
+	pipelineCreateInfo.layout = PipelineLayout;
+	pipelineCreateInfo.renderPass = RenderPass;
+	pipelineCreateInfo.subpass = 0;
+	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineCreateInfo.basePipelineIndex = -1;
+
+	if (Dispatch.vkCreateGraphicsPipelines(Dispatch.device, Device.pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE GRAPHICS PIPELINE " << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool OffscreenRenderer::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& memory) {
+	VkBufferCreateInfo bufferCreateInfo = {};
+	bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferCreateInfo.pNext = nullptr;
+	bufferCreateInfo.flags = 0;
+	bufferCreateInfo.size = size;
+	bufferCreateInfo.usage = usage;
+	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	bufferCreateInfo.queueFamilyIndexCount = 0;
+	bufferCreateInfo.pQueueFamilyIndices = nullptr;
+
+	if (Dispatch.vkCreateBuffer(Dispatch.device, &bufferCreateInfo, nullptr, &buffer) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE BUFFER " << std::endl;
+		return false;
+	}
+
+	VkMemoryRequirements memoryRequirements;
+	Dispatch.vkGetBufferMemoryRequirements(Dispatch.device, buffer, &memoryRequirements);
+
+	VkMemoryAllocateInfo memoryAllocateInfo = {};
+	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memoryAllocateInfo.pNext = nullptr;
+	memoryAllocateInfo.allocationSize = memoryRequirements.size;
+	if (!Device.GetMemoryType(memoryRequirements.memoryTypeBits, properties, memoryAllocateInfo.memoryTypeIndex)) {
+		std::cout << "NO SUITABLE MEMORY TYPE FOR BUFFER " << std::endl;
+		return false;
+	}
+
+	if ((Dispatch.vkAllocateMemory(Dispatch.device, &memoryAllocateInfo, nullptr, &memory) != VK_SUCCESS)
+		|| (Dispatch.vkBindBufferMemory(Dispatch.device, buffer, memory, 0) != VK_SUCCESS)) {
+		std::cout << "COULD NOT ALLOCATE MEMORY FOR BUFFER " << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool OffscreenRenderer::PrepareReadbackBuffer() {
+	if ((Format != VK_FORMAT_R8G8B8A8_UNORM) && (Format != VK_FORMAT_B8G8R8A8_UNORM)) {
+		std::cout << "READBACK SUPPORTS ONLY 8-BIT RGBA AND BGRA TARGETS " << std::endl;
+		return false;
+	}
+
+	const VkDeviceSize size = static_cast<VkDeviceSize>(OutputExtent.width) * OutputExtent.height * 4;
+	if ((ReadbackBuffer != VK_NULL_HANDLE) && (ReadbackSize == size)) {
+		return true;
+	}
+	DestroyReadbackBuffer();
+
+	if (!CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, ReadbackBuffer, ReadbackMemory)
+		|| (Dispatch.vkMapMemory(Dispatch.device, ReadbackMemory, 0, size, 0, &ReadbackData) != VK_SUCCESS)) {
+		std::cout << "COULD NOT CREATE READBACK BUFFER " << std::endl;
+		DestroyReadbackBuffer();
+		return false;
+	}
+	ReadbackSize = size;
+	return true;
+}
+
+void OffscreenRenderer::DestroyReadbackBuffer() {
+	if (ReadbackData != nullptr) {
+		Dispatch.vkUnmapMemory(Dispatch.device, ReadbackMemory);
+		ReadbackData = nullptr;
+	}
+	if (ReadbackBuffer != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyBuffer(Dispatch.device, ReadbackBuffer, nullptr);
+		ReadbackBuffer = VK_NULL_HANDLE;
+	}
+	if (ReadbackMemory != VK_NULL_HANDLE) {
+		Dispatch.vkFreeMemory(Dispatch.device, ReadbackMemory, nullptr);
+		ReadbackMemory = VK_NULL_HANDLE;
+	}
+	ReadbackSize = 0;
+}
+
+void OffscreenRenderer::CmdCopyToBuffer(VkBuffer buffer, VkDeviceSize offset) {
+	// The render pass leaves the image in TRANSFER_SRC_OPTIMAL and its external dependency covers the transfer read;
+	// a drawable replacing the result does the same for its own image
+	VkBufferImageCopy region = {};
+	region.bufferOffset = offset;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { OutputExtent.width, OutputExtent.height, 1 };
+	Dispatch.vkCmdCopyImageToBuffer(CommandBuffer, OutputImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+
+	VkBufferMemoryBarrier bufferBarrier = {};
+	bufferBarrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferBarrier.pNext = nullptr;
+	bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	bufferBarrier.buffer = buffer;
+	bufferBarrier.offset = offset;
+	bufferBarrier.size = static_cast<VkDeviceSize>(OutputExtent.width) * OutputExtent.height * 4;
+	Dispatch.vkCmdPipelineBarrier(CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+}
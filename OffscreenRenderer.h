@@ -0,0 +1,204 @@
+#pragma once
+#define VK_NO_PROTOTYPES
+
+#if defined _WIN32
+#define VK_USE_PLATFORM_WIN32_KHR
+#elif defined __linux__
+#define VK_USE_PLATFORM_XCB_KHR
+#endif
+
+#include "vulkan.h"
+#include "VulkanBase.h"
+#include "GpuTimer.h"
+#include "GraphicsPipeline.h"
+#include "PostProcessing.h"
+#include "ReadbackRing.h"
+#include "ShaderCompiler.h"
+#include <vector>
+
+// 2D view of the triangle grid, which spans -1 to 1 on both axes
+struct OffscreenCamera {
+	float centerX;
+	float centerY;
+	float zoom;
+
+	OffscreenCamera() :
+		centerX(0.0f),
+		centerY(0.0f),
+		zoom(1.0f) {
+	}
+};
+
+// The offscreen frame being recorded
+struct OffscreenFrame {
+	VkExtent2D extent;
+	OffscreenCamera camera;
+	float deltaSeconds;
+};
+
+// Subsystem drawn into offscreen frames, in the first subpass of render passes compatible with the renderer's.
+// Hooks run for the drawables of a draw list in their order: Prepare() before the frame's command buffer begins (the
+// only one which may fail), CmdPrePass() before the render pass, CmdDraw() and CmdDrawOverlay() inside it (with viewport
+// and scissor set, below and on top of the triangle grid) and CmdPostPass() after it.
+// A drawable may replace the renderer's image as the frame's result through GetOutput().
+class OffscreenDrawable {
+public:
+	virtual ~OffscreenDrawable() {
+	}
+
+	virtual bool Prepare(const OffscreenFrame& /*frame*/) {
+		return true;
+	}
+
+	virtual void CmdPrePass(VkCommandBuffer /*commandBuffer*/, const OffscreenFrame& /*frame*/) {
+	}
+
+	virtual void CmdDraw(VkCommandBuffer /*commandBuffer*/, const OffscreenFrame& /*frame*/) const {
+	}
+
+	virtual void CmdDrawOverlay(VkCommandBuffer /*commandBuffer*/, const OffscreenFrame& /*frame*/) const {
+	}
+
+	virtual void CmdPostPass(VkCommandBuffer /*commandBuffer*/, const OffscreenFrame& /*frame*/) {
+	}
+
+	// In the renderer's format and TRANSFER_SRC_OPTIMAL layout after CmdPostPass(), ready for transfer reads
+	virtual bool GetOutput(VkImage& /*image*/, VkExtent2D& /*extent*/) const {
+		return false;
+	}
+};
+
+// What a single offscreen frame consists of.
+// Draws are spread over the triangle buffer in order, each one drawing trianglesPerDraw triangles;
+// with more than one pipeline every draw binds the next one.
+struct OffscreenDrawList {
+	uint32_t drawCount;
+	uint32_t trianglesPerDraw;
+	uint32_t pipelineCount;
+	OffscreenCamera camera;
+	std::vector<OffscreenDrawable*> drawables;
+	float deltaSeconds;
+	const ReadbackTicket* readback;	// Also copy the image into this readback ring slot, in the same submission
+
+	OffscreenDrawList() :
+		drawCount(0),
+		trianglesPerDraw(1),
+		pipelineCount(1),
+		camera(),
+		drawables(),
+		deltaSeconds(1.0f / 60.0f),
+		readback(nullptr) {
+	}
+};
+
+// Renders simple triangle scenes into an image without any window or swapchain.
+// Works on the device created by VulkanBase::PrepareVulkanHeadless() (or a regular one) or on any other device
+// described by a DeviceContext. Uses the graphics queue and waits for every frame, so CPU and GPU times of each
+// frame can be measured separately.
+class OffscreenRenderer {
+public:
+	OffscreenRenderer(VulkanBase& vulkan);
+	// Context's dispatch table must outlive the renderer
+	explicit OffscreenRenderer(const DeviceContext& device);
+	~OffscreenRenderer();
+
+	OffscreenRenderer(const OffscreenRenderer&) = delete;
+	OffscreenRenderer& operator=(const OffscreenRenderer&) = delete;
+
+	// With more than one sample the multisampled color and depth attachments are transient (lazily allocated where
+	// possible) and the color is resolved into the image at the end of the subpass, so only the resolved image is stored.
+	// Post-processing effects run as further subpasses on HDR scene color, the last one writing the image.
+	bool Create(VkExtent2D extent, VkFormat format = VK_FORMAT_R8G8B8A8_UNORM, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT,
+		const PostProcessSettings& post = PostProcessSettings());
+	bool Resize(VkExtent2D extent);
+	void Destroy();
+
+	// Triangles are laid out on a regular grid, so every run renders exactly the same image
+	bool SetTriangleCount(uint32_t count);
+	// Pipelines differ only by a specialization constant, but each one is a separate pipeline object
+	bool SetPipelineCount(uint32_t count);
+
+	bool Record(const OffscreenDrawList& drawList);
+	// Also signals the readback ticket's timeline value when the recorded draw list had one
+	bool Submit();
+	// Returns immediately when nothing was submitted since the last wait
+	bool Wait();
+	bool GetGpuTime(double& milliseconds) const;
+
+	// Copies the last recorded frame's result through a host visible staging buffer, always as tightly packed RGBA8.
+	// When a drawable replaced the result, it must still exist.
+	bool ReadPixels(std::vector<uint8_t>& rgba);
+	// Of what ReadPixels() and draw list readbacks copy: the renderer's extent unless a drawable replaced the result
+	VkExtent2D GetOutputExtent() const;
+
+	VkImage GetImage() const;
+	// Of the final image, in TRANSFER_SRC_OPTIMAL layout after every frame
+	VkImageView GetImageView() const;
+	VkFormat GetFormat() const;
+	VkExtent2D GetExtent() const;
+	// For pipelines of other renderers (particles) drawing into this one's frames, in subpass 0 with the same sample count
+	VkRenderPass GetRenderPass() const;
+	VkSampleCountFlagBits GetSampleCount() const;
+	// Transient attachments (multisampled or post-processing intermediates) all got lazily allocated memory
+	bool HasLazyAttachments() const;
+	// Parameters of one of the post-processing effects given to Create()
+	bool SetPostParameters(uint32_t effect, float x, float y, float z, float w);
+	// Reversed depth (cleared to 0, near is 1) of the last frame, in DEPTH_STENCIL_READ_ONLY_OPTIMAL layout after it.
+	// Recreated by Resize(). VK_NULL_HANDLE when multisampled, the depth isn't kept then.
+	VkImageView GetDepthView() const;
+	VkFormat GetDepthFormat() const;
+
+private:
+	bool CreateTarget();
+	void DestroyTarget();
+	bool CreateRenderPass();
+	bool CreatePipeline(uint32_t index, VkPipeline& pipeline);
+	bool CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& memory);
+	bool PrepareReadbackBuffer();
+	void DestroyReadbackBuffer();
+	// Of the last recorded frame's result
+	void CmdCopyToBuffer(VkBuffer buffer, VkDeviceSize offset);
+
+	DeviceContext Device;
+	const DeviceDispatchTable& Dispatch;
+	ShaderCompiler Compiler;
+	GpuTimer Timer;
+	PostProcessChain Post;
+
+	VkFormat Format;
+	VkFormat SceneFormat;				// Of the scene subpass' color
+	VkFormat DepthFormat;
+	VkSampleCountFlagBits Samples;
+	VkExtent2D Extent;
+	ImageParameters Target;				// Written by the last subpass, or the resolve target when multisampled
+	VkImage OutputImage;				// Result of the last recorded frame, Target unless a drawable replaced it
+	VkExtent2D OutputExtent;
+	GpuImage SceneColor;				// When multisampled or post-processed
+	GpuImage SceneResolve;				// When multisampled and post-processed
+	std::vector<GpuImage> StageTargets;	// Of every post-processing stage but the last
+	GpuImage Depth;
+	VkRenderPass RenderPass;
+	VkFramebuffer Framebuffer;
+
+	VkShaderModule VertexShader;
+	VkShaderModule FragmentShader;
+	VkPipelineLayout PipelineLayout;
+	std::vector<VkPipeline> Pipelines;
+
+	VkBuffer VertexBuffer;
+	VkDeviceMemory VertexBufferMemory;
+	uint32_t TriangleCount;
+
+	// Persistently mapped, sized for the current extent
+	VkBuffer ReadbackBuffer;
+	VkDeviceMemory ReadbackMemory;
+	VkDeviceSize ReadbackSize;
+	void* ReadbackData;
+
+	VkCommandPool CommandPool;
+	VkCommandBuffer CommandBuffer;
+	VkFence Fence;
+	bool Pending;
+	VkSemaphore SignalSemaphore;		// Timeline of the recorded readback ticket
+	uint64_t SignalValue;
+};
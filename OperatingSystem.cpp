@@ -18,16 +18,259 @@
 #include <chrono>
 #include "OperatingSystem.h"
 
+#if defined(VK_USE_PLATFORM_XCB_KHR) || defined(VK_USE_PLATFORM_XLIB_KHR)
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
   namespace OS {
 
     Window::Window() :
-      Parameters() {
+      Parameters(),
+      Mode( LoopMode::Continuous ),
+      TargetFrameRate( 0 ) {
     }
 
     WindowParameters Window::GetParameters() const {
       return Parameters;
     }
 
+    void Window::SetLoopMode( LoopMode mode, uint32_t target_frame_rate ) {
+      Mode = mode;
+      TargetFrameRate = target_frame_rate;
+    }
+
+    RenderThread::RenderThread( ProjectBase &project, bool draw_continuously, std::function<void()> wake_window_thread,
+                                std::function<void()> frame_drawn ) :
+      Project( project ),
+      Queue(),
+      Signal(),
+      DrawContinuously( draw_continuously ),
+      WakeWindowThread( wake_window_thread ),
+      FrameDrawn( frame_drawn ),
+      Running( true ),
+      Result( true ),
+      Thread( &RenderThread::Run, this ) {
+    }
+
+    RenderThread::~RenderThread() {
+      Join();
+    }
+
+    void RenderThread::Submit( FramePacket const &packet ) {
+      // Render thread is behind anyway, so a frame-only request may be dropped
+      if( !packet.resize && !packet.quit ) {
+        if( Queue.Push( packet ) ) {
+          Signal.Notify();
+        }
+        return;
+      }
+
+      // Resize and quit requests can't be dropped - wait for the render thread to catch up
+      while( !Queue.Push( packet ) ) {
+        if( !Running ) {
+          return;
+        }
+        std::this_thread::yield();
+      }
+      Signal.Notify();
+    }
+
+    bool RenderThread::Join() {
+      if( Thread.joinable() ) {
+        Thread.join();
+      }
+      return Result;
+    }
+
+    void RenderThread::Run() {
+      FramePacket packet;
+      bool resize = false;
+      bool draw = false;
+      bool input = false;
+      std::chrono::steady_clock::time_point input_time;
+
+      // Consume everything the window thread published so far, returns false on quit
+      auto drain_queue = [&]() {
+        while( Queue.Pop( packet ) ) {
+          if( packet.quit ) {
+            return false;
+          }
+          resize = resize || packet.resize;
+          draw = draw || packet.draw;
+          if( packet.input && (!input || (packet.inputTime < input_time)) ) {
+            input = true;
+            input_time = packet.inputTime;
+          }
+        }
+        return true;
+      };
+
+      while( Running ) {
+        if( !drain_queue() ) {
+          Running = false;
+          return;
+        }
+
+        if( resize ) {
+          resize = false;
+          draw = true;
+          if( !Project.OnWindowSizeChanged() ) {
+            Result = false;
+            break;
+          }
+        }
+        if( !DrawContinuously && !draw ) {
+          // Nothing to render - sleep until the window thread publishes another packet
+          Signal.Wait();
+          continue;
+        }
+        if( Project.ReadyToDraw() ) {
+          // Sleep until the frame should start, then pick up input that arrived in the meantime
+          if( !Project.WaitForNextFrame() ) {
+            Result = false;
+            break;
+          }
+          if( !drain_queue() ) {
+            Running = false;
+            return;
+          }
+          if( input ) {
+            Project.OnInputSampled( input_time );
+            input = false;
+          }
+
+          draw = false;
+          if( !Project.Draw() ) {
+            Result = false;
+            break;
+          }
+          if( FrameDrawn ) {
+            FrameDrawn();
+          }
+        } else {
+          std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+        }
+      }
+
+      // Rendering failed - let the window thread leave its blocking wait
+      Running = false;
+      WakeWindowThread();
+    }
+
+#if defined(VK_USE_PLATFORM_XCB_KHR) || defined(VK_USE_PLATFORM_XLIB_KHR)
+
+    // ************************************************************ //
+    // EventWaiter                                                  //
+    //                                                              //
+    // Blocks (through epoll) on the display connection, on an      //
+    // optional frame pacing timer and on wake-ups from other       //
+    // threads                                                      //
+    // ************************************************************ //
+    class EventWaiter {
+    public:
+      EventWaiter( int connection_fd, uint32_t frame_rate ) :
+        EpollFd( epoll_create1( EPOLL_CLOEXEC ) ),
+        TimerFd( -1 ),
+        WakeFd( eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ),
+        Ready( false ) {
+        if( (EpollFd < 0) || (WakeFd < 0) ) {
+          return;
+        }
+
+        epoll_event connection_event = {};
+        connection_event.events = EPOLLIN;
+        connection_event.data.fd = connection_fd;
+        epoll_event wake_event = {};
+        wake_event.events = EPOLLIN;
+        wake_event.data.fd = WakeFd;
+        if( (epoll_ctl( EpollFd, EPOLL_CTL_ADD, connection_fd, &connection_event ) != 0) ||
+          (epoll_ctl( EpollFd, EPOLL_CTL_ADD, WakeFd, &wake_event ) != 0) ) {
+          return;
+        }
+
+        if( frame_rate > 0 ) {
+          // Without the timer paced mode would silently turn into on-demand mode
+          TimerFd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+          if( TimerFd < 0 ) {
+            return;
+          }
+
+          const long long period = 1000000000LL / frame_rate;
+          itimerspec interval = {};
+          interval.it_interval.tv_sec = static_cast<time_t>(period / 1000000000LL);
+          interval.it_interval.tv_nsec = static_cast<long>(period % 1000000000LL);
+          interval.it_value = interval.it_interval;
+
+          epoll_event timer_event = {};
+          timer_event.events = EPOLLIN;
+          timer_event.data.fd = TimerFd;
+          if( (timerfd_settime( TimerFd, 0, &interval, nullptr ) != 0) ||
+            (epoll_ctl( EpollFd, EPOLL_CTL_ADD, TimerFd, &timer_event ) != 0) ) {
+            return;
+          }
+        }
+        Ready = true;
+      }
+
+      ~EventWaiter() {
+        if( TimerFd >= 0 ) {
+          close( TimerFd );
+        }
+        if( WakeFd >= 0 ) {
+          close( WakeFd );
+        }
+        if( EpollFd >= 0 ) {
+          close( EpollFd );
+        }
+      }
+
+      bool Valid() const {
+        return Ready;
+      }
+
+      // Ends the current (or next) Wait(), from any thread
+      void Wake() {
+        const uint64_t one = 1;
+        ssize_t written = write( WakeFd, &one, sizeof( one ) );
+        (void)written;
+      }
+
+      // Sleeps until the connection is readable, frame timer expires or Wake() is called, frame_due is set when the timer expired
+      bool Wait( bool &frame_due ) {
+        epoll_event ready[3];
+        int ready_count = epoll_wait( EpollFd, ready, 3, -1 );
+        if( ready_count < 0 ) {
+          return errno == EINTR;
+        }
+
+        for( int i = 0; i < ready_count; ++i ) {
+          if( ready[i].data.fd == TimerFd ) {
+            uint64_t expirations;
+            if( read( TimerFd, &expirations, sizeof( expirations ) ) > 0 ) {
+              frame_due = true;
+            }
+          } else if( ready[i].data.fd == WakeFd ) {
+            uint64_t wakes;
+            ssize_t read_size = read( WakeFd, &wakes, sizeof( wakes ) );
+            (void)read_size;
+          }
+        }
+        return true;
+      }
+
+    private:
+      int EpollFd;
+      int TimerFd;
+      int WakeFd;
+      bool Ready;
+    };
+
+#endif
+
 #if defined(VK_USE_PLATFORM_WIN32_KHR)
 
 #define SERIES_NAME L"API without Secrets: Introduction to Vulkan"
@@ -58,7 +301,7 @@
       }
     }
 
-    bool Window::Create( const LPCWSTR& title ) {
+    bool Window::Create( WindowTitle title ) {
       Parameters.Instance = GetModuleHandle( nullptr );
 
       // Register window class
@@ -96,49 +339,74 @@
       ShowWindow( Parameters.Handle, SW_SHOWNORMAL );
       UpdateWindow( Parameters.Handle );
 
+      // Drawing happens on a separate thread, this one only waits for and translates messages
+      HWND handle = Parameters.Handle;
+      const bool paced = (Mode == LoopMode::Continuous) && (TargetFrameRate > 0);
+      RenderThread render_thread( project, (Mode == LoopMode::Continuous) && !paced, [handle]() {
+        PostMessage( handle, WM_USER + 2, 0, 0 );
+      } );
+
+      const std::chrono::nanoseconds frame_period( paced ? 1000000000LL / TargetFrameRate : 0 );
+      std::chrono::steady_clock::time_point next_frame = std::chrono::steady_clock::now() + frame_period;
+
       // Main message loop
       MSG message;
+      uint64_t frame_index = 0;
       bool loop = true;
-      bool resize = false;
-      bool result = true;
 
       while( loop ) {
-        if( PeekMessage( &message, NULL, 0, 0, PM_REMOVE ) ) {
+        FramePacket packet;
+        packet.index = ++frame_index;
+
+        // Sleep until a message arrives or it's time for the next frame
+        DWORD timeout = INFINITE;
+        if( paced ) {
+          std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+          timeout = (now >= next_frame) ? 0 : static_cast<DWORD>((std::chrono::duration_cast<std::chrono::microseconds>( next_frame - now ).count() + 999) / 1000);
+        }
+        MsgWaitForMultipleObjects( 0, nullptr, FALSE, timeout, QS_ALLINPUT );
+        packet.inputTime = std::chrono::steady_clock::now();
+
+        if( paced ) {
+          std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+          if( now >= next_frame ) {
+            packet.draw = true;
+            next_frame += frame_period;
+            if( next_frame < now ) {
+              next_frame = now + frame_period;
+            }
+          }
+        }
+
+        while( loop && PeekMessage( &message, NULL, 0, 0, PM_REMOVE ) ) {
           // Process events
           switch( message.message ) {
             // Resize
           case WM_USER + 1:
-            resize = true;
+            packet.resize = true;
             break;
             // Close
           case WM_USER + 2:
+          case WM_QUIT:
             loop = false;
             break;
+            // Window contents must be redrawn
+          case WM_PAINT:
+            packet.draw = true;
+            break;
           }
           TranslateMessage( &message );
           DispatchMessage( &message );
-        } else {
-          // Resize
-          if( resize ) {
-            resize = false;
-            if( !project.OnWindowSizeChanged() ) {
-              result = false;
-              break;
-            }
-          }
-          // Draw
-          if( project.ReadyToDraw() ) {
-            if( !project.Draw() ) {
-              result = false;
-              break;
-            }
-          } else {
-            std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
-          }
+          packet.input = true;
+        }
+
+        packet.quit = !loop;
+        if( packet.resize || packet.draw || packet.quit ) {
+          render_thread.Submit( packet );
         }
       }
 
-      return result;
+      return render_thread.Join();
     }
 
 #elif defined(VK_USE_PLATFORM_XCB_KHR)
@@ -148,7 +416,7 @@
       xcb_disconnect( Parameters.Connection );
     }
 
-    bool Window::Create( const char *title ) {
+    bool Window::Create( WindowTitle title ) {
       int screen_index;
       Parameters.Connection = xcb_connect( nullptr, &screen_index );
 
@@ -209,22 +477,64 @@
       xcb_intern_atom_cookie_t  delete_cookie    = xcb_intern_atom( Parameters.Connection, 0, 16, "WM_DELETE_WINDOW" );
       xcb_intern_atom_reply_t  *delete_reply     = xcb_intern_atom_reply( Parameters.Connection, delete_cookie, 0 );
       xcb_change_property( Parameters.Connection, XCB_PROP_MODE_REPLACE, Parameters.Handle, (*protocols_reply).atom, 4, 32, 1, &(*delete_reply).atom );
+      xcb_atom_t protocols_atom = (*protocols_reply).atom;
+      xcb_atom_t delete_atom = (*delete_reply).atom;
       free( protocols_reply );
+      free( delete_reply );
 
       // Display window
       xcb_map_window( Parameters.Connection, Parameters.Handle );
       xcb_flush( Parameters.Connection );
 
+      // Drawing happens on a separate thread, this one blocks on the connection until events arrive
+      xcb_connection_t *connection = Parameters.Connection;
+      xcb_window_t window = Parameters.Handle;
+      const bool paced = (Mode == LoopMode::Continuous) && (TargetFrameRate > 0);
+      EventWaiter waiter( xcb_get_file_descriptor( Parameters.Connection ), paced ? TargetFrameRate : 0 );
+      if( !waiter.Valid() ) {
+        std::cout << "Could not create event loop!" << std::endl;
+        return false;
+      }
+
+      // The render thread presents through the same connection, so libxcb may read window events on it into its
+      // in-memory queue, where epoll can't see them - it wakes the waiter after every frame to have them picked up
+      RenderThread render_thread( project, (Mode == LoopMode::Continuous) && !paced, [connection, window, protocols_atom, delete_atom]() {
+        // Send ourselves a close request so the window thread wakes up
+        xcb_client_message_event_t message = {};
+        message.response_type = XCB_CLIENT_MESSAGE;
+        message.format = 32;
+        message.window = window;
+        message.type = protocols_atom;
+        message.data.data32[0] = delete_atom;
+        xcb_send_event( connection, 0, window, XCB_EVENT_MASK_NO_EVENT, reinterpret_cast<const char*>(&message) );
+        xcb_flush( connection );
+      }, [&waiter]() {
+        waiter.Wake();
+      } );
+
       // Main message loop
       xcb_generic_event_t *event;
+      uint64_t frame_index = 0;
       bool loop = true;
-      bool resize = false;
-      bool result = true;
 
       while( loop ) {
+        FramePacket packet;
+        packet.index = ++frame_index;
+
+        // xcb_poll_for_event() reads everything available on the socket; events the render thread reads into the queue
+        // after this check come with a wake-up, so blocking can't miss them
         event = xcb_poll_for_event( Parameters.Connection );
+        if( !event ) {
+          // Sleep until X server sends something or it's time for the next frame
+          if( !waiter.Wait( packet.draw ) ) {
+            break;
+          }
+          event = xcb_poll_for_event( Parameters.Connection );
+        }
+        packet.inputTime = std::chrono::steady_clock::now();
+        packet.input = (event != nullptr);
 
-        if( event ) {
+        while( event ) {
           // Process events
           switch (event->response_type & 0x7f) {
             // Resize
@@ -235,17 +545,20 @@
 
               if( ((configure_event->width > 0) && (width != configure_event->width)) ||
                 ((configure_event->height > 0) && (height != configure_event->height)) ) {
-                resize = true;
+                packet.resize = true;
                 width = configure_event->width;
                 height = configure_event->height;
               }
             }
             break;
+            // Window contents must be redrawn
+          case XCB_EXPOSE:
+            packet.draw = true;
+            break;
             // Close
           case XCB_CLIENT_MESSAGE:
-            if( (*(xcb_client_message_event_t*)event).data.data32[0] == (*delete_reply).atom ) {
+            if( (*(xcb_client_message_event_t*)event).data.data32[0] == delete_atom ) {
               loop = false;
-              free( delete_reply );
             }
             break;
           case XCB_KEY_PRESS:
@@ -253,27 +566,20 @@
             break;
           }
           free( event );
-        } else {
-          // Draw
-          if( resize ) {
-            resize = false;
-            if( !project.OnWindowSizeChanged() ) {
-              result = false;
-              break;
-            }
-          }
-          if( project.ReadyToDraw() ) {
-            if( !project.Draw() ) {
-              result = false;
-              break;
-            }
-          } else {
-            std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
-          }
+          event = loop ? xcb_poll_for_event( Parameters.Connection ) : nullptr;
+        }
+        if( xcb_connection_has_error( Parameters.Connection ) ) {
+          // Connection to the X server was lost
+          loop = false;
+        }
+
+        packet.quit = !loop;
+        if( packet.resize || packet.draw || packet.quit ) {
+          render_thread.Submit( packet );
         }
       }
 
-      return result;
+      return render_thread.Join();
     }
 
 #elif defined(VK_USE_PLATFORM_XLIB_KHR)
@@ -283,7 +589,10 @@
       XCloseDisplay( Parameters.DisplayPtr );
     }
 
-    bool Window::Create( const char *title ) {
+    bool Window::Create( WindowTitle title ) {
+      // Window events are handled and surface is presented from different threads
+      XInitThreads();
+
       Parameters.DisplayPtr = XOpenDisplay( nullptr );
       if( !Parameters.DisplayPtr ) {
         return false;
@@ -319,14 +628,53 @@
       XClearWindow( Parameters.DisplayPtr, Parameters.Handle );
       XMapWindow( Parameters.DisplayPtr, Parameters.Handle );
 
+      // Drawing happens on a separate thread, this one blocks on the connection until events arrive
+      Display *display = Parameters.DisplayPtr;
+      ::Window window = Parameters.Handle;
+      const bool paced = (Mode == LoopMode::Continuous) && (TargetFrameRate > 0);
+      EventWaiter waiter( ConnectionNumber( Parameters.DisplayPtr ), paced ? TargetFrameRate : 0 );
+      if( !waiter.Valid() ) {
+        std::cout << "Could not create event loop!" << std::endl;
+        return false;
+      }
+
+      // The render thread presents through the same display, so Xlib may read window events on it into its in-memory
+      // queue, where epoll can't see them - it wakes the waiter after every frame to have them picked up
+      RenderThread render_thread( project, (Mode == LoopMode::Continuous) && !paced, [display, window, delete_window_atom]() {
+        // Send ourselves a close request so the window thread wakes up
+        XEvent message = {};
+        message.xclient.type = ClientMessage;
+        message.xclient.window = window;
+        message.xclient.message_type = XInternAtom( display, "WM_PROTOCOLS", false );
+        message.xclient.format = 32;
+        message.xclient.data.l[0] = delete_window_atom;
+        XSendEvent( display, window, false, NoEventMask, &message );
+        XFlush( display );
+      }, [&waiter]() {
+        waiter.Wake();
+      } );
+
       // Main message loop
       XEvent event;
+      uint64_t frame_index = 0;
       bool loop = true;
-      bool resize = false;
-      bool result = true;
 
       while( loop ) {
-        if( XPending( Parameters.DisplayPtr ) ) {
+        FramePacket packet;
+        packet.index = ++frame_index;
+
+        // XPending() flushes requests and reads the socket, so events may already wait in Xlib's queue; events the render
+        // thread reads into the queue after this check come with a wake-up, so blocking can't miss them
+        if( !XPending( Parameters.DisplayPtr ) ) {
+          // Sleep until X server sends something or it's time for the next frame
+          if( !waiter.Wait( packet.draw ) ) {
+            break;
+          }
+        }
+        packet.inputTime = std::chrono::steady_clock::now();
+
+        while( loop && XPending( Parameters.DisplayPtr ) ) {
+          packet.input = true;
           XNextEvent( Parameters.DisplayPtr, &event );
           switch( event.type ) {
             //Process events
@@ -338,10 +686,14 @@
                 ((event.xconfigure.height > 0) && (event.xconfigure.width != height)) ) {
                 width = event.xconfigure.width;
                 height = event.xconfigure.height;
-                resize = true;
+                packet.resize = true;
               }
             }
             break;
+            // Window contents must be redrawn
+          case Expose:
+            packet.draw = true;
+            break;
           case KeyPress:
             loop = false;
             break;
@@ -354,27 +706,15 @@
             }
             break;
           }
-        } else {
-          // Draw
-          if( resize ) {
-            resize = false;
-            if( !project.OnWindowSizeChanged() ) {
-              result = false;
-              break;
-            }
-          }
-          if( project.ReadyToDraw() ) {
-            if( !project.Draw() ) {
-              result = false;
-              break;
-            }
-          } else {
-            std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
-          }
+        }
+
+        packet.quit = !loop;
+        if( packet.resize || packet.draw || packet.quit ) {
+          render_thread.Submit( packet );
         }
       }
 
-      return result;
+      return render_thread.Join();
     }
 
 #endif
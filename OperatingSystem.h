@@ -41,6 +41,10 @@
 
 #include <cstring>
 #include <iostream>
+#include <atomic>
+#include <functional>
+#include <thread>
+#include "FrameQueue.h"
 
   namespace OS {
 
@@ -56,6 +60,21 @@
 #elif defined(VK_USE_PLATFORM_XCB_KHR) || defined(VK_USE_PLATFORM_XLIB_KHR)
     typedef void* LibraryHandle;
 
+#endif
+
+    // ************************************************************ //
+    // WindowTitle                                                  //
+    //                                                              //
+    // OS dependent window title string type                        //
+    // ************************************************************ //
+#if defined(VK_USE_PLATFORM_WIN32_KHR)
+    typedef LPCWSTR WindowTitle;
+#define OS_WINDOW_TITLE( title ) L##title
+
+#elif defined(VK_USE_PLATFORM_XCB_KHR) || defined(VK_USE_PLATFORM_XLIB_KHR)
+    typedef const char* WindowTitle;
+#define OS_WINDOW_TITLE( title ) title
+
 #endif
 
     // ************************************************************ //
@@ -68,6 +87,16 @@
       virtual bool OnWindowSizeChanged() = 0;
       virtual bool Draw() = 0;
 
+      // Called on the render thread right before input for the next frame is sampled,
+      // projects may sleep here so the input is as fresh as possible when drawing starts
+      virtual bool WaitForNextFrame() {
+        return true;
+      }
+
+      // Time of the oldest window input the next Draw() reacts to
+      virtual void OnInputSampled( std::chrono::steady_clock::time_point /*input_time*/ ) {
+      }
+
       virtual bool ReadyToDraw() const final {
         return CanRender;
       }
@@ -119,6 +148,46 @@
 #endif
     };
 
+    // ************************************************************ //
+    // LoopMode                                                     //
+    //                                                              //
+    // When rendering loop draws a new frame                        //
+    // ************************************************************ //
+    enum class LoopMode {
+      Continuous,   // Draw frames all the time (optionally capped at a target frame rate)
+      OnDemand      // Draw only after expose, resize or input events
+    };
+
+    // ************************************************************ //
+    // RenderThread                                                 //
+    //                                                              //
+    // Consumes frame packets published by the window thread and    //
+    // drives project's resizing and drawing on a separate thread   //
+    // ************************************************************ //
+    class RenderThread {
+    public:
+      // frame_drawn runs after every frame, e.g. to wake a window thread whose events presentation may have read
+      RenderThread( ProjectBase &project, bool draw_continuously, std::function<void()> wake_window_thread,
+                    std::function<void()> frame_drawn = std::function<void()>() );
+      ~RenderThread();
+
+      void              Submit( FramePacket const &packet );
+      bool              Join();
+
+    private:
+      void              Run();
+
+      ProjectBase            &Project;
+      FramePacketQueue        Queue;
+      FrameSignal             Signal;
+      bool                    DrawContinuously;
+      std::function<void()>   WakeWindowThread;
+      std::function<void()>   FrameDrawn;
+      std::atomic<bool>       Running;
+      std::atomic<bool>       Result;
+      std::thread             Thread;
+    };
+
     // ************************************************************ //
     // Window                                                       //
     //                                                              //
@@ -129,12 +198,15 @@
       Window();
       ~Window();
 
-      bool              Create( const LPCWSTR& title );
+      bool              Create( WindowTitle title );
+      void              SetLoopMode( LoopMode mode, uint32_t target_frame_rate = 0 );
       bool              RenderingLoop( ProjectBase &project ) const;
       WindowParameters  GetParameters() const;
 
     private:
       WindowParameters  Parameters;
+      LoopMode          Mode;
+      uint32_t          TargetFrameRate;
     };
 
   } // namespace OS
@@ -0,0 +1,863 @@
+#include "ParticleSystem.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+namespace {
+	const uint32_t GroupSize = 256;
+
+	// Sort keys are 16-bit depths, sorted 4 bits per pass
+	const uint32_t SortPasses = 4;
+	const uint32_t DigitCount = 16;
+
+	const float Gravity = 1.0f;
+
+	// Layout of the State buffer
+	const VkDeviceSize DrawArgumentsOffset = 0;
+	const VkDeviceSize DispatchArgumentsOffset = 4 * sizeof(uint32_t);
+	const VkDeviceSize AppendedOffset = 8 * sizeof(uint32_t);
+	const VkDeviceSize StateSize = 9 * sizeof(uint32_t);
+
+	// Every compute shader has the State buffer at binding 0
+	const char* ComputeHeader = R"(#version 450
+layout(local_size_x_id = 0) in;
+
+layout(set = 0, binding = 0) buffer State {
+	uint vertexCount;
+	uint instanceCount;
+	uint firstVertex;
+	uint firstInstance;
+	uint groupCountX;
+	uint groupCountY;
+	uint groupCountZ;
+	uint count;			// Live particles after the last update
+	uint appended;		// Appended during this update, may exceed the capacity
+} state;
+)";
+
+	// Moves the live particles and appends the survivors to the other streams
+	const char* SimulateShader = R"(
+layout(set = 0, binding = 1) readonly buffer SourcePositions {
+	vec4 sourcePositions[];
+};
+layout(set = 0, binding = 2) readonly buffer SourceVelocities {
+	vec4 sourceVelocities[];
+};
+layout(set = 0, binding = 3) writeonly buffer Positions {
+	vec4 positions[];
+};
+layout(set = 0, binding = 4) writeonly buffer Velocities {
+	vec4 velocities[];
+};
+layout(push_constant) uniform Parameters {
+	float deltaSeconds;
+	float gravity;
+	uint capacity;
+};
+
+void main() {
+	const uint index = gl_GlobalInvocationID.x;
+	if (index >= state.count) {
+		return;
+	}
+
+	vec4 position = sourcePositions[index];
+	vec4 velocity = sourceVelocities[index];
+	velocity.w -= deltaSeconds;
+	velocity.y += gravity * deltaSeconds;
+	position.xyz += velocity.xyz * deltaSeconds;
+
+	// Dead particles and ones which left the view are compacted away
+	if ((velocity.w <= 0.0) || any(greaterThan(abs(position.xy), vec2(1.5)))) {
+		return;
+	}
+	const uint slot = atomicAdd(state.appended, 1u);
+	if (slot < capacity) {
+		positions[slot] = position;
+		velocities[slot] = velocity;
+	}
+}
+)";
+
+	const char* EmitShader = R"(
+layout(set = 0, binding = 1) writeonly buffer Positions {
+	vec4 positions[];
+};
+layout(set = 0, binding = 2) writeonly buffer Velocities {
+	vec4 velocities[];
+};
+layout(push_constant) uniform Parameters {
+	uint emitCount;
+	uint seed;
+	uint capacity;
+	float x;
+	float y;
+	float speed;
+	float life;
+	float size;
+};
+
+uint Hash(uint value) {
+	value ^= value >> 16;
+	value *= 0x7feb352du;
+	value ^= value >> 15;
+	value *= 0x846ca68bu;
+	value ^= value >> 16;
+	return value;
+}
+
+float Random(inout uint random) {
+	random = Hash(random);
+	return float(random >> 8) / 16777216.0;
+}
+
+void main() {
+	const uint index = gl_GlobalInvocationID.x;
+	if (index >= emitCount) {
+		return;
+	}
+	const uint slot = atomicAdd(state.appended, 1u);
+	if (slot >= capacity) {
+		return;
+	}
+
+	// A fountain: upwards (towards negative y) in a narrow cone, at random depths
+	uint random = Hash(seed ^ Hash(index));
+	const float angle = (Random(random) - 0.5) * 0.6;
+	const float velocity = speed * (0.5 + 0.5 * Random(random));
+	positions[slot] = vec4(x + (Random(random) - 0.5) * 0.02, y, Random(random), size * (0.5 + Random(random)));
+	velocities[slot] = vec4(velocity * sin(angle), -velocity * cos(angle), (Random(random) - 0.5) * 0.2, life * (1.0 + Random(random)));
+}
+)";
+
+	// Single invocation, turns the append counter into the arguments of the next indirect calls
+	const char* FinalizeShader = R"(
+layout(push_constant) uniform Parameters {
+	uint capacity;
+	uint groupSize;
+};
+
+void main() {
+	const uint count = min(state.appended, capacity);
+	state.vertexCount = 6;
+	state.instanceCount = count;
+	state.firstVertex = 0;
+	state.firstInstance = 0;
+	state.groupCountX = (count + groupSize - 1) / groupSize;
+	state.groupCountY = 1;
+	state.groupCountZ = 1;
+	state.count = count;
+}
+)";
+
+	// Far particles get small keys, so an ascending sort draws them first
+	const char* KeyShader = R"(
+layout(set = 0, binding = 1) readonly buffer Positions {
+	vec4 positions[];
+};
+layout(set = 0, binding = 2) writeonly buffer Keys {
+	uint keys[];
+};
+layout(set = 0, binding = 3) writeonly buffer Values {
+	uint values[];
+};
+
+void main() {
+	const uint index = gl_GlobalInvocationID.x;
+	if (index < state.count) {
+		keys[index] = 65535u - uint(clamp(positions[index].z, 0.0, 1.0) * 65535.0);
+		values[index] = index;
+	}
+}
+)";
+
+	// Counts the digits of one tile; tiles past the live particles write zeros
+	const char* CountShader = R"(
+layout(set = 0, binding = 1) readonly buffer Keys {
+	uint keys[];
+};
+layout(set = 0, binding = 2) writeonly buffer Histogram {
+	uint histogram[];
+};
+layout(push_constant) uniform Parameters {
+	uint shift;
+	uint tileCount;
+};
+
+shared uint counts[16];
+
+void main() {
+	const uint local = gl_LocalInvocationID.x;
+	if (local < 16) {
+		counts[local] = 0;
+	}
+	barrier();
+
+	const uint index = gl_GlobalInvocationID.x;
+	if (index < state.count) {
+		atomicAdd(counts[(keys[index] >> shift) & 15u], 1u);
+	}
+	barrier();
+
+	if (local < 16) {
+		histogram[local * tileCount + gl_WorkGroupID.x] = counts[local];
+	}
+}
+)";
+
+	// Sorts one tile by the digit locally (stable, one bit at a time), then moves every key behind all smaller
+	// digits and all earlier tiles' keys of the same digit, which the scanned histogram holds
+	const char* ScatterShader = R"(
+layout(set = 0, binding = 1) readonly buffer SourceKeys {
+	uint sourceKeys[];
+};
+layout(set = 0, binding = 2) readonly buffer SourceValues {
+	uint sourceValues[];
+};
+layout(set = 0, binding = 3) readonly buffer Histogram {
+	uint histogram[];
+};
+layout(set = 0, binding = 4) writeonly buffer Keys {
+	uint keys[];
+};
+layout(set = 0, binding = 5) writeonly buffer Values {
+	uint values[];
+};
+layout(push_constant) uniform Parameters {
+	uint shift;
+	uint tileCount;
+};
+
+// Real keys have 16 bits, the padding of the last tile has digit 15 in every pass and stays at its end
+const uint Padding = 0xFFFFFFFFu;
+
+shared uint sortedKeys[gl_WorkGroupSize.x];
+shared uint sortedValues[gl_WorkGroupSize.x];
+shared uint ones[gl_WorkGroupSize.x];
+shared uint digitCounts[16];
+shared uint digitStarts[16];
+
+uint Digit(uint key) {
+	return (key >> shift) & 15u;
+}
+
+void main() {
+	const uint count = state.count;
+	// Uniform for the whole group, so returning before the barriers is fine
+	if (gl_WorkGroupID.x * gl_WorkGroupSize.x >= count) {
+		return;
+	}
+
+	const uint local = gl_LocalInvocationID.x;
+	const uint index = gl_GlobalInvocationID.x;
+	uint key = (index < count) ? sourceKeys[index] : Padding;
+	uint value = (index < count) ? sourceValues[index] : Padding;
+	if (local < 16) {
+		digitCounts[local] = 0;
+	}
+	barrier();
+	if (key != Padding) {
+		atomicAdd(digitCounts[Digit(key)], 1u);
+	}
+
+	for (uint bit = 0; bit < 4; ++bit) {
+		const uint one = (Digit(key) >> bit) & 1u;
+		ones[local] = one;
+		barrier();
+		for (uint offset = 1; offset < gl_WorkGroupSize.x; offset <<= 1) {
+			const uint previous = (local >= offset) ? ones[local - offset] : 0;
+			barrier();
+			ones[local] += previous;
+			barrier();
+		}
+
+		const uint onesBefore = ones[local] - one;
+		const uint zeros = gl_WorkGroupSize.x - ones[gl_WorkGroupSize.x - 1];
+		const uint position = (one != 0) ? zeros + onesBefore : local - onesBefore;
+		sortedKeys[position] = key;
+		sortedValues[position] = value;
+		barrier();
+		key = sortedKeys[local];
+		value = sortedValues[local];
+		barrier();
+	}
+
+	const uint digit = Digit(key);
+	if ((local == 0) || (Digit(sortedKeys[local - 1]) != digit)) {
+		digitStarts[digit] = local;
+	}
+	barrier();
+
+	if (key != Padding) {
+		const uint target = histogram[digit * tileCount + gl_WorkGroupID.x] - digitCounts[digit] + local - digitStarts[digit];
+		keys[target] = key;
+		values[target] = value;
+	}
+}
+)";
+
+	// Camera-facing quads, one instance per particle in sorted order
+	const char* DrawVertexShader = R"(#version 450
+layout(set = 0, binding = 0) readonly buffer Positions {
+	vec4 positions[];
+};
+layout(set = 0, binding = 1) readonly buffer Velocities {
+	vec4 velocities[];
+};
+layout(set = 0, binding = 2) readonly buffer Order {
+	uint order[];
+};
+
+layout(push_constant) uniform Camera {
+	vec2 Center;
+	float Zoom;
+} camera;
+
+layout(location = 0) out vec2 Corner;
+layout(location = 1) out vec4 Color;
+
+const vec2 Corners[6] = vec2[6](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0));
+
+void main() {
+	const uint particle = order[gl_InstanceIndex];
+	const vec4 position = positions[particle];
+	const float life = clamp(velocities[particle].w, 0.0, 1.0);
+
+	Corner = Corners[gl_VertexIndex];
+	Color = vec4(mix(vec3(0.9, 0.2, 0.1), vec3(1.0, 0.8, 0.3), life), 0.8 * life);
+	gl_Position = vec4((position.xy + Corner * position.w - camera.Center) * camera.Zoom, 0.0, 1.0);
+}
+)";
+
+	const char* DrawFragmentShader = R"(#version 450
+layout(location = 0) in vec2 Corner;
+layout(location = 1) in vec4 Color;
+
+layout(location = 0) out vec4 Output;
+
+void main() {
+	const float distance2 = dot(Corner, Corner);
+	if (distance2 > 1.0) {
+		discard;
+	}
+	Output = vec4(Color.rgb, Color.a * (1.0 - distance2));
+}
+)";
+
+	// Same layout as the offscreen renderer's Camera push constant block
+	const uint32_t CameraPushConstantSize = 4 * sizeof(float);
+
+	struct SimulateParameters {
+		float deltaSeconds;
+		float gravity;
+		uint32_t capacity;
+	};
+
+	struct EmitParameters {
+		uint32_t emitCount;
+		uint32_t seed;
+		uint32_t capacity;
+		float x;
+		float y;
+		float speed;
+		float life;
+		float size;
+	};
+
+	struct SortParameters {
+		uint32_t shift;
+		uint32_t tileCount;
+	};
+}
+
+ParticleSystem::ParticleSystem(const DeviceContext& device) :
+	Device(device),
+	Dispatch(*device.dispatch),
+	Compiler(),
+	SimulatePipeline(device),
+	EmitPipeline(device),
+	FinalizePipeline(device),
+	KeyPipeline(device),
+	CountPipeline(device),
+	ScatterPipeline(device),
+	HistogramScan(device),
+	ParticleStreams(),
+	State(),
+	StateCleared(false),
+	Keys(),
+	Values(),
+	Histogram(),
+	SimulateSets(),
+	EmitSets(),
+	FinalizeSet(VK_NULL_HANDLE),
+	KeySets(),
+	CountSets(),
+	ScatterSets(),
+	DrawSetLayout(VK_NULL_HANDLE),
+	DrawDescriptorPool(VK_NULL_HANDLE),
+	DrawSets(),
+	DrawPipelineLayout(VK_NULL_HANDLE),
+	DrawPipeline(VK_NULL_HANDLE),
+	Capacity(0),
+	TileCount(0),
+	Current(0),
+	Emitter(),
+	PendingEmission(0.0f),
+	PendingBurst(0),
+	Seed(0) {
+}
+
+ParticleSystem::~ParticleSystem() {
+	Destroy();
+}
+
+bool ParticleSystem::Create(uint32_t capacity, VkRenderPass renderPass, VkSampleCountFlagBits samples) {
+	Destroy();
+	Capacity = std::max<uint32_t>(capacity, 1);
+	TileCount = (Capacity + GroupSize - 1) / GroupSize;
+
+	const VkDeviceSize streamSize = static_cast<VkDeviceSize>(Capacity) * 4 * sizeof(float);
+	const VkDeviceSize indexSize = static_cast<VkDeviceSize>(Capacity) * sizeof(uint32_t);
+	const uint32_t histogramCount = DigitCount * TileCount;
+	for (uint32_t i = 0; i < 2; ++i) {
+		if (!CreateGpuBuffer(Device, streamSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ParticleStreams[i].positions)
+			|| !CreateGpuBuffer(Device, streamSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, ParticleStreams[i].velocities)
+			|| !CreateGpuBuffer(Device, indexSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, Keys[i])
+			|| !CreateGpuBuffer(Device, indexSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, Values[i])) {
+			return false;
+		}
+	}
+	if (!CreateGpuBuffer(Device, StateSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, State)
+		|| !CreateGpuBuffer(Device, histogramCount * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, Histogram)
+		|| !HistogramScan.Create(histogramCount)
+		|| !HistogramScan.SetBuffer(Histogram.handle, 0, histogramCount)) {
+		return false;
+	}
+
+	const std::string header = ComputeHeader;
+	const VkDescriptorType storage = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	if (!SimulatePipeline.Create((header + SimulateShader).c_str(), "particle_simulate.comp", std::vector<VkDescriptorType>(5, storage), sizeof(SimulateParameters), 2, GroupSize)
+		|| !EmitPipeline.Create((header + EmitShader).c_str(), "particle_emit.comp", std::vector<VkDescriptorType>(3, storage), sizeof(EmitParameters), 2, GroupSize)
+		|| !FinalizePipeline.Create((header + FinalizeShader).c_str(), "particle_finalize.comp", std::vector<VkDescriptorType>(1, storage), 2 * sizeof(uint32_t), 1, 1)
+		|| !KeyPipeline.Create((header + KeyShader).c_str(), "particle_key.comp", std::vector<VkDescriptorType>(4, storage), 0, 2, GroupSize)
+		|| !CountPipeline.Create((header + CountShader).c_str(), "particle_count.comp", std::vector<VkDescriptorType>(3, storage), sizeof(SortParameters), 2, GroupSize)
+		|| !ScatterPipeline.Create((header + ScatterShader).c_str(), "particle_scatter.comp", std::vector<VkDescriptorType>(6, storage), sizeof(SortParameters), 2, GroupSize)) {
+		return false;
+	}
+
+	// Every combination used by the updates is written once here
+	if (!FinalizePipeline.AllocateDescriptorSet(FinalizeSet)) {
+		return false;
+	}
+	FinalizePipeline.WriteBuffer(FinalizeSet, 0, State.handle);
+	for (uint32_t i = 0; i < 2; ++i) {
+		const Streams& source = ParticleStreams[i];
+		const Streams& target = ParticleStreams[1 - i];
+		if (!SimulatePipeline.AllocateDescriptorSet(SimulateSets[i]) || !EmitPipeline.AllocateDescriptorSet(EmitSets[i])
+			|| !KeyPipeline.AllocateDescriptorSet(KeySets[i]) || !CountPipeline.AllocateDescriptorSet(CountSets[i])
+			|| !ScatterPipeline.AllocateDescriptorSet(ScatterSets[i])) {
+			return false;
+		}
+
+		SimulatePipeline.WriteBuffer(SimulateSets[i], 0, State.handle);
+		SimulatePipeline.WriteBuffer(SimulateSets[i], 1, source.positions.handle);
+		SimulatePipeline.WriteBuffer(SimulateSets[i], 2, source.velocities.handle);
+		SimulatePipeline.WriteBuffer(SimulateSets[i], 3, target.positions.handle);
+		SimulatePipeline.WriteBuffer(SimulateSets[i], 4, target.velocities.handle);
+
+		EmitPipeline.WriteBuffer(EmitSets[i], 0, State.handle);
+		EmitPipeline.WriteBuffer(EmitSets[i], 1, source.positions.handle);
+		EmitPipeline.WriteBuffer(EmitSets[i], 2, source.velocities.handle);
+
+		KeyPipeline.WriteBuffer(KeySets[i], 0, State.handle);
+		KeyPipeline.WriteBuffer(KeySets[i], 1, source.positions.handle);
+		KeyPipeline.WriteBuffer(KeySets[i], 2, Keys[0].handle);
+		KeyPipeline.WriteBuffer(KeySets[i], 3, Values[0].handle);
+
+		CountPipeline.WriteBuffer(CountSets[i], 0, State.handle);
+		CountPipeline.WriteBuffer(CountSets[i], 1, Keys[i].handle);
+		CountPipeline.WriteBuffer(CountSets[i], 2, Histogram.handle);
+
+		ScatterPipeline.WriteBuffer(ScatterSets[i], 0, State.handle);
+		ScatterPipeline.WriteBuffer(ScatterSets[i], 1, Keys[i].handle);
+		ScatterPipeline.WriteBuffer(ScatterSets[i], 2, Values[i].handle);
+		ScatterPipeline.WriteBuffer(ScatterSets[i], 3, Histogram.handle);
+		ScatterPipeline.WriteBuffer(ScatterSets[i], 4, Keys[1 - i].handle);
+		ScatterPipeline.WriteBuffer(ScatterSets[i], 5, Values[1 - i].handle);
+	}
+	return CreateDrawPipeline(renderPass, samples);
+}
+
+void ParticleSystem::Destroy() {
+	if (Dispatch.device == VK_NULL_HANDLE) {
+		return;
+	}
+	DestroyDrawPipeline();
+	SimulatePipeline.Destroy();
+	EmitPipeline.Destroy();
+	FinalizePipeline.Destroy();
+	KeyPipeline.Destroy();
+	CountPipeline.Destroy();
+	ScatterPipeline.Destroy();
+	HistogramScan.Destroy();
+
+	for (uint32_t i = 0; i < 2; ++i) {
+		DestroyGpuBuffer(Device, ParticleStreams[i].positions);
+		DestroyGpuBuffer(Device, ParticleStreams[i].velocities);
+		DestroyGpuBuffer(Device, Keys[i]);
+		DestroyGpuBuffer(Device, Values[i]);
+	}
+	DestroyGpuBuffer(Device, State);
+	DestroyGpuBuffer(Device, Histogram);
+	StateCleared = false;
+	Capacity = 0;
+	TileCount = 0;
+	Current = 0;
+	PendingEmission = 0.0f;
+	PendingBurst = 0;
+}
+
+void ParticleSystem::SetEmitter(const ParticleEmitter& emitter) {
+	Emitter = emitter;
+}
+
+void ParticleSystem::Emit(uint32_t count) {
+	PendingBurst = std::min(PendingBurst + count, Capacity);
+}
+
+void ParticleSystem::CmdUpdate(VkCommandBuffer commandBuffer, float deltaSeconds) {
+	const uint32_t source = Current;
+	const uint32_t target = 1 - Current;
+
+	// Earlier draws still read the buffers rewritten below
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 0, nullptr);
+
+	// The first update starts from zero live particles (and zero work groups)
+	if (StateCleared) {
+		Dispatch.vkCmdFillBuffer(commandBuffer, State.handle, AppendedOffset, sizeof(uint32_t), 0);
+	}
+	else {
+		Dispatch.vkCmdFillBuffer(commandBuffer, State.handle, 0, StateSize, 0);
+		StateCleared = true;
+	}
+
+	VkMemoryBarrier clearBarrier = {};
+	clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	clearBarrier.pNext = nullptr;
+	clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0,
+		1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+	// Simulation runs over as many groups as the last update left live particles
+	const SimulateParameters simulateParameters = { deltaSeconds, Gravity, Capacity };
+	SimulatePipeline.CmdBind(commandBuffer, SimulateSets[source]);
+	SimulatePipeline.CmdPushConstants(commandBuffer, &simulateParameters, sizeof(simulateParameters));
+	SimulatePipeline.CmdDispatchIndirect(commandBuffer, State.handle, DispatchArgumentsOffset);
+
+	// Both passes only append through the atomic counter, so emission needs no barrier after the simulation
+	PendingEmission += Emitter.rate * deltaSeconds;
+	const float emitted = std::floor(PendingEmission);
+	PendingEmission -= emitted;
+	const uint32_t emitCount = static_cast<uint32_t>(std::min(static_cast<double>(emitted) + PendingBurst, static_cast<double>(Capacity)));
+	PendingBurst = 0;
+	if (emitCount > 0) {
+		const EmitParameters emitParameters = { emitCount, Seed, Capacity, Emitter.x, Emitter.y, Emitter.speed, Emitter.life, Emitter.size };
+		EmitPipeline.CmdBind(commandBuffer, EmitSets[target]);
+		EmitPipeline.CmdPushConstants(commandBuffer, &emitParameters, sizeof(emitParameters));
+		EmitPipeline.CmdDispatch(commandBuffer, emitCount);
+	}
+	CmdComputeBarrier(Dispatch, commandBuffer);
+
+	const uint32_t finalizeParameters[2] = { Capacity, GroupSize };
+	FinalizePipeline.CmdBind(commandBuffer, FinalizeSet);
+	FinalizePipeline.CmdPushConstants(commandBuffer, finalizeParameters, sizeof(finalizeParameters));
+	FinalizePipeline.CmdDispatch(commandBuffer, 1);
+	CmdComputeBarrier(Dispatch, commandBuffer);
+
+	KeyPipeline.CmdBind(commandBuffer, KeySets[target]);
+	KeyPipeline.CmdDispatchIndirect(commandBuffer, State.handle, DispatchArgumentsOffset);
+	CmdComputeBarrier(Dispatch, commandBuffer);
+	CmdSort(commandBuffer);
+
+	VkMemoryBarrier drawBarrier = {};
+	drawBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	drawBarrier.pNext = nullptr;
+	drawBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	drawBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0,
+		1, &drawBarrier, 0, nullptr, 0, nullptr);
+
+	Current = target;
+	++Seed;
+}
+
+void ParticleSystem::CmdPrePass(VkCommandBuffer commandBuffer, const OffscreenFrame& frame) {
+	CmdUpdate(commandBuffer, frame.deltaSeconds);
+}
+
+void ParticleSystem::CmdDrawOverlay(VkCommandBuffer commandBuffer, const OffscreenFrame& frame) const {
+	// Draw arguments don't exist before the first update
+	if (!StateCleared) {
+		return;
+	}
+	const float cameraConstants[4] = { frame.camera.centerX, frame.camera.centerY, frame.camera.zoom, 0.0f };
+	Dispatch.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, DrawPipeline);
+	Dispatch.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, DrawPipelineLayout, 0, 1, &DrawSets[Current], 0, nullptr);
+	Dispatch.vkCmdPushConstants(commandBuffer, DrawPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, CameraPushConstantSize, cameraConstants);
+	Dispatch.vkCmdDrawIndirect(commandBuffer, State.handle, DrawArgumentsOffset, 1, sizeof(VkDrawIndirectCommand));
+}
+
+uint32_t ParticleSystem::GetCapacity() const {
+	return Capacity;
+}
+
+bool ParticleSystem::CreateDrawPipeline(VkRenderPass renderPass, VkSampleCountFlagBits samples) {
+	VkDescriptorSetLayoutBinding layoutBindings[3] = {};
+	for (uint32_t i = 0; i < 3; ++i) {
+		layoutBindings[i].binding = i;
+		layoutBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		layoutBindings[i].descriptorCount = 1;
+		layoutBindings[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		layoutBindings[i].pImmutableSamplers = nullptr;
+	}
+
+	VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = {};
+	setLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutCreateInfo.pNext = nullptr;
+	setLayoutCreateInfo.flags = 0;
+	setLayoutCreateInfo.bindingCount = 3;
+	setLayoutCreateInfo.pBindings = layoutBindings;
+
+	if (Dispatch.vkCreateDescriptorSetLayout(Dispatch.device, &setLayoutCreateInfo, nullptr, &DrawSetLayout) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE PARTICLE DESCRIPTOR SET LAYOUT " << std::endl;
+		return false;
+	}
+
+	VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * 3 };
+
+	VkDescriptorPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolCreateInfo.pNext = nullptr;
+	poolCreateInfo.flags = 0;
+	poolCreateInfo.maxSets = 2;
+	poolCreateInfo.poolSizeCount = 1;
+	poolCreateInfo.pPoolSizes = &poolSize;
+
+	if (Dispatch.vkCreateDescriptorPool(Dispatch.device, &poolCreateInfo, nullptr, &DrawDescriptorPool) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE PARTICLE DESCRIPTOR POOL " << std::endl;
+		return false;
+	}
+
+	const VkDescriptorSetLayout setLayouts[2] = { DrawSetLayout, DrawSetLayout };
+
+	VkDescriptorSetAllocateInfo allocateInfo = {};
+	allocateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocateInfo.pNext = nullptr;
+	allocateInfo.descriptorPool = DrawDescriptorPool;
+	allocateInfo.descriptorSetCount = 2;
+	allocateInfo.pSetLayouts = setLayouts;
+
+	if (Dispatch.vkAllocateDescriptorSets(Dispatch.device, &allocateInfo, DrawSets) != VK_SUCCESS) {
+		std::cout << "COULD NOT ALLOCATE PARTICLE DESCRIPTOR SETS " << std::endl;
+		return false;
+	}
+
+	// Sorted order always ends up in Values[0]
+	for (uint32_t i = 0; i < 2; ++i) {
+		const VkDescriptorBufferInfo bufferInfos[3] = {
+			{ ParticleStreams[i].positions.handle, 0, VK_WHOLE_SIZE },
+			{ ParticleStreams[i].velocities.handle, 0, VK_WHOLE_SIZE },
+			{ Values[0].handle, 0, VK_WHOLE_SIZE }
+		};
+
+		VkWriteDescriptorSet descriptorWrite = {};
+		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrite.pNext = nullptr;
+		descriptorWrite.dstSet = DrawSets[i];
+		descriptorWrite.dstBinding = 0;
+		descriptorWrite.dstArrayElement = 0;
+		descriptorWrite.descriptorCount = 3;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrite.pImageInfo = nullptr;
+		descriptorWrite.pBufferInfo = bufferInfos;
+		descriptorWrite.pTexelBufferView = nullptr;
+		Dispatch.vkUpdateDescriptorSets(Dispatch.device, 1, &descriptorWrite, 0, nullptr);
+	}
+
+	VkPushConstantRange pushConstantRange = { VK_SHADER_STAGE_VERTEX_BIT, 0, CameraPushConstantSize };
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.pNext = nullptr;
+	pipelineLayoutCreateInfo.flags = 0;
+	pipelineLayoutCreateInfo.setLayoutCount = 1;
+	pipelineLayoutCreateInfo.pSetLayouts = &DrawSetLayout;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (Dispatch.vkCreatePipelineLayout(Dispatch.device, &pipelineLayoutCreateInfo, nullptr, &DrawPipelineLayout) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE PARTICLE PIPELINE LAYOUT " << std::endl;
+		return false;
+	}
+
+	VkShaderModule vertexShader = VK_NULL_HANDLE;
+	VkShaderModule fragmentShader = VK_NULL_HANDLE;
+	if (!Compiler.CreateShaderModule(Dispatch, DrawVertexShader, VK_SHADER_STAGE_VERTEX_BIT, "particle.vert", vertexShader)
+		|| !Compiler.CreateShaderModule(Dispatch, DrawFragmentShader, VK_SHADER_STAGE_FRAGMENT_BIT, "particle.frag", fragmentShader)) {
+		if (vertexShader != VK_NULL_HANDLE) {
+			Dispatch.vkDestroyShaderModule(Dispatch.device, vertexShader, nullptr);
+		}
+		return false;
+	}
+
+	VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = vertexShader;
+	shaderStages[0].pName = "main";
+	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = fragmentShader;
+	shaderStages[1].pName = "main";
+
+	// Everything comes from the storage buffers
+	VkPipelineVertexInputStateCreateInfo vertexInputState = {};
+	vertexInputState.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssemblyState = {};
+	inputAssemblyState.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssemblyState.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	inputAssemblyState.primitiveRestartEnable = VK_FALSE;
+
+	VkPipelineViewportStateCreateInfo viewportState = {};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.pViewports = nullptr;
+	viewportState.scissorCount = 1;
+	viewportState.pScissors = nullptr;
+
+	VkPipelineRasterizationStateCreateInfo rasterizationState = {};
+	rasterizationState.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizationState.depthClampEnable = VK_FALSE;
+	rasterizationState.rasterizerDiscardEnable = VK_FALSE;
+	rasterizationState.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizationState.cullMode = VK_CULL_MODE_NONE;
+	rasterizationState.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterizationState.depthBiasEnable = VK_FALSE;
+	rasterizationState.lineWidth = 1.0f;
+
+	VkPipelineMultisampleStateCreateInfo multisampleState = {};
+	multisampleState.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampleState.rasterizationSamples = samples;
+	multisampleState.sampleShadingEnable = VK_FALSE;
+	multisampleState.minSampleShading = 1.0f;
+
+	// Back to front "over" blending, which is what the sort is for
+	// Particles are a 2D overlay on top of any depth tested geometry
+	VkPipelineDepthStencilStateCreateInfo depthStencilState = {};
+	depthStencilState.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depthStencilState.depthTestEnable = VK_FALSE;
+	depthStencilState.depthWriteEnable = VK_FALSE;
+	depthStencilState.depthCompareOp = VK_COMPARE_OP_ALWAYS;
+	depthStencilState.depthBoundsTestEnable = VK_FALSE;
+	depthStencilState.stencilTestEnable = VK_FALSE;
+	depthStencilState.minDepthBounds = 0.0f;
+	depthStencilState.maxDepthBounds = 1.0f;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+	colorBlendAttachment.blendEnable = VK_TRUE;
+	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+	VkPipelineColorBlendStateCreateInfo colorBlendState = {};
+	colorBlendState.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlendState.logicOpEnable = VK_FALSE;
+	colorBlendState.attachmentCount = 1;
+	colorBlendState.pAttachments = &colorBlendAttachment;
+
+	VkDynamicState dynamicStates[2] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStates;
+
+	VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.pNext = nullptr;
+	pipelineCreateInfo.flags = 0;
+	pipelineCreateInfo.stageCount = 2;
+	pipelineCreateInfo.pStages = shaderStages;
+	pipelineCreateInfo.pVertexInputState = &vertexInputState;
+	pipelineCreateInfo.pInputAssemblyState = &inputAssemblyState;
+	pipelineCreateInfo.pTessellationState = nullptr;
+	pipelineCreateInfo.pViewportState = &viewportState;
+	pipelineCreateInfo.pRasterizationState = &rasterizationState;
+	pipelineCreateInfo.pMultisampleState = &multisampleState;
+	pipelineCreateInfo.pDepthStencilState = &depthStencilState;
+	pipelineCreateInfo.pColorBlendState = &colorBlendState;
+	pipelineCreateInfo.pDynamicState = &dynamicState;
+	pipelineCreateInfo.layout = DrawPipelineLayout;
+	pipelineCreateInfo.renderPass = renderPass;
+	pipelineCreateInfo.subpass = 0;
+	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+	pipelineCreateInfo.basePipelineIndex = -1;
+
+	const VkResult result = Dispatch.vkCreateGraphicsPipelines(Dispatch.device, Device.pipelineCache, 1, &pipelineCreateInfo, nullptr, &DrawPipeline);
+	Dispatch.vkDestroyShaderModule(Dispatch.device, vertexShader, nullptr);
+	Dispatch.vkDestroyShaderModule(Dispatch.device, fragmentShader, nullptr);
+	if (result != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE PARTICLE PIPELINE " << std::endl;
+		DrawPipeline = VK_NULL_HANDLE;
+		return false;
+	}
+	return true;
+}
+
+void ParticleSystem::DestroyDrawPipeline() {
+	if (DrawPipeline != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyPipeline(Dispatch.device, DrawPipeline, nullptr);
+		DrawPipeline = VK_NULL_HANDLE;
+	}
+	if (DrawPipelineLayout != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyPipelineLayout(Dispatch.device, DrawPipelineLayout, nullptr);
+		DrawPipelineLayout = VK_NULL_HANDLE;
+	}
+	// Sets are freed together with their pool
+	if (DrawDescriptorPool != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyDescriptorPool(Dispatch.device, DrawDescriptorPool, nullptr);
+		DrawDescriptorPool = VK_NULL_HANDLE;
+	}
+	if (DrawSetLayout != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyDescriptorSetLayout(Dispatch.device, DrawSetLayout, nullptr);
+		DrawSetLayout = VK_NULL_HANDLE;
+	}
+}
+
+void ParticleSystem::CmdSort(VkCommandBuffer commandBuffer) const {
+	// Passes alternate between the two key buffers, with an even count the result is back in Keys[0] and Values[0]
+	for (uint32_t pass = 0; pass < SortPasses; ++pass) {
+		const uint32_t from = pass % 2;
+		const SortParameters sortParameters = { 4 * pass, TileCount };
+
+		CountPipeline.CmdBind(commandBuffer, CountSets[from]);
+		CountPipeline.CmdPushConstants(commandBuffer, &sortParameters, sizeof(sortParameters));
+		CountPipeline.CmdDispatch(commandBuffer, TileCount * GroupSize);
+		CmdComputeBarrier(Dispatch, commandBuffer);
+
+		HistogramScan.CmdScan(commandBuffer);
+
+		ScatterPipeline.CmdBind(commandBuffer, ScatterSets[from]);
+		ScatterPipeline.CmdPushConstants(commandBuffer, &sortParameters, sizeof(sortParameters));
+		ScatterPipeline.CmdDispatch(commandBuffer, TileCount * GroupSize);
+		CmdComputeBarrier(Dispatch, commandBuffer);
+	}
+}
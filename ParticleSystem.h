@@ -0,0 +1,111 @@
+#pragma once
+
+#include "ComputePipeline.h"
+#include "ComputePrimitives.h"
+#include "OffscreenRenderer.h"
+#include <cstdint>
+#include <vector>
+
+// Where and how fast new particles are spawned, in the -1 to 1 space of the offscreen camera
+struct ParticleEmitter {
+	float x;
+	float y;
+	float rate;			// Particles per second
+	float speed;
+	float life;			// Seconds, every particle lives between one and two times this long
+	float size;
+
+	ParticleEmitter() :
+		x(0.0f),
+		y(0.8f),
+		rate(10000.0f),
+		speed(1.2f),
+		life(1.5f),
+		size(0.004f) {
+	}
+};
+
+// Particles which live entirely on the GPU: every update simulates the live particles, appends the survivors and
+// the newly emitted ones to the other of two structure-of-arrays stream sets (ping-pong), sorts them back to front
+// with a radix sort and leaves an indirect draw whose instance count is the number of survivors. The CPU only
+// records a fixed number of commands per frame, whatever the particle count.
+class ParticleSystem : public OffscreenDrawable {
+public:
+	// Context's dispatch table must outlive the particle system
+	explicit ParticleSystem(const DeviceContext& device);
+	~ParticleSystem();
+
+	ParticleSystem(const ParticleSystem&) = delete;
+	ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+	// Particles are drawn in the first subpass of render passes compatible with renderPass, which has samples samples per pixel
+	bool Create(uint32_t capacity, VkRenderPass renderPass, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+	void Destroy();
+
+	void SetEmitter(const ParticleEmitter& emitter);
+	// Spawns count more particles with the next update, on top of the emitter's rate
+	void Emit(uint32_t count);
+
+	// Outside a render pass, on a graphics queue. Results are visible to CmdDrawOverlay() in the same command buffer.
+	void CmdUpdate(VkCommandBuffer commandBuffer, float deltaSeconds);
+
+	// Updates by the frame's deltaSeconds before the render pass, then draws the particles on top of everything else
+	// with the frame's camera
+	void CmdPrePass(VkCommandBuffer commandBuffer, const OffscreenFrame& frame) override;
+	void CmdDrawOverlay(VkCommandBuffer commandBuffer, const OffscreenFrame& frame) const override;
+
+	uint32_t GetCapacity() const;
+
+private:
+	// Structure of arrays, one stream per attribute
+	struct Streams {
+		GpuBuffer positions;	// xyz, size
+		GpuBuffer velocities;	// xyz, remaining life
+	};
+
+	bool CreateDrawPipeline(VkRenderPass renderPass, VkSampleCountFlagBits samples);
+	void DestroyDrawPipeline();
+	void CmdSort(VkCommandBuffer commandBuffer) const;
+
+	DeviceContext Device;
+	const DeviceDispatchTable& Dispatch;
+	ShaderCompiler Compiler;
+
+	ComputePipeline SimulatePipeline;
+	ComputePipeline EmitPipeline;
+	ComputePipeline FinalizePipeline;
+	ComputePipeline KeyPipeline;
+	ComputePipeline CountPipeline;
+	ComputePipeline ScatterPipeline;
+	PrefixSum HistogramScan;
+
+	Streams ParticleStreams[2];
+	GpuBuffer State;				// Indirect draw and dispatch arguments followed by the counters
+	bool StateCleared;
+	GpuBuffer Keys[2];
+	GpuBuffer Values[2];			// Particle indices, sorted back to front in Values[0] after an update
+	GpuBuffer Histogram;			// Digit-major: count of every digit in every tile
+
+	// Indexed by the stream set which holds the live particles (or receives them, for emission)
+	VkDescriptorSet SimulateSets[2];
+	VkDescriptorSet EmitSets[2];
+	VkDescriptorSet FinalizeSet;
+	VkDescriptorSet KeySets[2];
+	// Indexed by the key buffer sorted from
+	VkDescriptorSet CountSets[2];
+	VkDescriptorSet ScatterSets[2];
+
+	VkDescriptorSetLayout DrawSetLayout;
+	VkDescriptorPool DrawDescriptorPool;
+	VkDescriptorSet DrawSets[2];
+	VkPipelineLayout DrawPipelineLayout;
+	VkPipeline DrawPipeline;
+
+	uint32_t Capacity;
+	uint32_t TileCount;
+	uint32_t Current;				// Stream set with the live particles
+	ParticleEmitter Emitter;
+	float PendingEmission;			// Fractional particles carried over to the next update
+	uint32_t PendingBurst;
+	uint32_t Seed;
+};
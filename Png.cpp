@@ -0,0 +1,567 @@
+#include "Png.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+namespace {
+	const uint8_t Signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+	uint32_t Crc32(const uint8_t* data, size_t size, uint32_t crc = 0) {
+		static uint32_t table[256] = {};
+		static bool tableReady = false;
+		if (!tableReady) {
+			for (uint32_t n = 0; n < 256; ++n) {
+				uint32_t c = n;
+				for (int k = 0; k < 8; ++k) {
+					c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+				}
+				table[n] = c;
+			}
+			tableReady = true;
+		}
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++i) {
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return ~crc;
+	}
+
+	uint32_t Adler32(const uint8_t* data, size_t size) {
+		uint32_t a = 1;
+		uint32_t b = 0;
+		for (size_t i = 0; i < size; ++i) {
+			a = (a + data[i]) % 65521;
+			b = (b + a) % 65521;
+		}
+		return (b << 16) | a;
+	}
+
+	uint32_t ReadBigEndian(const uint8_t* data) {
+		return (static_cast<uint32_t>(data[0]) << 24) | (static_cast<uint32_t>(data[1]) << 16) | (static_cast<uint32_t>(data[2]) << 8) | data[3];
+	}
+
+	void AppendBigEndian(std::vector<uint8_t>& output, uint32_t value) {
+		output.push_back(static_cast<uint8_t>(value >> 24));
+		output.push_back(static_cast<uint8_t>(value >> 16));
+		output.push_back(static_cast<uint8_t>(value >> 8));
+		output.push_back(static_cast<uint8_t>(value));
+	}
+
+	// ***** Inflate (RFC 1951), decoding one Huffman code bit by bit ***** //
+
+	struct Huffman {
+		uint16_t count[16];		// Number of codes of each length
+		uint16_t symbol[320];	// Symbols ordered by code
+	};
+
+	class Inflater {
+	public:
+		Inflater(const uint8_t* data, size_t size, std::vector<uint8_t>& output) :
+			Data(data),
+			Size(size),
+			Position(0),
+			BitBuffer(0),
+			BitCount(0),
+			Output(output),
+			Error(false) {
+		}
+
+		bool Run() {
+			bool last = false;
+			while (!last) {
+				last = Bits(1) == 1;
+				uint32_t type = Bits(2);
+				switch (type) {
+				case 0:
+					Stored();
+					break;
+				case 1:
+					Fixed();
+					break;
+				case 2:
+					Dynamic();
+					break;
+				default:
+					Error = true;
+				}
+				if (Error) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+	private:
+		uint32_t Bits(int need) {
+			uint32_t value = BitBuffer;
+			while (BitCount < need) {
+				if (Position >= Size) {
+					Error = true;
+					return 0;
+				}
+				value |= static_cast<uint32_t>(Data[Position++]) << BitCount;
+				BitCount += 8;
+			}
+			BitBuffer = value >> need;
+			BitCount -= need;
+			return value & ((1u << need) - 1);
+		}
+
+		void Stored() {
+			BitBuffer = 0;
+			BitCount = 0;
+			if (Position + 4 > Size) {
+				Error = true;
+				return;
+			}
+			uint32_t length = Data[Position] | (Data[Position + 1] << 8);
+			uint32_t complement = Data[Position + 2] | (Data[Position + 3] << 8);
+			Position += 4;
+			if ((length != (~complement & 0xFFFF)) || (Position + length > Size)) {
+				Error = true;
+				return;
+			}
+			Output.insert(Output.end(), Data + Position, Data + Position + length);
+			Position += length;
+		}
+
+		int Decode(const Huffman& huffman) {
+			int code = 0;
+			int first = 0;
+			int index = 0;
+			for (int length = 1; length < 16; ++length) {
+				code |= static_cast<int>(Bits(1));
+				if (Error) {
+					return -1;
+				}
+				int count = huffman.count[length];
+				if (code - count < first) {
+					return huffman.symbol[index + (code - first)];
+				}
+				index += count;
+				first += count;
+				first <<= 1;
+				code <<= 1;
+			}
+			Error = true;
+			return -1;
+		}
+
+		static bool Construct(Huffman& huffman, const uint16_t* lengths, int count) {
+			memset(huffman.count, 0, sizeof(huffman.count));
+			for (int i = 0; i < count; ++i) {
+				huffman.count[lengths[i]]++;
+			}
+			if (huffman.count[0] == count) {
+				return true;
+			}
+
+			int left = 1;
+			for (int length = 1; length < 16; ++length) {
+				left <<= 1;
+				left -= huffman.count[length];
+				if (left < 0) {
+					return false;
+				}
+			}
+
+			uint16_t offsets[16];
+			offsets[1] = 0;
+			for (int length = 1; length < 15; ++length) {
+				offsets[length + 1] = offsets[length] + huffman.count[length];
+			}
+			for (int i = 0; i < count; ++i) {
+				if (lengths[i] != 0) {
+					huffman.symbol[offsets[lengths[i]]++] = static_cast<uint16_t>(i);
+				}
+			}
+			return true;
+		}
+
+		void Codes(const Huffman& lengthCodes, const Huffman& distanceCodes) {
+			static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+			static const uint16_t lengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+			static const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+			static const uint16_t distanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+			for (;;) {
+				int symbol = Decode(lengthCodes);
+				if (symbol < 0) {
+					return;
+				}
+				if (symbol < 256) {
+					Output.push_back(static_cast<uint8_t>(symbol));
+					continue;
+				}
+				if (symbol == 256) {
+					return;
+				}
+
+				symbol -= 257;
+				if (symbol >= 29) {
+					Error = true;
+					return;
+				}
+				uint32_t length = lengthBase[symbol] + Bits(lengthExtra[symbol]);
+
+				symbol = Decode(distanceCodes);
+				if ((symbol < 0) || (symbol >= 30)) {
+					Error = true;
+					return;
+				}
+				uint32_t distance = distanceBase[symbol] + Bits(distanceExtra[symbol]);
+				if (Error || (distance > Output.size())) {
+					Error = true;
+					return;
+				}
+
+				// Byte by byte, source and destination may overlap
+				size_t from = Output.size() - distance;
+				for (uint32_t i = 0; i < length; ++i) {
+					Output.push_back(Output[from + i]);
+				}
+			}
+		}
+
+		void Fixed() {
+			Huffman lengthCodes;
+			Huffman distanceCodes;
+			uint16_t lengths[288];
+			int symbol = 0;
+			for (; symbol < 144; ++symbol) {
+				lengths[symbol] = 8;
+			}
+			for (; symbol < 256; ++symbol) {
+				lengths[symbol] = 9;
+			}
+			for (; symbol < 280; ++symbol) {
+				lengths[symbol] = 7;
+			}
+			for (; symbol < 288; ++symbol) {
+				lengths[symbol] = 8;
+			}
+			Construct(lengthCodes, lengths, 288);
+
+			for (symbol = 0; symbol < 30; ++symbol) {
+				lengths[symbol] = 5;
+			}
+			Construct(distanceCodes, lengths, 30);
+
+			Codes(lengthCodes, distanceCodes);
+		}
+
+		void Dynamic() {
+			static const uint8_t order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+			int lengthCount = static_cast<int>(Bits(5)) + 257;
+			int distanceCount = static_cast<int>(Bits(5)) + 1;
+			int codeCount = static_cast<int>(Bits(4)) + 4;
+			if (Error || (lengthCount > 286) || (distanceCount > 30)) {
+				Error = true;
+				return;
+			}
+
+			uint16_t lengths[320] = {};
+			for (int i = 0; i < codeCount; ++i) {
+				lengths[order[i]] = static_cast<uint16_t>(Bits(3));
+			}
+
+			Huffman codeLengthCodes;
+			if (!Construct(codeLengthCodes, lengths, 19)) {
+				Error = true;
+				return;
+			}
+
+			int index = 0;
+			while (index < lengthCount + distanceCount) {
+				int symbol = Decode(codeLengthCodes);
+				if (symbol < 0) {
+					return;
+				}
+				if (symbol < 16) {
+					lengths[index++] = static_cast<uint16_t>(symbol);
+					continue;
+				}
+
+				uint16_t length = 0;
+				uint32_t repeat = 0;
+				if (symbol == 16) {
+					if (index == 0) {
+						Error = true;
+						return;
+					}
+					length = lengths[index - 1];
+					repeat = 3 + Bits(2);
+				}
+				else if (symbol == 17) {
+					repeat = 3 + Bits(3);
+				}
+				else {
+					repeat = 11 + Bits(7);
+				}
+				if (Error || (index + static_cast<int>(repeat) > lengthCount + distanceCount)) {
+					Error = true;
+					return;
+				}
+				while (repeat--) {
+					lengths[index++] = length;
+				}
+			}
+
+			Huffman lengthCodes;
+			Huffman distanceCodes;
+			if (!Construct(lengthCodes, lengths, lengthCount) || !Construct(distanceCodes, lengths + lengthCount, distanceCount)) {
+				Error = true;
+				return;
+			}
+			Codes(lengthCodes, distanceCodes);
+		}
+
+		const uint8_t* Data;
+		size_t Size;
+		size_t Position;
+		uint32_t BitBuffer;
+		int BitCount;
+		std::vector<uint8_t>& Output;
+		bool Error;
+	};
+
+	// ***** Scanline filters ***** //
+
+	uint8_t Paeth(int a, int b, int c) {
+		int p = a + b - c;
+		int pa = abs(p - a);
+		int pb = abs(p - b);
+		int pc = abs(p - c);
+		if ((pa <= pb) && (pa <= pc)) {
+			return static_cast<uint8_t>(a);
+		}
+		return static_cast<uint8_t>((pb <= pc) ? b : c);
+	}
+
+	bool Unfilter(std::vector<uint8_t>& data, uint32_t width, uint32_t height, uint32_t bytesPerPixel, std::vector<uint8_t>& pixels) {
+		const size_t stride = static_cast<size_t>(width) * bytesPerPixel;
+		if (data.size() < (stride + 1) * height) {
+			return false;
+		}
+
+		pixels.assign(stride * height, 0);
+		std::vector<uint8_t> zeroRow(stride, 0);
+		for (uint32_t y = 0; y < height; ++y) {
+			const uint8_t filter = data[y * (stride + 1)];
+			const uint8_t* source = &data[y * (stride + 1) + 1];
+			uint8_t* row = &pixels[y * stride];
+			const uint8_t* previous = (y > 0) ? &pixels[(y - 1) * stride] : zeroRow.data();
+
+			for (size_t x = 0; x < stride; ++x) {
+				const int left = (x >= bytesPerPixel) ? row[x - bytesPerPixel] : 0;
+				const int up = previous[x];
+				const int upLeft = (x >= bytesPerPixel) ? previous[x - bytesPerPixel] : 0;
+				switch (filter) {
+				case 0:
+					row[x] = source[x];
+					break;
+				case 1:
+					row[x] = static_cast<uint8_t>(source[x] + left);
+					break;
+				case 2:
+					row[x] = static_cast<uint8_t>(source[x] + up);
+					break;
+				case 3:
+					row[x] = static_cast<uint8_t>(source[x] + ((left + up) >> 1));
+					break;
+				case 4:
+					row[x] = static_cast<uint8_t>(source[x] + Paeth(left, up, upLeft));
+					break;
+				default:
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	void AppendChunk(std::vector<uint8_t>& output, const char* type, const std::vector<uint8_t>& data) {
+		AppendBigEndian(output, static_cast<uint32_t>(data.size()));
+		const size_t typeOffset = output.size();
+		output.insert(output.end(), type, type + 4);
+		output.insert(output.end(), data.begin(), data.end());
+		AppendBigEndian(output, Crc32(&output[typeOffset], output.size() - typeOffset));
+	}
+}
+
+namespace Png {
+
+	bool Read(const std::string& path, uint32_t& width, uint32_t& height, std::vector<uint8_t>& rgba, std::string& error) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			error = "could not open " + path;
+			return false;
+		}
+		std::vector<uint8_t> contents((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+		if ((contents.size() < 8) || (memcmp(contents.data(), Signature, 8) != 0)) {
+			error = path + " is not a PNG file";
+			return false;
+		}
+
+		uint8_t bitDepth = 0;
+		uint8_t colorType = 0;
+		uint8_t interlace = 0;
+		std::vector<uint8_t> compressed;
+		width = 0;
+		height = 0;
+
+		size_t position = 8;
+		while (position + 12 <= contents.size()) {
+			const uint32_t length = ReadBigEndian(&contents[position]);
+			const char* type = reinterpret_cast<const char*>(&contents[position + 4]);
+			const uint8_t* data = &contents[position + 8];
+			if (position + 12 + static_cast<size_t>(length) > contents.size()) {
+				break;
+			}
+			if (Crc32(&contents[position + 4], length + 4) != ReadBigEndian(data + length)) {
+				error = path + " has a corrupted chunk";
+				return false;
+			}
+
+			if ((memcmp(type, "IHDR", 4) == 0) && (length >= 13)) {
+				width = ReadBigEndian(data);
+				height = ReadBigEndian(data + 4);
+				bitDepth = data[8];
+				colorType = data[9];
+				interlace = data[12];
+			}
+			else if (memcmp(type, "IDAT", 4) == 0) {
+				compressed.insert(compressed.end(), data, data + length);
+			}
+			else if (memcmp(type, "IEND", 4) == 0) {
+				break;
+			}
+			position += 12 + length;
+		}
+
+		uint32_t channels = 0;
+		switch (colorType) {
+		case 0:
+			channels = 1;
+			break;
+		case 2:
+			channels = 3;
+			break;
+		case 4:
+			channels = 2;
+			break;
+		case 6:
+			channels = 4;
+			break;
+		}
+		if ((width == 0) || (height == 0) || (bitDepth != 8) || (channels == 0) || (interlace != 0)) {
+			error = path + " uses an unsupported PNG format (only 8-bit, non-interlaced, without palette)";
+			return false;
+		}
+
+		// zlib stream: 2 byte header, deflate data, adler32
+		if ((compressed.size() < 6) || ((compressed[0] & 0x0F) != 8) || (compressed[1] & 0x20)) {
+			error = path + " has an unsupported zlib stream";
+			return false;
+		}
+		std::vector<uint8_t> filtered;
+		filtered.reserve((static_cast<size_t>(width) * channels + 1) * height);
+		Inflater inflater(compressed.data() + 2, compressed.size() - 2, filtered);
+		if (!inflater.Run()) {
+			error = path + " has corrupted image data";
+			return false;
+		}
+
+		std::vector<uint8_t> pixels;
+		if (!Unfilter(filtered, width, height, channels, pixels)) {
+			error = path + " has corrupted scanlines";
+			return false;
+		}
+
+		const size_t pixelCount = static_cast<size_t>(width) * height;
+		rgba.resize(pixelCount * 4);
+		for (size_t i = 0; i < pixelCount; ++i) {
+			const uint8_t* source = &pixels[i * channels];
+			uint8_t* destination = &rgba[i * 4];
+			switch (channels) {
+			case 1:
+				destination[0] = destination[1] = destination[2] = source[0];
+				destination[3] = 255;
+				break;
+			case 2:
+				destination[0] = destination[1] = destination[2] = source[0];
+				destination[3] = source[1];
+				break;
+			case 3:
+				memcpy(destination, source, 3);
+				destination[3] = 255;
+				break;
+			default:
+				memcpy(destination, source, 4);
+			}
+		}
+		return true;
+	}
+
+	bool Write(const std::string& path, uint32_t width, uint32_t height, const std::vector<uint8_t>& rgba) {
+		if (rgba.size() < static_cast<size_t>(width) * 4 * height) {
+			return false;
+		}
+		return Write(path, width, height, rgba.data());
+	}
+
+	bool Write(const std::string& path, uint32_t width, uint32_t height, const uint8_t* rgba) {
+		const size_t stride = static_cast<size_t>(width) * 4;
+
+		// Every scanline starts with filter type 0 (none)
+		std::vector<uint8_t> raw;
+		raw.reserve((stride + 1) * height);
+		for (uint32_t y = 0; y < height; ++y) {
+			raw.push_back(0);
+			raw.insert(raw.end(), rgba + y * stride, rgba + (y + 1) * stride);
+		}
+
+		// zlib stream made of stored deflate blocks
+		std::vector<uint8_t> compressed = { 0x78, 0x01 };
+		size_t offset = 0;
+		do {
+			const size_t blockSize = std::min<size_t>(raw.size() - offset, 65535);
+			const bool last = offset + blockSize == raw.size();
+			compressed.push_back(last ? 1 : 0);
+			compressed.push_back(static_cast<uint8_t>(blockSize));
+			compressed.push_back(static_cast<uint8_t>(blockSize >> 8));
+			compressed.push_back(static_cast<uint8_t>(~blockSize));
+			compressed.push_back(static_cast<uint8_t>(~blockSize >> 8));
+			compressed.insert(compressed.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+			offset += blockSize;
+		} while (offset < raw.size());
+		AppendBigEndian(compressed, Adler32(raw.data(), raw.size()));
+
+		std::vector<uint8_t> header;
+		AppendBigEndian(header, width);
+		AppendBigEndian(header, height);
+		header.push_back(8);	// Bit depth
+		header.push_back(6);	// RGBA
+		header.push_back(0);	// Deflate
+		header.push_back(0);	// Adaptive filtering
+		header.push_back(0);	// Not interlaced
+
+		std::vector<uint8_t> output(Signature, Signature + 8);
+		AppendChunk(output, "IHDR", header);
+		AppendChunk(output, "IDAT", compressed);
+		AppendChunk(output, "IEND", std::vector<uint8_t>());
+
+		std::ofstream file(path, std::ios::binary);
+		if (!file) {
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(output.data()), output.size());
+		return static_cast<bool>(file);
+	}
+
+}
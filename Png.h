@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Self-contained PNG reading and writing for golden images, so no image library or zlib is needed.
+// Pixels are always 8-bit RGBA, rows top to bottom without padding.
+namespace Png {
+
+	// Reads non-interlaced 8-bit grayscale, gray+alpha, RGB and RGBA images
+	bool Read(const std::string& path, uint32_t& width, uint32_t& height, std::vector<uint8_t>& rgba, std::string& error);
+
+	// Image data is stored without compression - golden images are small and this keeps the writer trivial
+	bool Write(const std::string& path, uint32_t width, uint32_t height, const std::vector<uint8_t>& rgba);
+	// Same for pixels somebody else owns, e.g. a mapped readback buffer - rgba must hold width * height * 4 bytes
+	bool Write(const std::string& path, uint32_t width, uint32_t height, const uint8_t* rgba);
+
+}
@@ -0,0 +1,159 @@
+#include "PostProcessing.h"
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {
+	// Single triangle covering the viewport
+	const char* FullscreenVertexShader = R"(#version 450
+
+void main() {
+	const vec2 position = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+	gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+	// Every effect maps a color to a color at a single pixel; main() is generated per stage
+	const char* EffectHeader = R"(#version 450
+
+layout(input_attachment_index = 0, set = 0, binding = 0) uniform subpassInput previous;
+
+layout(push_constant) uniform Stage {
+	vec4 inverseExtent;
+	vec4 parameters[7];
+};
+
+layout(location = 0) out vec4 Color;
+
+// Narkowicz's fit of the ACES filmic curve
+vec3 Tonemap(vec3 color, vec4 settings) {
+	const vec3 x = color * settings.x;
+	return clamp((x * (2.51 * x + 0.03)) / (x * (2.43 * x + 0.59) + 0.14), 0.0, 1.0);
+}
+
+vec3 ColorGrade(vec3 color, vec4 settings) {
+	const float luma = dot(color, vec3(0.2126, 0.7152, 0.0722));
+	color = mix(vec3(luma), color, settings.x);
+	color = (color - 0.5) * settings.y + 0.5;
+	color *= vec3(1.0 + 0.1 * settings.z, 1.0, 1.0 - 0.1 * settings.z);
+	return max(color, vec3(0.0));
+}
+
+vec3 Vignette(vec3 color, vec4 settings) {
+	const vec2 centered = gl_FragCoord.xy * inverseExtent.xy - 0.5;
+	const float falloff = smoothstep(settings.y, settings.y + max(settings.z, 0.001), length(centered) * 1.41421356);
+	return color * (1.0 - settings.x * falloff);
+}
+
+void main() {
+	vec3 color = subpassLoad(previous).rgb;
+)";
+
+	const char* EffectFunctions[] = { "Tonemap", "ColorGrade", "Vignette" };
+}
+
+PostProcessChain::PostProcessChain(const DeviceContext& device) :
+	Device(device),
+	Dispatch(*device.dispatch),
+	Effects(),
+	Stages(),
+	Pipelines() {
+}
+
+PostProcessChain::~PostProcessChain() {
+	Destroy();
+}
+
+void PostProcessChain::Configure(const PostProcessSettings& settings) {
+	Destroy();
+	Effects = settings.effects;
+	Stages.clear();
+
+	// Every effect only reads its own pixel, so the only limit on fusing is the room for parameters
+	const uint32_t effectsPerStage = settings.fuse ? MaxEffectsPerStage : 1;
+	for (uint32_t first = 0; first < static_cast<uint32_t>(Effects.size()); first += effectsPerStage) {
+		const uint32_t count = static_cast<uint32_t>(Effects.size()) - first;
+		Stages.push_back({ first, (count < effectsPerStage) ? count : effectsPerStage, VK_NULL_HANDLE });
+	}
+}
+
+uint32_t PostProcessChain::GetStageCount() const {
+	return static_cast<uint32_t>(Stages.size());
+}
+
+bool PostProcessChain::Create(VkRenderPass renderPass, uint32_t firstSubpass) {
+	for (uint32_t i = 0; i < static_cast<uint32_t>(Stages.size()); ++i) {
+		Stage& stage = Stages[i];
+
+		std::string fragmentShader = EffectHeader;
+		for (uint32_t j = 0; j < stage.effectCount; ++j) {
+			const PostEffect& effect = Effects[stage.firstEffect + j];
+			fragmentShader += "\tcolor = " + std::string(EffectFunctions[static_cast<uint32_t>(effect.type)]) + "(color, parameters[" + std::to_string(j) + "]);\n";
+		}
+		fragmentShader += "\tColor = vec4(color, 1.0);\n}\n";
+
+		// Full-screen stages have no depth attachment and overwrite every pixel
+		GraphicsPipelineState state;
+		state.renderPass = renderPass;
+		state.subpass = firstSubpass + i;
+
+		const std::string name = "post_stage_" + std::to_string(i);
+		Pipelines.emplace_back(new GraphicsPipeline(Device));
+		if (!Pipelines.back()->Create(FullscreenVertexShader, fragmentShader.c_str(), name.c_str(), { VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT },
+				sizeof(StageConstants), 1, state)
+			|| !Pipelines.back()->AllocateDescriptorSet(stage.set)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void PostProcessChain::Destroy() {
+	// Pipelines destroy themselves, together with the pools their sets came from
+	Pipelines.clear();
+	for (Stage& stage : Stages) {
+		stage.set = VK_NULL_HANDLE;
+	}
+}
+
+void PostProcessChain::SetInputs(const std::vector<VkImageView>& inputs) {
+	for (uint32_t i = 0; (i < static_cast<uint32_t>(Pipelines.size())) && (i < static_cast<uint32_t>(inputs.size())); ++i) {
+		Pipelines[i]->WriteImage(Stages[i].set, 0, inputs[i], VK_NULL_HANDLE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+}
+
+bool PostProcessChain::SetParameters(uint32_t effect, float x, float y, float z, float w) {
+	if (effect >= Effects.size()) {
+		std::cout << "POST-PROCESSING CHAIN HAS NO EFFECT " << effect << std::endl;
+		return false;
+	}
+	float* parameters = Effects[effect].parameters;
+	parameters[0] = x;
+	parameters[1] = y;
+	parameters[2] = z;
+	parameters[3] = w;
+	return true;
+}
+
+void PostProcessChain::CmdDraw(VkCommandBuffer commandBuffer, VkExtent2D extent) const {
+	VkViewport viewport = { 0.0f, 0.0f, static_cast<float>(extent.width), static_cast<float>(extent.height), 0.0f, 1.0f };
+	VkRect2D scissor = { { 0, 0 }, extent };
+
+	StageConstants constants = {};
+	constants.inverseExtent[0] = 1.0f / static_cast<float>(extent.width);
+	constants.inverseExtent[1] = 1.0f / static_cast<float>(extent.height);
+
+	for (uint32_t i = 0; i < static_cast<uint32_t>(Pipelines.size()); ++i) {
+		const Stage& stage = Stages[i];
+		Dispatch.vkCmdNextSubpass(commandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+		Dispatch.vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		Dispatch.vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		for (uint32_t j = 0; j < stage.effectCount; ++j) {
+			memcpy(constants.parameters[j], Effects[stage.firstEffect + j].parameters, sizeof(constants.parameters[j]));
+		}
+		Pipelines[i]->CmdBind(commandBuffer, stage.set);
+		Pipelines[i]->CmdPushConstants(commandBuffer, &constants, sizeof(constants));
+		Dispatch.vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+	}
+}
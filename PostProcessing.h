@@ -0,0 +1,92 @@
+#pragma once
+
+#include "GraphicsPipeline.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+enum class PostEffectType {
+	Tonemap,			// x: exposure; filmic curve from linear HDR to 0 - 1
+	ColorGrade,			// x: saturation, y: contrast around mid grey, z: warmth (-1 cool to 1 warm)
+	Vignette			// x: strength, y: radius where darkening starts, z: softness
+};
+
+struct PostEffect {
+	PostEffectType type;
+	float parameters[4];
+
+	PostEffect() :
+		type(PostEffectType::Tonemap),
+		parameters() {
+	}
+
+	PostEffect(PostEffectType type, float x, float y = 0.0f, float z = 0.0f, float w = 0.0f) :
+		type(type),
+		parameters() {
+		parameters[0] = x;
+		parameters[1] = y;
+		parameters[2] = z;
+		parameters[3] = w;
+	}
+};
+
+struct PostProcessSettings {
+	std::vector<PostEffect> effects;	// Applied in order
+	bool fuse;							// Adjacent effects share one subpass; off gives every effect its own
+
+	PostProcessSettings() :
+		effects(),
+		fuse(true) {
+	}
+};
+
+// Chain of full-screen per-pixel effects run as subpasses of the render pass that draws the scene.
+// Every stage reads the previous subpass' result through an input attachment at its own pixel, so on tilers the
+// intermediates never leave tile memory. Effects of a stage are fused into one generated fragment shader, up to as many
+// as the push constants hold parameters for; the owner of the render pass creates one subpass and one transient
+// intermediate attachment per stage (GetStageCount()), the last stage writing the final image.
+class PostProcessChain {
+public:
+	static const uint32_t MaxEffectsPerStage = 7;
+
+	// Context's dispatch table must outlive the chain
+	explicit PostProcessChain(const DeviceContext& device);
+	~PostProcessChain();
+
+	PostProcessChain(const PostProcessChain&) = delete;
+	PostProcessChain& operator=(const PostProcessChain&) = delete;
+
+	// Splits the effects into stages, before the render pass is created
+	void Configure(const PostProcessSettings& settings);
+	uint32_t GetStageCount() const;
+	// Stage i is subpass firstSubpass + i of renderPass
+	bool Create(VkRenderPass renderPass, uint32_t firstSubpass);
+	void Destroy();
+
+	// Input attachment view of every stage, in SHADER_READ_ONLY_OPTIMAL layout; again after the views were recreated
+	void SetInputs(const std::vector<VkImageView>& inputs);
+	// Takes effect from the next recorded frame
+	bool SetParameters(uint32_t effect, float x, float y, float z, float w);
+
+	// Inside the render pass, at the end of the scene subpass; moves through every stage's subpass
+	void CmdDraw(VkCommandBuffer commandBuffer, VkExtent2D extent) const;
+
+private:
+	struct Stage {
+		uint32_t firstEffect;
+		uint32_t effectCount;
+		VkDescriptorSet set;
+	};
+
+	// Push constant block of a stage
+	struct StageConstants {
+		float inverseExtent[4];
+		float parameters[MaxEffectsPerStage][4];
+	};
+
+	DeviceContext Device;
+	const DeviceDispatchTable& Dispatch;
+	std::vector<PostEffect> Effects;
+	std::vector<Stage> Stages;
+	std::vector<std::unique_ptr<GraphicsPipeline>> Pipelines;		// One per stage
+};
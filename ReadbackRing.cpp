@@ -0,0 +1,389 @@
+#include "ReadbackRing.h"
+#include "VulkanFunctions.h"
+#include <algorithm>
+#include <iostream>
+
+ReadbackRing::ReadbackRing(const DeviceContext& device) :
+	Device(device),
+	Dispatch(*device.dispatch),
+	Buffer(VK_NULL_HANDLE),
+	Memory(VK_NULL_HANDLE),
+	MappedData(nullptr),
+	SlotSize(0),
+	SlotStride(0),
+	Coherent(true),
+	HostCached(false),
+	Timeline(VK_NULL_HANDLE),
+	NextValue(1),
+	Slots(),
+	NextSlot(0),
+	InFlight(),
+	Ready(),
+	Busy(0),
+	Mutex(),
+	SlotCommitted(),
+	SlotReady(),
+	SlotReleased(),
+	CompletionThread(),
+	Workers(),
+	Stopping(false),
+	Failed(false) {
+}
+
+ReadbackRing::~ReadbackRing() {
+	Destroy();
+}
+
+bool ReadbackRing::Create(uint32_t slotCount, VkDeviceSize slotSize, uint32_t workerCount) {
+	Destroy();
+	if ((slotCount == 0) || (slotSize == 0)) {
+		return false;
+	}
+
+	// Slots start on a non-coherent atom, so invalidating one never touches its neighbours
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(Device.physicalDevice, &properties);
+	const VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.nonCoherentAtomSize, 16);
+	SlotSize = slotSize;
+	SlotStride = (slotSize + alignment - 1) / alignment * alignment;
+
+	VkBufferCreateInfo bufferCreateInfo = {};
+	bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferCreateInfo.pNext = nullptr;
+	bufferCreateInfo.flags = 0;
+	bufferCreateInfo.size = SlotStride * slotCount;
+	bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	bufferCreateInfo.queueFamilyIndexCount = 0;
+	bufferCreateInfo.pQueueFamilyIndices = nullptr;
+
+	if (Dispatch.vkCreateBuffer(Dispatch.device, &bufferCreateInfo, nullptr, &Buffer) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE READBACK RING BUFFER " << std::endl;
+		return false;
+	}
+
+	VkMemoryRequirements memoryRequirements;
+	Dispatch.vkGetBufferMemoryRequirements(Dispatch.device, Buffer, &memoryRequirements);
+
+	// Uncached memory is write-combined, reading it from the CPU is many times slower
+	VkMemoryAllocateInfo memoryAllocateInfo = {};
+	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memoryAllocateInfo.pNext = nullptr;
+	memoryAllocateInfo.allocationSize = memoryRequirements.size;
+	if (!Device.GetMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, memoryAllocateInfo.memoryTypeIndex)
+		&& !Device.GetMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, memoryAllocateInfo.memoryTypeIndex)) {
+		std::cout << "NO HOST VISIBLE MEMORY TYPE FOR READBACK RING " << std::endl;
+		Destroy();
+		return false;
+	}
+
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(Device.physicalDevice, &memoryProperties);
+	const VkMemoryPropertyFlags memoryFlags = memoryProperties.memoryTypes[memoryAllocateInfo.memoryTypeIndex].propertyFlags;
+	Coherent = (memoryFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+	HostCached = (memoryFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != 0;
+
+	void* data = nullptr;
+	if ((Dispatch.vkAllocateMemory(Dispatch.device, &memoryAllocateInfo, nullptr, &Memory) != VK_SUCCESS)
+		|| (Dispatch.vkBindBufferMemory(Dispatch.device, Buffer, Memory, 0) != VK_SUCCESS)
+		|| (Dispatch.vkMapMemory(Dispatch.device, Memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS)) {
+		std::cout << "COULD NOT ALLOCATE MEMORY FOR READBACK RING " << std::endl;
+		Destroy();
+		return false;
+	}
+	MappedData = static_cast<uint8_t*>(data);
+
+	Slots.resize(slotCount);
+	for (Slot& slot : Slots) {
+		slot.state = SlotState::Free;
+		slot.fence = VK_NULL_HANDLE;
+		slot.value = 0;
+		slot.data = ReadbackData();
+	}
+
+	// One timeline value per readback, otherwise one fence per slot
+	if (Device.timelineSemaphores) {
+		VkSemaphoreTypeCreateInfoKHR semaphoreTypeCreateInfo = {};
+		semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+		semaphoreTypeCreateInfo.pNext = nullptr;
+		semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+		semaphoreTypeCreateInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+		semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+		semaphoreCreateInfo.flags = 0;
+
+		if (Dispatch.vkCreateSemaphore(Dispatch.device, &semaphoreCreateInfo, nullptr, &Timeline) != VK_SUCCESS) {
+			std::cout << "COULD NOT CREATE READBACK TIMELINE SEMAPHORE " << std::endl;
+			Destroy();
+			return false;
+		}
+		NextValue = 1;
+	}
+	else {
+		VkFenceCreateInfo fenceCreateInfo = {};
+		fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		fenceCreateInfo.pNext = nullptr;
+		fenceCreateInfo.flags = 0;
+		for (Slot& slot : Slots) {
+			if (Dispatch.vkCreateFence(Dispatch.device, &fenceCreateInfo, nullptr, &slot.fence) != VK_SUCCESS) {
+				std::cout << "COULD NOT CREATE READBACK FENCE " << std::endl;
+				Destroy();
+				return false;
+			}
+		}
+	}
+
+	CompletionThread = std::thread(&ReadbackRing::CompleteSubmissions, this);
+	for (uint32_t i = 0; i < std::max(workerCount, 1u); ++i) {
+		Workers.emplace_back(&ReadbackRing::ConsumeReadbacks, this);
+	}
+	return true;
+}
+
+void ReadbackRing::Destroy() {
+	if (CompletionThread.joinable()) {
+		Drain();
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			Stopping = true;
+		}
+		SlotCommitted.notify_all();
+		SlotReady.notify_all();
+		CompletionThread.join();
+		for (std::thread& worker : Workers) {
+			worker.join();
+		}
+		Workers.clear();
+		Stopping = false;
+	}
+
+	for (Slot& slot : Slots) {
+		if (slot.fence != VK_NULL_HANDLE) {
+			Dispatch.vkDestroyFence(Dispatch.device, slot.fence, nullptr);
+		}
+	}
+	Slots.clear();
+	InFlight.clear();
+	Ready.clear();
+	NextSlot = 0;
+	Busy = 0;
+
+	if (Timeline != VK_NULL_HANDLE) {
+		Dispatch.vkDestroySemaphore(Dispatch.device, Timeline, nullptr);
+		Timeline = VK_NULL_HANDLE;
+	}
+	if (MappedData != nullptr) {
+		Dispatch.vkUnmapMemory(Dispatch.device, Memory);
+		MappedData = nullptr;
+	}
+	if (Buffer != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyBuffer(Dispatch.device, Buffer, nullptr);
+		Buffer = VK_NULL_HANDLE;
+	}
+	if (Memory != VK_NULL_HANDLE) {
+		Dispatch.vkFreeMemory(Dispatch.device, Memory, nullptr);
+		Memory = VK_NULL_HANDLE;
+	}
+}
+
+bool ReadbackRing::TryAcquire(VkDeviceSize size, ReadbackTicket& ticket) {
+	std::lock_guard<std::mutex> lock(Mutex);
+	return AcquireLocked(size, ticket);
+}
+
+bool ReadbackRing::Acquire(VkDeviceSize size, ReadbackTicket& ticket) {
+	std::unique_lock<std::mutex> lock(Mutex);
+	for (;;) {
+		if (AcquireLocked(size, ticket)) {
+			return true;
+		}
+		// Nothing committed would ever free a slot
+		if ((Busy == 0) || (size > SlotSize)) {
+			return false;
+		}
+		SlotReleased.wait(lock);
+	}
+}
+
+bool ReadbackRing::Commit(const ReadbackTicket& ticket, VkExtent2D extent, VkFormat format, const Consumer& consumer) {
+	if (ticket.slot >= Slots.size()) {
+		return false;
+	}
+
+	Slot& slot = Slots[ticket.slot];
+	slot.data.data = MappedData + ticket.offset;
+	slot.data.size = ticket.size;
+	slot.data.extent = extent;
+	slot.data.format = format;
+	slot.consumer = consumer;
+
+	// Fence signal operations cover everything submitted to the queue before, so an empty submission is enough
+	if ((Timeline == VK_NULL_HANDLE) && (Dispatch.vkQueueSubmit(Device.graphicsQueue, 0, nullptr, slot.fence) != VK_SUCCESS)) {
+		std::cout << "COULD NOT SUBMIT READBACK FENCE " << std::endl;
+		Cancel(ticket);
+		return false;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		slot.state = SlotState::InFlight;
+		++Busy;
+		InFlight.push_back(ticket.slot);
+	}
+	SlotCommitted.notify_one();
+	return true;
+}
+
+void ReadbackRing::Cancel(const ReadbackTicket& ticket) {
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		if ((ticket.slot >= Slots.size()) || (Slots[ticket.slot].state != SlotState::Acquired)) {
+			return;
+		}
+		Slots[ticket.slot].state = SlotState::Free;
+		Slots[ticket.slot].consumer = Consumer();
+	}
+	SlotReleased.notify_all();
+}
+
+void ReadbackRing::Drain() {
+	std::unique_lock<std::mutex> lock(Mutex);
+	SlotReleased.wait(lock, [this]() { return Busy == 0; });
+}
+
+bool ReadbackRing::UsesTimelineSemaphore() const {
+	return Timeline != VK_NULL_HANDLE;
+}
+
+bool ReadbackRing::IsHostCached() const {
+	return HostCached;
+}
+
+bool ReadbackRing::HasFailed() const {
+	return Failed;
+}
+
+bool ReadbackRing::AcquireLocked(VkDeviceSize size, ReadbackTicket& ticket) {
+	if (size > SlotSize) {
+		return false;
+	}
+	for (size_t i = 0; i < Slots.size(); ++i) {
+		const uint32_t index = static_cast<uint32_t>((NextSlot + i) % Slots.size());
+		if (Slots[index].state != SlotState::Free) {
+			continue;
+		}
+
+		Slot& slot = Slots[index];
+		slot.state = SlotState::Acquired;
+		slot.value = (Timeline != VK_NULL_HANDLE) ? NextValue++ : 0;
+		NextSlot = static_cast<uint32_t>((index + 1) % Slots.size());
+
+		ticket.slot = index;
+		ticket.buffer = Buffer;
+		ticket.offset = index * SlotStride;
+		ticket.size = size;
+		ticket.semaphore = Timeline;
+		ticket.value = slot.value;
+		return true;
+	}
+	return false;
+}
+
+void ReadbackRing::Release(uint32_t slot) {
+	{
+		std::lock_guard<std::mutex> lock(Mutex);
+		Slots[slot].state = SlotState::Free;
+		Slots[slot].consumer = Consumer();
+		--Busy;
+	}
+	SlotReleased.notify_all();
+}
+
+void ReadbackRing::CompleteSubmissions() {
+	for (;;) {
+		uint32_t index = 0;
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			SlotCommitted.wait(lock, [this]() { return Stopping || !InFlight.empty(); });
+			if (InFlight.empty()) {
+				return;
+			}
+			index = InFlight.front();
+		}
+
+		// The queue finishes work in order, so waiting for the oldest readback first never waits too long
+		Slot& slot = Slots[index];
+		bool finished = false;
+		if (Timeline != VK_NULL_HANDLE) {
+			VkSemaphoreWaitInfoKHR waitInfo = {};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+			waitInfo.pNext = nullptr;
+			waitInfo.flags = 0;
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &Timeline;
+			waitInfo.pValues = &slot.value;
+			finished = Dispatch.vkWaitSemaphoresKHR(Dispatch.device, &waitInfo, UINT64_MAX) == VK_SUCCESS;
+		}
+		else {
+			finished = (Dispatch.vkWaitForFences(Dispatch.device, 1, &slot.fence, VK_TRUE, UINT64_MAX) == VK_SUCCESS)
+				&& (Dispatch.vkResetFences(Dispatch.device, 1, &slot.fence) == VK_SUCCESS);
+		}
+
+		if (finished && !Coherent) {
+			VkMappedMemoryRange range = {};
+			range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+			range.pNext = nullptr;
+			range.memory = Memory;
+			range.offset = index * SlotStride;
+			range.size = SlotStride;
+			finished = Dispatch.vkInvalidateMappedMemoryRanges(Dispatch.device, 1, &range) == VK_SUCCESS;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(Mutex);
+			InFlight.pop_front();
+			if (finished) {
+				slot.state = SlotState::Consuming;
+				Ready.push_back(index);
+			}
+		}
+		if (finished) {
+			SlotReady.notify_one();
+		}
+		else {
+			std::cout << "READBACK DID NOT FINISH ON THE GPU " << std::endl;
+			Failed = true;
+			// Consumers still hear about it, so whoever waits for readbacks in order can move past this one
+			if (slot.consumer) {
+				ReadbackData failed = slot.data;
+				failed.data = nullptr;
+				failed.size = 0;
+				slot.consumer(failed);
+			}
+			Release(index);
+		}
+	}
+}
+
+void ReadbackRing::ConsumeReadbacks() {
+	for (;;) {
+		uint32_t index = 0;
+		{
+			std::unique_lock<std::mutex> lock(Mutex);
+			SlotReady.wait(lock, [this]() { return Stopping || !Ready.empty(); });
+			if (Ready.empty()) {
+				return;
+			}
+			index = Ready.front();
+			Ready.pop_front();
+		}
+
+		const Slot& slot = Slots[index];
+		if (slot.consumer) {
+			slot.consumer(slot.data);
+		}
+		Release(index);
+	}
+}
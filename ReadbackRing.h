@@ -0,0 +1,128 @@
+#pragma once
+
+#include "VulkanDispatch.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Where one readback goes, from Acquire() until the ring hands the data to its consumer.
+// The copy (vkCmdCopyImageToBuffer into buffer at offset) must be in a submission that also signals
+// semaphore with value when semaphore isn't VK_NULL_HANDLE.
+struct ReadbackTicket {
+	uint32_t slot;
+	VkBuffer buffer;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	VkSemaphore semaphore;		// Timeline semaphore, VK_NULL_HANDLE when the ring tracks slots with fences
+	uint64_t value;
+
+	ReadbackTicket() :
+		slot(UINT32_MAX),
+		buffer(VK_NULL_HANDLE),
+		offset(0),
+		size(0),
+		semaphore(VK_NULL_HANDLE),
+		value(0) {
+	}
+};
+
+// A finished readback. data points straight into the mapped ring and is valid only during the consumer call;
+// it is null when the readback failed on the GPU.
+struct ReadbackData {
+	const uint8_t* data;
+	VkDeviceSize size;
+	VkExtent2D extent;
+	VkFormat format;
+};
+
+// Ring of readback slots in one persistently mapped buffer, preferably host cached so the CPU reads it at
+// full speed. The submit thread only acquires slots and commits them after its submission; a completion
+// thread waits for the GPU (timeline value or fence) and worker threads run the consumers on the mapped
+// memory without copying. A slot is reused once its consumer returns.
+class ReadbackRing {
+public:
+	typedef std::function<void(const ReadbackData& data)> Consumer;
+
+	explicit ReadbackRing(const DeviceContext& device);
+	~ReadbackRing();
+
+	ReadbackRing(const ReadbackRing&) = delete;
+	ReadbackRing& operator=(const ReadbackRing&) = delete;
+
+	bool Create(uint32_t slotCount, VkDeviceSize slotSize, uint32_t workerCount);
+	void Destroy();
+
+	// Never blocks - false when every slot is still in flight or being consumed, the caller decides whether
+	// to skip the readback. Tickets must be committed in the order they were acquired.
+	bool TryAcquire(VkDeviceSize size, ReadbackTicket& ticket);
+	// Waits for a consumer to free a slot, for offline work where throttling on the consumers is wanted
+	bool Acquire(VkDeviceSize size, ReadbackTicket& ticket);
+
+	// Call right after the submission containing the copy, on the thread that owns the queue - without
+	// timeline semaphores an empty submission follows it to signal the slot's fence.
+	bool Commit(const ReadbackTicket& ticket, VkExtent2D extent, VkFormat format, const Consumer& consumer);
+	// Returns an acquired slot whose copy was never submitted
+	void Cancel(const ReadbackTicket& ticket);
+
+	// Blocks until all committed readbacks were consumed
+	void Drain();
+
+	bool UsesTimelineSemaphore() const;
+	bool IsHostCached() const;
+	// A GPU wait failed (device lost), the affected slots' consumers were called without data
+	bool HasFailed() const;
+
+private:
+	enum class SlotState {
+		Free,
+		Acquired,
+		InFlight,
+		Consuming
+	};
+
+	struct Slot {
+		SlotState state;
+		VkFence fence;
+		uint64_t value;
+		ReadbackData data;
+		Consumer consumer;
+	};
+
+	bool AcquireLocked(VkDeviceSize size, ReadbackTicket& ticket);
+	void Release(uint32_t slot);
+	void CompleteSubmissions();
+	void ConsumeReadbacks();
+
+	DeviceContext Device;
+	const DeviceDispatchTable& Dispatch;
+
+	VkBuffer Buffer;
+	VkDeviceMemory Memory;
+	uint8_t* MappedData;
+	VkDeviceSize SlotSize;
+	VkDeviceSize SlotStride;
+	bool Coherent;
+	bool HostCached;
+	VkSemaphore Timeline;
+	uint64_t NextValue;
+
+	std::vector<Slot> Slots;
+	uint32_t NextSlot;
+	std::deque<uint32_t> InFlight;		// Committed, in submission order
+	std::deque<uint32_t> Ready;			// Finished on the GPU, waiting for a worker
+	size_t Busy;						// Slots in flight or being consumed
+
+	std::mutex Mutex;
+	std::condition_variable SlotCommitted;
+	std::condition_variable SlotReady;
+	std::condition_variable SlotReleased;
+	std::thread CompletionThread;
+	std::vector<std::thread> Workers;
+	bool Stopping;
+	std::atomic<bool> Failed;
+};
@@ -82,8 +82,8 @@ bool Renderer::CreateFrameBuffers() {
 		frameBufferCreateInfo.renderPass = handle.renderPass;
 		frameBufferCreateInfo.attachmentCount = 1;
 		frameBufferCreateInfo.pAttachments = &swapchainImages[i].view;
-		frameBufferCreateInfo.width = 300;
-		frameBufferCreateInfo.height = 300;
+		frameBufferCreateInfo.width = GetSwapChain().extent.width;
+		frameBufferCreateInfo.height = GetSwapChain().extent.height;
 		frameBufferCreateInfo.layers = 1;
 
 		if (vkCreateFramebuffer(GetDevice(), &frameBufferCreateInfo, nullptr, &handle.frameBuffers[i]) != VK_SUCCESS) {
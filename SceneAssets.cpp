@@ -0,0 +1,106 @@
+#include "SceneAssets.h"
+#include <algorithm>
+#include <cmath>
+
+void BuildRockMesh(uint32_t rings, uint32_t segments, std::vector<float>& positions, std::vector<uint32_t>& indices) {
+	const float pi = 3.14159265f;
+	positions = { 0.0f, 1.0f, 0.0f };
+	for (uint32_t ring = 1; ring < rings; ++ring) {
+		for (uint32_t segment = 0; segment < segments; ++segment) {
+			const float theta = pi * static_cast<float>(ring) / static_cast<float>(rings);
+			const float phi = 2.0f * pi * static_cast<float>(segment) / static_cast<float>(segments);
+			const float radius = 1.0f + 0.08f * std::sin(5.0f * theta) * std::cos(3.0f * phi) + 0.03f * std::sin(17.0f * theta + 11.0f * phi);
+			positions.push_back(radius * std::sin(theta) * std::cos(phi));
+			positions.push_back(radius * std::cos(theta));
+			positions.push_back(radius * std::sin(theta) * std::sin(phi));
+		}
+	}
+	positions.insert(positions.end(), { 0.0f, -1.0f, 0.0f });
+
+	const uint32_t south = 1 + (rings - 1) * segments;
+	auto vertex = [segments](uint32_t ring, uint32_t segment) {
+		return 1 + (ring - 1) * segments + segment % segments;
+	};
+	indices.clear();
+	for (uint32_t segment = 0; segment < segments; ++segment) {
+		indices.insert(indices.end(), { 0, vertex(1, segment + 1), vertex(1, segment) });
+		indices.insert(indices.end(), { south, vertex(rings - 1, segment), vertex(rings - 1, segment + 1) });
+	}
+	for (uint32_t ring = 1; ring + 1 < rings; ++ring) {
+		for (uint32_t segment = 0; segment < segments; ++segment) {
+			indices.insert(indices.end(), { vertex(ring, segment), vertex(ring, segment + 1), vertex(ring + 1, segment) });
+			indices.insert(indices.end(), { vertex(ring, segment + 1), vertex(ring + 1, segment + 1), vertex(ring + 1, segment) });
+		}
+	}
+}
+
+void BuildTentacle(uint32_t jointCount, float segmentLength, SkinnedMesh& mesh, Skeleton& skeleton) {
+	const float pi = 3.14159265f;
+	const uint32_t ringsPerJoint = 4;
+	const uint32_t rings = jointCount * ringsPerJoint + 1;
+	const uint32_t segments = 12;
+
+	skeleton.parents.clear();
+	skeleton.inverseBind.clear();
+	for (uint32_t joint = 0; joint < jointCount; ++joint) {
+		skeleton.parents.push_back(static_cast<int32_t>(joint) - 1);
+		const float inverseBind[12] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, -segmentLength * joint, 0.0f, 0.0f, 1.0f, 0.0f };
+		skeleton.inverseBind.insert(skeleton.inverseBind.end(), inverseBind, inverseBind + 12);
+	}
+
+	mesh.positions.clear();
+	mesh.joints.clear();
+	mesh.weights.clear();
+	auto addVertex = [&](float x, float y, float z) {
+		const float along = y / segmentLength;
+		const uint32_t lower = std::min(static_cast<uint32_t>(along), jointCount - 1);
+		const uint32_t upper = std::min(lower + 1, jointCount - 1);
+		const uint32_t weight = static_cast<uint32_t>(std::lround(255.0f * (1.0f - std::min(along - static_cast<float>(lower), 1.0f))));
+		mesh.positions.insert(mesh.positions.end(), { x, y, z });
+		mesh.joints.push_back(lower | (upper << 8));
+		mesh.weights.push_back(weight | ((255 - weight) << 8));
+	};
+	for (uint32_t ring = 0; ring < rings; ++ring) {
+		const float y = segmentLength * static_cast<float>(ring) / static_cast<float>(ringsPerJoint);
+		const float radius = 0.15f * (1.0f - 0.6f * static_cast<float>(ring) / static_cast<float>(rings));
+		for (uint32_t segment = 0; segment < segments; ++segment) {
+			const float phi = 2.0f * pi * static_cast<float>(segment) / static_cast<float>(segments);
+			addVertex(radius * std::cos(phi), y, radius * std::sin(phi));
+		}
+	}
+	const uint32_t bottom = rings * segments;
+	addVertex(0.0f, 0.0f, 0.0f);
+	addVertex(0.0f, segmentLength * static_cast<float>(rings - 1) / static_cast<float>(ringsPerJoint), 0.0f);
+
+	auto vertex = [segments](uint32_t ring, uint32_t segment) {
+		return ring * segments + segment % segments;
+	};
+	mesh.indices.clear();
+	for (uint32_t segment = 0; segment < segments; ++segment) {
+		mesh.indices.insert(mesh.indices.end(), { bottom, vertex(0, segment), vertex(0, segment + 1) });
+		mesh.indices.insert(mesh.indices.end(), { bottom + 1, vertex(rings - 1, segment + 1), vertex(rings - 1, segment) });
+	}
+	for (uint32_t ring = 0; ring + 1 < rings; ++ring) {
+		for (uint32_t segment = 0; segment < segments; ++segment) {
+			mesh.indices.insert(mesh.indices.end(), { vertex(ring + 1, segment), vertex(ring + 1, segment + 1), vertex(ring, segment) });
+			mesh.indices.insert(mesh.indices.end(), { vertex(ring + 1, segment + 1), vertex(ring, segment + 1), vertex(ring, segment) });
+		}
+	}
+}
+
+bool BuildWaveClip(uint32_t jointCount, float segmentLength, uint32_t axis, float amplitude, AnimationClip& clip) {
+	const float pi = 3.14159265f;
+	const uint32_t frameCount = 60;
+	std::vector<float> rotations;
+	std::vector<float> translations;
+	for (uint32_t frame = 0; frame < frameCount; ++frame) {
+		const float phase = 2.0f * pi * static_cast<float>(frame) / static_cast<float>(frameCount);
+		for (uint32_t joint = 0; joint < jointCount; ++joint) {
+			const float half = 0.5f * ((joint == 0) ? 0.0f : amplitude * std::sin(phase - 0.4f * static_cast<float>(joint)));
+			rotations.insert(rotations.end(), { (axis == 0) ? std::sin(half) : 0.0f, 0.0f, (axis == 0) ? 0.0f : std::sin(half), std::cos(half) });
+			const float y = (joint == 0) ? 0.05f * std::fabs(std::sin(phase)) : segmentLength;
+			translations.insert(translations.end(), { 0.0f, y, 0.0f });
+		}
+	}
+	return CompressClip(rotations, translations, jointCount, frameCount, 2.0f, clip);
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "SkeletalAnimation.h"
+#include <cstdint>
+#include <vector>
+
+// Procedural assets shared by the benchmark and golden image scenes. Built from fixed formulas, so every run gets
+// exactly the same data.
+
+// Bumpy unit sphere of latitude rings around the y axis, wound counter-clockwise seen from outside
+void BuildRockMesh(uint32_t rings, uint32_t segments, std::vector<float>& positions, std::vector<uint32_t>& indices);
+
+// Closed tube standing on the origin around a chain of joints going up the y axis, segmentLength apart. Every vertex
+// is weighted between the two joints it lies between.
+void BuildTentacle(uint32_t jointCount, float segmentLength, SkinnedMesh& mesh, Skeleton& skeleton);
+
+// Looping clip of a joint chain built by BuildTentacle(), every joint bending around axis (x or z) in a wave
+// travelling up the chain while the root bobs up and down
+bool BuildWaveClip(uint32_t jointCount, float segmentLength, uint32_t axis, float amplitude, AnimationClip& clip);
@@ -0,0 +1,96 @@
+#include "SceneCamera.h"
+#include <cmath>
+
+void GetCameraAxes(const SceneCamera& camera, float forward[3], float right[3], float up[3]) {
+	const float cosPitch = std::cos(camera.pitch);
+	forward[0] = std::sin(camera.yaw) * cosPitch;
+	forward[1] = std::sin(camera.pitch);
+	forward[2] = -std::cos(camera.yaw) * cosPitch;
+
+	// forward x (0, 1, 0), normalized
+	const float rightLength = std::sqrt(forward[0] * forward[0] + forward[2] * forward[2]);
+	right[0] = -forward[2] / rightLength;
+	right[1] = 0.0f;
+	right[2] = forward[0] / rightLength;
+
+	// right x forward
+	up[0] = right[1] * forward[2] - right[2] * forward[1];
+	up[1] = right[2] * forward[0] - right[0] * forward[2];
+	up[2] = right[0] * forward[1] - right[1] * forward[0];
+}
+
+void GetCameraViewProjection(const SceneCamera& camera, float aspect, float viewProjection[16]) {
+	float forward[3];
+	float right[3];
+	float up[3];
+	GetCameraAxes(camera, forward, right, up);
+	const float* position = camera.position;
+
+	float view[16] = {};
+	for (int i = 0; i < 3; ++i) {
+		view[i * 4 + 0] = right[i];
+		view[i * 4 + 1] = up[i];
+		view[i * 4 + 2] = -forward[i];
+	}
+	view[12] = -(right[0] * position[0] + right[1] * position[1] + right[2] * position[2]);
+	view[13] = -(up[0] * position[0] + up[1] * position[1] + up[2] * position[2]);
+	view[14] = forward[0] * position[0] + forward[1] * position[1] + forward[2] * position[2];
+	view[15] = 1.0f;
+
+	const float tanY = std::tan(0.5f * camera.verticalFov);
+	const float nearPlane = camera.nearPlane;
+	const float farPlane = camera.farPlane;
+	float projection[16] = {};
+	projection[0] = 1.0f / (tanY * aspect);
+	projection[5] = -1.0f / tanY;
+	projection[10] = nearPlane / (farPlane - nearPlane);
+	projection[11] = -1.0f;
+	projection[14] = nearPlane * farPlane / (farPlane - nearPlane);
+	// Clip w is minus the view z, so after the perspective divide this moves the whole image by +jitter in NDC
+	projection[8] = -camera.jitter[0];
+	projection[9] = -camera.jitter[1];
+	MultiplyMatrices(projection, view, viewProjection);
+}
+
+void MultiplyMatrices(const float a[16], const float b[16], float result[16]) {
+	for (int column = 0; column < 4; ++column) {
+		for (int row = 0; row < 4; ++row) {
+			float sum = 0.0f;
+			for (int k = 0; k < 4; ++k) {
+				sum += a[k * 4 + row] * b[column * 4 + k];
+			}
+			result[column * 4 + row] = sum;
+		}
+	}
+}
+
+bool InvertMatrix(const float matrix[16], float result[16]) {
+	// Adjugate over the determinant, by cofactor expansion
+	const float* m = matrix;
+	float inverse[16];
+	inverse[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+	inverse[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+	inverse[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+	inverse[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+	inverse[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+	inverse[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+	inverse[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+	inverse[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+	inverse[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+	inverse[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+	inverse[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+	inverse[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+	inverse[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+	inverse[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+	inverse[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+	inverse[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+	const float determinant = m[0] * inverse[0] + m[1] * inverse[4] + m[2] * inverse[8] + m[3] * inverse[12];
+	if (std::fabs(determinant) < 1e-20f) {
+		return false;
+	}
+	for (int i = 0; i < 16; ++i) {
+		result[i] = inverse[i] / determinant;
+	}
+	return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+// Perspective camera in world space (y up). Yaw 0 and pitch 0 look down -z.
+struct SceneCamera {
+	float position[3];
+	float yaw;					// Radians, around y
+	float pitch;				// Radians, up is positive; must stay short of straight up or down
+	float verticalFov;			// Radians
+	float nearPlane;
+	float farPlane;
+	float jitter[2];				// Sub-pixel offset of the projection in NDC, for temporal anti-aliasing
+
+	SceneCamera() :
+		position(),
+		yaw(0.0f),
+		pitch(0.0f),
+		verticalFov(1.0f),
+		nearPlane(0.1f),
+		farPlane(200.0f),
+		jitter() {
+	}
+};
+
+// Unit vectors of the camera's view direction, right and up
+void GetCameraAxes(const SceneCamera& camera, float forward[3], float right[3], float up[3]);
+// Column major world to clip space matrix, with Vulkan's y down and reversed depth (near plane at 1, far plane at 0)
+void GetCameraViewProjection(const SceneCamera& camera, float aspect, float viewProjection[16]);
+// Column major, result = a * b
+void MultiplyMatrices(const float a[16], const float b[16], float result[16]);
+// False for singular matrices
+bool InvertMatrix(const float matrix[16], float result[16]);
@@ -0,0 +1,288 @@
+#include "SceneGraph.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define SCENE_GRAPH_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+	// Fewer transforms to recompute aren't worth a thread of their own
+	const uint32_t MinThreadNodes = 4096;
+
+	// 3x4 row major transforms with an implied last row of 0, 0, 0, 1
+	void MultiplyTransforms(const float* a, const float* b, float* result) {
+#if defined(SCENE_GRAPH_SSE2)
+		const __m128 b0 = _mm_loadu_ps(b);
+		const __m128 b1 = _mm_loadu_ps(b + 4);
+		const __m128 b2 = _mm_loadu_ps(b + 8);
+		const __m128 b3 = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+		for (uint32_t r = 0; r < 3; ++r) {
+			const float* row = &a[4 * r];
+			const __m128 xy = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(row[0]), b0), _mm_mul_ps(_mm_set1_ps(row[1]), b1));
+			const __m128 zw = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(row[2]), b2), _mm_mul_ps(_mm_set1_ps(row[3]), b3));
+			_mm_storeu_ps(&result[4 * r], _mm_add_ps(xy, zw));
+		}
+#else
+		for (uint32_t r = 0; r < 3; ++r) {
+			const float* row = &a[4 * r];
+			for (uint32_t c = 0; c < 4; ++c) {
+				result[4 * r + c] = row[0] * b[c] + row[1] * b[4 + c] + row[2] * b[8 + c] + ((c == 3) ? row[3] : 0.0f);
+			}
+		}
+#endif
+	}
+}
+
+SceneGraph::SceneGraph(uint32_t threadCount) :
+	ThreadCount((threadCount > 0) ? threadCount : std::max<uint32_t>(std::thread::hardware_concurrency(), 1)),
+	Unsorted(false),
+	NodeParents(),
+	NodeDepths(),
+	NodeMeshes(),
+	Slots(),
+	PendingLocals(),
+	Handles(),
+	ParentSlots(),
+	Locals(),
+	Worlds(),
+	Dirty(),
+	LevelOffsets(1, 0),
+	LevelChanges(),
+	RenderSlots(),
+	RenderList(),
+	UpdatedCount(0) {
+}
+
+uint32_t SceneGraph::AddNode(uint32_t parent, const float* local, uint32_t mesh) {
+	const uint32_t node = static_cast<uint32_t>(NodeParents.size());
+	if ((parent != UINT32_MAX) && (parent >= node)) {
+		std::cout << "SCENE NODE " << parent << " DOES NOT EXIST " << std::endl;
+		return UINT32_MAX;
+	}
+	NodeParents.push_back(parent);
+	NodeDepths.push_back((parent == UINT32_MAX) ? 0 : NodeDepths[parent] + 1);
+	NodeMeshes.push_back(mesh);
+	PendingLocals.insert(PendingLocals.end(), local, local + 12);
+	Unsorted = true;
+	return node;
+}
+
+void SceneGraph::Clear() {
+	NodeParents.clear();
+	NodeDepths.clear();
+	NodeMeshes.clear();
+	Slots.clear();
+	PendingLocals.clear();
+	Handles.clear();
+	ParentSlots.clear();
+	Locals.clear();
+	Worlds.clear();
+	Dirty.clear();
+	LevelOffsets.assign(1, 0);
+	LevelChanges.clear();
+	RenderSlots.clear();
+	RenderList.clear();
+	UpdatedCount = 0;
+	Unsorted = false;
+}
+
+bool SceneGraph::SetLocalTransform(uint32_t node, const float* local) {
+	if (node >= NodeParents.size()) {
+		std::cout << "SCENE NODE " << node << " DOES NOT EXIST " << std::endl;
+		return false;
+	}
+	if (node >= Handles.size()) {
+		memcpy(&PendingLocals[12 * (node - Handles.size())], local, 12 * sizeof(float));
+		return true;
+	}
+	const uint32_t slot = Slots[node];
+	memcpy(&Locals[12 * slot], local, 12 * sizeof(float));
+	if (!Dirty[slot]) {
+		Dirty[slot] = 1;
+		LevelChanges[NodeDepths[node]]++;
+	}
+	return true;
+}
+
+void SceneGraph::Update() {
+	if (Unsorted) {
+		Sort();
+	}
+
+	// Dirty flags of a level are read by the next one, so they are only cleared once every level is done
+	const uint32_t depthCount = GetDepthCount();
+	std::vector<uint8_t> levelUpdated(depthCount, 0);
+	uint32_t parentUpdated = 0;
+	UpdatedCount = 0;
+	for (uint32_t level = 0; level < depthCount; ++level) {
+		if ((LevelChanges[level] == 0) && (parentUpdated == 0)) {
+			continue;
+		}
+		// Transforms set on this level plus the average number of children of every parent updated above
+		const uint64_t count = LevelOffsets[level + 1] - LevelOffsets[level];
+		const uint64_t parentCount = (level > 0) ? LevelOffsets[level] - LevelOffsets[level - 1] : 1;
+		const uint64_t expected = std::min<uint64_t>(count, LevelChanges[level] + parentUpdated * count / parentCount);
+		const uint32_t threadCount = std::min<uint32_t>(ThreadCount, static_cast<uint32_t>(expected / MinThreadNodes));
+
+		parentUpdated = 0;
+		if (threadCount <= 1) {
+			parentUpdated = PropagateRange(LevelOffsets[level], LevelOffsets[level + 1]);
+		}
+		else {
+			// Every thread writes its own nodes, and only reads parents of the finished level above
+			const uint32_t perThread = static_cast<uint32_t>((count + threadCount - 1) / threadCount);
+			std::vector<uint32_t> counts(threadCount, 0);
+			std::vector<std::thread> threads;
+			for (uint32_t i = 0; i < threadCount; ++i) {
+				const uint32_t first = LevelOffsets[level] + i * perThread;
+				const uint32_t end = std::min(first + perThread, LevelOffsets[level + 1]);
+				threads.emplace_back([this, i, first, end, &counts]() {
+					counts[i] = (first < end) ? PropagateRange(first, end) : 0;
+				});
+			}
+			for (std::thread& thread : threads) {
+				thread.join();
+			}
+			for (uint32_t updated : counts) {
+				parentUpdated += updated;
+			}
+		}
+		levelUpdated[level] = 1;
+		UpdatedCount += parentUpdated;
+	}
+	if (UpdatedCount == 0) {
+		return;
+	}
+
+	for (size_t i = 0; i < RenderList.size(); ++i) {
+		const uint32_t slot = RenderSlots[i];
+		if (Dirty[slot]) {
+			memcpy(RenderList[i].world, &Worlds[12 * slot], sizeof(RenderList[i].world));
+		}
+	}
+	for (uint32_t level = 0; level < depthCount; ++level) {
+		if (levelUpdated[level]) {
+			memset(&Dirty[LevelOffsets[level]], 0, LevelOffsets[level + 1] - LevelOffsets[level]);
+		}
+	}
+	std::fill(LevelChanges.begin(), LevelChanges.end(), 0);
+}
+
+const float* SceneGraph::GetWorldTransform(uint32_t node) const {
+	return (node < Handles.size()) ? &Worlds[12 * Slots[node]] : nullptr;
+}
+
+const std::vector<SceneRenderItem>& SceneGraph::GetRenderList() const {
+	return RenderList;
+}
+
+uint32_t SceneGraph::GetNodeCount() const {
+	return static_cast<uint32_t>(NodeParents.size());
+}
+
+uint32_t SceneGraph::GetDepthCount() const {
+	return static_cast<uint32_t>(LevelOffsets.size() - 1);
+}
+
+uint32_t SceneGraph::GetUpdatedCount() const {
+	return UpdatedCount;
+}
+
+void SceneGraph::Sort() {
+	const uint32_t count = static_cast<uint32_t>(NodeParents.size());
+
+	// Children of every node in the order they were added, the roots under count
+	std::vector<uint32_t> childOffsets(count + 2, 0);
+	for (uint32_t parent : NodeParents) {
+		childOffsets[((parent == UINT32_MAX) ? count : parent) + 1]++;
+	}
+	for (uint32_t i = 0; i <= count; ++i) {
+		childOffsets[i + 1] += childOffsets[i];
+	}
+	std::vector<uint32_t> children(count);
+	std::vector<uint32_t> fill(childOffsets.begin(), childOffsets.end() - 1);
+	for (uint32_t node = 0; node < count; ++node) {
+		children[fill[(NodeParents[node] == UINT32_MAX) ? count : NodeParents[node]]++] = node;
+	}
+
+	// Breadth first, which sorts by depth and keeps the children of a level in their parents' order
+	std::vector<uint32_t> order(children.begin() + childOffsets[count], children.begin() + childOffsets[count + 1]);
+	order.reserve(count);
+	for (size_t i = 0; i < order.size(); ++i) {
+		const uint32_t node = order[i];
+		order.insert(order.end(), children.begin() + childOffsets[node], children.begin() + childOffsets[node + 1]);
+	}
+
+	const uint32_t sortedCount = static_cast<uint32_t>(Handles.size());
+	std::vector<float> locals(12 * static_cast<size_t>(count));
+	for (uint32_t slot = 0; slot < count; ++slot) {
+		const uint32_t node = order[slot];
+		const float* local = (node < sortedCount) ? &Locals[12 * Slots[node]] : &PendingLocals[12 * (node - sortedCount)];
+		memcpy(&locals[12 * slot], local, 12 * sizeof(float));
+	}
+	Locals.swap(locals);
+	PendingLocals.clear();
+
+	Slots.resize(count);
+	for (uint32_t slot = 0; slot < count; ++slot) {
+		Slots[order[slot]] = slot;
+	}
+	Handles.swap(order);
+	ParentSlots.resize(count);
+	for (uint32_t slot = 0; slot < count; ++slot) {
+		const uint32_t parent = NodeParents[Handles[slot]];
+		ParentSlots[slot] = (parent == UINT32_MAX) ? UINT32_MAX : Slots[parent];
+	}
+	Worlds.assign(12 * static_cast<size_t>(count), 0.0f);
+	Dirty.assign(count, 1);
+
+	// The last node is one of the deepest
+	const uint32_t depthCount = (count > 0) ? NodeDepths[Handles[count - 1]] + 1 : 0;
+	LevelOffsets.assign(depthCount + 1, 0);
+	for (uint32_t depth : NodeDepths) {
+		LevelOffsets[depth + 1]++;
+	}
+	for (uint32_t level = 0; level < depthCount; ++level) {
+		LevelOffsets[level + 1] += LevelOffsets[level];
+	}
+	LevelChanges.assign(depthCount, 1);
+
+	RenderSlots.clear();
+	for (uint32_t slot = 0; slot < count; ++slot) {
+		if (NodeMeshes[Handles[slot]] != UINT32_MAX) {
+			RenderSlots.push_back(slot);
+		}
+	}
+	std::stable_sort(RenderSlots.begin(), RenderSlots.end(), [this](uint32_t a, uint32_t b) {
+		return NodeMeshes[Handles[a]] < NodeMeshes[Handles[b]];
+	});
+	RenderList.resize(RenderSlots.size());
+	for (size_t i = 0; i < RenderSlots.size(); ++i) {
+		RenderList[i].mesh = NodeMeshes[Handles[RenderSlots[i]]];
+		RenderList[i].node = Handles[RenderSlots[i]];
+	}
+	Unsorted = false;
+}
+
+uint32_t SceneGraph::PropagateRange(uint32_t first, uint32_t end) {
+	uint32_t updated = 0;
+	for (uint32_t slot = first; slot < end; ++slot) {
+		const uint32_t parent = ParentSlots[slot];
+		if (parent == UINT32_MAX) {
+			if (Dirty[slot]) {
+				memcpy(&Worlds[12 * slot], &Locals[12 * slot], 12 * sizeof(float));
+				++updated;
+			}
+		}
+		else if (Dirty[slot] || Dirty[parent]) {
+			Dirty[slot] = 1;
+			MultiplyTransforms(&Worlds[12 * parent], &Locals[12 * slot], &Worlds[12 * slot]);
+			++updated;
+		}
+	}
+	return updated;
+}
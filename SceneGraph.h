@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Node with a mesh, as handed to the renderer
+struct SceneRenderItem {
+	float world[12];			// 3x4 row major
+	uint32_t mesh;
+	uint32_t node;
+};
+
+// Transform hierarchy kept as flat arrays sorted by depth, children of a level in the order of their parents, so
+// propagation streams through memory one level after the other instead of chasing pointers.
+// Update() recomputes world transforms only below nodes whose local transform changed, a level at a time; levels with
+// enough dirty work are split over worker threads, since nodes of one level only read the level above. Levels without
+// changes above or in them are skipped outright. Nodes with a mesh end up in a render list grouped by mesh.
+// Transforms are 3x4 row major, like Skeleton's.
+class SceneGraph {
+public:
+	// threadCount 0 uses one per hardware thread
+	explicit SceneGraph(uint32_t threadCount = 0);
+
+	SceneGraph(const SceneGraph&) = delete;
+	SceneGraph& operator=(const SceneGraph&) = delete;
+
+	// parent UINT32_MAX adds a root, mesh UINT32_MAX a node which isn't drawn. Returns the node's handle, UINT32_MAX
+	// when the parent doesn't exist. Adding nodes re-sorts the arrays and recomputes every world transform on the next
+	// update.
+	uint32_t AddNode(uint32_t parent, const float* local, uint32_t mesh = UINT32_MAX);
+	void Clear();
+
+	bool SetLocalTransform(uint32_t node, const float* local);
+	void Update();
+
+	// As of the last Update()
+	const float* GetWorldTransform(uint32_t node) const;
+	const std::vector<SceneRenderItem>& GetRenderList() const;
+	uint32_t GetNodeCount() const;
+	uint32_t GetDepthCount() const;
+	// World transforms recomputed by the last update
+	uint32_t GetUpdatedCount() const;
+
+private:
+	void Sort();
+	uint32_t PropagateRange(uint32_t first, uint32_t end);
+
+	uint32_t ThreadCount;
+	bool Unsorted;
+
+	// By handle
+	std::vector<uint32_t> NodeParents;
+	std::vector<uint32_t> NodeDepths;
+	std::vector<uint32_t> NodeMeshes;
+	std::vector<uint32_t> Slots;				// In the sorted arrays
+	std::vector<float> PendingLocals;			// Of nodes added since the last sort, from the first one on
+
+	// Sorted by depth
+	std::vector<uint32_t> Handles;
+	std::vector<uint32_t> ParentSlots;			// UINT32_MAX for roots
+	std::vector<float> Locals;
+	std::vector<float> Worlds;
+	std::vector<uint8_t> Dirty;					// Local transform changed, or any parent's world transform did
+	std::vector<uint32_t> LevelOffsets;			// Depth count plus one
+	std::vector<uint32_t> LevelChanges;			// Local transforms set per level since the last update
+
+	std::vector<uint32_t> RenderSlots;
+	std::vector<SceneRenderItem> RenderList;
+	uint32_t UpdatedCount;
+};
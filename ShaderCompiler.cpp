@@ -0,0 +1,82 @@
+#include "ShaderCompiler.h"
+#include "shaderc/shaderc.h"
+#include <cstring>
+#include <iostream>
+
+ShaderCompiler::ShaderCompiler() :
+	Compiler(nullptr) {
+}
+
+ShaderCompiler::~ShaderCompiler() {
+	if (Compiler != nullptr) {
+		shaderc_compiler_release(static_cast<shaderc_compiler_t>(Compiler));
+	}
+}
+
+bool ShaderCompiler::Compile(const char* source, VkShaderStageFlagBits stage, const char* name, std::vector<uint32_t>& spirv) {
+	shaderc_shader_kind kind;
+	switch (stage) {
+	case VK_SHADER_STAGE_VERTEX_BIT:
+		kind = shaderc_vertex_shader;
+		break;
+	case VK_SHADER_STAGE_FRAGMENT_BIT:
+		kind = shaderc_fragment_shader;
+		break;
+	case VK_SHADER_STAGE_COMPUTE_BIT:
+		kind = shaderc_compute_shader;
+		break;
+	case VK_SHADER_STAGE_GEOMETRY_BIT:
+		kind = shaderc_geometry_shader;
+		break;
+	default:
+		std::cout << "UNSUPPORTED SHADER STAGE OF " << name << std::endl;
+		return false;
+	}
+
+	if (Compiler == nullptr) {
+		Compiler = shaderc_compiler_initialize();
+		if (Compiler == nullptr) {
+			std::cout << "COULD NOT INITIALIZE SHADER COMPILER " << std::endl;
+			return false;
+		}
+	}
+
+	shaderc_compile_options_t options = shaderc_compile_options_initialize();
+	shaderc_compile_options_set_target_env(options, shaderc_target_env_vulkan, 0);
+	shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_performance);
+
+	shaderc_compilation_result_t result = shaderc_compile_into_spv(static_cast<shaderc_compiler_t>(Compiler), source, strlen(source), kind, name, "main", options);
+	shaderc_compile_options_release(options);
+
+	if (shaderc_result_get_compilation_status(result) != shaderc_compilation_status_success) {
+		std::cout << "COULD NOT COMPILE SHADER " << name << std::endl << shaderc_result_get_error_message(result) << std::endl;
+		shaderc_result_release(result);
+		return false;
+	}
+
+	size_t length = shaderc_result_get_length(result);
+	spirv.resize(length / sizeof(uint32_t));
+	memcpy(spirv.data(), shaderc_result_get_bytes(result), length);
+	shaderc_result_release(result);
+	return true;
+}
+
+bool ShaderCompiler::CreateShaderModule(const DeviceDispatchTable& device, const char* source, VkShaderStageFlagBits stage, const char* name, VkShaderModule& shaderModule) {
+	std::vector<uint32_t> spirv;
+	if (!Compile(source, stage, name, spirv)) {
+		return false;
+	}
+
+	VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
+	shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	shaderModuleCreateInfo.pNext = nullptr;
+	shaderModuleCreateInfo.flags = 0;
+	shaderModuleCreateInfo.codeSize = spirv.size() * sizeof(uint32_t);
+	shaderModuleCreateInfo.pCode = spirv.data();
+
+	if (device.vkCreateShaderModule(device.device, &shaderModuleCreateInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE SHADER MODULE " << name << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#define VK_NO_PROTOTYPES
+
+#if defined _WIN32
+#define VK_USE_PLATFORM_WIN32_KHR
+#elif defined __linux__
+#define VK_USE_PLATFORM_XCB_KHR
+#endif
+
+#include "vulkan.h"
+#include "VulkanDispatch.h"
+#include <cstdint>
+#include <vector>
+
+// Compiles GLSL sources embedded in the program to SPIR-V with shaderc,
+// so no offline compilation step is needed for built-in shaders.
+class ShaderCompiler {
+public:
+	ShaderCompiler();
+	~ShaderCompiler();
+
+	ShaderCompiler(const ShaderCompiler&) = delete;
+	ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+
+	// Name is only used in error messages
+	bool Compile(const char* source, VkShaderStageFlagBits stage, const char* name, std::vector<uint32_t>& spirv);
+	bool CreateShaderModule(const DeviceDispatchTable& device, const char* source, VkShaderStageFlagBits stage, const char* name, VkShaderModule& shaderModule);
+
+private:
+	void* Compiler;		// shaderc_compiler_t, created on first use
+};
@@ -0,0 +1,887 @@
+#include "ShadowCascades.h"
+#include "VulkanFunctions.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {
+	struct Vector {
+		float x;
+		float y;
+		float z;
+	};
+
+	Vector Add(const Vector& a, const Vector& b) {
+		return { a.x + b.x, a.y + b.y, a.z + b.z };
+	}
+
+	Vector Scale(const Vector& a, float s) {
+		return { a.x * s, a.y * s, a.z * s };
+	}
+
+	float Dot(const Vector& a, const Vector& b) {
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	Vector Cross(const Vector& a, const Vector& b) {
+		return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x };
+	}
+
+	Vector Normalize(const Vector& a) {
+		const float length = std::sqrt(Dot(a, a));
+		return (length > 0.0f) ? Scale(a, 1.0f / length) : Vector{ 0.0f, -1.0f, 0.0f };
+	}
+
+	const VkFormat AtlasFormats[2] = { VK_FORMAT_D32_SFLOAT, VK_FORMAT_D16_UNORM };
+
+	// Bounding sphere radius of a cube relative to its half size
+	const float CubeSphereScale = 1.7320508f;
+
+	// Reversed depth, so negative factors push the casters away from the light
+	const float DepthBiasConstant = -1.25f;
+	const float DepthBiasSlope = -1.75f;
+
+	const char* CasterVertexShader = R"(#version 450
+
+layout(set = 0, binding = 0) readonly buffer Casters {
+	vec4 casters[];		// Position and half size
+};
+
+layout(push_constant) uniform Cascade {
+	mat4 shadowMatrix;
+};
+
+// Two triangles per face of the unit cube, corners numbered by their x, y and z bits
+const uint Corners[36] = uint[36](
+	0u, 2u, 1u, 1u, 2u, 3u,  4u, 5u, 6u, 5u, 7u, 6u,
+	0u, 1u, 4u, 1u, 5u, 4u,  2u, 6u, 3u, 3u, 6u, 7u,
+	0u, 4u, 2u, 2u, 4u, 6u,  1u, 3u, 5u, 3u, 7u, 5u);
+
+void main() {
+	const uint corner = Corners[gl_VertexIndex];
+	const vec3 local = vec3(corner & 1u, (corner >> 1) & 1u, (corner >> 2) & 1u) * 2.0 - 1.0;
+	const vec4 caster = casters[gl_InstanceIndex];
+	gl_Position = shadowMatrix * vec4(caster.xyz + local * caster.w, 1.0);
+}
+)";
+
+	const char* MeshCasterVertexShader = R"(#version 450
+
+layout(set = 0, binding = 0) readonly buffer Vertices {
+	vec4 vertices[];	// World space
+};
+
+layout(push_constant) uniform Cascade {
+	mat4 shadowMatrix;
+	uint vertexCount;
+};
+
+void main() {
+	gl_Position = shadowMatrix * vec4(vertices[uint(gl_InstanceIndex) * vertexCount + uint(gl_VertexIndex)].xyz, 1.0);
+}
+)";
+
+	const char* ReceiverHeader = R"(#version 450
+
+layout(set = 0, binding = 0) uniform Shadows {
+	mat4 viewProjection;
+	mat4 cascades[4];
+	vec4 splits;
+	vec4 cameraPosition;
+	vec4 cameraForward;
+	vec4 lightDirection;
+};
+layout(set = 0, binding = 1) uniform sampler2DArrayShadow atlas;
+
+const float GroundSize = 150.0;
+)";
+
+	const char* ReceiverVertexShader = R"(
+layout(location = 0) out vec3 WorldPosition;
+
+const vec2 Corners[6] = vec2[6](vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0));
+
+void main() {
+	WorldPosition = vec3(Corners[gl_VertexIndex].x, 0.0, Corners[gl_VertexIndex].y) * GroundSize;
+	gl_Position = viewProjection * vec4(WorldPosition, 1.0);
+}
+)";
+
+	const char* ReceiverFragmentShader = R"(
+layout(location = 0) in vec3 WorldPosition;
+
+layout(location = 0) out vec4 Color;
+
+// Linear filtering of the comparison gives 2x2 PCF
+float Shadow(uint cascade) {
+	const vec4 position = cascades[cascade] * vec4(WorldPosition, 1.0);
+	return texture(atlas, vec4(position.xy * 0.5 + 0.5, float(cascade), position.z));
+}
+
+void main() {
+	const float depth = dot(WorldPosition - cameraPosition.xyz, cameraForward.xyz);
+	const uint cascadeCount = uint(cameraPosition.w);
+	float shadow = 1.0;
+	for (uint i = 0u; i < cascadeCount; ++i) {
+		if (depth < splits[i]) {
+			shadow = Shadow(i);
+			break;
+		}
+	}
+
+	// Checkerboard, so the shadows' movement is easy to follow
+	const vec2 cell = floor(WorldPosition.xz);
+	const vec3 albedo = mix(vec3(0.55), vec3(0.7), mod(cell.x + cell.y, 2.0));
+	const float diffuse = max(-lightDirection.y, 0.0);
+	Color = vec4(albedo * (0.25 + 0.75 * diffuse * shadow), 1.0);
+}
+)";
+}
+
+ShadowCascades::ShadowCascades(const DeviceContext& device) :
+	Device(device),
+	Dispatch(*device.dispatch),
+	CasterPipeline(device),
+	MeshCasterPipeline(device),
+	ReceiverPipeline(device),
+	Settings(),
+	StaticAtlas(),
+	Atlas(),
+	StaticLayerViews(),
+	LayerViews(),
+	StaticRenderPass(VK_NULL_HANDLE),
+	DynamicRenderPass(VK_NULL_HANDLE),
+	StaticFramebuffers(),
+	Framebuffers(),
+	Sampler(VK_NULL_HANDLE),
+	CommandPools(),
+	StaticCommandBuffers(),
+	DynamicCommandBuffers(),
+	StaticCasters(),
+	DynamicCasters(),
+	Uniforms(),
+	StaticSet(VK_NULL_HANDLE),
+	DynamicSet(VK_NULL_HANDLE),
+	MeshSet(VK_NULL_HANDLE),
+	ReceiverSet(VK_NULL_HANDLE),
+	StaticCasterData(),
+	DynamicCasterData(),
+	MeshCasters(),
+	Camera(),
+	LightDirection(),
+	LightAxes(),
+	Cascades(),
+	Parameters(),
+	Workers(),
+	WorkMutex(),
+	WorkReady(),
+	WorkDone(),
+	WorkGeneration(0),
+	WorkPending(0),
+	WorkFailed(false),
+	Stopping(false),
+	StaticRenderCount(0),
+	CascadeFrameCount(0) {
+	SetLightDirection(-0.4f, -1.0f, -0.3f);
+}
+
+ShadowCascades::~ShadowCascades() {
+	Destroy();
+}
+
+bool ShadowCascades::Create(const ShadowSettings& settings, VkRenderPass renderPass, VkSampleCountFlagBits samples) {
+	Destroy();
+	Settings = settings;
+	Settings.cascadeCount = (Settings.cascadeCount > MaxCascades) ? MaxCascades : std::max<uint32_t>(Settings.cascadeCount, 1);
+	Settings.resolution = std::max<uint32_t>(Settings.resolution, 1);
+	Settings.maxStaticCasters = std::max<uint32_t>(Settings.maxStaticCasters, 1);
+	Settings.maxDynamicCasters = std::max<uint32_t>(Settings.maxDynamicCasters, 1);
+	const uint32_t count = Settings.cascadeCount;
+	const VkExtent2D extent = { Settings.resolution, Settings.resolution };
+
+	// Depth attachment and linearly filtered sampling are needed
+	VkFormat format = VK_FORMAT_UNDEFINED;
+	for (VkFormat candidate : AtlasFormats) {
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(Device.physicalDevice, candidate, &formatProperties);
+		const VkFormatFeatureFlags features = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		if ((formatProperties.optimalTilingFeatures & features) == features) {
+			format = candidate;
+			break;
+		}
+	}
+	if (format == VK_FORMAT_UNDEFINED) {
+		std::cout << "NO FILTERABLE DEPTH FORMAT FOR SHADOW MAPS " << std::endl;
+		return false;
+	}
+
+	if (!CreateGpuImage(Device, format, extent, count, 1, VK_SAMPLE_COUNT_1_BIT,
+			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, StaticAtlas)
+		|| !CreateGpuImage(Device, format, extent, count, 1, VK_SAMPLE_COUNT_1_BIT,
+			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, Atlas)) {
+		return false;
+	}
+
+	if (!CreateRenderPass(VK_ATTACHMENT_LOAD_OP_CLEAR, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, StaticRenderPass)
+		|| !CreateRenderPass(VK_ATTACHMENT_LOAD_OP_LOAD, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, DynamicRenderPass)) {
+		return false;
+	}
+
+	StaticLayerViews.assign(count, VK_NULL_HANDLE);
+	LayerViews.assign(count, VK_NULL_HANDLE);
+	StaticFramebuffers.assign(count, VK_NULL_HANDLE);
+	Framebuffers.assign(count, VK_NULL_HANDLE);
+	for (uint32_t i = 0; i < count; ++i) {
+		if (!CreateGpuImageView(Device, StaticAtlas, i, 0, 1, StaticLayerViews[i]) || !CreateGpuImageView(Device, Atlas, i, 0, 1, LayerViews[i])) {
+			return false;
+		}
+
+		VkFramebufferCreateInfo frameBufferCreateInfo = {};
+		frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		frameBufferCreateInfo.pNext = nullptr;
+		frameBufferCreateInfo.flags = 0;
+		frameBufferCreateInfo.renderPass = StaticRenderPass;
+		frameBufferCreateInfo.attachmentCount = 1;
+		frameBufferCreateInfo.pAttachments = &StaticLayerViews[i];
+		frameBufferCreateInfo.width = Settings.resolution;
+		frameBufferCreateInfo.height = Settings.resolution;
+		frameBufferCreateInfo.layers = 1;
+
+		if (Dispatch.vkCreateFramebuffer(Dispatch.device, &frameBufferCreateInfo, nullptr, &StaticFramebuffers[i]) != VK_SUCCESS) {
+			std::cout << "COULD NOT CREATE SHADOW FRAME BUFFER " << std::endl;
+			return false;
+		}
+
+		frameBufferCreateInfo.renderPass = DynamicRenderPass;
+		frameBufferCreateInfo.pAttachments = &LayerViews[i];
+		if (Dispatch.vkCreateFramebuffer(Dispatch.device, &frameBufferCreateInfo, nullptr, &Framebuffers[i]) != VK_SUCCESS) {
+			std::cout << "COULD NOT CREATE SHADOW FRAME BUFFER " << std::endl;
+			return false;
+		}
+	}
+
+	// Outside the atlas reads as the far plane (0 in reversed depth), so nothing is in shadow there
+	VkSamplerCreateInfo samplerCreateInfo = {};
+	samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCreateInfo.pNext = nullptr;
+	samplerCreateInfo.flags = 0;
+	samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+	samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+	samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.mipLodBias = 0.0f;
+	samplerCreateInfo.anisotropyEnable = VK_FALSE;
+	samplerCreateInfo.maxAnisotropy = 1.0f;
+	samplerCreateInfo.compareEnable = VK_TRUE;
+	samplerCreateInfo.compareOp = VK_COMPARE_OP_GREATER_OR_EQUAL;
+	samplerCreateInfo.minLod = 0.0f;
+	samplerCreateInfo.maxLod = 0.0f;
+	samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+	samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+
+	if (Dispatch.vkCreateSampler(Dispatch.device, &samplerCreateInfo, nullptr, &Sampler) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE SHADOW SAMPLER " << std::endl;
+		return false;
+	}
+
+	CommandPools.assign(count, VK_NULL_HANDLE);
+	StaticCommandBuffers.assign(count, VK_NULL_HANDLE);
+	DynamicCommandBuffers.assign(count, VK_NULL_HANDLE);
+	for (uint32_t i = 0; i < count; ++i) {
+		VkCommandPoolCreateInfo commandPoolCreateInfo = {};
+		commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		commandPoolCreateInfo.pNext = nullptr;
+		commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		commandPoolCreateInfo.queueFamilyIndex = Device.graphicsQueueFamilyIndex;
+
+		if (Dispatch.vkCreateCommandPool(Dispatch.device, &commandPoolCreateInfo, nullptr, &CommandPools[i]) != VK_SUCCESS) {
+			std::cout << "ERROR WHILE CREATING COMMAND POOL " << std::endl;
+			return false;
+		}
+
+		VkCommandBuffer commandBuffers[2] = {};
+		VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+		commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		commandBufferAllocateInfo.pNext = nullptr;
+		commandBufferAllocateInfo.commandPool = CommandPools[i];
+		commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+		commandBufferAllocateInfo.commandBufferCount = 2;
+
+		if (Dispatch.vkAllocateCommandBuffers(Dispatch.device, &commandBufferAllocateInfo, commandBuffers) != VK_SUCCESS) {
+			std::cout << "COULD NOT ALLOCATE COMMAND BUFFERS FROM COMMAND POOL " << std::endl;
+			return false;
+		}
+		StaticCommandBuffers[i] = commandBuffers[0];
+		DynamicCommandBuffers[i] = commandBuffers[1];
+	}
+
+	const VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	if (!CreateGpuBuffer(Device, Settings.maxStaticCasters * sizeof(ShadowCaster), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, StaticCasters)
+		|| !CreateGpuBuffer(Device, Settings.maxDynamicCasters * sizeof(ShadowCaster), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, DynamicCasters)
+		|| !CreateGpuBuffer(Device, sizeof(Constants), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostVisible, Uniforms)) {
+		return false;
+	}
+
+	// Casters only write depth, into a render pass compatible with both shadow render passes
+	GraphicsPipelineState casterState;
+	casterState.renderPass = StaticRenderPass;
+	casterState.colorAttachmentCount = 0;
+	casterState.depthTest = true;
+	casterState.depthWrite = true;
+	casterState.depthBias = true;
+
+	GraphicsPipelineState receiverState;
+	receiverState.renderPass = renderPass;
+	receiverState.samples = samples;
+	receiverState.depthTest = true;
+	receiverState.depthWrite = true;
+
+	const std::string header = ReceiverHeader;
+	if (!CasterPipeline.Create(CasterVertexShader, nullptr, "shadow_caster", std::vector<VkDescriptorType>(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER),
+			16 * sizeof(float), 2, casterState)
+		|| !MeshCasterPipeline.Create(MeshCasterVertexShader, nullptr, "shadow_mesh_caster", std::vector<VkDescriptorType>(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER),
+			sizeof(MeshConstants), 1, casterState)
+		|| !ReceiverPipeline.Create((header + ReceiverVertexShader).c_str(), (header + ReceiverFragmentShader).c_str(), "shadow_receiver",
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER }, 0, 1, receiverState)
+		|| !CasterPipeline.AllocateDescriptorSet(StaticSet)
+		|| !CasterPipeline.AllocateDescriptorSet(DynamicSet)
+		|| !MeshCasterPipeline.AllocateDescriptorSet(MeshSet)
+		|| !ReceiverPipeline.AllocateDescriptorSet(ReceiverSet)) {
+		return false;
+	}
+	CasterPipeline.WriteBuffer(StaticSet, 0, StaticCasters.handle);
+	CasterPipeline.WriteBuffer(DynamicSet, 0, DynamicCasters.handle);
+	ReceiverPipeline.WriteBuffer(ReceiverSet, 0, Uniforms.handle);
+	ReceiverPipeline.WriteImage(ReceiverSet, 1, Atlas.view, Sampler, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+
+	MeshCasters = ShadowMeshCasters();
+	InvalidateStaticCascades();
+	StaticRenderCount = 0;
+	CascadeFrameCount = 0;
+	StartWorkers();
+	return true;
+}
+
+void ShadowCascades::Destroy() {
+	StopWorkers();
+	if (Dispatch.device == VK_NULL_HANDLE) {
+		return;
+	}
+
+	CasterPipeline.Destroy();
+	MeshCasterPipeline.Destroy();
+	ReceiverPipeline.Destroy();
+	StaticSet = VK_NULL_HANDLE;
+	DynamicSet = VK_NULL_HANDLE;
+	MeshSet = VK_NULL_HANDLE;
+	ReceiverSet = VK_NULL_HANDLE;
+	DestroyGpuBuffer(Device, StaticCasters);
+	DestroyGpuBuffer(Device, DynamicCasters);
+	DestroyGpuBuffer(Device, Uniforms);
+
+	// Command buffers are freed together with their pools
+	for (VkCommandPool pool : CommandPools) {
+		if (pool != VK_NULL_HANDLE) {
+			Dispatch.vkDestroyCommandPool(Dispatch.device, pool, nullptr);
+		}
+	}
+	CommandPools.clear();
+	StaticCommandBuffers.clear();
+	DynamicCommandBuffers.clear();
+
+	if (Sampler != VK_NULL_HANDLE) {
+		Dispatch.vkDestroySampler(Dispatch.device, Sampler, nullptr);
+		Sampler = VK_NULL_HANDLE;
+	}
+	for (std::vector<VkFramebuffer>* framebuffers : { &StaticFramebuffers, &Framebuffers }) {
+		for (VkFramebuffer framebuffer : *framebuffers) {
+			if (framebuffer != VK_NULL_HANDLE) {
+				Dispatch.vkDestroyFramebuffer(Dispatch.device, framebuffer, nullptr);
+			}
+		}
+		framebuffers->clear();
+	}
+	for (std::vector<VkImageView>* views : { &StaticLayerViews, &LayerViews }) {
+		for (VkImageView view : *views) {
+			if (view != VK_NULL_HANDLE) {
+				Dispatch.vkDestroyImageView(Dispatch.device, view, nullptr);
+			}
+		}
+		views->clear();
+	}
+	for (VkRenderPass* renderPass : { &StaticRenderPass, &DynamicRenderPass }) {
+		if (*renderPass != VK_NULL_HANDLE) {
+			Dispatch.vkDestroyRenderPass(Dispatch.device, *renderPass, nullptr);
+			*renderPass = VK_NULL_HANDLE;
+		}
+	}
+	DestroyGpuImage(Device, StaticAtlas);
+	DestroyGpuImage(Device, Atlas);
+}
+
+void ShadowCascades::SetLightDirection(float x, float y, float z) {
+	const Vector direction = Normalize({ x, y, z });
+	LightDirection[0] = direction.x;
+	LightDirection[1] = direction.y;
+	LightDirection[2] = direction.z;
+
+	// Light space looks along the light, +z points towards it
+	const Vector zAxis = Scale(direction, -1.0f);
+	const Vector up = (std::fabs(direction.y) > 0.99f) ? Vector{ 1.0f, 0.0f, 0.0f } : Vector{ 0.0f, 1.0f, 0.0f };
+	const Vector xAxis = Normalize(Cross(up, zAxis));
+	const Vector yAxis = Cross(zAxis, xAxis);
+	const Vector axes[3] = { xAxis, yAxis, zAxis };
+	for (int i = 0; i < 3; ++i) {
+		LightAxes[i][0] = axes[i].x;
+		LightAxes[i][1] = axes[i].y;
+		LightAxes[i][2] = axes[i].z;
+	}
+	InvalidateStaticCascades();
+}
+
+void ShadowCascades::SetCamera(const SceneCamera& camera) {
+	Camera = camera;
+}
+
+bool ShadowCascades::SetStaticCasters(const std::vector<ShadowCaster>& casters) {
+	if (casters.size() > Settings.maxStaticCasters) {
+		std::cout << "SHADOWS WERE CREATED FOR AT MOST " << Settings.maxStaticCasters << " STATIC CASTERS " << std::endl;
+		return false;
+	}
+	StaticCasterData = casters;
+	if (!casters.empty()) {
+		memcpy(StaticCasters.mapped, casters.data(), casters.size() * sizeof(ShadowCaster));
+	}
+	InvalidateStaticCascades();
+	return true;
+}
+
+bool ShadowCascades::SetDynamicCasters(const std::vector<ShadowCaster>& casters) {
+	if (casters.size() > Settings.maxDynamicCasters) {
+		std::cout << "SHADOWS WERE CREATED FOR AT MOST " << Settings.maxDynamicCasters << " DYNAMIC CASTERS " << std::endl;
+		return false;
+	}
+	DynamicCasterData = casters;
+	if (!casters.empty()) {
+		memcpy(DynamicCasters.mapped, casters.data(), casters.size() * sizeof(ShadowCaster));
+	}
+	return true;
+}
+
+void ShadowCascades::SetMeshCasters(const ShadowMeshCasters& casters) {
+	if ((casters.vertices != VK_NULL_HANDLE) && (casters.vertices != MeshCasters.vertices)) {
+		MeshCasterPipeline.WriteBuffer(MeshSet, 0, casters.vertices);
+	}
+	MeshCasters = casters;
+	if ((MeshCasters.vertices == VK_NULL_HANDLE) || (MeshCasters.indices == VK_NULL_HANDLE)) {
+		MeshCasters.instanceCount = 0;
+	}
+}
+
+void ShadowCascades::InvalidateStaticCascades() {
+	for (Cascade& cascade : Cascades) {
+		cascade.staticValid = false;
+	}
+}
+
+bool ShadowCascades::Prepare(const OffscreenFrame& frame) {
+	const uint32_t count = Settings.cascadeCount;
+	UpdateCascades(frame.extent);
+	memcpy(Uniforms.mapped, &Parameters, sizeof(Constants));
+
+	// A layer only needs rebuilding when its static part changed or dynamic casters are (or were) on it
+	for (uint32_t i = 0; i < count; ++i) {
+		Cascade& cascade = Cascades[i];
+		cascade.record = !cascade.staticValid || HasDynamicCasters() || cascade.hasDynamic;
+	}
+	CascadeFrameCount += count;
+
+	{
+		std::lock_guard<std::mutex> lock(WorkMutex);
+		WorkPending = static_cast<uint32_t>(Workers.size());
+		WorkFailed = false;
+		++WorkGeneration;
+	}
+	WorkReady.notify_all();
+	bool recorded = !Cascades[0].record || RecordCascade(0);
+	{
+		std::unique_lock<std::mutex> lock(WorkMutex);
+		WorkDone.wait(lock, [this]() { return WorkPending == 0; });
+		recorded = recorded && !WorkFailed;
+	}
+	if (!recorded) {
+		std::cout << "COULD NOT RECORD SHADOW CASCADES " << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void ShadowCascades::CmdRender(VkCommandBuffer commandBuffer) {
+	const uint32_t count = Settings.cascadeCount;
+
+	VkClearValue clearValue = {};
+	clearValue.depthStencil = { 0.0f, 0 };
+
+	VkRenderPassBeginInfo renderPassBeginInfo = {};
+	renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassBeginInfo.pNext = nullptr;
+	renderPassBeginInfo.renderArea.offset = { 0, 0 };
+	renderPassBeginInfo.renderArea.extent = { Settings.resolution, Settings.resolution };
+	renderPassBeginInfo.clearValueCount = 1;
+	renderPassBeginInfo.pClearValues = &clearValue;
+
+	for (uint32_t i = 0; i < count; ++i) {
+		Cascade& cascade = Cascades[i];
+		if (!cascade.record) {
+			continue;
+		}
+
+		if (!cascade.staticValid) {
+			renderPassBeginInfo.renderPass = StaticRenderPass;
+			renderPassBeginInfo.framebuffer = StaticFramebuffers[i];
+			Dispatch.vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			Dispatch.vkCmdExecuteCommands(commandBuffer, 1, &StaticCommandBuffers[i]);
+			Dispatch.vkCmdEndRenderPass(commandBuffer);
+			cascade.staticValid = true;
+			++StaticRenderCount;
+		}
+
+		// Previous contents are replaced completely
+		VkImageMemoryBarrier imageMemoryBarrier = {};
+		imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageMemoryBarrier.pNext = nullptr;
+		imageMemoryBarrier.srcAccessMask = 0;
+		imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		imageMemoryBarrier.image = Atlas.handle;
+		imageMemoryBarrier.subresourceRange = { Atlas.aspect, 0, 1, i, 1 };
+		Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageMemoryBarrier);
+
+		VkImageCopy region = {};
+		region.srcSubresource = { StaticAtlas.aspect, 0, i, 1 };
+		region.srcOffset = { 0, 0, 0 };
+		region.dstSubresource = { Atlas.aspect, 0, i, 1 };
+		region.dstOffset = { 0, 0, 0 };
+		region.extent = { Settings.resolution, Settings.resolution, 1 };
+		Dispatch.vkCmdCopyImage(commandBuffer, StaticAtlas.handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, Atlas.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+		renderPassBeginInfo.renderPass = DynamicRenderPass;
+		renderPassBeginInfo.framebuffer = Framebuffers[i];
+		Dispatch.vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+		Dispatch.vkCmdExecuteCommands(commandBuffer, 1, &DynamicCommandBuffers[i]);
+		Dispatch.vkCmdEndRenderPass(commandBuffer);
+		cascade.hasDynamic = HasDynamicCasters();
+	}
+}
+
+void ShadowCascades::CmdPrePass(VkCommandBuffer commandBuffer, const OffscreenFrame& /*frame*/) {
+	CmdRender(commandBuffer);
+}
+
+void ShadowCascades::CmdDraw(VkCommandBuffer commandBuffer, const OffscreenFrame& /*frame*/) const {
+	ReceiverPipeline.CmdBind(commandBuffer, ReceiverSet);
+	Dispatch.vkCmdDraw(commandBuffer, 6, 1, 0, 0);
+}
+
+uint64_t ShadowCascades::GetStaticRenderCount() const {
+	return StaticRenderCount;
+}
+
+uint64_t ShadowCascades::GetCascadeFrameCount() const {
+	return CascadeFrameCount;
+}
+
+bool ShadowCascades::CreateRenderPass(VkAttachmentLoadOp loadOp, VkImageLayout initialLayout, VkImageLayout finalLayout, VkRenderPass& renderPass) {
+	VkAttachmentDescription attachmentDescription = {};
+	attachmentDescription.flags = 0;
+	attachmentDescription.format = Atlas.format;
+	attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
+	attachmentDescription.loadOp = loadOp;
+	attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachmentDescription.initialLayout = initialLayout;
+	attachmentDescription.finalLayout = finalLayout;
+
+	VkAttachmentReference depthAttachmentReference = { 0, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+	VkSubpassDescription subpassDescription = {};
+	subpassDescription.flags = 0;
+	subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpassDescription.inputAttachmentCount = 0;
+	subpassDescription.pInputAttachments = nullptr;
+	subpassDescription.colorAttachmentCount = 0;
+	subpassDescription.pColorAttachments = nullptr;
+	subpassDescription.pResolveAttachments = nullptr;
+	subpassDescription.pDepthStencilAttachment = &depthAttachmentReference;
+	subpassDescription.preserveAttachmentCount = 0;
+	subpassDescription.pPreserveAttachments = nullptr;
+
+	// In: after the copy into (or out of) the layer and the previous frame's sampling.
+	// Out: before the copy of the static layer and the receiver's sampling.
+	const VkPipelineStageFlags depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	VkSubpassDependency dependencies[2] = {};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dependencies[0].dstStageMask = depthStages;
+	dependencies[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dependencyFlags = 0;
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = depthStages;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+	dependencies[1].dependencyFlags = 0;
+
+	VkRenderPassCreateInfo renderPassCreateInfo = {};
+	renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassCreateInfo.pNext = nullptr;
+	renderPassCreateInfo.flags = 0;
+	renderPassCreateInfo.attachmentCount = 1;
+	renderPassCreateInfo.pAttachments = &attachmentDescription;
+	renderPassCreateInfo.subpassCount = 1;
+	renderPassCreateInfo.pSubpasses = &subpassDescription;
+	renderPassCreateInfo.dependencyCount = 2;
+	renderPassCreateInfo.pDependencies = dependencies;
+
+	if (Dispatch.vkCreateRenderPass(Dispatch.device, &renderPassCreateInfo, nullptr, &renderPass) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE SHADOW RENDER PASS " << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool ShadowCascades::HasDynamicCasters() const {
+	return !DynamicCasterData.empty() || (MeshCasters.instanceCount > 0);
+}
+
+void ShadowCascades::UpdateCascades(VkExtent2D extent) {
+	const uint32_t count = Settings.cascadeCount;
+	const float aspect = static_cast<float>(extent.width) / static_cast<float>(std::max<uint32_t>(extent.height, 1));
+	const float tanY = std::tan(0.5f * Camera.verticalFov);
+	const float tanX = tanY * aspect;
+
+	float cameraForward[3];
+	float cameraRight[3];
+	float cameraUp[3];
+	GetCameraAxes(Camera, cameraForward, cameraRight, cameraUp);
+	const Vector position = { Camera.position[0], Camera.position[1], Camera.position[2] };
+	const Vector forward = { cameraForward[0], cameraForward[1], cameraForward[2] };
+	GetCameraViewProjection(Camera, aspect, Parameters.viewProjection);
+
+	const float nearPlane = Camera.nearPlane;
+	const float shadowFar = std::max(std::min(Camera.farPlane, Settings.shadowDistance), nearPlane * 1.001f);
+
+	const Vector axes[3] = {
+		{ LightAxes[0][0], LightAxes[0][1], LightAxes[0][2] },
+		{ LightAxes[1][0], LightAxes[1][1], LightAxes[1][2] },
+		{ LightAxes[2][0], LightAxes[2][1], LightAxes[2][2] }
+	};
+
+	float previousSplit = nearPlane;
+	for (uint32_t i = 0; i < count; ++i) {
+		// Practical split scheme: a blend of logarithmic and uniform splits
+		const float t = static_cast<float>(i + 1) / static_cast<float>(count);
+		const float logSplit = nearPlane * std::pow(shadowFar / nearPlane, t);
+		const float uniformSplit = nearPlane + (shadowFar - nearPlane) * t;
+		const float split = Settings.splitLambda * logSplit + (1.0f - Settings.splitLambda) * uniformSplit;
+
+		// Sphere around the slice's corners, centered on the view axis. Its size doesn't depend on the camera's
+		// orientation and is rounded up, so rotating the camera doesn't change the cascade's scale.
+		const float middle = 0.5f * (previousSplit + split);
+		const float nearRadius = std::sqrt((tanX * tanX + tanY * tanY) * previousSplit * previousSplit + (middle - previousSplit) * (middle - previousSplit));
+		const float farRadius = std::sqrt((tanX * tanX + tanY * tanY) * split * split + (split - middle) * (split - middle));
+		const float radius = std::ceil(std::max(nearRadius, farRadius) * 16.0f) / 16.0f;
+		const Vector center = Add(position, Scale(forward, middle));
+
+		// Snap the center to whole texels in light space, so the cascade's texels don't crawl as the camera moves
+		const float texel = 2.0f * radius / static_cast<float>(Settings.resolution);
+		float snapped[3] = {};
+		for (int axis = 0; axis < 3; ++axis) {
+			snapped[axis] = std::floor(Dot(axes[axis], center) / texel) * texel;
+		}
+
+		// Orthographic projection around the sphere, extended towards the light by casterDistance, in reversed depth
+		const float depthRange = 2.0f * radius + Settings.casterDistance;
+		float matrix[16] = {};
+		for (int column = 0; column < 3; ++column) {
+			matrix[column * 4 + 0] = LightAxes[0][column] / radius;
+			matrix[column * 4 + 1] = LightAxes[1][column] / radius;
+			matrix[column * 4 + 2] = LightAxes[2][column] / depthRange;
+		}
+		matrix[12] = -snapped[0] / radius;
+		matrix[13] = -snapped[1] / radius;
+		matrix[14] = (radius - snapped[2]) / depthRange;
+		matrix[15] = 1.0f;
+
+		Cascade& cascade = Cascades[i];
+		if (memcmp(cascade.matrix, matrix, sizeof(matrix)) != 0) {
+			memcpy(cascade.matrix, matrix, sizeof(matrix));
+			cascade.staticValid = false;
+		}
+		memcpy(cascade.center, snapped, sizeof(snapped));
+		cascade.radius = radius;
+
+		memcpy(Parameters.cascades[i], matrix, sizeof(matrix));
+		Parameters.splits[i] = split;
+		previousSplit = split;
+	}
+
+	Parameters.cameraPosition[0] = position.x;
+	Parameters.cameraPosition[1] = position.y;
+	Parameters.cameraPosition[2] = position.z;
+	Parameters.cameraPosition[3] = static_cast<float>(count);
+	Parameters.cameraForward[0] = forward.x;
+	Parameters.cameraForward[1] = forward.y;
+	Parameters.cameraForward[2] = forward.z;
+	Parameters.cameraForward[3] = 0.0f;
+	Parameters.lightDirection[0] = LightDirection[0];
+	Parameters.lightDirection[1] = LightDirection[1];
+	Parameters.lightDirection[2] = LightDirection[2];
+	Parameters.lightDirection[3] = 0.0f;
+}
+
+void ShadowCascades::StartWorkers() {
+	for (uint32_t i = 1; i < Settings.cascadeCount; ++i) {
+		Workers.emplace_back(&ShadowCascades::WorkerLoop, this, i, WorkGeneration);
+	}
+}
+
+void ShadowCascades::StopWorkers() {
+	{
+		std::lock_guard<std::mutex> lock(WorkMutex);
+		Stopping = true;
+	}
+	WorkReady.notify_all();
+	for (std::thread& worker : Workers) {
+		worker.join();
+	}
+	Workers.clear();
+	Stopping = false;
+}
+
+void ShadowCascades::WorkerLoop(uint32_t index, uint64_t generation) {
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(WorkMutex);
+			WorkReady.wait(lock, [this, generation]() { return Stopping || (WorkGeneration != generation); });
+			if (Stopping) {
+				return;
+			}
+			generation = WorkGeneration;
+		}
+
+		const bool recorded = !Cascades[index].record || RecordCascade(index);
+		bool done = false;
+		{
+			std::lock_guard<std::mutex> lock(WorkMutex);
+			WorkFailed = WorkFailed || !recorded;
+			done = --WorkPending == 0;
+		}
+		if (done) {
+			WorkDone.notify_one();
+		}
+	}
+}
+
+bool ShadowCascades::RecordCascade(uint32_t index) {
+	if (Dispatch.vkResetCommandPool(Dispatch.device, CommandPools[index], 0) != VK_SUCCESS) {
+		return false;
+	}
+
+	const Cascade& cascade = Cascades[index];
+	if (!cascade.staticValid
+		&& !RecordCasters(StaticCommandBuffers[index], StaticRenderPass, StaticFramebuffers[index], StaticSet, StaticCasterData, nullptr, cascade)) {
+		return false;
+	}
+	return RecordCasters(DynamicCommandBuffers[index], DynamicRenderPass, Framebuffers[index], DynamicSet, DynamicCasterData, &MeshCasters, cascade);
+}
+
+bool ShadowCascades::RecordCasters(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkFramebuffer framebuffer, VkDescriptorSet set,
+	const std::vector<ShadowCaster>& casters, const ShadowMeshCasters* meshes, const Cascade& cascade) const {
+	VkCommandBufferInheritanceInfo inheritanceInfo = {};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.pNext = nullptr;
+	inheritanceInfo.renderPass = renderPass;
+	inheritanceInfo.subpass = 0;
+	inheritanceInfo.framebuffer = framebuffer;
+	inheritanceInfo.occlusionQueryEnable = VK_FALSE;
+	inheritanceInfo.queryFlags = 0;
+	inheritanceInfo.pipelineStatistics = 0;
+
+	VkCommandBufferBeginInfo cmdBufferBeginInfo = {};
+	cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	cmdBufferBeginInfo.pNext = nullptr;
+	cmdBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+	cmdBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+
+	if (Dispatch.vkBeginCommandBuffer(commandBuffer, &cmdBufferBeginInfo) != VK_SUCCESS) {
+		return false;
+	}
+
+	const bool drawMeshes = (meshes != nullptr) && (meshes->instanceCount > 0) && (meshes->indexCount > 0);
+	if (!casters.empty() || drawMeshes) {
+		const float size = static_cast<float>(Settings.resolution);
+		VkViewport viewport = { 0.0f, 0.0f, size, size, 0.0f, 1.0f };
+		VkRect2D scissor = { { 0, 0 }, { Settings.resolution, Settings.resolution } };
+		Dispatch.vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		Dispatch.vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		Dispatch.vkCmdSetDepthBias(commandBuffer, DepthBiasConstant, 0.0f, DepthBiasSlope);
+	}
+
+	if (!casters.empty()) {
+		CasterPipeline.CmdBind(commandBuffer, set);
+		CasterPipeline.CmdPushConstants(commandBuffer, cascade.matrix, sizeof(cascade.matrix));
+
+		// Cull against the cascade's box in light space, consecutive visible casters share a draw
+		const float depthReach = cascade.radius + Settings.casterDistance;
+		uint32_t first = 0;
+		uint32_t run = 0;
+		for (uint32_t i = 0; i <= static_cast<uint32_t>(casters.size()); ++i) {
+			bool visible = false;
+			if (i < casters.size()) {
+				const ShadowCaster& caster = casters[i];
+				const float extent = caster.halfSize * CubeSphereScale;
+				float local[3] = {};
+				for (int axis = 0; axis < 3; ++axis) {
+					local[axis] = LightAxes[axis][0] * caster.position[0] + LightAxes[axis][1] * caster.position[1] + LightAxes[axis][2] * caster.position[2]
+						- cascade.center[axis];
+				}
+				visible = (std::fabs(local[0]) <= cascade.radius + extent) && (std::fabs(local[1]) <= cascade.radius + extent)
+					&& (local[2] >= -cascade.radius - extent) && (local[2] <= depthReach + extent);
+			}
+			if (visible) {
+				if (run == 0) {
+					first = i;
+				}
+				++run;
+			}
+			else if (run > 0) {
+				Dispatch.vkCmdDraw(commandBuffer, 36, run, 0, first);
+				run = 0;
+			}
+		}
+	}
+
+	if (drawMeshes) {
+		MeshConstants constants = {};
+		memcpy(constants.shadowMatrix, cascade.matrix, sizeof(cascade.matrix));
+		constants.vertexCount = meshes->vertexCount;
+		MeshCasterPipeline.CmdBind(commandBuffer, MeshSet);
+		MeshCasterPipeline.CmdPushConstants(commandBuffer, &constants, sizeof(constants));
+		Dispatch.vkCmdBindIndexBuffer(commandBuffer, meshes->indices, 0, VK_INDEX_TYPE_UINT32);
+		Dispatch.vkCmdDrawIndexed(commandBuffer, meshes->indexCount, meshes->instanceCount, 0, 0, 0);
+	}
+
+	return Dispatch.vkEndCommandBuffer(commandBuffer) == VK_SUCCESS;
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include "ComputePipeline.h"
+#include "GraphicsPipeline.h"
+#include "OffscreenRenderer.h"
+#include "SceneCamera.h"
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Axis aligned cube in world space (y up)
+struct ShadowCaster {
+	float position[3];
+	float halfSize;
+
+	ShadowCaster() :
+		position(),
+		halfSize(0.5f) {
+	}
+};
+
+// Indexed mesh instances in a storage buffer of world space xyzw positions, e.g. SkinnedCrowd's skinned vertices:
+// instance i's vertices start at i * vertexCount
+struct ShadowMeshCasters {
+	VkBuffer vertices;
+	VkBuffer indices;					// uint32_t
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	uint32_t instanceCount;
+
+	ShadowMeshCasters() :
+		vertices(VK_NULL_HANDLE),
+		indices(VK_NULL_HANDLE),
+		vertexCount(0),
+		indexCount(0),
+		instanceCount(0) {
+	}
+};
+
+struct ShadowSettings {
+	uint32_t cascadeCount;				// 1 to 4
+	uint32_t resolution;				// Of every cascade
+	float splitLambda;					// 0 spaces the splits uniformly, 1 logarithmically
+	float shadowDistance;				// Cascades end here or at the camera's far plane
+	float casterDistance;				// How far towards the light casters may be outside a cascade's bounds
+	uint32_t maxStaticCasters;
+	uint32_t maxDynamicCasters;
+
+	ShadowSettings() :
+		cascadeCount(4),
+		resolution(2048),
+		splitLambda(0.75f),
+		shadowDistance(80.0f),
+		casterDistance(50.0f),
+		maxStaticCasters(4096),
+		maxDynamicCasters(256) {
+	}
+};
+
+// Cascaded shadow maps of a directional light.
+// Every frame the camera's frustum is split into cascades, each bounded by a sphere whose projection is snapped to
+// whole texels, so a cascade's matrix only changes when the camera moves by more than a texel. Static casters are
+// rendered into a cached atlas layer only when that matrix, the light or the static casters change; every frame the
+// cached layer is copied into the sampled depth array atlas and the dynamic casters are drawn on top.
+// Each cascade's casters are culled and recorded into secondary command buffers concurrently: the first cascade on the
+// calling thread, every other one on a worker thread of its own which lives as long as the shadows. Mesh casters, such as
+// a skinned crowd, are drawn with the dynamic casters.
+// The receiver is a ground plane at y = 0, drawn in the first subpass of render passes compatible with the given one.
+class ShadowCascades : public OffscreenDrawable {
+public:
+	static const uint32_t MaxCascades = 4;
+
+	// Context's dispatch table must outlive the shadows
+	explicit ShadowCascades(const DeviceContext& device);
+	~ShadowCascades();
+
+	ShadowCascades(const ShadowCascades&) = delete;
+	ShadowCascades& operator=(const ShadowCascades&) = delete;
+
+	// samples is the sample count of renderPass, the shadow maps themselves are always single sampled
+	bool Create(const ShadowSettings& settings, VkRenderPass renderPass, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT);
+	void Destroy();
+
+	// Direction the light travels in, doesn't need to be normalized
+	void SetLightDirection(float x, float y, float z);
+	// Cascades are fitted to this camera's frustum
+	void SetCamera(const SceneCamera& camera);
+	bool SetStaticCasters(const std::vector<ShadowCaster>& casters);
+	// Written straight into mapped memory, so no frame using the previous ones may still be executing
+	bool SetDynamicCasters(const std::vector<ShadowCaster>& casters);
+	// Drawn every frame into every cascade, after the dynamic cubes and without culling. Whatever writes the vertices
+	// must make them visible to vertex shaders before CmdRender(), e.g. a SkinnedCrowd earlier in the same draw list.
+	// No frame using the previous ones may still be executing.
+	void SetMeshCasters(const ShadowMeshCasters& casters);
+	// Re-renders every static cascade in the next frame even if nothing changed
+	void InvalidateStaticCascades();
+
+	// Fits the cascades to the frame and records their casters, before the command buffer passed to CmdRender() is
+	// begun, so a failure doesn't leave it recording. Everything written here is single buffered, so the previous frame
+	// must have finished.
+	bool Prepare(const OffscreenFrame& frame) override;
+	// Outside a render pass, after Prepare(); the atlas is ready for CmdDraw() in the same command buffer
+	void CmdRender(VkCommandBuffer commandBuffer);
+
+	// Renders the cascades before the render pass, then draws the receiver in it
+	void CmdPrePass(VkCommandBuffer commandBuffer, const OffscreenFrame& frame) override;
+	void CmdDraw(VkCommandBuffer commandBuffer, const OffscreenFrame& frame) const override;
+
+	// How many times a static cascade was rendered, and how many times one was needed
+	uint64_t GetStaticRenderCount() const;
+	uint64_t GetCascadeFrameCount() const;
+
+private:
+	struct Cascade {
+		float matrix[16];				// World to shadow clip space
+		float center[3];				// Snapped, in light space
+		float radius;
+		bool staticValid;				// Static layer was rendered with this matrix
+		bool hasDynamic;				// Atlas layer holds dynamic casters on top of the static ones
+		bool record;					// Atlas layer is rebuilt this frame
+	};
+
+	// Push constants of the mesh caster shader
+	struct MeshConstants {
+		float shadowMatrix[16];
+		uint32_t vertexCount;
+	};
+
+	// Uniform block of the receiver, std140
+	struct Constants {
+		float viewProjection[16];
+		float cascades[MaxCascades][16];
+		float splits[MaxCascades];		// View depth where each cascade ends
+		float cameraPosition[4];		// w is the cascade count
+		float cameraForward[4];
+		float lightDirection[4];
+	};
+
+	bool CreateRenderPass(VkAttachmentLoadOp loadOp, VkImageLayout initialLayout, VkImageLayout finalLayout, VkRenderPass& renderPass);
+	bool HasDynamicCasters() const;
+	void UpdateCascades(VkExtent2D extent);
+	void StartWorkers();
+	void StopWorkers();
+	// Waits for generations after the given one
+	void WorkerLoop(uint32_t index, uint64_t generation);
+	bool RecordCascade(uint32_t index);
+	// Secondary command buffer drawing the casters which can reach the cascade, then the mesh casters if given
+	bool RecordCasters(VkCommandBuffer commandBuffer, VkRenderPass renderPass, VkFramebuffer framebuffer, VkDescriptorSet set,
+		const std::vector<ShadowCaster>& casters, const ShadowMeshCasters* meshes, const Cascade& cascade) const;
+
+	DeviceContext Device;
+	const DeviceDispatchTable& Dispatch;
+	GraphicsPipeline CasterPipeline;
+	GraphicsPipeline MeshCasterPipeline;
+	GraphicsPipeline ReceiverPipeline;
+	ShadowSettings Settings;
+
+	GpuImage StaticAtlas;						// Static casters only, kept between frames
+	GpuImage Atlas;								// Sampled by the receiver
+	std::vector<VkImageView> StaticLayerViews;
+	std::vector<VkImageView> LayerViews;
+	VkRenderPass StaticRenderPass;				// Clears
+	VkRenderPass DynamicRenderPass;				// Loads the copied static depth
+	std::vector<VkFramebuffer> StaticFramebuffers;
+	std::vector<VkFramebuffer> Framebuffers;
+	VkSampler Sampler;
+
+	// One pool per cascade, so cascades can be recorded concurrently
+	std::vector<VkCommandPool> CommandPools;
+	std::vector<VkCommandBuffer> StaticCommandBuffers;
+	std::vector<VkCommandBuffer> DynamicCommandBuffers;
+
+	GpuBuffer StaticCasters;
+	GpuBuffer DynamicCasters;
+	GpuBuffer Uniforms;
+	VkDescriptorSet StaticSet;
+	VkDescriptorSet DynamicSet;
+	VkDescriptorSet MeshSet;
+	VkDescriptorSet ReceiverSet;
+
+	std::vector<ShadowCaster> StaticCasterData;
+	std::vector<ShadowCaster> DynamicCasterData;
+	ShadowMeshCasters MeshCasters;
+	SceneCamera Camera;
+	float LightDirection[3];
+	float LightAxes[3][3];						// Rows rotate world space into light space
+	Cascade Cascades[MaxCascades];
+	Constants Parameters;
+
+	// Worker i records cascade i + 1 once per generation
+	std::vector<std::thread> Workers;
+	std::mutex WorkMutex;
+	std::condition_variable WorkReady;
+	std::condition_variable WorkDone;
+	uint64_t WorkGeneration;
+	uint32_t WorkPending;
+	bool WorkFailed;
+	bool Stopping;
+
+	uint64_t StaticRenderCount;
+	uint64_t CascadeFrameCount;
+};
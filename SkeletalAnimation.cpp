@@ -0,0 +1,604 @@
+#include "SkeletalAnimation.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define SKELETAL_ANIMATION_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+	const uint32_t SkinGroupSize = 64;
+
+	// Fewer characters aren't worth a thread of their own
+	const uint32_t MinThreadCharacters = 16;
+
+	// Tracks whose keys all stay this close to the first one keep only that key
+	const float ConstantTrackEpsilon = 1e-5f;
+
+	const float RotationDequantize = 1.0f / 32767.0f;
+
+	const char* SkinShader = R"(#version 450
+
+layout(local_size_x_id = 0) in;
+
+struct BindVertex {
+	vec3 position;
+	uint joints;				// Four 8 bit indices
+	uint weights;				// Four 8 bit unorm weights
+	uint padding0;
+	uint padding1;
+	uint padding2;
+};
+
+layout(push_constant) uniform Skin {
+	uint characterCount;
+	uint vertexCount;
+	uint jointCount;
+};
+
+layout(set = 0, binding = 0) readonly buffer BindVertices {
+	BindVertex vertices[];
+};
+layout(set = 0, binding = 1) readonly buffer Palettes {
+	vec4 palettes[];			// Three rows per joint per character
+};
+layout(set = 0, binding = 2) writeonly buffer SkinnedVertices {
+	vec4 skinned[];
+};
+
+void main() {
+	const uint index = gl_GlobalInvocationID.x;
+	if (index >= characterCount * vertexCount) {
+		return;
+	}
+
+	const uint character = index / vertexCount;
+	const BindVertex vertex = vertices[index % vertexCount];
+	const vec4 position = vec4(vertex.position, 1.0);
+	const vec4 weights = unpackUnorm4x8(vertex.weights);
+	vec3 result = vec3(0.0);
+	for (uint i = 0u; i < 4u; ++i) {
+		const uint row = 3u * (character * jointCount + ((vertex.joints >> (8u * i)) & 0xFFu));
+		result += weights[i] * vec3(dot(palettes[row], position), dot(palettes[row + 1u], position), dot(palettes[row + 2u], position));
+	}
+	skinned[index] = vec4(result, 1.0);
+}
+)";
+
+	const char* DrawVertexShader = R"(#version 450
+
+layout(push_constant) uniform Camera {
+	mat4 viewProjection;
+	uint vertexCount;
+};
+
+layout(set = 0, binding = 0) readonly buffer SkinnedVertices {
+	vec4 skinned[];
+};
+
+layout(location = 0) out vec3 WorldPosition;
+
+void main() {
+	WorldPosition = skinned[uint(gl_InstanceIndex) * vertexCount + uint(gl_VertexIndex)].xyz;
+	gl_Position = viewProjection * vec4(WorldPosition, 1.0);
+}
+)";
+
+	const char* DrawFragmentShader = R"(#version 450
+
+layout(location = 0) in vec3 WorldPosition;
+
+layout(location = 0) out vec4 Color;
+
+const vec3 ToLight = normalize(vec3(0.4, 1.0, 0.3));
+
+void main() {
+	// y is down in the framebuffer, which makes this face the camera
+	const vec3 normal = normalize(cross(dFdy(WorldPosition), dFdx(WorldPosition)));
+	const float diffuse = max(dot(normal, ToLight), 0.0);
+	Color = vec4(vec3(0.45, 0.55, 0.7) * (0.3 + 0.7 * diffuse), 1.0);
+}
+)";
+
+	// Mesh vertex as read by the skinning shader, std430
+	struct BindVertex {
+		float position[3];
+		uint32_t joints;
+		uint32_t weights;
+		uint32_t padding[3];
+	};
+
+	struct SkinConstants {
+		uint32_t characterCount;
+		uint32_t vertexCount;
+		uint32_t jointCount;
+		uint32_t padding;
+	};
+
+	bool IsConstantTrack(const std::vector<float>& values, uint32_t stride, uint32_t joint, uint32_t jointCount, uint32_t frameCount, uint32_t components) {
+		const float* first = &values[stride * joint];
+		for (uint32_t frame = 1; frame < frameCount; ++frame) {
+			const float* key = &values[stride * (frame * jointCount + joint)];
+			for (uint32_t c = 0; c < components; ++c) {
+				if (std::fabs(key[c] - first[c]) > ConstantTrackEpsilon) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	// 3x4 row major transforms with an implied last row of 0, 0, 0, 1
+	void MultiplyTransforms(const float* a, const float* b, float* result) {
+		for (uint32_t r = 0; r < 3; ++r) {
+			const float* row = &a[4 * r];
+			for (uint32_t c = 0; c < 4; ++c) {
+				result[4 * r + c] = row[0] * b[c] + row[1] * b[4 + c] + row[2] * b[8 + c] + ((c == 3) ? row[3] : 0.0f);
+			}
+		}
+	}
+
+	void ToTransform(const float* q, const float* t, float* result) {
+		const float x = q[0], y = q[1], z = q[2], w = q[3];
+		result[0] = 1.0f - 2.0f * (y * y + z * z);
+		result[1] = 2.0f * (x * y - w * z);
+		result[2] = 2.0f * (x * z + w * y);
+		result[3] = t[0];
+		result[4] = 2.0f * (x * y + w * z);
+		result[5] = 1.0f - 2.0f * (x * x + z * z);
+		result[6] = 2.0f * (y * z - w * x);
+		result[7] = t[1];
+		result[8] = 2.0f * (x * z - w * y);
+		result[9] = 2.0f * (y * z + w * x);
+		result[10] = 1.0f - 2.0f * (x * x + y * y);
+		result[11] = t[2];
+	}
+
+#if defined(SKELETAL_ANIMATION_SSE2)
+	__m128 LoadRotation(const int16_t* key) {
+		const __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(key));
+		// Both halves of every 32 bit lane hold the component, so shifting the upper one down sign extends it
+		const __m128i wide = _mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16);
+		return _mm_mul_ps(_mm_cvtepi32_ps(wide), _mm_set1_ps(RotationDequantize));
+	}
+
+	__m128 LoadTranslation(const uint16_t* key, __m128 minimum, __m128 scale) {
+		const __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(key));
+		const __m128i wide = _mm_unpacklo_epi16(packed, _mm_setzero_si128());
+		return _mm_add_ps(minimum, _mm_mul_ps(_mm_cvtepi32_ps(wide), scale));
+	}
+
+	// In every lane
+	__m128 Dot(__m128 a, __m128 b) {
+		const __m128 products = _mm_mul_ps(a, b);
+		const __m128 pairs = _mm_add_ps(products, _mm_shuffle_ps(products, products, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_add_ps(pairs, _mm_shuffle_ps(pairs, pairs, _MM_SHUFFLE(1, 0, 3, 2)));
+	}
+
+	__m128 Lerp(__m128 a, __m128 b, __m128 t) {
+		return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+	}
+
+	// q and -q are the same rotation; blending toward the one on a's side takes the short way
+	__m128 Nlerp(__m128 a, __m128 b, __m128 t) {
+		const __m128 flip = _mm_and_ps(_mm_cmplt_ps(Dot(a, b), _mm_setzero_ps()), _mm_set1_ps(-0.0f));
+		const __m128 q = Lerp(a, _mm_xor_ps(b, flip), t);
+		return _mm_div_ps(q, _mm_sqrt_ps(Dot(q, q)));
+	}
+#else
+	void LoadRotation(const int16_t* key, float* q) {
+		for (uint32_t c = 0; c < 4; ++c) {
+			q[c] = static_cast<float>(key[c]) * RotationDequantize;
+		}
+	}
+
+	void LoadTranslation(const uint16_t* key, const float* minimum, const float* scale, float* t) {
+		for (uint32_t c = 0; c < 4; ++c) {
+			t[c] = minimum[c] + static_cast<float>(key[c]) * scale[c];
+		}
+	}
+
+	void Lerp(const float* a, const float* b, float t, float* result) {
+		for (uint32_t c = 0; c < 4; ++c) {
+			result[c] = a[c] + (b[c] - a[c]) * t;
+		}
+	}
+
+	void Nlerp(const float* a, const float* b, float t, float* result) {
+		const float sign = (a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3] < 0.0f) ? -1.0f : 1.0f;
+		for (uint32_t c = 0; c < 4; ++c) {
+			result[c] = a[c] + (sign * b[c] - a[c]) * t;
+		}
+		const float length = std::sqrt(result[0] * result[0] + result[1] * result[1] + result[2] * result[2] + result[3] * result[3]);
+		if (length > 0.0f) {
+			for (uint32_t c = 0; c < 4; ++c) {
+				result[c] /= length;
+			}
+		}
+	}
+#endif
+
+	// Blends the second pose into the first, rotations and translations four floats per joint
+	void BlendPoses(float* rotations, float* translations, const float* otherRotations, const float* otherTranslations, float weight, uint32_t jointCount) {
+#if defined(SKELETAL_ANIMATION_SSE2)
+		const __m128 t = _mm_set1_ps(weight);
+		for (uint32_t i = 0; i < 4 * jointCount; i += 4) {
+			_mm_storeu_ps(&rotations[i], Nlerp(_mm_loadu_ps(&rotations[i]), _mm_loadu_ps(&otherRotations[i]), t));
+			_mm_storeu_ps(&translations[i], Lerp(_mm_loadu_ps(&translations[i]), _mm_loadu_ps(&otherTranslations[i]), t));
+		}
+#else
+		for (uint32_t i = 0; i < 4 * jointCount; i += 4) {
+			Nlerp(&rotations[i], &otherRotations[i], weight, &rotations[i]);
+			Lerp(&translations[i], &otherTranslations[i], weight, &translations[i]);
+		}
+#endif
+	}
+}
+
+bool CompressClip(const std::vector<float>& rotations, const std::vector<float>& translations, uint32_t jointCount, uint32_t frameCount,
+	float duration, AnimationClip& clip) {
+	const size_t keyCount = static_cast<size_t>(jointCount) * frameCount;
+	if ((jointCount == 0) || (frameCount == 0) || !(duration > 0.0f) || (rotations.size() != 4 * keyCount) || (translations.size() != 3 * keyCount)) {
+		std::cout << "COULD NOT COMPRESS ANIMATION CLIP OF " << jointCount << " JOINTS AND " << frameCount << " FRAMES " << std::endl;
+		return false;
+	}
+
+	clip.duration = duration;
+	clip.frameCount = frameCount;
+	clip.tracks.assign(jointCount, AnimationTrack());
+	clip.rotations.clear();
+	clip.translations.clear();
+
+	float minimum[3] = { translations[0], translations[1], translations[2] };
+	float maximum[3] = { minimum[0], minimum[1], minimum[2] };
+	for (size_t i = 0; i < keyCount; ++i) {
+		for (uint32_t axis = 0; axis < 3; ++axis) {
+			minimum[axis] = std::min(minimum[axis], translations[3 * i + axis]);
+			maximum[axis] = std::max(maximum[axis], translations[3 * i + axis]);
+		}
+	}
+	for (uint32_t axis = 0; axis < 3; ++axis) {
+		clip.translationMin[axis] = minimum[axis];
+		clip.translationScale[axis] = (maximum[axis] - minimum[axis]) / 65535.0f;
+	}
+	clip.translationMin[3] = 0.0f;
+	clip.translationScale[3] = 0.0f;
+
+	for (uint32_t joint = 0; joint < jointCount; ++joint) {
+		AnimationTrack& track = clip.tracks[joint];
+		track.rotationOffset = static_cast<uint32_t>(clip.rotations.size() / 4);
+		track.rotationCount = IsConstantTrack(rotations, 4, joint, jointCount, frameCount, 4) ? 1 : frameCount;
+		for (uint32_t frame = 0; frame < track.rotationCount; ++frame) {
+			const float* q = &rotations[4 * (static_cast<size_t>(frame) * jointCount + joint)];
+			const float length = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+			for (uint32_t c = 0; c < 4; ++c) {
+				const float value = (length > 0.0f) ? q[c] / length : ((c == 3) ? 1.0f : 0.0f);
+				clip.rotations.push_back(static_cast<int16_t>(std::lround(std::max(-1.0f, std::min(value, 1.0f)) * 32767.0f)));
+			}
+		}
+
+		track.translationOffset = static_cast<uint32_t>(clip.translations.size() / 4);
+		track.translationCount = IsConstantTrack(translations, 3, joint, jointCount, frameCount, 3) ? 1 : frameCount;
+		for (uint32_t frame = 0; frame < track.translationCount; ++frame) {
+			const float* t = &translations[3 * (static_cast<size_t>(frame) * jointCount + joint)];
+			for (uint32_t axis = 0; axis < 3; ++axis) {
+				const float steps = (clip.translationScale[axis] > 0.0f) ? (t[axis] - minimum[axis]) / clip.translationScale[axis] : 0.0f;
+				clip.translations.push_back(static_cast<uint16_t>(std::lround(std::max(0.0f, std::min(steps, 65535.0f)))));
+			}
+			clip.translations.push_back(0);
+		}
+	}
+	return true;
+}
+
+SkinnedCrowd::SkinnedCrowd(const DeviceContext& device) :
+	Device(device),
+	Dispatch(*device.dispatch),
+	SkinPipeline(device),
+	DrawPipeline(device),
+	CrowdSkeleton(),
+	Clips(),
+	Characters(),
+	MaxCharacters(0),
+	ThreadCount(1),
+	VertexCount(0),
+	IndexCount(0),
+	BindVertices(),
+	Indices(),
+	Palettes(),
+	SkinnedVertices(),
+	SkinSet(VK_NULL_HANDLE),
+	DrawSet(VK_NULL_HANDLE),
+	Camera(),
+	Parameters() {
+}
+
+SkinnedCrowd::~SkinnedCrowd() {
+	Destroy();
+}
+
+bool SkinnedCrowd::Create(const Skeleton& skeleton, const std::vector<AnimationClip>& clips, const SkinnedMesh& mesh, uint32_t maxCharacters,
+	VkRenderPass renderPass, VkSampleCountFlagBits samples, uint32_t threadCount) {
+	Destroy();
+	const uint32_t jointCount = static_cast<uint32_t>(skeleton.parents.size());
+	if ((jointCount == 0) || (jointCount > 256) || (skeleton.inverseBind.size() != 12 * static_cast<size_t>(jointCount))) {
+		std::cout << "SKELETON OF " << jointCount << " JOINTS CAN NOT BE SKINNED " << std::endl;
+		return false;
+	}
+	for (uint32_t joint = 0; joint < jointCount; ++joint) {
+		if (skeleton.parents[joint] >= static_cast<int32_t>(joint)) {
+			std::cout << "PARENT OF JOINT " << joint << " DOES NOT COME BEFORE IT " << std::endl;
+			return false;
+		}
+	}
+	if (clips.empty()) {
+		std::cout << "CROWD HAS NO ANIMATION CLIPS " << std::endl;
+		return false;
+	}
+	for (const AnimationClip& clip : clips) {
+		if ((clip.tracks.size() != jointCount) || (clip.frameCount == 0) || !(clip.duration > 0.0f)) {
+			std::cout << "ANIMATION CLIP DOES NOT MATCH THE SKELETON " << std::endl;
+			return false;
+		}
+	}
+	const size_t vertexCount = mesh.positions.size() / 3;
+	if ((vertexCount == 0) || (mesh.joints.size() != vertexCount) || (mesh.weights.size() != vertexCount) || mesh.indices.empty()) {
+		std::cout << "SKINNED MESH NEEDS JOINTS AND WEIGHTS FOR EVERY VERTEX " << std::endl;
+		return false;
+	}
+	for (uint32_t joints : mesh.joints) {
+		for (uint32_t i = 0; i < 4; ++i) {
+			if (((joints >> (8 * i)) & 0xFF) >= jointCount) {
+				std::cout << "SKINNED MESH JOINT " << ((joints >> (8 * i)) & 0xFF) << " IS OUT OF RANGE " << std::endl;
+				return false;
+			}
+		}
+	}
+
+	CrowdSkeleton = skeleton;
+	Clips = clips;
+	MaxCharacters = std::max<uint32_t>(maxCharacters, 1);
+	ThreadCount = (threadCount > 0) ? threadCount : std::max<uint32_t>(std::thread::hardware_concurrency(), 1);
+	VertexCount = static_cast<uint32_t>(vertexCount);
+	IndexCount = static_cast<uint32_t>(mesh.indices.size());
+	Parameters.vertexCount = VertexCount;
+
+	const VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	const VkDeviceSize paletteSize = static_cast<VkDeviceSize>(MaxCharacters) * jointCount * 12 * sizeof(float);
+	const VkDeviceSize skinnedSize = static_cast<VkDeviceSize>(MaxCharacters) * VertexCount * 4 * sizeof(float);
+	if (!CreateGpuBuffer(Device, vertexCount * sizeof(BindVertex), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, BindVertices)
+		|| !CreateGpuBuffer(Device, mesh.indices.size() * sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT, hostVisible, Indices)
+		|| !CreateGpuBuffer(Device, paletteSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, Palettes)
+		|| !CreateGpuBuffer(Device, skinnedSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, SkinnedVertices)) {
+		return false;
+	}
+	BindVertex* bindVertices = static_cast<BindVertex*>(BindVertices.mapped);
+	for (size_t v = 0; v < vertexCount; ++v) {
+		BindVertex vertex = {};
+		memcpy(vertex.position, &mesh.positions[3 * v], sizeof(vertex.position));
+		vertex.joints = mesh.joints[v];
+		vertex.weights = mesh.weights[v];
+		bindVertices[v] = vertex;
+	}
+	memcpy(Indices.mapped, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+
+	GraphicsPipelineState state;
+	state.renderPass = renderPass;
+	state.samples = samples;
+	state.cullMode = VK_CULL_MODE_BACK_BIT;
+	state.depthTest = true;
+	state.depthWrite = true;
+
+	const std::vector<VkDescriptorType> skinBindings = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER };
+	if (!SkinPipeline.Create(SkinShader, "crowd_skin.comp", skinBindings, sizeof(SkinConstants), 1, SkinGroupSize)
+		|| !DrawPipeline.Create(DrawVertexShader, DrawFragmentShader, "crowd_draw", { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER }, sizeof(DrawConstants), 1, state)
+		|| !SkinPipeline.AllocateDescriptorSet(SkinSet)
+		|| !DrawPipeline.AllocateDescriptorSet(DrawSet)) {
+		return false;
+	}
+	SkinPipeline.WriteBuffer(SkinSet, 0, BindVertices.handle);
+	SkinPipeline.WriteBuffer(SkinSet, 1, Palettes.handle);
+	SkinPipeline.WriteBuffer(SkinSet, 2, SkinnedVertices.handle);
+	DrawPipeline.WriteBuffer(DrawSet, 0, SkinnedVertices.handle);
+	return true;
+}
+
+void SkinnedCrowd::Destroy() {
+	if (Dispatch.device == VK_NULL_HANDLE) {
+		return;
+	}
+
+	SkinPipeline.Destroy();
+	DrawPipeline.Destroy();
+	SkinSet = VK_NULL_HANDLE;
+	DrawSet = VK_NULL_HANDLE;
+	DestroyGpuBuffer(Device, BindVertices);
+	DestroyGpuBuffer(Device, Indices);
+	DestroyGpuBuffer(Device, Palettes);
+	DestroyGpuBuffer(Device, SkinnedVertices);
+	Characters.clear();
+}
+
+bool SkinnedCrowd::SetCharacters(const std::vector<CrowdCharacter>& characters) {
+	if (characters.size() > MaxCharacters) {
+		std::cout << "CROWD WAS CREATED FOR AT MOST " << MaxCharacters << " CHARACTERS " << std::endl;
+		return false;
+	}
+	for (const CrowdCharacter& character : characters) {
+		if ((character.clips[0] >= Clips.size()) || (character.clips[1] >= Clips.size())) {
+			std::cout << "CROWD CHARACTER PLAYS A CLIP WHICH DOES NOT EXIST " << std::endl;
+			return false;
+		}
+	}
+	Characters = characters;
+	return true;
+}
+
+void SkinnedCrowd::Update(float time) {
+	const uint32_t count = static_cast<uint32_t>(Characters.size());
+	const uint32_t threadCount = std::min(ThreadCount, (count + MinThreadCharacters - 1) / MinThreadCharacters);
+	if (threadCount <= 1) {
+		PoseCharacters(0, count, time);
+		return;
+	}
+
+	// Every thread writes its own characters' palettes, so they never touch the same memory
+	const uint32_t perThread = (count + threadCount - 1) / threadCount;
+	std::vector<std::thread> threads;
+	for (uint32_t first = 0; first < count; first += perThread) {
+		const uint32_t end = std::min(first + perThread, count);
+		threads.emplace_back([this, first, end, time]() {
+			PoseCharacters(first, end, time);
+		});
+	}
+	for (std::thread& thread : threads) {
+		thread.join();
+	}
+}
+
+void SkinnedCrowd::SetCamera(const SceneCamera& camera) {
+	Camera = camera;
+}
+
+void SkinnedCrowd::CmdSkin(VkCommandBuffer commandBuffer, VkExtent2D extent) {
+	const float aspect = static_cast<float>(extent.width) / static_cast<float>(std::max<uint32_t>(extent.height, 1));
+	GetCameraViewProjection(Camera, aspect, Parameters.viewProjection);
+
+	// Skinned vertices were read by the last frame's draws
+	VkMemoryBarrier memoryBarrier = {};
+	memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryBarrier.pNext = nullptr;
+	memoryBarrier.srcAccessMask = 0;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+	SkinConstants constants = {};
+	constants.characterCount = static_cast<uint32_t>(Characters.size());
+	constants.vertexCount = VertexCount;
+	constants.jointCount = static_cast<uint32_t>(CrowdSkeleton.parents.size());
+	SkinPipeline.CmdBind(commandBuffer, SkinSet);
+	SkinPipeline.CmdPushConstants(commandBuffer, &constants, sizeof(constants));
+	SkinPipeline.CmdDispatch(commandBuffer, std::max<uint32_t>(constants.characterCount * VertexCount, 1));
+
+	memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+}
+
+void SkinnedCrowd::CmdPrePass(VkCommandBuffer commandBuffer, const OffscreenFrame& frame) {
+	CmdSkin(commandBuffer, frame.extent);
+}
+
+void SkinnedCrowd::CmdDraw(VkCommandBuffer commandBuffer, const OffscreenFrame& /*frame*/) const {
+	if (Characters.empty()) {
+		return;
+	}
+	DrawPipeline.CmdBind(commandBuffer, DrawSet);
+	DrawPipeline.CmdPushConstants(commandBuffer, &Parameters, sizeof(DrawConstants));
+	Dispatch.vkCmdBindIndexBuffer(commandBuffer, Indices.handle, 0, VK_INDEX_TYPE_UINT32);
+	Dispatch.vkCmdDrawIndexed(commandBuffer, IndexCount, static_cast<uint32_t>(Characters.size()), 0, 0, 0);
+}
+
+VkBuffer SkinnedCrowd::GetSkinnedVertices() const {
+	return SkinnedVertices.handle;
+}
+
+VkBuffer SkinnedCrowd::GetIndices() const {
+	return Indices.handle;
+}
+
+uint32_t SkinnedCrowd::GetVertexCount() const {
+	return VertexCount;
+}
+
+uint32_t SkinnedCrowd::GetIndexCount() const {
+	return IndexCount;
+}
+
+uint32_t SkinnedCrowd::GetCharacterCount() const {
+	return static_cast<uint32_t>(Characters.size());
+}
+
+void SkinnedCrowd::PoseCharacters(uint32_t first, uint32_t end, float time) {
+	const uint32_t jointCount = static_cast<uint32_t>(CrowdSkeleton.parents.size());
+	std::vector<float> rotations(4 * jointCount);
+	std::vector<float> translations(4 * jointCount);
+	std::vector<float> otherRotations(4 * jointCount);
+	std::vector<float> otherTranslations(4 * jointCount);
+	std::vector<float> model(12 * jointCount);
+	float* palettes = static_cast<float*>(Palettes.mapped);
+
+	for (uint32_t c = first; c < end; ++c) {
+		const CrowdCharacter& character = Characters[c];
+		const float clipTime = time * character.speed + character.timeOffset;
+		SamplePose(Clips[character.clips[0]], clipTime, rotations.data(), translations.data());
+		if (character.blend > 0.0f) {
+			SamplePose(Clips[character.clips[1]], clipTime, otherRotations.data(), otherTranslations.data());
+			BlendPoses(rotations.data(), translations.data(), otherRotations.data(), otherTranslations.data(), std::min(character.blend, 1.0f), jointCount);
+		}
+
+		// Roots are placed in the world by the character's heading and position
+		const float cosine = std::cos(character.heading);
+		const float sine = std::sin(character.heading);
+		const float placement[12] = {
+			cosine, 0.0f, sine, character.position[0],
+			0.0f, 1.0f, 0.0f, character.position[1],
+			-sine, 0.0f, cosine, character.position[2]
+		};
+
+		float* palette = palettes + static_cast<size_t>(c) * jointCount * 12;
+		for (uint32_t joint = 0; joint < jointCount; ++joint) {
+			float local[12];
+			ToTransform(&rotations[4 * joint], &translations[4 * joint], local);
+			const int32_t parent = CrowdSkeleton.parents[joint];
+			MultiplyTransforms((parent < 0) ? placement : &model[12 * parent], local, &model[12 * joint]);
+			MultiplyTransforms(&model[12 * joint], &CrowdSkeleton.inverseBind[12 * joint], &palette[12 * joint]);
+		}
+	}
+}
+
+void SkinnedCrowd::SamplePose(const AnimationClip& clip, float time, float* rotations, float* translations) const {
+	float clipTime = std::fmod(time, clip.duration);
+	if (clipTime < 0.0f) {
+		clipTime += clip.duration;
+	}
+	const float position = clipTime / clip.duration * static_cast<float>(clip.frameCount);
+	const uint32_t frame = std::min(static_cast<uint32_t>(position), clip.frameCount - 1);
+	const uint32_t next = (frame + 1) % clip.frameCount;
+	const float alpha = position - static_cast<float>(frame);
+	const uint32_t jointCount = static_cast<uint32_t>(clip.tracks.size());
+
+#if defined(SKELETAL_ANIMATION_SSE2)
+	const __m128 t = _mm_set1_ps(alpha);
+	const __m128 minimum = _mm_loadu_ps(clip.translationMin);
+	const __m128 scale = _mm_loadu_ps(clip.translationScale);
+	for (uint32_t joint = 0; joint < jointCount; ++joint) {
+		const AnimationTrack& track = clip.tracks[joint];
+		const int16_t* rotation0 = &clip.rotations[4 * (track.rotationOffset + std::min(frame, track.rotationCount - 1))];
+		const int16_t* rotation1 = &clip.rotations[4 * (track.rotationOffset + std::min(next, track.rotationCount - 1))];
+		const uint16_t* translation0 = &clip.translations[4 * (track.translationOffset + std::min(frame, track.translationCount - 1))];
+		const uint16_t* translation1 = &clip.translations[4 * (track.translationOffset + std::min(next, track.translationCount - 1))];
+		_mm_storeu_ps(&rotations[4 * joint], Nlerp(LoadRotation(rotation0), LoadRotation(rotation1), t));
+		_mm_storeu_ps(&translations[4 * joint], Lerp(LoadTranslation(translation0, minimum, scale), LoadTranslation(translation1, minimum, scale), t));
+	}
+#else
+	for (uint32_t joint = 0; joint < jointCount; ++joint) {
+		const AnimationTrack& track = clip.tracks[joint];
+		float a[4], b[4];
+		LoadRotation(&clip.rotations[4 * (track.rotationOffset + std::min(frame, track.rotationCount - 1))], a);
+		LoadRotation(&clip.rotations[4 * (track.rotationOffset + std::min(next, track.rotationCount - 1))], b);
+		Nlerp(a, b, alpha, &rotations[4 * joint]);
+		LoadTranslation(&clip.translations[4 * (track.translationOffset + std::min(frame, track.translationCount - 1))], clip.translationMin, clip.translationScale, a);
+		LoadTranslation(&clip.translations[4 * (track.translationOffset + std::min(next, track.translationCount - 1))], clip.translationMin, clip.translationScale, b);
+		Lerp(a, b, alpha, &translations[4 * joint]);
+	}
+#endif
+}
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "ComputePipeline.h"
+#include "GraphicsPipeline.h"
+#include "OffscreenRenderer.h"
+#include "SceneCamera.h"
+#include <cstdint>
+#include <vector>
+
+// Joints ordered so every parent comes before its children
+struct Skeleton {
+	std::vector<int32_t> parents;		// -1 for roots
+	std::vector<float> inverseBind;		// 3x4 row major per joint, model space to the joint's bind space
+};
+
+// Keyframes of one joint inside AnimationClip's key arrays. Tracks which don't change over the clip keep a single key.
+struct AnimationTrack {
+	uint32_t rotationOffset;			// In keys
+	uint32_t rotationCount;				// 1 or the clip's frame count
+	uint32_t translationOffset;
+	uint32_t translationCount;
+};
+
+// Looping clip with keys at a fixed rate.
+// Rotations are quantized to 16 bit signed components, translations to 16 bits within the clip's bounds.
+struct AnimationClip {
+	float duration;						// Seconds; the last key blends back into the first
+	uint32_t frameCount;
+	std::vector<AnimationTrack> tracks;	// One per joint
+	std::vector<int16_t> rotations;		// xyzw per key
+	std::vector<uint16_t> translations;	// xyz and an unused fourth per key, so a key loads as 64 bits
+	float translationMin[4];
+	float translationScale[4];			// Per step of the quantized value
+
+	AnimationClip() :
+		duration(0.0f),
+		frameCount(0),
+		tracks(),
+		rotations(),
+		translations(),
+		translationMin(),
+		translationScale() {
+	}
+};
+
+// rotations (unit quaternion xyzw) and translations (xyz) hold every joint's local transform for frame 0, then frame 1...
+bool CompressClip(const std::vector<float>& rotations, const std::vector<float>& translations, uint32_t jointCount, uint32_t frameCount,
+	float duration, AnimationClip& clip);
+
+// Bind pose vertices with up to four joints each
+struct SkinnedMesh {
+	std::vector<float> positions;		// xyz per vertex
+	std::vector<uint32_t> joints;		// Four 8 bit joint indices per vertex, first in the low byte
+	std::vector<uint32_t> weights;		// Four 8 bit unorm weights per vertex, in the same order
+	std::vector<uint32_t> indices;
+};
+
+struct CrowdCharacter {
+	float position[3];
+	float heading;						// Radians around y
+	uint32_t clips[2];					// Blended from the first to the second by blend
+	float blend;
+	float timeOffset;					// Seconds into the clips at time 0
+	float speed;						// Playback rate
+
+	CrowdCharacter() :
+		position(),
+		heading(0.0f),
+		clips(),
+		blend(0.0f),
+		timeOffset(0.0f),
+		speed(1.0f) {
+	}
+};
+
+// Many characters sharing one skeleton, skinned mesh and set of clips.
+// Update() samples both clips of every character, blends them and turns the pose into a palette of skinning matrices,
+// splitting the characters over worker threads; keys are decoded and interpolated four components at a time with SSE2
+// where the compiler targets it. Palettes are written straight into mapped memory. CmdSkin() then skins every
+// character's vertices into one buffer of world space positions in a compute pass, so any number of passes (shadows,
+// depth pre-pass, shading) can draw the skinned result without skinning again.
+// Drawn in the first subpass of render passes compatible with the given one.
+class SkinnedCrowd : public OffscreenDrawable {
+public:
+	// Context's dispatch table must outlive the crowd
+	explicit SkinnedCrowd(const DeviceContext& device);
+	~SkinnedCrowd();
+
+	SkinnedCrowd(const SkinnedCrowd&) = delete;
+	SkinnedCrowd& operator=(const SkinnedCrowd&) = delete;
+
+	// threadCount 0 uses one per hardware thread
+	bool Create(const Skeleton& skeleton, const std::vector<AnimationClip>& clips, const SkinnedMesh& mesh, uint32_t maxCharacters,
+		VkRenderPass renderPass, VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT, uint32_t threadCount = 0);
+	void Destroy();
+
+	bool SetCharacters(const std::vector<CrowdCharacter>& characters);
+	// Poses every character at time seconds. No frame using the previous palettes may still be executing.
+	void Update(float time);
+	void SetCamera(const SceneCamera& camera);
+
+	// Outside a render pass. Results are visible to vertex shaders afterwards.
+	void CmdSkin(VkCommandBuffer commandBuffer, VkExtent2D extent);
+
+	// Skins before the render pass, then draws the characters in it
+	void CmdPrePass(VkCommandBuffer commandBuffer, const OffscreenFrame& frame) override;
+	void CmdDraw(VkCommandBuffer commandBuffer, const OffscreenFrame& frame) const override;
+
+	// World space xyzw, the mesh's vertex count per character in character order
+	VkBuffer GetSkinnedVertices() const;
+	// uint32_t indices of the mesh into one character's skinned vertices
+	VkBuffer GetIndices() const;
+	uint32_t GetVertexCount() const;
+	uint32_t GetIndexCount() const;
+	uint32_t GetCharacterCount() const;
+
+private:
+	void PoseCharacters(uint32_t first, uint32_t end, float time);
+	void SamplePose(const AnimationClip& clip, float time, float* rotations, float* translations) const;
+
+	// Push constants of the drawing shaders
+	struct DrawConstants {
+		float viewProjection[16];
+		uint32_t vertexCount;
+		uint32_t padding[3];
+	};
+
+	DeviceContext Device;
+	const DeviceDispatchTable& Dispatch;
+	ComputePipeline SkinPipeline;
+	GraphicsPipeline DrawPipeline;
+
+	Skeleton CrowdSkeleton;
+	std::vector<AnimationClip> Clips;
+	std::vector<CrowdCharacter> Characters;
+	uint32_t MaxCharacters;
+	uint32_t ThreadCount;
+	uint32_t VertexCount;
+	uint32_t IndexCount;
+
+	GpuBuffer BindVertices;						// Position xyz, joints and weights per vertex
+	GpuBuffer Indices;
+	GpuBuffer Palettes;							// Host visible, 3x4 per joint per character
+	GpuBuffer SkinnedVertices;
+	VkDescriptorSet SkinSet;
+	VkDescriptorSet DrawSet;
+
+	SceneCamera Camera;
+	DrawConstants Parameters;
+};
@@ -0,0 +1,67 @@
+#include "StartupProfiler.h"
+#include <algorithm>
+#include <iomanip>
+
+StartupProfiler::StartupProfiler() :
+	Origin(std::chrono::steady_clock::now()),
+	Mutex(),
+	Stages(),
+	Threads() {
+}
+
+void StartupProfiler::Record(const std::string& name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	const std::thread::id id = std::this_thread::get_id();
+	auto thread = std::find(Threads.begin(), Threads.end(), id);
+	if (thread == Threads.end()) {
+		thread = Threads.insert(Threads.end(), id);
+	}
+
+	Stage stage;
+	stage.name = name;
+	stage.startMs = std::chrono::duration<double, std::milli>(start - Origin).count();
+	stage.durationMs = std::chrono::duration<double, std::milli>(end - start).count();
+	stage.thread = static_cast<uint32_t>(thread - Threads.begin());
+	Stages.push_back(stage);
+}
+
+std::vector<StartupProfiler::Stage> StartupProfiler::GetStages() const {
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	std::vector<Stage> stages = Stages;
+	std::stable_sort(stages.begin(), stages.end(), [](const Stage& a, const Stage& b) {
+		return a.startMs < b.startMs;
+	});
+	return stages;
+}
+
+double StartupProfiler::GetWallTimeMs() const {
+	std::lock_guard<std::mutex> lock(Mutex);
+
+	double end = 0.0;
+	for (const Stage& stage : Stages) {
+		end = std::max(end, stage.startMs + stage.durationMs);
+	}
+	return end;
+}
+
+void StartupProfiler::Print(std::ostream& stream) const {
+	const std::vector<Stage> stages = GetStages();
+
+	const std::ios::fmtflags flags = stream.flags();
+	const std::streamsize precision = stream.precision();
+
+	double sum = 0.0;
+	stream << "Startup breakdown (ms)" << std::endl;
+	stream << std::fixed << std::setprecision(2);
+	for (const Stage& stage : stages) {
+		stream << "  " << std::left << std::setw(28) << stage.name << std::right
+			<< std::setw(9) << stage.startMs << " +" << std::setw(9) << stage.durationMs
+			<< "  thread " << stage.thread << std::endl;
+		sum += stage.durationMs;
+	}
+	stream << "  wall time " << GetWallTimeMs() << ", sum of stages " << sum << std::endl;
+	stream.flags(flags);
+	stream.precision(precision);
+}
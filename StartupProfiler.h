@@ -0,0 +1,56 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Collects how long every stage of the application start took. Stages may run on several threads at once,
+// so the report shows both the wall time and the summed stage time (the difference is what overlapping saved).
+class StartupProfiler {
+public:
+	struct Stage {
+		std::string name;
+		double startMs;			// Relative to the profiler's creation
+		double durationMs;
+		uint32_t thread;		// 0 is the thread which recorded the first stage
+	};
+
+	StartupProfiler();
+
+	void Record(const std::string& name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+	std::vector<Stage> GetStages() const;
+
+	double GetWallTimeMs() const;
+	void Print(std::ostream& stream) const;
+
+private:
+	std::chrono::steady_clock::time_point Origin;
+	mutable std::mutex Mutex;
+	std::vector<Stage> Stages;
+	std::vector<std::thread::id> Threads;
+};
+
+// Records the time from its construction to its destruction as one stage
+class StartupStage {
+public:
+	StartupStage(StartupProfiler& profiler, const char* name) :
+		Profiler(profiler),
+		Name(name),
+		Start(std::chrono::steady_clock::now()) {
+	}
+
+	~StartupStage() {
+		Profiler.Record(Name, Start, std::chrono::steady_clock::now());
+	}
+
+	StartupStage(const StartupStage&) = delete;
+	StartupStage& operator=(const StartupStage&) = delete;
+
+private:
+	StartupProfiler& Profiler;
+	const char* Name;
+	std::chrono::steady_clock::time_point Start;
+};
@@ -0,0 +1,561 @@
+#include "TemporalUpscaling.h"
+#include "OffscreenRenderer.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+namespace {
+	const uint32_t ResolveGroupSize = 8;
+	const VkFormat MotionFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+	const VkFormat OutputFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+
+	// Jitter repeats after this many frames
+	const uint32_t JitterPhases = 8;
+
+	float Halton(uint32_t index, uint32_t base) {
+		float result = 0.0f;
+		float fraction = 1.0f;
+		while (index > 0) {
+			fraction /= static_cast<float>(base);
+			result += fraction * static_cast<float>(index % base);
+			index /= base;
+		}
+		return result;
+	}
+
+	const char* FrameHeader = R"(#version 450
+
+layout(set = 0, binding = 0) uniform Frame {
+	mat4 viewProjection;
+	mat4 currentViewProjection;
+	mat4 previousViewProjection;
+	mat4 reprojection;
+	vec4 jitter;
+	vec4 renderSize;
+	vec4 outputSize;
+};
+)";
+
+	const char* MotionVertexShader = R"(
+struct MotionBox {
+	vec4 center;
+	vec4 halfExtent;
+	vec4 previousCenter;
+};
+
+layout(set = 0, binding = 1) readonly buffer MotionBoxes {
+	MotionBox boxes[];
+};
+
+layout(location = 0) out vec4 CurrentClip;
+layout(location = 1) out vec4 PreviousClip;
+
+// Two triangles per face of the unit cube, corners numbered by their x, y and z bits
+const uint Corners[36] = uint[36](
+	0u, 2u, 1u, 1u, 2u, 3u,  4u, 5u, 6u, 5u, 7u, 6u,
+	0u, 1u, 4u, 1u, 5u, 4u,  2u, 6u, 3u, 3u, 6u, 7u,
+	0u, 4u, 2u, 2u, 4u, 6u,  1u, 3u, 5u, 3u, 7u, 5u);
+
+void main() {
+	const MotionBox box = boxes[gl_InstanceIndex];
+	const uint corner = Corners[gl_VertexIndex];
+	const vec3 offset = (vec3(corner & 1u, (corner >> 1) & 1u, (corner >> 2) & 1u) * 2.0 - 1.0) * box.halfExtent.xyz;
+	gl_Position = viewProjection * vec4(box.center.xyz + offset, 1.0);
+	CurrentClip = currentViewProjection * vec4(box.center.xyz + offset, 1.0);
+	PreviousClip = previousViewProjection * vec4(box.previousCenter.xyz + offset, 1.0);
+}
+)";
+
+	const char* MotionFragmentShader = R"(#version 450
+
+layout(location = 0) in vec4 CurrentClip;
+layout(location = 1) in vec4 PreviousClip;
+
+layout(location = 0) out vec4 Motion;
+
+void main() {
+	const vec2 current = CurrentClip.xy / CurrentClip.w * 0.5 + 0.5;
+	const vec2 previous = PreviousClip.xy / PreviousClip.w * 0.5 + 0.5;
+	// z marks pixels with motion of their own, the others only move with the camera
+	Motion = vec4(previous - current, 1.0, 0.0);
+}
+)";
+
+	const char* ResolveShader = R"(
+layout(local_size_x_id = 0, local_size_y_id = 1) in;
+
+layout(set = 0, binding = 1) uniform sampler2D color;
+layout(set = 0, binding = 2) uniform sampler2D depth;
+layout(set = 0, binding = 3) uniform sampler2D motion;
+layout(set = 0, binding = 4) uniform sampler2D history;
+layout(set = 0, binding = 5, rgba16f) uniform writeonly image2D resolved;
+
+vec3 ToYCoCg(vec3 rgb) {
+	return vec3(dot(rgb, vec3(0.25, 0.5, 0.25)), dot(rgb, vec3(0.5, 0.0, -0.5)), dot(rgb, vec3(-0.25, 0.5, -0.25)));
+}
+
+vec3 FromYCoCg(vec3 yCoCg) {
+	return vec3(yCoCg.x + yCoCg.y - yCoCg.z, yCoCg.x + yCoCg.z, yCoCg.x - yCoCg.y - yCoCg.z);
+}
+
+void main() {
+	const ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	if (any(greaterThanEqual(pixel, ivec2(outputSize.xy)))) {
+		return;
+	}
+	const vec2 uv = (vec2(pixel) + 0.5) * outputSize.zw;
+
+	// The jittered projection moved the whole image by +jitter render pixels, so this point of the scene landed there
+	const vec2 unjittered = uv + jitter.xy * renderSize.zw;
+	const ivec2 lastTexel = ivec2(renderSize.xy) - 1;
+	const ivec2 center = clamp(ivec2(unjittered * renderSize.xy), ivec2(0), lastTexel);
+
+	// Neighborhood the history is clamped to, and its nearest surface (largest reversed depth)
+	vec3 minimum = vec3(1.0e9);
+	vec3 maximum = vec3(-1.0e9);
+	float nearest = -1.0;
+	ivec2 nearestTexel = center;
+	for (int y = -1; y <= 1; ++y) {
+		for (int x = -1; x <= 1; ++x) {
+			const ivec2 texel = clamp(center + ivec2(x, y), ivec2(0), lastTexel);
+			const vec3 neighbor = ToYCoCg(texelFetch(color, texel, 0).rgb);
+			minimum = min(minimum, neighbor);
+			maximum = max(maximum, neighbor);
+			const float neighborDepth = texelFetch(depth, texel, 0).r;
+			if (neighborDepth > nearest) {
+				nearest = neighborDepth;
+				nearestTexel = texel;
+			}
+		}
+	}
+	const vec3 current = texture(color, unjittered).rgb;
+
+	// Nearest surface's motion, so the edges of moving objects move with them
+	const vec4 objectMotion = texelFetch(motion, nearestTexel, 0);
+	vec2 previousUv;
+	if (objectMotion.z > 0.5) {
+		previousUv = uv + objectMotion.xy;
+	} else {
+		const vec4 previousClip = reprojection * vec4(uv * 2.0 - 1.0, nearest, 1.0);
+		previousUv = previousClip.xy / previousClip.w * 0.5 + 0.5;
+	}
+
+	vec3 result = current;
+	if ((jitter.w > 0.5) && all(greaterThanEqual(previousUv, vec2(0.0))) && all(lessThanEqual(previousUv, vec2(1.0)))) {
+		const vec3 previous = FromYCoCg(clamp(ToYCoCg(texture(history, previousUv).rgb), minimum, maximum));
+		result = mix(previous, current, jitter.z);
+	}
+	imageStore(resolved, pixel, vec4(result, 1.0));
+}
+)";
+}
+
+TemporalUpscaler::TemporalUpscaler(const DeviceContext& device) :
+	Device(device),
+	Dispatch(*device.dispatch),
+	MotionPipeline(device),
+	ResolvePipeline(device),
+	Settings(),
+	Color(VK_NULL_HANDLE),
+	RenderExtent(),
+	Motion(),
+	MotionRenderPass(VK_NULL_HANDLE),
+	MotionFramebuffer(VK_NULL_HANDLE),
+	Outputs(),
+	Display(),
+	Sampler(VK_NULL_HANDLE),
+	MotionBoxes(),
+	Uniforms(),
+	MotionSet(VK_NULL_HANDLE),
+	ResolveSets(),
+	MotionBoxCount(0),
+	FrameIndex(0),
+	Current(0),
+	HistoryValid(false),
+	OutputsInitialized(false),
+	Parameters() {
+}
+
+TemporalUpscaler::~TemporalUpscaler() {
+	Destroy();
+}
+
+bool TemporalUpscaler::Create(const TemporalSettings& settings, const OffscreenRenderer& renderer) {
+	Destroy();
+	Settings = settings;
+	Settings.maxMotionBoxes = std::max<uint32_t>(Settings.maxMotionBoxes, 1);
+	Color = renderer.GetImage();
+	RenderExtent = renderer.GetExtent();
+	if (renderer.GetDepthView() == VK_NULL_HANDLE) {
+		std::cout << "TEMPORAL UPSCALING NEEDS A SINGLE SAMPLED RENDERER " << std::endl;
+		return false;
+	}
+
+	if (!CreateGpuImage(Device, MotionFormat, RenderExtent, 1, 1, VK_SAMPLE_COUNT_1_BIT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, Motion)
+		|| !CreateMotionPass(renderer.GetDepthView(), renderer.GetDepthFormat())) {
+		return false;
+	}
+	for (GpuImage& output : Outputs) {
+		if (!CreateGpuImage(Device, OutputFormat, Settings.outputExtent, 1, 1, VK_SAMPLE_COUNT_1_BIT,
+			VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, output)) {
+			return false;
+		}
+	}
+	if (!CreateGpuImage(Device, renderer.GetFormat(), Settings.outputExtent, 1, 1, VK_SAMPLE_COUNT_1_BIT,
+		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, Display)) {
+		return false;
+	}
+
+	VkSamplerCreateInfo samplerCreateInfo = {};
+	samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerCreateInfo.pNext = nullptr;
+	samplerCreateInfo.flags = 0;
+	samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
+	samplerCreateInfo.minFilter = VK_FILTER_LINEAR;
+	samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerCreateInfo.mipLodBias = 0.0f;
+	samplerCreateInfo.anisotropyEnable = VK_FALSE;
+	samplerCreateInfo.maxAnisotropy = 1.0f;
+	samplerCreateInfo.compareEnable = VK_FALSE;
+	samplerCreateInfo.compareOp = VK_COMPARE_OP_ALWAYS;
+	samplerCreateInfo.minLod = 0.0f;
+	samplerCreateInfo.maxLod = 0.0f;
+	samplerCreateInfo.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+	samplerCreateInfo.unnormalizedCoordinates = VK_FALSE;
+
+	if (Dispatch.vkCreateSampler(Dispatch.device, &samplerCreateInfo, nullptr, &Sampler) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE TEMPORAL UPSCALING SAMPLER " << std::endl;
+		return false;
+	}
+
+	const VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	if (!CreateGpuBuffer(Device, Settings.maxMotionBoxes * sizeof(TemporalMotionBox), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible, MotionBoxes)
+		|| !CreateGpuBuffer(Device, sizeof(Constants), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostVisible, Uniforms)) {
+		return false;
+	}
+
+	// Motion is only drawn where the box is the visible surface; the bias keeps it in front of the scene's own depth
+	GraphicsPipelineState motionState;
+	motionState.renderPass = MotionRenderPass;
+	motionState.depthTest = true;
+	motionState.depthBias = true;
+
+	const std::string header = FrameHeader;
+	if (!MotionPipeline.Create((header + MotionVertexShader).c_str(), MotionFragmentShader, "temporal_motion",
+			{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER }, 0, 1, motionState)
+		|| !ResolvePipeline.Create((header + ResolveShader).c_str(), "temporal_resolve.comp", { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE }, 0, 2, ResolveGroupSize, ResolveGroupSize)
+		|| !MotionPipeline.AllocateDescriptorSet(MotionSet)) {
+		return false;
+	}
+	MotionPipeline.WriteBuffer(MotionSet, 0, Uniforms.handle);
+	MotionPipeline.WriteBuffer(MotionSet, 1, MotionBoxes.handle);
+
+	for (uint32_t i = 0; i < 2; ++i) {
+		if (!ResolvePipeline.AllocateDescriptorSet(ResolveSets[i])) {
+			return false;
+		}
+		ResolvePipeline.WriteBuffer(ResolveSets[i], 0, Uniforms.handle);
+		ResolvePipeline.WriteImage(ResolveSets[i], 1, renderer.GetImageView(), Sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		ResolvePipeline.WriteImage(ResolveSets[i], 2, renderer.GetDepthView(), Sampler, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL);
+		ResolvePipeline.WriteImage(ResolveSets[i], 3, Motion.view, Sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		ResolvePipeline.WriteImage(ResolveSets[i], 4, Outputs[1 - i].view, Sampler, VK_IMAGE_LAYOUT_GENERAL);
+		ResolvePipeline.WriteStorageImage(ResolveSets[i], 5, Outputs[i].view);
+	}
+
+	Parameters.renderSize[0] = static_cast<float>(RenderExtent.width);
+	Parameters.renderSize[1] = static_cast<float>(RenderExtent.height);
+	Parameters.renderSize[2] = 1.0f / Parameters.renderSize[0];
+	Parameters.renderSize[3] = 1.0f / Parameters.renderSize[1];
+	Parameters.outputSize[0] = static_cast<float>(Settings.outputExtent.width);
+	Parameters.outputSize[1] = static_cast<float>(Settings.outputExtent.height);
+	Parameters.outputSize[2] = 1.0f / Parameters.outputSize[0];
+	Parameters.outputSize[3] = 1.0f / Parameters.outputSize[1];
+	Parameters.jitter[2] = Settings.feedback;
+	Reset();
+	return true;
+}
+
+void TemporalUpscaler::Destroy() {
+	if (Dispatch.device == VK_NULL_HANDLE) {
+		return;
+	}
+
+	MotionPipeline.Destroy();
+	ResolvePipeline.Destroy();
+	MotionSet = VK_NULL_HANDLE;
+	ResolveSets[0] = VK_NULL_HANDLE;
+	ResolveSets[1] = VK_NULL_HANDLE;
+	DestroyGpuBuffer(Device, MotionBoxes);
+	DestroyGpuBuffer(Device, Uniforms);
+	MotionBoxCount = 0;
+
+	if (Sampler != VK_NULL_HANDLE) {
+		Dispatch.vkDestroySampler(Dispatch.device, Sampler, nullptr);
+		Sampler = VK_NULL_HANDLE;
+	}
+	if (MotionFramebuffer != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyFramebuffer(Dispatch.device, MotionFramebuffer, nullptr);
+		MotionFramebuffer = VK_NULL_HANDLE;
+	}
+	if (MotionRenderPass != VK_NULL_HANDLE) {
+		Dispatch.vkDestroyRenderPass(Dispatch.device, MotionRenderPass, nullptr);
+		MotionRenderPass = VK_NULL_HANDLE;
+	}
+	for (GpuImage& output : Outputs) {
+		DestroyGpuImage(Device, output);
+	}
+	DestroyGpuImage(Device, Display);
+	DestroyGpuImage(Device, Motion);
+	Color = VK_NULL_HANDLE;
+}
+
+SceneCamera TemporalUpscaler::JitterCamera(const SceneCamera& camera) {
+	const float aspect = static_cast<float>(RenderExtent.width) / static_cast<float>(std::max<uint32_t>(RenderExtent.height, 1));
+
+	// Halton (2, 3) offsets within a render pixel, centered on it
+	const uint32_t phase = static_cast<uint32_t>(FrameIndex % JitterPhases) + 1;
+	Parameters.jitter[0] = Halton(phase, 2) - 0.5f;
+	Parameters.jitter[1] = Halton(phase, 3) - 0.5f;
+	++FrameIndex;
+
+	SceneCamera jittered = camera;
+	jittered.jitter[0] = 2.0f * Parameters.jitter[0] / static_cast<float>(RenderExtent.width);
+	jittered.jitter[1] = 2.0f * Parameters.jitter[1] / static_cast<float>(RenderExtent.height);
+
+	SceneCamera unjittered = camera;
+	unjittered.jitter[0] = 0.0f;
+	unjittered.jitter[1] = 0.0f;
+	memcpy(Parameters.previousViewProjection, Parameters.currentViewProjection, sizeof(Parameters.currentViewProjection));
+	GetCameraViewProjection(unjittered, aspect, Parameters.currentViewProjection);
+	GetCameraViewProjection(jittered, aspect, Parameters.viewProjection);
+	if (!HistoryValid) {
+		memcpy(Parameters.previousViewProjection, Parameters.currentViewProjection, sizeof(Parameters.currentViewProjection));
+	}
+
+	float inverse[16];
+	if (!InvertMatrix(Parameters.currentViewProjection, inverse)) {
+		memcpy(Parameters.reprojection, Parameters.previousViewProjection, sizeof(Parameters.reprojection));
+	} else {
+		MultiplyMatrices(Parameters.previousViewProjection, inverse, Parameters.reprojection);
+	}
+	return jittered;
+}
+
+bool TemporalUpscaler::SetMotionBoxes(const std::vector<TemporalMotionBox>& boxes) {
+	if (boxes.size() > Settings.maxMotionBoxes) {
+		std::cout << "TEMPORAL UPSCALING WAS CREATED FOR AT MOST " << Settings.maxMotionBoxes << " MOTION BOXES " << std::endl;
+		return false;
+	}
+	if (!boxes.empty()) {
+		memcpy(MotionBoxes.mapped, boxes.data(), boxes.size() * sizeof(TemporalMotionBox));
+	}
+	MotionBoxCount = static_cast<uint32_t>(boxes.size());
+	return true;
+}
+
+void TemporalUpscaler::Reset() {
+	HistoryValid = false;
+}
+
+void TemporalUpscaler::CmdPostPass(VkCommandBuffer commandBuffer, const OffscreenFrame& /*frame*/) {
+	CmdResolve(commandBuffer);
+}
+
+void TemporalUpscaler::CmdResolve(VkCommandBuffer commandBuffer) {
+	Parameters.jitter[3] = HistoryValid ? 1.0f : 0.0f;
+	memcpy(Uniforms.mapped, &Parameters, sizeof(Constants));
+
+	// Renderer's image is sampled here and handed back ready for copies
+	VkImageMemoryBarrier imageMemoryBarriers[3] = {};
+	imageMemoryBarriers[0].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageMemoryBarriers[0].pNext = nullptr;
+	imageMemoryBarriers[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	imageMemoryBarriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	imageMemoryBarriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	imageMemoryBarriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageMemoryBarriers[0].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarriers[0].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	imageMemoryBarriers[0].image = Color;
+	imageMemoryBarriers[0].subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	// Output being written was last read as history by the previous frame; both start out undefined
+	imageMemoryBarriers[1] = imageMemoryBarriers[0];
+	imageMemoryBarriers[1].srcAccessMask = 0;
+	imageMemoryBarriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	imageMemoryBarriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageMemoryBarriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	imageMemoryBarriers[1].image = Outputs[Current].handle;
+	imageMemoryBarriers[2] = imageMemoryBarriers[1];
+	imageMemoryBarriers[2].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	imageMemoryBarriers[2].image = Outputs[1 - Current].handle;
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, OutputsInitialized ? 2 : 3, imageMemoryBarriers);
+	OutputsInitialized = true;
+
+	VkClearValue clearValue = {};
+	VkRenderPassBeginInfo renderPassBeginInfo = {};
+	renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+	renderPassBeginInfo.pNext = nullptr;
+	renderPassBeginInfo.renderPass = MotionRenderPass;
+	renderPassBeginInfo.framebuffer = MotionFramebuffer;
+	renderPassBeginInfo.renderArea.offset = { 0, 0 };
+	renderPassBeginInfo.renderArea.extent = RenderExtent;
+	renderPassBeginInfo.clearValueCount = 1;
+	renderPassBeginInfo.pClearValues = &clearValue;
+
+	Dispatch.vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	if (MotionBoxCount > 0) {
+		VkViewport viewport = { 0.0f, 0.0f, static_cast<float>(RenderExtent.width), static_cast<float>(RenderExtent.height), 0.0f, 1.0f };
+		VkRect2D scissor = { { 0, 0 }, RenderExtent };
+		Dispatch.vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		Dispatch.vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		Dispatch.vkCmdSetDepthBias(commandBuffer, 4.0f, 0.0f, 2.0f);
+		MotionPipeline.CmdBind(commandBuffer, MotionSet);
+		Dispatch.vkCmdDraw(commandBuffer, 36, MotionBoxCount, 0, 0);
+	}
+	Dispatch.vkCmdEndRenderPass(commandBuffer);
+
+	ResolvePipeline.CmdBind(commandBuffer, ResolveSets[Current]);
+	ResolvePipeline.CmdDispatch(commandBuffer, Settings.outputExtent.width, Settings.outputExtent.height);
+
+	imageMemoryBarriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	imageMemoryBarriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	imageMemoryBarriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageMemoryBarriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	imageMemoryBarriers[1].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	imageMemoryBarriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+	imageMemoryBarriers[1].oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT,
+		0, 0, nullptr, 0, nullptr, 2, imageMemoryBarriers);
+
+	// Converted for the renderer's readbacks; the previous frame's copy of it only has to be done before the blit
+	VkImageMemoryBarrier displayBarrier = imageMemoryBarriers[1];
+	displayBarrier.srcAccessMask = 0;
+	displayBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	displayBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	displayBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	displayBarrier.image = Display.handle;
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &displayBarrier);
+
+	VkImageBlit region = {};
+	region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	region.srcOffsets[1] = { static_cast<int32_t>(Settings.outputExtent.width), static_cast<int32_t>(Settings.outputExtent.height), 1 };
+	region.dstSubresource = region.srcSubresource;
+	region.dstOffsets[1] = region.srcOffsets[1];
+	Dispatch.vkCmdBlitImage(commandBuffer, Outputs[Current].handle, VK_IMAGE_LAYOUT_GENERAL, Display.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		1, &region, VK_FILTER_NEAREST);
+
+	displayBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	displayBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	displayBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	displayBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	Dispatch.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &displayBarrier);
+
+	Current = 1 - Current;
+	HistoryValid = true;
+}
+
+bool TemporalUpscaler::GetOutput(VkImage& image, VkExtent2D& extent) const {
+	image = Display.handle;
+	extent = Settings.outputExtent;
+	return true;
+}
+
+VkImage TemporalUpscaler::GetOutputImage() const {
+	return Outputs[1 - Current].handle;
+}
+
+VkImageView TemporalUpscaler::GetOutputView() const {
+	return Outputs[1 - Current].view;
+}
+
+VkExtent2D TemporalUpscaler::GetOutputExtent() const {
+	return Settings.outputExtent;
+}
+
+bool TemporalUpscaler::CreateMotionPass(VkImageView depthView, VkFormat depthFormat) {
+	// Depth of the scene is only tested against, it stays read only
+	VkAttachmentDescription attachmentDescriptions[2] = {};
+	attachmentDescriptions[0].flags = 0;
+	attachmentDescriptions[0].format = MotionFormat;
+	attachmentDescriptions[0].samples = VK_SAMPLE_COUNT_1_BIT;
+	attachmentDescriptions[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachmentDescriptions[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachmentDescriptions[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachmentDescriptions[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachmentDescriptions[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachmentDescriptions[0].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	attachmentDescriptions[1] = attachmentDescriptions[0];
+	attachmentDescriptions[1].format = depthFormat;
+	attachmentDescriptions[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachmentDescriptions[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	attachmentDescriptions[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+	VkAttachmentReference colorAttachmentReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+	VkAttachmentReference depthAttachmentReference = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+
+	VkSubpassDescription subpassDescription = {};
+	subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpassDescription.colorAttachmentCount = 1;
+	subpassDescription.pColorAttachments = &colorAttachmentReference;
+	subpassDescription.pDepthStencilAttachment = &depthAttachmentReference;
+
+	// Scene's depth was made visible to compute shaders by its render pass, the motion was read by the last resolve
+	const VkPipelineStageFlags depthStages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	VkSubpassDependency dependencies[2] = {};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | depthStages;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | depthStages;
+	dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+	dependencies[0].dependencyFlags = 0;
+
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	dependencies[1].dependencyFlags = 0;
+
+	VkRenderPassCreateInfo renderPassCreateInfo = {};
+	renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassCreateInfo.pNext = nullptr;
+	renderPassCreateInfo.flags = 0;
+	renderPassCreateInfo.attachmentCount = 2;
+	renderPassCreateInfo.pAttachments = attachmentDescriptions;
+	renderPassCreateInfo.subpassCount = 1;
+	renderPassCreateInfo.pSubpasses = &subpassDescription;
+	renderPassCreateInfo.dependencyCount = 2;
+	renderPassCreateInfo.pDependencies = dependencies;
+
+	if (Dispatch.vkCreateRenderPass(Dispatch.device, &renderPassCreateInfo, nullptr, &MotionRenderPass) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE MOTION VECTOR RENDER PASS " << std::endl;
+		return false;
+	}
+
+	VkFramebufferCreateInfo frameBufferCreateInfo = {};
+	frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	frameBufferCreateInfo.pNext = nullptr;
+	frameBufferCreateInfo.flags = 0;
+	frameBufferCreateInfo.renderPass = MotionRenderPass;
+	const VkImageView attachments[2] = { Motion.view, depthView };
+	frameBufferCreateInfo.attachmentCount = 2;
+	frameBufferCreateInfo.pAttachments = attachments;
+	frameBufferCreateInfo.width = RenderExtent.width;
+	frameBufferCreateInfo.height = RenderExtent.height;
+	frameBufferCreateInfo.layers = 1;
+
+	if (Dispatch.vkCreateFramebuffer(Dispatch.device, &frameBufferCreateInfo, nullptr, &MotionFramebuffer) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE MOTION VECTOR FRAME BUFFER " << std::endl;
+		return false;
+	}
+	return true;
+}
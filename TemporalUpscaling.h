@@ -0,0 +1,122 @@
+#pragma once
+
+#include "ComputePipeline.h"
+#include "GraphicsPipeline.h"
+#include "OffscreenRenderer.h"
+#include "SceneCamera.h"
+#include <cstdint>
+#include <vector>
+
+// Box that moved since the previous frame and is drawn in the scene at center; gets its own motion vectors
+struct TemporalMotionBox {
+	float center[3];
+	float padding0;
+	float halfExtent[3];
+	float padding1;
+	float previousCenter[3];
+	float padding2;
+
+	TemporalMotionBox() :
+		center(),
+		padding0(0.0f),
+		halfExtent(),
+		padding1(0.0f),
+		previousCenter(),
+		padding2(0.0f) {
+	}
+};
+
+struct TemporalSettings {
+	VkExtent2D outputExtent;			// Reconstructed size, usually larger than the renderer's
+	float feedback;						// Share of the current frame in every result
+	uint32_t maxMotionBoxes;
+
+	TemporalSettings() :
+		outputExtent({ 1280, 720 }),
+		feedback(0.1f),
+		maxMotionBoxes(256) {
+	}
+};
+
+// Temporal anti-aliasing and upscaling of an OffscreenRenderer's frames.
+// The scene is rendered at the renderer's (internal) resolution with a camera jittered along a Halton sequence.
+// After the renderer's render pass, moving objects draw their own motion vectors into a motion target, depth tested
+// against the scene's depth; everything else is reprojected by the camera's motion from depth alone. A compute pass
+// then reconstructs the output resolution: the current frame, sampled without its jitter, is blended with the history
+// fetched at the reprojected position and clamped to the current frame's 3x3 neighborhood (in YCoCg), which rejects
+// history of disoccluded or changed surfaces.
+// Runs on the renderer's final image, after its post-processing, and replaces it as the frame's result: the renderer's
+// readbacks copy the output, converted to the renderer's format.
+class TemporalUpscaler : public OffscreenDrawable {
+public:
+	// Context's dispatch table must outlive the upscaler
+	explicit TemporalUpscaler(const DeviceContext& device);
+	~TemporalUpscaler();
+
+	TemporalUpscaler(const TemporalUpscaler&) = delete;
+	TemporalUpscaler& operator=(const TemporalUpscaler&) = delete;
+
+	// Renderer must be single sampled. Create again after it was resized or recreated.
+	bool Create(const TemporalSettings& settings, const OffscreenRenderer& renderer);
+	void Destroy();
+
+	// Once per frame, before recording: returns the camera jittered for this frame, which everything in the scene
+	// must be drawn with
+	SceneCamera JitterCamera(const SceneCamera& camera);
+	// Written straight into mapped memory, so no frame using the previous ones may still be executing
+	bool SetMotionBoxes(const std::vector<TemporalMotionBox>& boxes);
+	// Drops the history, e.g. after a camera cut
+	void Reset();
+
+	// After the renderer's render pass, in the same command buffer. The previous frame must have finished.
+	void CmdResolve(VkCommandBuffer commandBuffer);
+	// Resolves after the render pass
+	void CmdPostPass(VkCommandBuffer commandBuffer, const OffscreenFrame& frame) override;
+	bool GetOutput(VkImage& image, VkExtent2D& extent) const override;
+
+	// Result of the last frame, in GENERAL layout
+	VkImage GetOutputImage() const;
+	VkImageView GetOutputView() const;
+	VkExtent2D GetOutputExtent() const;
+
+private:
+	// Uniform block of the motion and resolve shaders, std140
+	struct Constants {
+		float viewProjection[16];				// Jittered, the scene's
+		float currentViewProjection[16];		// Without jitter
+		float previousViewProjection[16];		// Without jitter
+		float reprojection[16];					// Current clip space (without jitter) to previous clip space
+		float jitter[4];						// xy: jitter in render pixels, z: feedback, w: history is valid
+		float renderSize[4];					// zw: inverse of xy
+		float outputSize[4];
+	};
+
+	bool CreateMotionPass(VkImageView depthView, VkFormat depthFormat);
+
+	DeviceContext Device;
+	const DeviceDispatchTable& Dispatch;
+	GraphicsPipeline MotionPipeline;
+	ComputePipeline ResolvePipeline;
+	TemporalSettings Settings;
+
+	VkImage Color;								// Renderer's image
+	VkExtent2D RenderExtent;
+	GpuImage Motion;
+	VkRenderPass MotionRenderPass;
+	VkFramebuffer MotionFramebuffer;
+	GpuImage Outputs[2];						// Ping-pong: one is written, the other is the history
+	GpuImage Display;							// Last output in the renderer's format, TRANSFER_SRC_OPTIMAL
+	VkSampler Sampler;
+
+	GpuBuffer MotionBoxes;						// Host visible
+	GpuBuffer Uniforms;
+	VkDescriptorSet MotionSet;
+	VkDescriptorSet ResolveSets[2];				// Writes Outputs[i], reads the other one
+
+	uint32_t MotionBoxCount;
+	uint64_t FrameIndex;
+	uint32_t Current;							// Output written by the next resolve
+	bool HistoryValid;
+	bool OutputsInitialized;
+	Constants Parameters;
+};
@@ -1,9 +1,41 @@
 
 #include "VulkanBase.h"
 #include "VulkanFunctions.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
 
 VulkanHandles handle;
 
+namespace {
+	std::vector<char> ReadBinaryFile(const std::string& path) {
+		std::ifstream file(path, std::ios::binary);
+		if (!file) {
+			return std::vector<char>();
+		}
+		return std::vector<char>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	}
+
+	// Data saved by another driver or GPU is useless, the header tells which one created it
+	bool IsPipelineCacheCompatible(const std::vector<char>& data) {
+		const size_t headerSize = 16 + VK_UUID_SIZE;
+		if (data.size() < headerSize) {
+			return false;
+		}
+
+		uint32_t header[4];
+		memcpy(header, data.data(), sizeof(header));
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(handle.physicalDevice, &properties);
+		return (header[0] >= headerSize)
+			&& (header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+			&& (header[2] == properties.vendorID)
+			&& (header[3] == properties.deviceID)
+			&& (memcmp(data.data() + 16, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0);
+	}
+}
+
 bool VulkanBase::LoadVulkanLibrary() {
 
 #if defined _WIN32
@@ -47,32 +79,29 @@ bool VulkanBase::LoadGlobalLevelEntryPoints(){
 		return false;                                                                     \
 	}																					  \
 
-#include "ListOfFunctions.inl"
+#include "ListofFunctions.inl"
 	return true;
 }																			
 
 bool VulkanBase::LoadInstanceLevelEntryPoints()
 {
-#define VK_INSTANCE_LEVEL_FUNCTION( fun )											\
-	if( !(fun = (PFN_##fun) vkGetInstanceProcAddr( handle.instance, #fun)) ){		\
-		std::cout << "COULD NOT LOAD INSTANCE LEVEL FUNCTION " << #fun << std::endl;	\
-		return false;																\
-	}																				\
+	if (!instanceDispatch.Load(handle.instance, handle.enabledInstanceExtensions)) {
+		return false;
+	}
 
-#include "ListofFunctions.inl"
+	// Most of the code calls the global functions, they are a shortcut to this instance's table
+	instanceDispatch.MakeCurrent();
 	return true;
 }
 
 bool VulkanBase::LoadDeviceLevelEntryPoints()
 {
-#define VK_DEVICE_LEVEL_FUNCTION( fun )											\
-	if( !(fun = (PFN_##fun) vkGetDeviceProcAddr(handle.device, #fun)) ){			\
-		std::cout << "COULD NOT LOAD DEVICE LEVEL FUNCTION " << #fun << std::endl;	\
-		return false;																\
-	}																				\
+	if (!deviceDispatch.Load(instanceDispatch, handle.device, handle.enabledDeviceExtensions)) {
+		return false;
+	}
 
-#include "ListofFunctions.inl"
-		return true;
+	deviceDispatch.MakeCurrent();
+	return true;
 }
 
 bool VulkanBase::CheckExtensionAvailability(const char* extension, const std::vector<VkExtensionProperties>& availableExtensions)
@@ -85,6 +114,36 @@ bool VulkanBase::CheckExtensionAvailability(const char* extension, const std::ve
 	return false;
 }
 
+bool VulkanBase::IsInstanceExtensionEnabled(const char* extension) const
+{
+	for (const char* enabledExtension : handle.enabledInstanceExtensions) {
+		if (strcmp(enabledExtension, extension) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+bool VulkanBase::IsDeviceExtensionEnabled(const char* extension) const
+{
+	for (const char* enabledExtension : handle.enabledDeviceExtensions) {
+		if (strcmp(enabledExtension, extension) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+const InstanceDispatchTable& VulkanBase::GetInstanceDispatch() const
+{
+	return instanceDispatch;
+}
+
+const DeviceDispatchTable& VulkanBase::GetDeviceDispatch() const
+{
+	return deviceDispatch;
+}
 
 VkDevice VulkanBase::GetDevice() const{
 	return handle.device;
@@ -92,7 +151,137 @@ VkDevice VulkanBase::GetDevice() const{
 
 const SwapChainParameters& VulkanBase::GetSwapChain() const
 {
-	// TODO: insert return statement here
+	return swapchainParameters;
+}
+
+FramePacingController& VulkanBase::GetFramePacing()
+{
+	return framePacing;
+}
+
+const LatencyMonitor& VulkanBase::GetLatencyMonitor() const
+{
+	return latencyMonitor;
+}
+
+void VulkanBase::SetLowLatencyMode(bool enable)
+{
+	lowLatencyMode = enable;
+}
+
+void VulkanBase::SetDynamicResolution(bool enable, const DynamicResolutionParameters& parameters)
+{
+	// Takes effect when command buffers are (re)created
+	dynamicResolutionEnabled = enable;
+	dynamicResolution.SetParameters(parameters);
+	dynamicResolution.Reset();
+}
+
+const DynamicResolutionController& VulkanBase::GetDynamicResolution() const
+{
+	return dynamicResolution;
+}
+
+StartupProfiler& VulkanBase::GetStartupProfiler()
+{
+	return startupProfiler;
+}
+
+void VulkanBase::SetPipelineCachePath(const std::string& path)
+{
+	pipelineCachePath = path;
+}
+
+void VulkanBase::SetCapture(const CaptureOptions& options)
+{
+	// Swapchain images need the transfer source usage, so it must be known when the swapchain is created
+	captureEnabled = true;
+	captureOptions = options;
+}
+
+bool VulkanBase::StopCapture()
+{
+	captureEnabled = false;
+	return !frameCapture || frameCapture->Close();
+}
+
+CaptureStats VulkanBase::GetCaptureStats() const
+{
+	return frameCapture ? frameCapture->GetStats() : CaptureStats();
+}
+
+VkPipelineCache VulkanBase::GetPipelineCache()
+{
+	if ((pipelineCache != VK_NULL_HANDLE) || (handle.device == VK_NULL_HANDLE)) {
+		return pipelineCache;
+	}
+	StartupStage stage(startupProfiler, "pipeline cache (on first use)");
+
+	std::vector<char> data;
+	if (pipelineCacheLoad.valid()) {
+		data = pipelineCacheLoad.get();
+	}
+	if (!data.empty() && !IsPipelineCacheCompatible(data)) {
+		std::cout << "Pipeline cache " << pipelineCachePath << " was created by a different device or driver, ignoring it" << std::endl;
+		data.clear();
+	}
+
+	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
+	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	pipelineCacheCreateInfo.pNext = nullptr;
+	pipelineCacheCreateInfo.flags = 0;
+	pipelineCacheCreateInfo.initialDataSize = data.size();
+	pipelineCacheCreateInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+	if (vkCreatePipelineCache(handle.device, &pipelineCacheCreateInfo, nullptr, &pipelineCache) != VK_SUCCESS) {
+		// Pipelines can still be created without a cache
+		std::cout << "COULD NOT CREATE PIPELINE CACHE " << std::endl;
+		pipelineCache = VK_NULL_HANDLE;
+	}
+	return pipelineCache;
+}
+
+void VulkanBase::StartPipelineCacheLoad()
+{
+	if (pipelineCachePath.empty() || pipelineCacheLoad.valid()) {
+		return;
+	}
+
+	// Only reads the file, the cache object itself is created when the first pipeline needs it
+	const std::string path = pipelineCachePath;
+	StartupProfiler& profiler = startupProfiler;
+	pipelineCacheLoad = std::async(std::launch::async, [path, &profiler]() {
+		StartupStage stage(profiler, "pipeline cache file");
+		return ReadBinaryFile(path);
+	});
+}
+
+void VulkanBase::DestroyPipelineCache()
+{
+	if (pipelineCache == VK_NULL_HANDLE) {
+		return;
+	}
+
+	if (!pipelineCachePath.empty()) {
+		size_t size = 0;
+		std::vector<char> data;
+		if ((vkGetPipelineCacheData(handle.device, pipelineCache, &size, nullptr) == VK_SUCCESS) && (size > 0)) {
+			data.resize(size);
+			if (vkGetPipelineCacheData(handle.device, pipelineCache, &size, data.data()) == VK_SUCCESS) {
+				std::ofstream file(pipelineCachePath, std::ios::binary);
+				file.write(data.data(), size);
+			}
+		}
+	}
+
+	vkDestroyPipelineCache(handle.device, pipelineCache, nullptr);
+	pipelineCache = VK_NULL_HANDLE;
+}
+
+bool VulkanBase::RunStartupStage(const char* name, bool (VulkanBase::*step)())
+{
+	StartupStage stage(startupProfiler, name);
+	return (this->*step)();
 }
 
 bool VulkanBase::CreateVulkanInstance() {
@@ -109,14 +298,18 @@ bool VulkanBase::CreateVulkanInstance() {
 		return false;
 	}
 
-	std::vector<const char*> requiredExtensions = {
-		VK_KHR_SURFACE_EXTENSION_NAME,
+	std::vector<const char*> requiredExtensions;
+	// Without a window nothing is presented, so surface extensions aren't needed (CPU-only drivers may lack them)
+	if (!headless) {
+		requiredExtensions = {
+			VK_KHR_SURFACE_EXTENSION_NAME,
 #if defined (VK_USE_PLATFORM_WIN32_KHR)
-		VK_KHR_WIN32_SURFACE_EXTENSION_NAME
+			VK_KHR_WIN32_SURFACE_EXTENSION_NAME
 #elif defined (VK_USE_PLATFORM_XCB_KHR)
-		VK_KHR_XCB_SURFACE_EXTENSION_NAME
+			VK_KHR_XCB_SURFACE_EXTENSION_NAME
 #endif
-	};
+		};
+	}
 
 	for (size_t i = 0; i < requiredExtensions.size(); ++i) {
 		if (!CheckExtensionAvailability(requiredExtensions.at(i), availableExtensions)) {
@@ -125,6 +318,12 @@ bool VulkanBase::CreateVulkanInstance() {
 		}
 	}
 
+	// Optional extensions
+	// Dependency of timeline semaphores on 1.0 instances
+	if (CheckExtensionAvailability(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME, availableExtensions)) {
+		requiredExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+	}
+
 	VkApplicationInfo applicationInfo = {};
 	applicationInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
 	applicationInfo.pNext = nullptr;
@@ -150,29 +349,27 @@ bool VulkanBase::CreateVulkanInstance() {
 		return false;
 	}
 
+	handle.enabledInstanceExtensions = requiredExtensions;
 	return true;
 }
 
 bool VulkanBase::CreateLogicalDevice()
 {
-	uint32_t deviceCount =  0;
-	if ((vkEnumeratePhysicalDevices(handle.instance, &deviceCount, nullptr)) != VK_SUCCESS) {
-		std::cout << "ERROR OCURRED DURING PHYSICAL DEVICE ENUMERATION " << std::endl;
-		return false;
-	}
-
-	std::vector<VkPhysicalDevice> PhysicalDevices(deviceCount);
-	if ((vkEnumeratePhysicalDevices(handle.instance, &deviceCount, PhysicalDevices.data())) != VK_SUCCESS) {
+	// Best scoring device first (discrete before integrated before CPU, then memory and limits)
+	std::vector<PhysicalDeviceInfo> PhysicalDevices = EnumeratePhysicalDevices(handle.instance);
+	if (PhysicalDevices.empty()) {
 		std::cout << "ERROR OCURRED DURING PHYSICAL DEVICE ENUMERATION " << std::endl;
 		return false;
 	}
 
 	uint32_t selectedGraphicsQueueFamilyIndex = UINT32_MAX;
 	uint32_t selectedPresentQueueFamilyIndex = UINT32_MAX;
+	uint32_t selectedComputeQueueFamilyIndex = UINT32_MAX;
 
-	for (auto device : PhysicalDevices) {
-		if (CheckPhysicalDeviceProperties(device, selectedGraphicsQueueFamilyIndex, selectedPresentQueueFamilyIndex)) {
-			handle.physicalDevice = device;
+	for (const PhysicalDeviceInfo& device : PhysicalDevices) {
+		if (device.CanRender() && CheckPhysicalDeviceProperties(device.handle, selectedGraphicsQueueFamilyIndex, selectedPresentQueueFamilyIndex)) {
+			handle.physicalDevice = device.handle;
+			selectedComputeQueueFamilyIndex = device.computeQueueFamilyIndex;
 			break;
 		}
 	}
@@ -204,15 +401,59 @@ bool VulkanBase::CreateLogicalDevice()
 			});
 	}
 
-	std::vector<const char*> requiredExtensions = {
-		VK_KHR_SWAPCHAIN_EXTENSION_NAME
-	};
+	// Compute-only family runs compute work asynchronously next to the graphics queue, otherwise they share it
+	if (selectedComputeQueueFamilyIndex == UINT32_MAX) {
+		selectedComputeQueueFamilyIndex = selectedGraphicsQueueFamilyIndex;
+	}
+	else if (selectedComputeQueueFamilyIndex != selectedPresentQueueFamilyIndex) {
+		queueCreateInfo.push_back({
+		VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+		nullptr,
+		0,
+		selectedComputeQueueFamilyIndex,
+		static_cast<uint32_t>(queuePriorites.size()),
+		queuePriorites.data(),
+			});
+	}
+
+	std::vector<const char*> requiredExtensions;
+	if (!headless) {
+		requiredExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+	}
+
+	// Optional extensions
+	uint32_t extensionCount = 0;
+	if (vkEnumerateDeviceExtensionProperties(handle.physicalDevice, nullptr, &extensionCount, nullptr) == VK_SUCCESS) {
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		if (vkEnumerateDeviceExtensionProperties(handle.physicalDevice, nullptr, &extensionCount, availableExtensions.data()) == VK_SUCCESS) {
+			// Real presentation times for frame pacing
+			if (!headless && CheckExtensionAvailability(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME, availableExtensions)) {
+				requiredExtensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+			}
+			// Readback completion can be polled from any thread without touching fences the submitter owns
+			if (IsInstanceExtensionEnabled(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME)
+				&& CheckExtensionAvailability(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME, availableExtensions)) {
+				requiredExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+			}
+		}
+	}
+
+	// Every device exposing the extension supports the feature, it only has to be turned on
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineSemaphoreFeatures = {};
+	timelineSemaphoreFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+	timelineSemaphoreFeatures.pNext = nullptr;
+	timelineSemaphoreFeatures.timelineSemaphore = VK_TRUE;
+
+	bool timelineSemaphores = false;
+	for (const char* extension : requiredExtensions) {
+		timelineSemaphores = timelineSemaphores || (strcmp(extension, VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME) == 0);
+	}
 
 	VkDeviceCreateInfo deviceCreateInfo = {};
 	deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-	deviceCreateInfo.pNext = nullptr;
+	deviceCreateInfo.pNext = timelineSemaphores ? &timelineSemaphoreFeatures : nullptr;
 	deviceCreateInfo.flags = 0;
-	deviceCreateInfo.queueCreateInfoCount = 1;
+	deviceCreateInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfo.size());
 	deviceCreateInfo.pQueueCreateInfos = queueCreateInfo.data();
 	deviceCreateInfo.enabledLayerCount = 0;
 	deviceCreateInfo.ppEnabledLayerNames = nullptr;
@@ -227,6 +468,8 @@ bool VulkanBase::CreateLogicalDevice()
 
 	handle.graphicsQueueFamilyIndex = selectedGraphicsQueueFamilyIndex;
 	handle.presentationQueueFamilyIndex = selectedPresentQueueFamilyIndex;
+	handle.computeQueueFamilyIndex = selectedComputeQueueFamilyIndex;
+	handle.enabledDeviceExtensions = requiredExtensions;
 	return true;
 }
 
@@ -282,6 +525,16 @@ bool VulkanBase::CheckPhysicalDeviceProperties(VkPhysicalDevice device, uint32_t
 	uint32_t presentQueueFamilyIndex = UINT32_MAX;
 
 	for (uint32_t i = 0; i < queueFamiliesCount; i++) {
+		if (headless) {
+			// Nothing is presented, the graphics queue does all the work
+			if ((queueFamiliesProperties[i].queueCount > 0) && (queueFamiliesProperties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+				selectedGraphicsQueuefamilyIndex = i;
+				selectedPresentQueueFamilyIndex = i;
+				return true;
+			}
+			continue;
+		}
+
 		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, handle.presentationSurface, &queuePresentSupport[i]);
 		if ((queueFamiliesProperties[i].queueCount > 0) &&
 			(queueFamiliesProperties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
@@ -321,6 +574,7 @@ bool VulkanBase::GetDeviceQueue()
 {
 	vkGetDeviceQueue(handle.device, handle.graphicsQueueFamilyIndex, 0, &handle.graphicsQueue);
 	vkGetDeviceQueue(handle.device, handle.presentationQueueFamilyIndex, 0, &handle.presentQueue);
+	vkGetDeviceQueue(handle.device, handle.computeQueueFamilyIndex, 0, &handle.computeQueue);
 	return true;
 }
 
@@ -348,7 +602,7 @@ bool VulkanBase::CreatePresentationSurface()
 	surfaceCreateInfo.connection = window.Connection;
 	surfaceCreateInfo.window = window.Handle;
 
-	if (vkCreateXCBSurfaceKHR(handle.instance, &surfaceCreateInfo, nullptr, &handle.presentationSurface) == VK_SUCCESS) {
+	if (vkCreateXcbSurfaceKHR(handle.instance, &surfaceCreateInfo, nullptr, &handle.presentationSurface) == VK_SUCCESS) {
 		return true;
 	}
 #endif
@@ -411,6 +665,9 @@ bool VulkanBase::CreateSwapchain()
 // 	uint32_t noOfImages = GetSwapChainNumImages(surfaceCapabilities);
 // 	VkSurfaceFormat
 
+	// Present mode has to be known first as the number of images depends on it
+	VkPresentModeKHR presentMode = GetSwapChainPresentMode(presentModes);
+
 	VkSwapchainCreateInfoKHR swapchainCreateInfo = {};
 	swapchainCreateInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
 	swapchainCreateInfo.pNext = nullptr;
@@ -435,14 +692,45 @@ bool VulkanBase::CreateSwapchain()
 	swapchainCreateInfo.pQueueFamilyIndices = nullptr;
 	swapchainCreateInfo.preTransform = GetSwapChainTransform(surfaceCapabilities);
 	swapchainCreateInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-	swapchainCreateInfo.presentMode = GetSwapChainPresentMode(presentModes);
+	swapchainCreateInfo.presentMode = presentMode;
 	swapchainCreateInfo.clipped = VK_TRUE;
 	swapchainCreateInfo.oldSwapchain = handle.swapChain;
 
+	VkSwapchainKHR oldSwapChain = handle.swapChain;
 	if (vkCreateSwapchainKHR(handle.device, &swapchainCreateInfo, nullptr, &handle.swapChain)) {
 		std::cout << "COULD NOT CREATE SWAPCHAIN " << std::endl;
 		return false;
 	}
+	if (oldSwapChain != VK_NULL_HANDLE) {
+		vkDestroySwapchainKHR(handle.device, oldSwapChain, nullptr);
+	}
+
+	uint32_t imageCount = 0;
+	if (vkGetSwapchainImagesKHR(handle.device, handle.swapChain, &imageCount, nullptr) != VK_SUCCESS) {
+		std::cout << "COULD NOT GET NUMBER OF SWAPCHAIN IMAGES " << std::endl;
+		return false;
+	}
+
+	std::vector<VkImage> swapchainImages(imageCount, VK_NULL_HANDLE);
+	if (vkGetSwapchainImagesKHR(handle.device, handle.swapChain, &imageCount, swapchainImages.data()) != VK_SUCCESS) {
+		std::cout << "COULD NOT GET SWAPCHAIN IMAGES HANDLES " << std::endl;
+		return false;
+	}
+
+	swapchainParameters.handle = handle.swapChain;
+	swapchainParameters.format = format.format;
+	swapchainParameters.extent = swapchainCreateInfo.imageExtent;
+	swapchainParameters.images.assign(imageCount, ImageParameters());
+	for (uint32_t i = 0; i < imageCount; ++i) {
+		swapchainParameters.images[i].handle = swapchainImages[i];
+	}
+
+	if (IsDeviceExtensionEnabled(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME)) {
+		VkRefreshCycleDurationGOOGLE refreshCycle = {};
+		if (vkGetRefreshCycleDurationGOOGLE(handle.device, handle.swapChain, &refreshCycle) == VK_SUCCESS) {
+			framePacing.SetRefreshDuration(refreshCycle.refreshDuration);
+		}
+	}
 
 	CanRender = true;
 	return true;
@@ -450,11 +738,8 @@ bool VulkanBase::CreateSwapchain()
 
 uint32_t VulkanBase::GetSwapChainNumImages(VkSurfaceCapabilitiesKHR& surfaceCapabilities)
 {
-	uint32_t imageCount = surfaceCapabilities.minImageCount + 1;
-	if ((surfaceCapabilities.maxImageCount > 0) && (imageCount > surfaceCapabilities.maxImageCount)){
-	imageCount = surfaceCapabilities.maxImageCount;
-}
- 	return uint32_t(imageCount);
+	// Depends on the pacing policy and on misses measured with the current swapchain
+	return framePacing.SelectImageCount(surfaceCapabilities);
 }
 
 VkSurfaceFormatKHR VulkanBase::GetSwapChainFormat(std::vector<VkSurfaceFormatKHR>& surfaceFormats)
@@ -503,7 +788,16 @@ VkExtent2D VulkanBase::GetSwapChainExtent(VkSurfaceCapabilitiesKHR& surfaceCapab
 VkImageUsageFlags VulkanBase::GetSwapChainUsageFlags(VkSurfaceCapabilitiesKHR& surfaceCapabilities)
 {
 	if (surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) {
-		return VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+		// Only requested for capture, the extra usage may cost some drivers their framebuffer compression
+		if (captureEnabled && (surfaceCapabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) {
+			usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		}
+		else if (captureEnabled) {
+			std::cout << "SWAPCHAIN IMAGES CAN'T BE COPIED, CAPTURE DISABLED " << std::endl;
+			captureEnabled = false;
+		}
+		return usage;
 	}
 
 	std::cout << "VK_IMAGE_USAGE_TRANSFER_DST_BIT not supported by SwapChain " << std::endl;
@@ -531,21 +825,12 @@ VkSurfaceTransformFlagBitsKHR VulkanBase::GetSwapChainTransform(VkSurfaceCapabil
 
 VkPresentModeKHR VulkanBase::GetSwapChainPresentMode(std::vector<VkPresentModeKHR>& presentModes)
 {
-	for (VkPresentModeKHR& mode : presentModes) {
-		if (mode == VK_PRESENT_MODE_MAILBOX_KHR) {
-			return mode;
-		}
-	}
-
-	//This mode is always available
-	for (VkPresentModeKHR& mode : presentModes) {
-		if (mode == VK_PRESENT_MODE_FIFO_KHR) {
-			return mode;
-		}
+	// Preference order depends on the latency / power policy set on the frame pacing controller
+	VkPresentModeKHR presentMode = framePacing.SelectPresentMode(presentModes);
+	if (presentMode == static_cast<VkPresentModeKHR>(-1)) {
+		std::cout << "EVEN FIFO_MODE NOT SUPPORTED" << std::endl;
 	}
-
-	std::cout << "EVEN FIFO_MODE NOT SUPPORTED" << std::endl;
-	return static_cast<VkPresentModeKHR>(-1);
+	return presentMode;
 }
 
 VulkanBase::~VulkanBase() {
@@ -553,6 +838,7 @@ VulkanBase::~VulkanBase() {
 
 	if (handle.device != VK_NULL_HANDLE) {
 		vkDeviceWaitIdle(handle.device);
+		frameCapture.reset();
 
 		if (handle.imageAvailableSemaphore != VK_NULL_HANDLE) {
 			vkDestroySemaphore(handle.device, handle.imageAvailableSemaphore, nullptr);
@@ -566,6 +852,7 @@ VulkanBase::~VulkanBase() {
 			vkDestroySwapchainKHR(handle.device, handle.swapChain, nullptr);
 		}
 
+		DestroyPipelineCache();
 		vkDestroyDevice(handle.device, nullptr);
 	}
 
@@ -591,7 +878,8 @@ bool VulkanBase::CreateCommandBuffers()
 	VkCommandPoolCreateInfo commandPoolCreateInfo = {};
 	commandPoolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	commandPoolCreateInfo.pNext = nullptr;
-	commandPoolCreateInfo.flags = 0;
+	// Single command buffers get re-recorded when the dynamic resolution scale changes
+	commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 	commandPoolCreateInfo.queueFamilyIndex = handle.presentationQueueFamilyIndex;
 
 	if (vkCreateCommandPool(handle.device, &commandPoolCreateInfo, nullptr, &handle.presentQueueCommandPool) != VK_SUCCESS) {
@@ -599,11 +887,7 @@ bool VulkanBase::CreateCommandBuffers()
 		return false;
 	}
 
-	uint32_t imageCount = 0;
-	if (vkGetSwapchainImagesKHR(handle.device, handle.swapChain, &imageCount, nullptr) != VK_SUCCESS) {
-		std::cout << "COULD NOT GET NUMBER OF SWAPCHAIN IMAGES " << std::endl;
-		return false;
-	}
+	uint32_t imageCount = static_cast<uint32_t>(swapchainParameters.images.size());
 
 	handle.presentQueueCommandBuffers.resize(imageCount, VK_NULL_HANDLE);
 	VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
@@ -618,6 +902,35 @@ bool VulkanBase::CreateCommandBuffers()
 		return false;
 	}
 
+	if (captureEnabled) {
+		captureCommandBuffers.resize(imageCount, VK_NULL_HANDLE);
+		if ((vkAllocateCommandBuffers(handle.device, &commandBufferAllocateInfo, captureCommandBuffers.data()) != VK_SUCCESS) || !StartCapture()) {
+			std::cout << "COULD NOT START CAPTURE " << std::endl;
+			return false;
+		}
+	}
+
+	// Fences start signaled, so the first wait for each image returns immediately
+	VkFenceCreateInfo fenceCreateInfo = {};
+	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	fenceCreateInfo.pNext = nullptr;
+	fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+	handle.presentQueueFences.resize(imageCount, VK_NULL_HANDLE);
+	for (uint32_t i = 0; i < imageCount; ++i) {
+		if (vkCreateFence(handle.device, &fenceCreateInfo, nullptr, &handle.presentQueueFences[i]) != VK_SUCCESS) {
+			std::cout << "COULD NOT CREATE FENCE " << std::endl;
+			return false;
+		}
+	}
+
+	// Timing is optional - without timestamp support frames are only scheduled from CPU measurements
+	gpuTimer.Create(handle.physicalDevice, deviceDispatch, handle.presentQueue, handle.presentationQueueFamilyIndex, imageCount);
+
+	if (dynamicResolutionEnabled && !CreateSceneTarget()) {
+		return false;
+	}
+
 	if (!RecordCommandBuffers()) {
 		std::cout << "COULD NOT RECORD COMMAND BUFFERS " << std::endl;
 		return false;
@@ -627,13 +940,17 @@ bool VulkanBase::CreateCommandBuffers()
 }
 
 bool VulkanBase::RecordCommandBuffers() {
-	uint32_t imageCount = static_cast<uint32_t>(handle.presentQueueCommandBuffers.size());
-
-	std::vector<VkImage> swapchainImages(imageCount, VK_NULL_HANDLE);
-	if (vkGetSwapchainImagesKHR(handle.device, handle.swapChain, &imageCount, swapchainImages.data()) != VK_SUCCESS) {
-		std::cout << "COULD NOT GET SWAPCHAIN IMAGES HANDLES " << std::endl;
-		return false;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(handle.presentQueueCommandBuffers.size()); ++i) {
+		if (!RecordCommandBuffer(i)) {
+			return false;
+		}
 	}
+	return true;
+}
+
+bool VulkanBase::RecordCommandBuffer(uint32_t imageIndex) {
+	VkCommandBuffer commandBuffer = handle.presentQueueCommandBuffers.at(imageIndex);
+	VkImage swapchainImage = swapchainParameters.images.at(imageIndex).handle;
 
 	VkCommandBufferBeginInfo cmdBufferBeginInfo = {};
 	cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -652,49 +969,332 @@ bool VulkanBase::RecordCommandBuffers() {
 	imageSubresourceRange.baseArrayLayer = 0;
 	imageSubresourceRange.layerCount = 1;
 
-	for (size_t i = 0; i < imageCount; ++i) {
-		VkImageMemoryBarrier memoryBarrier_present_to_clear = {};
-		memoryBarrier_present_to_clear.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		memoryBarrier_present_to_clear.pNext = nullptr;
-		memoryBarrier_present_to_clear.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT; //srcAccessMask  Types of memory operations done on the image before the barrier.
-		memoryBarrier_present_to_clear.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT; //dstAccessMask  Types of memory operations that will take place after the barrier.
-		memoryBarrier_present_to_clear.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		memoryBarrier_present_to_clear.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		memoryBarrier_present_to_clear.srcQueueFamilyIndex = handle.presentationQueueFamilyIndex;
-		memoryBarrier_present_to_clear.dstQueueFamilyIndex = handle.presentationQueueFamilyIndex;
-		memoryBarrier_present_to_clear.image = swapchainImages.at(i);
-		memoryBarrier_present_to_clear.subresourceRange = imageSubresourceRange;
-
-		VkImageMemoryBarrier memoryBarrier_clear_to_present = {};
-		memoryBarrier_clear_to_present.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		memoryBarrier_clear_to_present.pNext = nullptr;
-		memoryBarrier_clear_to_present.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT; //srcAccessMask  Types of memory operations done on the image before the barrier.
-		memoryBarrier_clear_to_present.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT; //dstAccessMask  Types of memory operations that will take place after the barrier.
-		memoryBarrier_clear_to_present.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		memoryBarrier_clear_to_present.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-		memoryBarrier_clear_to_present.srcQueueFamilyIndex = handle.presentationQueueFamilyIndex;
-		memoryBarrier_clear_to_present.dstQueueFamilyIndex = handle.presentationQueueFamilyIndex;
-		memoryBarrier_clear_to_present.image = swapchainImages.at(i);
-		memoryBarrier_clear_to_present.subresourceRange = imageSubresourceRange;
-
-		vkBeginCommandBuffer(handle.presentQueueCommandBuffers.at(i), &cmdBufferBeginInfo);
-		vkCmdPipelineBarrier(handle.presentQueueCommandBuffers.at(i), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+	VkImageMemoryBarrier memoryBarrier_present_to_clear = {};
+	memoryBarrier_present_to_clear.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	memoryBarrier_present_to_clear.pNext = nullptr;
+	memoryBarrier_present_to_clear.srcAccessMask = VK_ACCESS_MEMORY_READ_BIT; //srcAccessMask  Types of memory operations done on the image before the barrier.
+	memoryBarrier_present_to_clear.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT; //dstAccessMask  Types of memory operations that will take place after the barrier.
+	memoryBarrier_present_to_clear.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	memoryBarrier_present_to_clear.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	memoryBarrier_present_to_clear.srcQueueFamilyIndex = handle.presentationQueueFamilyIndex;
+	memoryBarrier_present_to_clear.dstQueueFamilyIndex = handle.presentationQueueFamilyIndex;
+	memoryBarrier_present_to_clear.image = swapchainImage;
+	memoryBarrier_present_to_clear.subresourceRange = imageSubresourceRange;
+
+	VkImageMemoryBarrier memoryBarrier_clear_to_present = {};
+	memoryBarrier_clear_to_present.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	memoryBarrier_clear_to_present.pNext = nullptr;
+	memoryBarrier_clear_to_present.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT; //srcAccessMask  Types of memory operations done on the image before the barrier.
+	memoryBarrier_clear_to_present.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT; //dstAccessMask  Types of memory operations that will take place after the barrier.
+	memoryBarrier_clear_to_present.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	memoryBarrier_clear_to_present.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	memoryBarrier_clear_to_present.srcQueueFamilyIndex = handle.presentationQueueFamilyIndex;
+	memoryBarrier_clear_to_present.dstQueueFamilyIndex = handle.presentationQueueFamilyIndex;
+	memoryBarrier_clear_to_present.image = swapchainImage;
+	memoryBarrier_clear_to_present.subresourceRange = imageSubresourceRange;
+
+	vkBeginCommandBuffer(commandBuffer, &cmdBufferBeginInfo);
+
+	if (dynamicResolutionEnabled) {
+		VkExtent2D renderExtent = dynamicResolution.GetRenderExtent(swapchainParameters.extent);
+
+		// Scene pass doesn't touch the swapchain image, so it can start before the acquire semaphore is signaled
+		gpuTimer.CmdBegin(commandBuffer, imageIndex, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+
+		VkClearValue clearValue = {};
+		clearValue.color = clearColor;
+
+		// Only the scaled corner of the full size target is rendered, so no reallocation is needed when the scale changes
+		VkRenderPassBeginInfo renderPassBeginInfo = {};
+		renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		renderPassBeginInfo.pNext = nullptr;
+		renderPassBeginInfo.renderPass = sceneRenderPass;
+		renderPassBeginInfo.framebuffer = sceneFramebuffer;
+		renderPassBeginInfo.renderArea.offset = { 0, 0 };
+		renderPassBeginInfo.renderArea.extent = renderExtent;
+		renderPassBeginInfo.clearValueCount = 1;
+		renderPassBeginInfo.pClearValues = &clearValue;
+
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdEndRenderPass(commandBuffer);
+
+		// Measure the scene pass only - the blit below waits for the acquired image, which under vsync says nothing about
+		// how expensive rendering is
+		gpuTimer.CmdEnd(commandBuffer, imageIndex);
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
 			0, 0, nullptr, 0, nullptr, 1, &memoryBarrier_present_to_clear);
 
-		vkCmdClearColorImage(handle.presentQueueCommandBuffers.at(i), swapchainImages.at(i), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		// Upscale the rendered region to the whole swapchain image
+		VkImageBlit blitRegion = {};
+		blitRegion.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blitRegion.srcSubresource.mipLevel = 0;
+		blitRegion.srcSubresource.baseArrayLayer = 0;
+		blitRegion.srcSubresource.layerCount = 1;
+		blitRegion.srcOffsets[0] = { 0, 0, 0 };
+		blitRegion.srcOffsets[1] = { static_cast<int32_t>(renderExtent.width), static_cast<int32_t>(renderExtent.height), 1 };
+		blitRegion.dstSubresource = blitRegion.srcSubresource;
+		blitRegion.dstOffsets[0] = { 0, 0, 0 };
+		blitRegion.dstOffsets[1] = { static_cast<int32_t>(swapchainParameters.extent.width), static_cast<int32_t>(swapchainParameters.extent.height), 1 };
+
+		vkCmdBlitImage(commandBuffer, sceneTarget.handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapchainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			1, &blitRegion, sceneUpscaleFilter);
+
+		recordedRenderExtents.at(imageIndex) = renderExtent;
+	}
+	else {
+		// Submission waits for the acquired image at transfer stage, so start measuring there and not at top of pipe
+		gpuTimer.CmdBegin(commandBuffer, imageIndex, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			0, 0, nullptr, 0, nullptr, 1, &memoryBarrier_present_to_clear);
+
+		vkCmdClearColorImage(commandBuffer, swapchainImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			&clearColor, 1, &imageSubresourceRange);
+		gpuTimer.CmdEnd(commandBuffer, imageIndex);
+	}
 
-		vkCmdPipelineBarrier(handle.presentQueueCommandBuffers.at(i), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-			0, 0, nullptr, 0, nullptr, 1, &memoryBarrier_clear_to_present);
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+		0, 0, nullptr, 0, nullptr, 1, &memoryBarrier_clear_to_present);
 
-		if (vkEndCommandBuffer(handle.presentQueueCommandBuffers.at(i)) != VK_SUCCESS) {
-			std::cout << "COULD NOT RECORD COMMAND BUFFER " << std::endl;
-			return false;
-		}
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		std::cout << "COULD NOT RECORD COMMAND BUFFER " << std::endl;
+		return false;
 	}
 	return true;
 }
 
+bool VulkanBase::StartCapture()
+{
+	// Stream is opened once, later swapchains of another size are simply not captured
+	if (frameCapture) {
+		return true;
+	}
+
+	// Copies are submitted together with the frame, so the readback ring has to track the present queue
+	DeviceContext context = GetDeviceContext();
+	context.graphicsQueue = handle.presentQueue;
+	context.graphicsQueueFamilyIndex = handle.presentationQueueFamilyIndex;
+
+	frameCapture.reset(new FrameCapture(context));
+	if (!frameCapture->Open(captureOptions, swapchainParameters.extent)) {
+		frameCapture.reset();
+		return false;
+	}
+	return true;
+}
+
+bool VulkanBase::RecordCaptureCommandBuffer(uint32_t imageIndex, const ReadbackTicket& ticket)
+{
+	// Image's fence was waited for, so its capture command buffer is free to be recorded again
+	VkCommandBuffer commandBuffer = captureCommandBuffers.at(imageIndex);
+
+	VkCommandBufferBeginInfo cmdBufferBeginInfo = {};
+	cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	cmdBufferBeginInfo.pNext = nullptr;
+	cmdBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	cmdBufferBeginInfo.pInheritanceInfo = nullptr;
+
+	vkBeginCommandBuffer(commandBuffer, &cmdBufferBeginInfo);
+	frameCapture->CmdCopyImage(commandBuffer, ticket, swapchainParameters.images.at(imageIndex).handle, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+		std::cout << "COULD NOT RECORD CAPTURE COMMAND BUFFER " << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool VulkanBase::GetMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags properties, uint32_t& memoryType) const
+{
+	return GetDeviceContext().GetMemoryType(memoryTypeBits, properties, memoryType);
+}
+
+DeviceContext VulkanBase::GetDeviceContext() const
+{
+	// Pipeline cache is left out, it's created on first use (GetPipelineCache())
+	DeviceContext context;
+	context.physicalDevice = handle.physicalDevice;
+	context.dispatch = &deviceDispatch;
+	context.graphicsQueue = handle.graphicsQueue;
+	context.graphicsQueueFamilyIndex = handle.graphicsQueueFamilyIndex;
+	context.computeQueue = handle.computeQueue;
+	context.computeQueueFamilyIndex = handle.computeQueueFamilyIndex;
+	context.timelineSemaphores = IsDeviceExtensionEnabled(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+	return context;
+}
+
+bool VulkanBase::CreateSceneTarget()
+{
+	const VkFormat format = swapchainParameters.format;
+
+	// Scene target is rendered to and blitted from, swapchain image (same format) is blitted to
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(handle.physicalDevice, format, &formatProperties);
+	const VkFormatFeatureFlags requiredFeatures = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+	if ((formatProperties.optimalTilingFeatures & requiredFeatures) != requiredFeatures) {
+		std::cout << "SWAPCHAIN FORMAT CAN'T BE BLITTED, DYNAMIC RESOLUTION DISABLED " << std::endl;
+		dynamicResolutionEnabled = false;
+		return true;
+	}
+	sceneUpscaleFilter = (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT) ? VK_FILTER_LINEAR : VK_FILTER_NEAREST;
+
+	// Allocated at full swapchain size, the scale only changes the rendered area
+	VkImageCreateInfo imageCreateInfo = {};
+	imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCreateInfo.pNext = nullptr;
+	imageCreateInfo.flags = 0;
+	imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageCreateInfo.format = format;
+	imageCreateInfo.extent = { swapchainParameters.extent.width, swapchainParameters.extent.height, 1 };
+	imageCreateInfo.mipLevels = 1;
+	imageCreateInfo.arrayLayers = 1;
+	imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageCreateInfo.queueFamilyIndexCount = 0;
+	imageCreateInfo.pQueueFamilyIndices = nullptr;
+	imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	if (vkCreateImage(handle.device, &imageCreateInfo, nullptr, &sceneTarget.handle) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE SCENE IMAGE " << std::endl;
+		return false;
+	}
+
+	VkMemoryRequirements memoryRequirements;
+	vkGetImageMemoryRequirements(handle.device, sceneTarget.handle, &memoryRequirements);
+
+	VkMemoryAllocateInfo memoryAllocateInfo = {};
+	memoryAllocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	memoryAllocateInfo.pNext = nullptr;
+	memoryAllocateInfo.allocationSize = memoryRequirements.size;
+	if (!GetMemoryType(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, memoryAllocateInfo.memoryTypeIndex)) {
+		std::cout << "NO DEVICE LOCAL MEMORY TYPE FOR SCENE IMAGE " << std::endl;
+		return false;
+	}
+
+	if ((vkAllocateMemory(handle.device, &memoryAllocateInfo, nullptr, &sceneTarget.deviceMemory) != VK_SUCCESS)
+		|| (vkBindImageMemory(handle.device, sceneTarget.handle, sceneTarget.deviceMemory, 0) != VK_SUCCESS)) {
+		std::cout << "COULD NOT ALLOCATE MEMORY FOR SCENE IMAGE " << std::endl;
+		return false;
+	}
+
+	VkImageViewCreateInfo imageViewCreateInfo = {};
+	imageViewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	imageViewCreateInfo.pNext = nullptr;
+	imageViewCreateInfo.flags = 0;
+	imageViewCreateInfo.image = sceneTarget.handle;
+	imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	imageViewCreateInfo.format = format;
+	imageViewCreateInfo.components = {
+		VK_COMPONENT_SWIZZLE_IDENTITY,
+		VK_COMPONENT_SWIZZLE_IDENTITY,
+		VK_COMPONENT_SWIZZLE_IDENTITY,
+		VK_COMPONENT_SWIZZLE_IDENTITY
+	};
+	imageViewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+	if (vkCreateImageView(handle.device, &imageViewCreateInfo, nullptr, &sceneTarget.view) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE SCENE IMAGE VIEW " << std::endl;
+		return false;
+	}
+
+	// Render pass leaves the image ready to be blitted from
+	VkAttachmentDescription attachmentDescription = {};
+	attachmentDescription.flags = 0;
+	attachmentDescription.format = format;
+	attachmentDescription.samples = VK_SAMPLE_COUNT_1_BIT;
+	attachmentDescription.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	attachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachmentDescription.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+	VkAttachmentReference colorAttachmentReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+
+	VkSubpassDescription subpassDescription = {};
+	subpassDescription.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpassDescription.colorAttachmentCount = 1;
+	subpassDescription.pColorAttachments = &colorAttachmentReference;
+
+	// One target is shared by all frames - previous frame's blit has to finish reading it before it's overwritten
+	VkSubpassDependency dependencies[2] = {};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[0].srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dependencyFlags = 0;
+
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	dependencies[1].dependencyFlags = 0;
+
+	VkRenderPassCreateInfo renderPassCreateInfo = {};
+	renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassCreateInfo.pNext = nullptr;
+	renderPassCreateInfo.flags = 0;
+	renderPassCreateInfo.attachmentCount = 1;
+	renderPassCreateInfo.pAttachments = &attachmentDescription;
+	renderPassCreateInfo.subpassCount = 1;
+	renderPassCreateInfo.pSubpasses = &subpassDescription;
+	renderPassCreateInfo.dependencyCount = 2;
+	renderPassCreateInfo.pDependencies = dependencies;
+
+	if (vkCreateRenderPass(handle.device, &renderPassCreateInfo, nullptr, &sceneRenderPass) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE SCENE RENDER PASS " << std::endl;
+		return false;
+	}
+
+	VkFramebufferCreateInfo frameBufferCreateInfo = {};
+	frameBufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+	frameBufferCreateInfo.pNext = nullptr;
+	frameBufferCreateInfo.flags = 0;
+	frameBufferCreateInfo.renderPass = sceneRenderPass;
+	frameBufferCreateInfo.attachmentCount = 1;
+	frameBufferCreateInfo.pAttachments = &sceneTarget.view;
+	frameBufferCreateInfo.width = swapchainParameters.extent.width;
+	frameBufferCreateInfo.height = swapchainParameters.extent.height;
+	frameBufferCreateInfo.layers = 1;
+
+	if (vkCreateFramebuffer(handle.device, &frameBufferCreateInfo, nullptr, &sceneFramebuffer) != VK_SUCCESS) {
+		std::cout << "COULD NOT CREATE SCENE FRAME BUFFER " << std::endl;
+		return false;
+	}
+
+	recordedRenderExtents.assign(swapchainParameters.images.size(), VkExtent2D());
+	return true;
+}
+
+void VulkanBase::DestroySceneTarget()
+{
+	if (sceneFramebuffer != VK_NULL_HANDLE) {
+		vkDestroyFramebuffer(handle.device, sceneFramebuffer, nullptr);
+		sceneFramebuffer = VK_NULL_HANDLE;
+	}
+	if (sceneRenderPass != VK_NULL_HANDLE) {
+		vkDestroyRenderPass(handle.device, sceneRenderPass, nullptr);
+		sceneRenderPass = VK_NULL_HANDLE;
+	}
+	if (sceneTarget.view != VK_NULL_HANDLE) {
+		vkDestroyImageView(handle.device, sceneTarget.view, nullptr);
+		sceneTarget.view = VK_NULL_HANDLE;
+	}
+	if (sceneTarget.handle != VK_NULL_HANDLE) {
+		vkDestroyImage(handle.device, sceneTarget.handle, nullptr);
+		sceneTarget.handle = VK_NULL_HANDLE;
+	}
+	if (sceneTarget.deviceMemory != VK_NULL_HANDLE) {
+		vkFreeMemory(handle.device, sceneTarget.deviceMemory, nullptr);
+		sceneTarget.deviceMemory = VK_NULL_HANDLE;
+	}
+}
+
 void VulkanBase::Clear() {
 	if (handle.device != VK_NULL_HANDLE) {
 		vkDeviceWaitIdle(handle.device);
@@ -708,6 +1308,17 @@ void VulkanBase::Clear() {
 			vkDestroyCommandPool(handle.device, handle.presentQueueCommandPool, nullptr);
 			handle.presentQueueCommandPool = VK_NULL_HANDLE;
 		}
+		captureCommandBuffers.clear();
+
+		for (VkFence fence : handle.presentQueueFences) {
+			if (fence != VK_NULL_HANDLE) {
+				vkDestroyFence(handle.device, fence, nullptr);
+			}
+		}
+		handle.presentQueueFences.clear();
+
+		gpuTimer.Destroy();
+		DestroySceneTarget();
 	}
 }
 
@@ -725,23 +1336,129 @@ bool VulkanBase::OnWindowSizeChanged() {
 	return true;
 }
 
-bool VulkanBase::Draw()
+void VulkanBase::QueryPresentationTiming()
 {
-	uint32_t imageIndex;
-	VkResult result = vkAcquireNextImageKHR(handle.device, handle.swapChain, UINT32_MAX, handle.imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
-	
+	uint32_t timingCount = 0;
+	if ((vkGetPastPresentationTimingGOOGLE(handle.device, handle.swapChain, &timingCount, nullptr) != VK_SUCCESS) || (timingCount == 0)) {
+		return;
+	}
+
+	std::vector<VkPastPresentationTimingGOOGLE> timings(timingCount);
+	if (vkGetPastPresentationTimingGOOGLE(handle.device, handle.swapChain, &timingCount, timings.data()) != VK_SUCCESS) {
+		return;
+	}
+	for (uint32_t i = 0; i < timingCount; ++i) {
+		framePacing.OnPresentationTiming(timings[i]);
+	}
+}
+
+bool VulkanBase::AcquireNextImage()
+{
+	// Swapchain with a different number of images works better with the measured present intervals
+	if (framePacing.ConsumeSwapchainRecreateRequest()) {
+		if (!OnWindowSizeChanged()) {
+			return false;
+		}
+	}
+
+	VkResult result = vkAcquireNextImageKHR(handle.device, handle.swapChain, UINT32_MAX, handle.imageAvailableSemaphore, VK_NULL_HANDLE, &acquiredImageIndex);
+
 	switch (result)
 	{
 	case VK_SUCCESS:
 	case VK_SUBOPTIMAL_KHR:
-		break;
+		imageAcquired = true;
+		latencyMonitor.MarkAcquired();
+		return true;
 	case VK_ERROR_OUT_OF_DATE_KHR:
 		return OnWindowSizeChanged();
-	
+
 	default:
 		std::cout << "COULD NOT ACQUIRE SWAPCHAIN IMAGE " << std::endl;
 		return false;
 	}
+}
+
+bool VulkanBase::WaitForNextFrame()
+{
+	// Low latency mode acquires ahead, so blocking on a free swapchain image happens before input is sampled
+	if (lowLatencyMode && !imageAcquired) {
+		if (!AcquireNextImage()) {
+			return false;
+		}
+	}
+
+	// Start the frame as late as possible so it still makes the next refresh
+	framePacing.WaitForFrameStart();
+	return true;
+}
+
+void VulkanBase::OnInputSampled(std::chrono::steady_clock::time_point inputTime)
+{
+	latencyMonitor.MarkInput(inputTime);
+}
+
+bool VulkanBase::Draw()
+{
+	if (!imageAcquired) {
+		if (!AcquireNextImage()) {
+			return false;
+		}
+		if (!imageAcquired) {
+			// Swapchain was recreated, nothing to draw into this time
+			return true;
+		}
+	}
+	imageAcquired = false;
+	uint32_t imageIndex = acquiredImageIndex;
+	latencyMonitor.MarkStarted();
+
+	// Acquired image may still be read by its previous frame, its command buffer can't be touched before that finishes
+	VkFence fence = handle.presentQueueFences[imageIndex];
+	if (vkWaitForFences(handle.device, 1, &fence, VK_TRUE, UINT64_MAX) != VK_SUCCESS) {
+		std::cout << "WAITING FOR FENCE TOOK TOO LONG " << std::endl;
+		return false;
+	}
+
+	double gpuTime = 0.0;
+	if (gpuTimer.GetResult(imageIndex, gpuTime)) {
+		framePacing.OnGpuFrameTime(gpuTime);
+		latencyMonitor.SetGpuTime(gpuTime);
+		if (dynamicResolutionEnabled) {
+			dynamicResolution.Update(gpuTime);
+		}
+	}
+
+	// Scale may have changed since this image's command buffer was recorded
+	if (dynamicResolutionEnabled) {
+		VkExtent2D renderExtent = dynamicResolution.GetRenderExtent(swapchainParameters.extent);
+		const VkExtent2D& recordedExtent = recordedRenderExtents[imageIndex];
+		if ((renderExtent.width != recordedExtent.width) || (renderExtent.height != recordedExtent.height)) {
+			if (!RecordCommandBuffer(imageIndex)) {
+				std::cout << "COULD NOT RECORD COMMAND BUFFER " << std::endl;
+				return false;
+			}
+		}
+	}
+
+	if (vkResetFences(handle.device, 1, &fence) != VK_SUCCESS) {
+		return false;
+	}
+
+	// Captured frames get their copy appended to the same submission. Frames are skipped (never waited for)
+	// while every readback slot is busy.
+	ReadbackTicket captureTicket;
+	bool capturing = false;
+	if (frameCapture && frameCapture->BeginFrame(swapchainParameters.extent, swapchainParameters.format, captureTicket)) {
+		capturing = RecordCaptureCommandBuffer(imageIndex, captureTicket);
+		if (!capturing) {
+			frameCapture->CancelFrame(captureTicket);
+		}
+	}
+
+	VkCommandBuffer commandBuffers[2] = { handle.presentQueueCommandBuffers[imageIndex], capturing ? captureCommandBuffers[imageIndex] : VK_NULL_HANDLE };
+	VkSemaphore signalSemaphores[2] = { handle.renderingFinishedSemaphore, captureTicket.semaphore };
+	uint64_t signalValues[2] = { 0, captureTicket.value };
 
 	VkPipelineStageFlags wait_Dst_StageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
 	VkSubmitInfo submitInfo = {};
@@ -750,14 +1467,34 @@ bool VulkanBase::Draw()
 	submitInfo.waitSemaphoreCount = 1;
 	submitInfo.pWaitSemaphores = &handle.imageAvailableSemaphore;
 	submitInfo.pWaitDstStageMask = &wait_Dst_StageMask;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &handle.presentQueueCommandBuffers[imageIndex];
+	submitInfo.commandBufferCount = capturing ? 2 : 1;
+	submitInfo.pCommandBuffers = commandBuffers;
 	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = &handle.renderingFinishedSemaphore;
+	submitInfo.pSignalSemaphores = signalSemaphores;
+
+	// Value of the binary semaphore is ignored
+	VkTimelineSemaphoreSubmitInfoKHR timelineSubmitInfo = {};
+	timelineSubmitInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+	timelineSubmitInfo.pNext = nullptr;
+	timelineSubmitInfo.waitSemaphoreValueCount = 0;
+	timelineSubmitInfo.pWaitSemaphoreValues = nullptr;
+	timelineSubmitInfo.signalSemaphoreValueCount = 2;
+	timelineSubmitInfo.pSignalSemaphoreValues = signalValues;
+	if (capturing && (captureTicket.semaphore != VK_NULL_HANDLE)) {
+		submitInfo.pNext = &timelineSubmitInfo;
+		submitInfo.signalSemaphoreCount = 2;
+	}
 
-	if (vkQueueSubmit(handle.presentQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+	if (vkQueueSubmit(handle.presentQueue, 1, &submitInfo, fence) != VK_SUCCESS) {
+		if (capturing) {
+			frameCapture->CancelFrame(captureTicket);
+		}
 		return false;
 	}
+	latencyMonitor.MarkSubmitted();
+	if (capturing) {
+		frameCapture->CommitFrame(captureTicket, swapchainParameters.format);
+	}
 
 	VkPresentInfoKHR presentInfo = {};
 	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -773,7 +1510,28 @@ bool VulkanBase::Draw()
 //	a single value returned by the whole function is the same as the worst result value from all swap chains.
 	presentInfo.pResults = nullptr;
 
-	result = vkQueuePresentKHR(handle.presentQueue, &presentInfo);
+	const bool displayTiming = IsDeviceExtensionEnabled(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+	VkPresentTimeGOOGLE presentTime = {};
+	VkPresentTimesInfoGOOGLE presentTimesInfo = {};
+	if (displayTiming) {
+		// Zero desired time means "as soon as possible", the id lets us read back when it actually happened
+		presentTime.presentID = framePacing.NextPresentId();
+		presentTime.desiredPresentTime = 0;
+
+		presentTimesInfo.sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE;
+		presentTimesInfo.pNext = nullptr;
+		presentTimesInfo.swapchainCount = 1;
+		presentTimesInfo.pTimes = &presentTime;
+		presentInfo.pNext = &presentTimesInfo;
+	}
+
+	VkResult result = vkQueuePresentKHR(handle.presentQueue, &presentInfo);
+	framePacing.OnFramePresented();
+	latencyMonitor.MarkPresented();
+	if (displayTiming) {
+		QueryPresentationTiming();
+	}
+
 	switch (result)
 	{
 	case VK_SUCCESS:
@@ -790,45 +1548,91 @@ bool VulkanBase::Draw()
 	return true;
 }
 
+bool VulkanBase::PrepareInstance()
+{
+	if (instanceReady) {
+		return true;
+	}
+
+	if (!RunStartupStage("load library", &VulkanBase::LoadVulkanLibrary)) {
+		return false;
+	}
+
+	if (!RunStartupStage("exported functions", &VulkanBase::LoadExportedFunctions)) {
+		return false;
+	}
+
+	if (!RunStartupStage("global entry points", &VulkanBase::LoadGlobalLevelEntryPoints)) {
+		return false;
+	}
+
+	if (!RunStartupStage("instance", &VulkanBase::CreateVulkanInstance)) {
+		return false;
+	}
+
+	if (!RunStartupStage("instance entry points", &VulkanBase::LoadInstanceLevelEntryPoints)) {
+		return false;
+	}
+
+	instanceReady = true;
+	return true;
+}
+
 bool VulkanBase::PrepareVulkan(OS::WindowParameters parameters)
 {
 	window = parameters;
 
-	if (!LoadVulkanLibrary() )
+	// Usually already done on another thread while the window was being created
+	if (!PrepareInstance()) {
 		return false;
+	}
 
-	if (!LoadExportedFunctions()) {
+	// Disk read overlaps with device creation
+	StartPipelineCacheLoad();
+
+	if (!RunStartupStage("presentation surface", &VulkanBase::CreatePresentationSurface)) {
 		return false;
 	}
 
-	if (!LoadGlobalLevelEntryPoints()) {
+	if (!RunStartupStage("logical device", &VulkanBase::CreateLogicalDevice)) {
 		return false;
 	}
 
-	if (!CreateVulkanInstance()) {
+	if (!RunStartupStage("device entry points", &VulkanBase::LoadDeviceLevelEntryPoints)) {
 		return false;
 	}
 
-	if (!LoadInstanceLevelEntryPoints()) {
+	if (!RunStartupStage("device queues", &VulkanBase::GetDeviceQueue)) {
 		return false;
 	}
 
-	if (!CreatePresentationSurface()) {
+	if (!RunStartupStage("semaphores", &VulkanBase::CreateSemaphores)) {
 		return false;
 	}
-	if (!CreateLogicalDevice()) {
+
+	return true;
+}
+
+bool VulkanBase::PrepareVulkanHeadless()
+{
+	// No window and no swapchain - everything is rendered into offscreen images (benchmarks, CPU-only drivers)
+	headless = true;
+
+	if (!PrepareInstance()) {
 		return false;
 	}
 
-	if (!LoadDeviceLevelEntryPoints()) {
+	StartPipelineCacheLoad();
+
+	if (!RunStartupStage("logical device", &VulkanBase::CreateLogicalDevice)) {
 		return false;
 	}
 
-	if (!GetDeviceQueue()) {
+	if (!RunStartupStage("device entry points", &VulkanBase::LoadDeviceLevelEntryPoints)) {
 		return false;
 	}
 
-	if (!CreateSemaphores()) {
+	if (!RunStartupStage("device queues", &VulkanBase::GetDeviceQueue)) {
 		return false;
 	}
 
@@ -9,7 +9,18 @@
 
 #include "vulkan.h"
 #include "OperatingSystem.h"
+#include "FramePacing.h"
+#include "GpuTimer.h"
+#include "LatencyMonitor.h"
+#include "DynamicResolution.h"
+#include "StartupProfiler.h"
+#include "VulkanDispatch.h"
+#include "DeviceSelection.h"
+#include "FrameCapture.h"
 #include<iostream>
+#include <future>
+#include <memory>
+#include <string>
 #include "vector"
 
 struct QueueParameters {
@@ -82,11 +93,16 @@ public:
 	VkQueue presentQueue = VK_NULL_HANDLE;
 	uint32_t graphicsQueueFamilyIndex = 0;
 	uint32_t presentationQueueFamilyIndex = 0;
+	VkQueue computeQueue = VK_NULL_HANDLE;			// Same as the graphics queue when there's no compute-only family
+	uint32_t computeQueueFamilyIndex = 0;
 	VkSurfaceKHR presentationSurface = VK_NULL_HANDLE;
 	VkSwapchainKHR swapChain = VK_NULL_HANDLE;
 	VkSemaphore imageAvailableSemaphore = VK_NULL_HANDLE;
 	VkSemaphore renderingFinishedSemaphore = VK_NULL_HANDLE;
+	std::vector<const char*> enabledInstanceExtensions;
+	std::vector<const char*> enabledDeviceExtensions;
 	std::vector<VkCommandBuffer> presentQueueCommandBuffers;
+	std::vector<VkFence> presentQueueFences;
 	VkCommandPool presentQueueCommandPool = VK_NULL_HANDLE;
 
 	VkRenderPass renderPass;
@@ -109,13 +125,50 @@ private:
 #endif
 
 	OS::WindowParameters window;
-
+	bool headless = false;
+	InstanceDispatchTable instanceDispatch;
+	DeviceDispatchTable deviceDispatch;
+	FramePacingController framePacing;
+	GpuTimer gpuTimer;
+	LatencyMonitor latencyMonitor;
+	bool lowLatencyMode = false;
+	bool imageAcquired = false;
+	uint32_t acquiredImageIndex = 0;
+	SwapChainParameters swapchainParameters;
+
+	// Dynamic resolution - scene is rendered into sceneTarget at a scaled size and blitted to the swapchain image
+	DynamicResolutionController dynamicResolution;
+	bool dynamicResolutionEnabled = false;
+	ImageParameters sceneTarget;
+	VkRenderPass sceneRenderPass = VK_NULL_HANDLE;
+	VkFramebuffer sceneFramebuffer = VK_NULL_HANDLE;
+	VkFilter sceneUpscaleFilter = VK_FILTER_LINEAR;
+	std::vector<VkExtent2D> recordedRenderExtents;
+
+	// Startup - instance creation may run on another thread, rarely needed objects are created on first use
+	StartupProfiler startupProfiler;
+	bool instanceReady = false;
+	std::string pipelineCachePath = "pipeline_cache.bin";
+	std::future<std::vector<char>> pipelineCacheLoad;
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
+	// Capture - presented images are copied out in the frame's own submission, one extra command buffer per image
+	bool captureEnabled = false;
+	CaptureOptions captureOptions;
+	std::unique_ptr<FrameCapture> frameCapture;
+	std::vector<VkCommandBuffer> captureCommandBuffers;
+
+	bool RunStartupStage(const char* name, bool (VulkanBase::*step)());
+	void StartPipelineCacheLoad();
+	void DestroyPipelineCache();
 	bool LoadVulkanLibrary();
 	bool LoadExportedFunctions();
 	bool LoadGlobalLevelEntryPoints();
 	bool LoadInstanceLevelEntryPoints();
 	bool LoadDeviceLevelEntryPoints();
 	bool CheckExtensionAvailability(const char* extension, const std::vector<VkExtensionProperties>& availableExtensions);
+	bool IsInstanceExtensionEnabled(const char* extension) const;
+	bool IsDeviceExtensionEnabled(const char* extension) const;
 	bool CreateVulkanInstance();
 	bool CreateLogicalDevice();
 	bool CheckPhysicalDeviceProperties(VkPhysicalDevice device, uint32_t& selectedGraphicsQueuefamilyIndex, uint32_t& selectedPpresentQueueFamilyIndex);
@@ -123,7 +176,14 @@ private:
 	bool CreatePresentationSurface();
 	bool CreateSemaphores();
 	bool RecordCommandBuffers();
+	bool RecordCommandBuffer(uint32_t imageIndex);
+	bool StartCapture();
+	bool RecordCaptureCommandBuffer(uint32_t imageIndex, const ReadbackTicket& ticket);
+	bool CreateSceneTarget();
+	void DestroySceneTarget();
 	void Clear();
+	void QueryPresentationTiming();
+	bool AcquireNextImage();
 
 	uint32_t GetSwapChainNumImages(VkSurfaceCapabilitiesKHR& surfaceCapabilities);
 	VkSurfaceFormatKHR GetSwapChainFormat(std::vector<VkSurfaceFormatKHR>& surfaceFormats);
@@ -138,17 +198,40 @@ public:
 
 	VkPhysicalDevice GetPhysicalDevice() const;
 	VkDevice GetDevice() const;
+	const InstanceDispatchTable& GetInstanceDispatch() const;
+	const DeviceDispatchTable& GetDeviceDispatch() const;
 
 	const QueueParameters GetGraphicsQueue() const;
 	const QueueParameters GetPresentQueue() const;
 
 	const SwapChainParameters& GetSwapChain() const;
+	FramePacingController& GetFramePacing();
+	const LatencyMonitor& GetLatencyMonitor() const;
+	void SetLowLatencyMode(bool enable);
+	void SetDynamicResolution(bool enable, const DynamicResolutionParameters& parameters = DynamicResolutionParameters());
+	const DynamicResolutionController& GetDynamicResolution() const;
+	bool GetMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags properties, uint32_t& memoryType) const;
+	DeviceContext GetDeviceContext() const;
+	StartupProfiler& GetStartupProfiler();
+	// Empty path keeps the cache in memory only
+	void SetPipelineCachePath(const std::string& path);
+	VkPipelineCache GetPipelineCache();
+	// Call before the swapchain is created, the stream keeps the size of the first swapchain
+	void SetCapture(const CaptureOptions& options);
+	// Writes out the frames still in flight, false when the capture failed
+	bool StopCapture();
+	CaptureStats GetCaptureStats() const;
 
 	bool CreateSwapchain();
 	bool CreateCommandBuffers();
 	bool OnWindowSizeChanged() override;
+	bool WaitForNextFrame() override;
+	void OnInputSampled(std::chrono::steady_clock::time_point inputTime) override;
 	bool Draw() override;
+	// Doesn't need the window, so it can run on another thread while the window is being created
+	bool PrepareInstance();
 	bool PrepareVulkan( OS::WindowParameters parameters);
+	bool PrepareVulkanHeadless();
 
 };
 
@@ -0,0 +1,82 @@
+#include "VulkanDispatch.h"
+#include "VulkanFunctions.h"
+#include <cstring>
+#include <iostream>
+
+namespace {
+	bool IsExtensionEnabled(const std::vector<const char*>& enabledExtensions, const char* extension) {
+		for (const char* enabled : enabledExtensions) {
+			if (strcmp(enabled, extension) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+bool InstanceDispatchTable::Load(VkInstance instanceHandle, const std::vector<const char*>& enabledExtensions) {
+	instance = instanceHandle;
+
+#define VK_INSTANCE_LEVEL_FUNCTION( fun )											\
+	if( !(fun = (PFN_##fun) ::vkGetInstanceProcAddr( instance, #fun)) ){			\
+		std::cout << "COULD NOT LOAD INSTANCE LEVEL FUNCTION " << #fun << std::endl;	\
+		return false;																\
+	}																				\
+
+#define VK_INSTANCE_LEVEL_FUNCTION_FROM_EXTENSION( fun, extension )				\
+	if( IsExtensionEnabled(enabledExtensions, extension) ) {						\
+		if( !(fun = (PFN_##fun) ::vkGetInstanceProcAddr( instance, #fun)) ){		\
+			std::cout << "COULD NOT LOAD INSTANCE LEVEL FUNCTION " << #fun << std::endl;	\
+			return false;															\
+		}																			\
+	}																				\
+
+#include "ListofFunctions.inl"
+	return true;
+}
+
+void InstanceDispatchTable::MakeCurrent() const {
+#define VK_INSTANCE_LEVEL_FUNCTION( fun ) ::fun = fun;
+#define VK_INSTANCE_LEVEL_FUNCTION_FROM_EXTENSION( fun, extension ) ::fun = fun;
+#include "ListofFunctions.inl"
+}
+
+bool DeviceDispatchTable::Load(const InstanceDispatchTable& instanceTable, VkDevice deviceHandle, const std::vector<const char*>& enabledExtensions) {
+	device = deviceHandle;
+
+#define VK_DEVICE_LEVEL_FUNCTION( fun )											\
+	if( !(fun = (PFN_##fun) instanceTable.vkGetDeviceProcAddr(device, #fun)) ){		\
+		std::cout << "COULD NOT LOAD DEVICE LEVEL FUNCTION " << #fun << std::endl;	\
+		return false;																\
+	}																				\
+
+#define VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION( fun, extension )					\
+	if( IsExtensionEnabled(enabledExtensions, extension) ) {						\
+		if( !(fun = (PFN_##fun) instanceTable.vkGetDeviceProcAddr(device, #fun)) ){	\
+			std::cout << "COULD NOT LOAD DEVICE LEVEL FUNCTION " << #fun << std::endl;	\
+			return false;															\
+		}																			\
+	}																				\
+
+#include "ListofFunctions.inl"
+	return true;
+}
+
+bool DeviceContext::GetMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags properties, uint32_t& memoryType) const {
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+	for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+		if ((memoryTypeBits & (1 << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)) {
+			memoryType = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+void DeviceDispatchTable::MakeCurrent() const {
+#define VK_DEVICE_LEVEL_FUNCTION( fun ) ::fun = fun;
+#define VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION( fun, extension ) ::fun = fun;
+#include "ListofFunctions.inl"
+}
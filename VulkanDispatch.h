@@ -0,0 +1,55 @@
+#pragma once
+#define VK_NO_PROTOTYPES
+
+#if defined _WIN32
+#define VK_USE_PLATFORM_WIN32_KHR
+#elif defined __linux__
+#define VK_USE_PLATFORM_XCB_KHR
+#endif
+
+#include "vulkan.h"
+#include <vector>
+
+// Entry points of one VkInstance, generated from ListofFunctions.inl.
+// Physical device functions always pass through the loader, it has to route them to the right driver.
+struct InstanceDispatchTable {
+	VkInstance instance = VK_NULL_HANDLE;
+
+#define VK_INSTANCE_LEVEL_FUNCTION( fun ) PFN_##fun fun = nullptr;
+#define VK_INSTANCE_LEVEL_FUNCTION_FROM_EXTENSION( fun, extension ) PFN_##fun fun = nullptr;
+#include "ListofFunctions.inl"
+
+	bool Load(VkInstance instanceHandle, const std::vector<const char*>& enabledExtensions);
+	// Points the global function pointers (VulkanFunctions.h) at this table
+	void MakeCurrent() const;
+};
+
+// Entry points of one VkDevice, generated from ListofFunctions.inl.
+// They come from vkGetDeviceProcAddr, so vkCmd* and vkQueue* calls go straight into the driver without the
+// loader's trampoline, and every device has its own table - any number of devices can be used side by side.
+struct DeviceDispatchTable {
+	VkDevice device = VK_NULL_HANDLE;
+
+#define VK_DEVICE_LEVEL_FUNCTION( fun ) PFN_##fun fun = nullptr;
+#define VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION( fun, extension ) PFN_##fun fun = nullptr;
+#include "ListofFunctions.inl"
+
+	bool Load(const InstanceDispatchTable& instanceTable, VkDevice deviceHandle, const std::vector<const char*>& enabledExtensions);
+	// Points the global function pointers (VulkanFunctions.h) at this table
+	void MakeCurrent() const;
+};
+
+// What code rendering on one logical device needs, so it doesn't depend on the global handle.
+// All devices come from the same instance, physical device queries use the global instance functions.
+struct DeviceContext {
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	const DeviceDispatchTable* dispatch = nullptr;
+	VkQueue graphicsQueue = VK_NULL_HANDLE;
+	uint32_t graphicsQueueFamilyIndex = 0;
+	VkQueue computeQueue = VK_NULL_HANDLE;				// Optional, compute work goes to the graphics queue without it
+	uint32_t computeQueueFamilyIndex = 0;
+	VkPipelineCache pipelineCache = VK_NULL_HANDLE;		// Optional
+	bool timelineSemaphores = false;					// VK_KHR_timeline_semaphore is enabled
+
+	bool GetMemoryType(uint32_t memoryTypeBits, VkMemoryPropertyFlags properties, uint32_t& memoryType) const;
+};
@@ -12,6 +12,8 @@
 #define VK_EXPORTED_FUNCTION( fun ) extern PFN_##fun fun;
 #define VK_GLOBAL_LEVEL_FUNCTION( fun ) extern PFN_##fun fun;
 #define VK_INSTANCE_LEVEL_FUNCTION( fun ) extern PFN_##fun fun;
+#define VK_INSTANCE_LEVEL_FUNCTION_FROM_EXTENSION( fun, extension ) extern PFN_##fun fun;
 #define VK_DEVICE_LEVEL_FUNCTION( fun ) extern PFN_##fun fun;		
+#define VK_DEVICE_LEVEL_FUNCTION_FROM_EXTENSION( fun, extension ) extern PFN_##fun fun;
 
 #include "ListofFunctions.inl"
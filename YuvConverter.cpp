@@ -0,0 +1,167 @@
+#include "YuvConverter.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define YUV_CONVERTER_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+	// BT.601 limited range in 8.8 fixed point, the same integer math in both paths
+	const int YR = 66, YG = 129, YB = 25;
+	const int UR = -38, UG = -74, UB = 112;
+	const int VR = 112, VG = -94, VB = -18;
+
+	inline uint8_t Luma(int r, int g, int b) {
+		return static_cast<uint8_t>(((YR * r + YG * g + YB * b + 128) >> 8) + 16);
+	}
+
+	inline uint8_t ChromaU(int r, int g, int b) {
+		return static_cast<uint8_t>(((UR * r + UG * g + UB * b + 128) >> 8) + 128);
+	}
+
+	inline uint8_t ChromaV(int r, int g, int b) {
+		return static_cast<uint8_t>(((VR * r + VG * g + VB * b + 128) >> 8) + 128);
+	}
+
+	struct ChannelOrder {
+		int r;
+		int b;
+	};
+
+	void LumaRowScalar(const uint8_t* row, uint32_t begin, uint32_t width, ChannelOrder order, uint8_t* y) {
+		for (uint32_t x = begin; x < width; ++x) {
+			const uint8_t* pixel = row + 4 * x;
+			y[x] = Luma(pixel[order.r], pixel[1], pixel[order.b]);
+		}
+	}
+
+	// Chroma samples from begin on, for the block rows row0 and row1 (the same row at the bottom of odd heights)
+	void ChromaRowScalar(const uint8_t* row0, const uint8_t* row1, uint32_t begin, uint32_t width, ChannelOrder order, uint8_t* u, uint8_t* v) {
+		const uint32_t chromaWidth = (width + 1) / 2;
+		for (uint32_t cx = begin; cx < chromaWidth; ++cx) {
+			const uint32_t x0 = 2 * cx;
+			const uint32_t x1 = (x0 + 1 < width) ? x0 + 1 : x0;
+			const uint8_t* p[4] = { row0 + 4 * x0, row0 + 4 * x1, row1 + 4 * x0, row1 + 4 * x1 };
+			const int r = (p[0][order.r] + p[1][order.r] + p[2][order.r] + p[3][order.r] + 2) >> 2;
+			const int g = (p[0][1] + p[1][1] + p[2][1] + p[3][1] + 2) >> 2;
+			const int b = (p[0][order.b] + p[1][order.b] + p[2][order.b] + p[3][order.b] + 2) >> 2;
+			u[cx] = ChromaU(r, g, b);
+			v[cx] = ChromaV(r, g, b);
+		}
+	}
+
+#if defined(YUV_CONVERTER_SSE2)
+	inline __m128i Coefficients(int r, int g, int b, bool bgra) {
+		return bgra ? _mm_setr_epi16(static_cast<short>(b), static_cast<short>(g), static_cast<short>(r), 0, static_cast<short>(b), static_cast<short>(g), static_cast<short>(r), 0)
+			: _mm_setr_epi16(static_cast<short>(r), static_cast<short>(g), static_cast<short>(b), 0, static_cast<short>(r), static_cast<short>(g), static_cast<short>(b), 0);
+	}
+
+	// a and b hold two 32-bit partial sums per pixel, returns the four per-pixel totals
+	inline __m128i AddPairs(__m128i a, __m128i b) {
+		const __m128 fa = _mm_castsi128_ps(a);
+		const __m128 fb = _mm_castsi128_ps(b);
+		const __m128i even = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0)));
+		const __m128i odd = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1)));
+		return _mm_add_epi32(even, odd);
+	}
+
+	// ((sum + 128) >> 8) + offset for four values
+	inline __m128i Scale(__m128i sum, int offset) {
+		return _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(128)), 8), _mm_set1_epi32(offset));
+	}
+
+	// Handles whole groups of eight pixels, returns how many pixels it processed
+	uint32_t LumaRowSse2(const uint8_t* row, uint32_t width, bool bgra, uint8_t* y) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i coefficients = Coefficients(YR, YG, YB, bgra);
+		uint32_t x = 0;
+		for (; x + 8 <= width; x += 8) {
+			const __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + 4 * x));
+			const __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + 4 * x + 16));
+
+			const __m128i y0 = AddPairs(_mm_madd_epi16(_mm_unpacklo_epi8(p0, zero), coefficients), _mm_madd_epi16(_mm_unpackhi_epi8(p0, zero), coefficients));
+			const __m128i y1 = AddPairs(_mm_madd_epi16(_mm_unpacklo_epi8(p1, zero), coefficients), _mm_madd_epi16(_mm_unpackhi_epi8(p1, zero), coefficients));
+
+			const __m128i packed = _mm_packs_epi32(Scale(y0, 16), Scale(y1, 16));
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(y + x), _mm_packus_epi16(packed, packed));
+		}
+		return x;
+	}
+
+	// Rounded averages of the two 2x2 blocks in four pixels of both rows, as [block0 channels, block1 channels]
+	inline __m128i BlockAverages(__m128i top, __m128i bottom) {
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i left = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+		const __m128i right = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+		const __m128i sums = _mm_unpacklo_epi64(_mm_add_epi16(left, _mm_srli_si128(left, 8)), _mm_add_epi16(right, _mm_srli_si128(right, 8)));
+		return _mm_srli_epi16(_mm_add_epi16(sums, _mm_set1_epi16(2)), 2);
+	}
+
+	inline void StoreChroma(__m128i values, uint8_t* output) {
+		const __m128i packed = _mm_packs_epi32(values, values);
+		const int bytes = _mm_cvtsi128_si32(_mm_packus_epi16(packed, packed));
+		output[0] = static_cast<uint8_t>(bytes);
+		output[1] = static_cast<uint8_t>(bytes >> 8);
+		output[2] = static_cast<uint8_t>(bytes >> 16);
+		output[3] = static_cast<uint8_t>(bytes >> 24);
+	}
+
+	// Handles whole groups of eight pixels (four chroma samples), returns how many chroma samples it produced
+	uint32_t ChromaRowSse2(const uint8_t* row0, const uint8_t* row1, uint32_t width, bool bgra, uint8_t* u, uint8_t* v) {
+		const __m128i uCoefficients = Coefficients(UR, UG, UB, bgra);
+		const __m128i vCoefficients = Coefficients(VR, VG, VB, bgra);
+		uint32_t x = 0;
+		for (; x + 8 <= width; x += 8) {
+			const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 4 * x));
+			const __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + 4 * x + 16));
+			const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 4 * x));
+			const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + 4 * x + 16));
+
+			const __m128i blocks01 = BlockAverages(a0, b0);
+			const __m128i blocks23 = BlockAverages(a1, b1);
+
+			StoreChroma(Scale(AddPairs(_mm_madd_epi16(blocks01, uCoefficients), _mm_madd_epi16(blocks23, uCoefficients)), 128), u + x / 2);
+			StoreChroma(Scale(AddPairs(_mm_madd_epi16(blocks01, vCoefficients), _mm_madd_epi16(blocks23, vCoefficients)), 128), v + x / 2);
+		}
+		return x / 2;
+	}
+#endif
+}
+
+size_t GetI420Size(uint32_t width, uint32_t height) {
+	const size_t chromaSize = static_cast<size_t>((width + 1) / 2) * ((height + 1) / 2);
+	return static_cast<size_t>(width) * height + 2 * chromaSize;
+}
+
+void ConvertToI420(const uint8_t* pixels, uint32_t width, uint32_t height, bool bgra, uint8_t* i420) {
+	const ChannelOrder order = bgra ? ChannelOrder{ 2, 0 } : ChannelOrder{ 0, 2 };
+	const size_t stride = static_cast<size_t>(width) * 4;
+	const uint32_t chromaWidth = (width + 1) / 2;
+
+	uint8_t* yPlane = i420;
+	uint8_t* uPlane = yPlane + static_cast<size_t>(width) * height;
+	uint8_t* vPlane = uPlane + static_cast<size_t>(chromaWidth) * ((height + 1) / 2);
+
+	for (uint32_t y = 0; y < height; y += 2) {
+		const uint8_t* row0 = pixels + y * stride;
+		const uint8_t* row1 = (y + 1 < height) ? row0 + stride : row0;
+		uint8_t* y0 = yPlane + static_cast<size_t>(y) * width;
+		uint8_t* u = uPlane + static_cast<size_t>(y / 2) * chromaWidth;
+		uint8_t* v = vPlane + static_cast<size_t>(y / 2) * chromaWidth;
+
+		uint32_t lumaDone = 0;
+		uint32_t chromaDone = 0;
+#if defined(YUV_CONVERTER_SSE2)
+		lumaDone = LumaRowSse2(row0, width, bgra, y0);
+		if (y + 1 < height) {
+			LumaRowSse2(row1, width, bgra, y0 + width);
+		}
+		chromaDone = ChromaRowSse2(row0, row1, width, bgra, u, v);
+#endif
+		LumaRowScalar(row0, lumaDone, width, order, y0);
+		if (y + 1 < height) {
+			LumaRowScalar(row1, lumaDone, width, order, y0 + width);
+		}
+		ChromaRowScalar(row0, row1, chromaDone, width, order, u, v);
+	}
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Bytes of an I420 image: full size Y plane, then quarter size U and V planes (odd sizes round up)
+size_t GetI420Size(uint32_t width, uint32_t height);
+
+// Converts tightly packed 8-bit RGBA (or BGRA) to planar I420 with BT.601 limited range coefficients,
+// each chroma sample is the average of a 2x2 block. Alpha is ignored.
+// Uses SSE2 when the compiler targets it, eight pixels per step; results are identical to the scalar path.
+void ConvertToI420(const uint8_t* pixels, uint32_t width, uint32_t height, bool bgra, uint8_t* i420);
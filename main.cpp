@@ -1,25 +1,135 @@
 #include "VulkanBase.h"
+#include "BatchRenderer.h"
+#include "Benchmark.h"
+#include "GoldenImage.h"
+#include "MultiGpu.h"
+#include <cstdlib>
+#include <future>
 
-int main() {
+int main(int argc, char* argv[]) {
+
+	// --benchmark : run the offscreen benchmark scenes without a window (see RunBenchmarks() for its options)
+	// --golden    : render the offscreen scenes and compare them with stored images (see RunGoldenTests())
+	// --multi-gpu : split offscreen frames and batch jobs across all GPUs (see RunMultiGpu())
+	// --batch     : render a manifest of jobs offscreen and write them as PNGs (see RunBatchRenderer())
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--benchmark") == 0) {
+			return RunBenchmarks(argc, argv);
+		}
+		if (strcmp(argv[i], "--golden") == 0) {
+			return RunGoldenTests(argc, argv);
+		}
+		if (strcmp(argv[i], "--multi-gpu") == 0) {
+			return RunMultiGpu(argc, argv);
+		}
+		if (strcmp(argv[i], "--batch") == 0) {
+			return RunBatchRenderer(argc, argv);
+		}
+	}
 
 	OS::Window window;
 	VulkanBase r;
+	bool lowLatency = false;
+	bool startupReport = false;
+	CaptureOptions capture;
+
+	// --on-demand : redraw only after expose, resize or input events (idle window doesn't use CPU)
+	// --fps N     : draw continuously, paced to N frames per second
+	// --latency   : prefer present modes and swapchain sizes with the lowest input-to-photon latency
+	// --power     : prefer vsync-limited presentation which never renders discarded frames
+	// --low-latency : acquire ahead, start frames just in time and report input-to-present latency
+	// --dynamic-resolution MS : scale the rendered resolution so GPU frames fit in MS milliseconds
+	// --startup-report : print how long each stage of the start took
+	// --capture FILE : record the presented frames into a Y4M file
+	// --capture-pipe CMD : pipe the Y4M stream into an encoder, e.g. "ffmpeg -i - capture.mp4"
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--on-demand") == 0) {
+			window.SetLoopMode(OS::LoopMode::OnDemand);
+		}
+		else if ((strcmp(argv[i], "--fps") == 0) && (i + 1 < argc)) {
+			capture.framesPerSecond = static_cast<uint32_t>(atoi(argv[++i]));
+			window.SetLoopMode(OS::LoopMode::Continuous, capture.framesPerSecond);
+		}
+		else if (strcmp(argv[i], "--latency") == 0) {
+			r.GetFramePacing().SetPolicy(PresentPolicy::LowLatency);
+		}
+		else if (strcmp(argv[i], "--power") == 0) {
+			r.GetFramePacing().SetPolicy(PresentPolicy::PowerSaving);
+		}
+		else if (strcmp(argv[i], "--low-latency") == 0) {
+			r.SetLowLatencyMode(true);
+			lowLatency = true;
+		}
+		else if ((strcmp(argv[i], "--dynamic-resolution") == 0) && (i + 1 < argc)) {
+			DynamicResolutionParameters parameters;
+			parameters.frameBudgetMs = atof(argv[++i]);
+			r.SetDynamicResolution(true, parameters);
+		}
+		else if (strcmp(argv[i], "--startup-report") == 0) {
+			startupReport = true;
+		}
+		else if ((strcmp(argv[i], "--capture") == 0) && (i + 1 < argc)) {
+			capture.path = argv[++i];
+		}
+		else if ((strcmp(argv[i], "--capture-pipe") == 0) && (i + 1 < argc)) {
+			capture.pipeCommand = argv[++i];
+		}
+	}
+	if (!capture.path.empty() || !capture.pipeCommand.empty()) {
+		r.SetCapture(capture);
+	}
+
+	// Loader and driver initialization don't need the window, so the instance is created on a worker while the
+	// window is mapped. The window itself stays on this thread, which is the only one receiving its messages.
+	std::future<bool> instanceReady = std::async(std::launch::async, [&r]() {
+		return r.PrepareInstance();
+	});
 
-	if (!window.Create(L"Vulkan Example")) {
+	bool windowCreated = false;
+	{
+		StartupStage stage(r.GetStartupProfiler(), "window");
+		windowCreated = window.Create(OS_WINDOW_TITLE("Vulkan Example"));
+	}
+	if (!instanceReady.get() || !windowCreated) {
 		return -1;
 	}
 	r.PrepareVulkan(window.GetParameters());
 
-	if (!r.CreateSwapchain()) {
-		return -1;
+	{
+		StartupStage stage(r.GetStartupProfiler(), "swapchain");
+		if (!r.CreateSwapchain()) {
+			return -1;
+		}
 	}
 
-	if (!r.CreateCommandBuffers()) {
-		return -1;
+	{
+		StartupStage stage(r.GetStartupProfiler(), "command buffers");
+		if (!r.CreateCommandBuffers()) {
+			return -1;
+		}
+	}
+
+	if (startupReport) {
+		r.GetStartupProfiler().Print(std::cout);
 	}
 
 	if (!window.RenderingLoop(r)) {
 		return -1;
 	}
+
+	if (lowLatency) {
+		r.GetLatencyMonitor().Print(std::cout);
+	}
+	if (!capture.path.empty() || !capture.pipeCommand.empty()) {
+		const bool captured = r.StopCapture();
+		const CaptureStats stats = r.GetCaptureStats();
+		std::cout << "Capture: " << stats.written << " frames written, " << stats.droppedReadback << " dropped waiting for readback, "
+			<< stats.droppedQueue << " dropped waiting for the writer, " << stats.droppedUnsupported << " of another size, "
+			<< stats.droppedFailed << " failed"
+			<< (captured ? "" : " - CAPTURE FAILED") << std::endl;
+	}
+	if (r.GetDynamicResolution().GetScale() < 1.0) {
+		std::cout << "Final resolution scale: " << r.GetDynamicResolution().GetScale() << std::endl;
+	}
 	return true;
 }